@@ -44,6 +44,7 @@
 #endif				/* HAVE_CONFIG_H */
 
 #include <stdlib.h>
+#include <string.h>
 #include <complib/cl_dispatcher.h>
 #include <complib/cl_thread.h>
 #include <complib/cl_timer.h>
@@ -56,11 +57,68 @@
 #define CL_DISP_INITIAL_REG_COUNT   16
 #define CL_DISP_REG_GROW_SIZE       16
 
+/* messages each priority may take per scheduling round */
+static const unsigned cl_disp_prio_weight[CL_DISP_PRIO_MAX] = { 16, 4, 1 };
+
+/********************************************************************
+   disp_get_msg
+
+   Description:
+   Picks the next message to process: the head message of the first
+   registration in the highest priority ready list which has credits
+   left. When all non empty priorities ran out of credits a new round
+   starts. Must be called with the Dispatcher lock held.
+********************************************************************/
+static cl_disp_msg_t *disp_get_msg(IN cl_dispatcher_t * const p_disp)
+{
+	cl_disp_reg_info_t *p_reg;
+	cl_disp_msg_t *p_msg;
+	uint64_t queue_time;
+	int round, prio;
+
+	if (!p_disp->msg_count)
+		return NULL;
+
+	for (round = 0; round < 2; round++) {
+		for (prio = 0; prio < CL_DISP_PRIO_MAX; prio++) {
+			if (!p_disp->credits[prio] ||
+			    cl_is_qlist_empty(&p_disp->ready_list[prio]))
+				continue;
+
+			p_disp->credits[prio]--;
+			p_reg = PARENT_STRUCT(cl_qlist_remove_head
+					      (&p_disp->ready_list[prio]),
+					      cl_disp_reg_info_t, ready_item);
+			p_msg = (cl_disp_msg_t *)
+			    cl_qlist_remove_head(&p_reg->msg_fifo);
+			if (!cl_is_qlist_empty(&p_reg->msg_fifo))
+				cl_qlist_insert_tail(&p_disp->ready_list[prio],
+						     &p_reg->ready_item);
+			p_disp->msg_count--;
+
+			/* we track the time the last message spent in the queue */
+			queue_time = cl_get_time_stamp() - p_msg->in_time;
+			p_disp->last_msg_queue_time_us = queue_time;
+			p_reg->msgs++;
+			p_reg->total_queue_time_us += queue_time;
+			if (queue_time > p_reg->max_queue_time_us)
+				p_reg->max_queue_time_us = queue_time;
+
+			return p_msg;
+		}
+		memcpy(p_disp->credits, cl_disp_prio_weight,
+		       sizeof(p_disp->credits));
+	}
+
+	CL_ASSERT(FALSE);
+	return NULL;
+}
+
 /********************************************************************
    __cl_disp_worker
 
    Description:
-   This function takes messages off the FIFO and calls Processmsg()
+   This function takes messages off the queues and calls Processmsg()
    This function executes as passive level.
 
    Inputs:
@@ -79,16 +137,8 @@ void __cl_disp_worker(IN void *context)
 
 	cl_spinlock_acquire(&p_disp->lock);
 
-	/* Process the FIFO until we drain it dry. */
-	while (cl_qlist_count(&p_disp->msg_fifo)) {
-		/* Pop the message at the head from the FIFO. */
-		p_msg =
-		    (cl_disp_msg_t *) cl_qlist_remove_head(&p_disp->msg_fifo);
-
-		/* we track the time the last message spent in the queue */
-		p_disp->last_msg_queue_time_us =
-		    cl_get_time_stamp() - p_msg->in_time;
-
+	/* Process the queues until we drain them dry. */
+	while ((p_msg = disp_get_msg(p_disp))) {
 		/*
 		 * Release the spinlock while the message is processed.
 		 * The user's callback may reenter the dispatcher
@@ -120,11 +170,16 @@ void __cl_disp_worker(IN void *context)
 
 void cl_disp_construct(IN cl_dispatcher_t * const p_disp)
 {
+	int i;
+
 	CL_ASSERT(p_disp);
 
 	cl_qlist_init(&p_disp->reg_list);
 	cl_ptr_vector_construct(&p_disp->reg_vec);
-	cl_qlist_init(&p_disp->msg_fifo);
+	for (i = 0; i < CL_DISP_PRIO_MAX; i++)
+		cl_qlist_init(&p_disp->ready_list[i]);
+	memcpy(p_disp->credits, cl_disp_prio_weight, sizeof(p_disp->credits));
+	p_disp->msg_count = 0;
 	cl_spinlock_construct(&p_disp->lock);
 	cl_qpool_construct(&p_disp->msg_pool);
 }
@@ -229,6 +284,8 @@ cl_disp_reg_handle_t cl_disp_register(IN cl_dispatcher_t * const p_disp,
 	p_reg->pfn_rcv_callback = pfn_callback;
 	p_reg->context = context;
 	p_reg->msg_id = msg_id;
+	p_reg->prio = CL_DISP_PRIO_NORMAL;
+	cl_qlist_init(&p_reg->msg_fifo);
 
 	/* Insert the registration in the list. */
 	cl_qlist_insert_tail(&p_disp->reg_list, (cl_list_item_t *) p_reg);
@@ -337,8 +394,14 @@ cl_status_t cl_disp_post(IN const cl_disp_reg_handle_t handle,
 	/* Increment the recipient's reference count. */
 	cl_atomic_inc(&p_dest_reg->ref_cnt);
 
-	/* Queue the message in the FIFO. */
-	cl_qlist_insert_tail(&p_disp->msg_fifo, (cl_list_item_t *) p_msg);
+	/* Queue the message in the recipient FIFO. */
+	if (cl_is_qlist_empty(&p_dest_reg->msg_fifo))
+		cl_qlist_insert_tail(&p_disp->ready_list[p_dest_reg->prio],
+				     &p_dest_reg->ready_item);
+	cl_qlist_insert_tail(&p_dest_reg->msg_fifo, (cl_list_item_t *) p_msg);
+	if (cl_qlist_count(&p_dest_reg->msg_fifo) > p_dest_reg->max_depth)
+		p_dest_reg->max_depth = cl_qlist_count(&p_dest_reg->msg_fifo);
+	p_disp->msg_count++;
 	cl_spinlock_release(&p_disp->lock);
 
 	/* Signal the thread pool that there is work to be done. */
@@ -359,7 +422,51 @@ void cl_disp_get_queue_status(IN const cl_disp_reg_handle_t handle,
 		    p_disp->last_msg_queue_time_us / 1000;
 
 	if (p_num_queued_msgs)
-		*p_num_queued_msgs = cl_qlist_count(&p_disp->msg_fifo);
+		*p_num_queued_msgs = p_disp->msg_count;
 
 	cl_spinlock_release(&p_disp->lock);
 }
+
+void cl_disp_set_prio(IN const cl_disp_reg_handle_t handle,
+		      IN cl_disp_prio_t prio)
+{
+	cl_disp_reg_info_t *p_reg = (cl_disp_reg_info_t *) handle;
+	cl_dispatcher_t *p_disp = p_reg->p_disp;
+
+	CL_ASSERT(prio < CL_DISP_PRIO_MAX);
+
+	cl_spinlock_acquire(&p_disp->lock);
+	if (!cl_is_qlist_empty(&p_reg->msg_fifo)) {
+		cl_qlist_remove_item(&p_disp->ready_list[p_reg->prio],
+				     &p_reg->ready_item);
+		cl_qlist_insert_tail(&p_disp->ready_list[prio],
+				     &p_reg->ready_item);
+	}
+	p_reg->prio = prio;
+	cl_spinlock_release(&p_disp->lock);
+}
+
+cl_status_t cl_disp_get_msg_stats(IN cl_dispatcher_t * const p_disp,
+				  IN const cl_disp_msgid_t msg_id,
+				  OUT cl_disp_queue_stats_t * p_stats)
+{
+	cl_disp_reg_info_t *p_reg = NULL;
+
+	cl_spinlock_acquire(&p_disp->lock);
+	if (msg_id < cl_ptr_vector_get_size(&p_disp->reg_vec))
+		p_reg = cl_ptr_vector_get(&p_disp->reg_vec, msg_id);
+	if (!p_reg) {
+		cl_spinlock_release(&p_disp->lock);
+		return CL_NOT_FOUND;
+	}
+
+	p_stats->prio = p_reg->prio;
+	p_stats->depth = cl_qlist_count(&p_reg->msg_fifo);
+	p_stats->max_depth = p_reg->max_depth;
+	p_stats->msgs = p_reg->msgs;
+	p_stats->total_queue_time_us = p_reg->total_queue_time_us;
+	p_stats->max_queue_time_us = p_reg->max_queue_time_us;
+	cl_spinlock_release(&p_disp->lock);
+
+	return CL_SUCCESS;
+}
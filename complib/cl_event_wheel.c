@@ -47,31 +47,263 @@
 
 #define CL_DBG(fmt, ...)
 
-static cl_status_t __event_will_age_before(IN const cl_list_item_t *
-					   const p_list_item, IN void *context)
+#define CL_EVENT_WHEEL_HASH_BITS_MIN	6
+
+static inline uint64_t __event_tick(IN uint64_t aging_time)
+{
+	/* an event fires at the first tick not earlier than its time */
+	return (aging_time + 999) / 1000;
+}
+
+static inline unsigned __slot_index(IN uint64_t tick, IN unsigned level)
+{
+	return (tick >> (CL_EVENT_WHEEL_BITS * level)) &
+	    (CL_EVENT_WHEEL_SLOTS - 1);
+}
+
+static inline unsigned __slot_level(IN cl_event_wheel_t * const p_event_wheel,
+				    IN cl_qlist_t * p_slot)
+{
+	return (p_slot - &p_event_wheel->slots[0][0]) / CL_EVENT_WHEEL_SLOTS;
+}
+
+static inline cl_qlist_t *__hash_bucket(IN cl_event_wheel_t *
+					const p_event_wheel, IN uint64_t key)
+{
+	return &p_event_wheel->hash[(key * 0x9e3779b97f4a7c15ULL) >>
+				    (64 - p_event_wheel->hash_bits)];
+}
+
+/*
+ * Place the event in the lowest level whose range covers its distance
+ * from the current tick; events beyond the top level range are parked
+ * in the farthest top level slot and placed again when it cascades.
+ * Events due before min_tick are moved to it.
+ */
+static void __wheel_insert(IN cl_event_wheel_t * const p_event_wheel,
+			   IN cl_event_wheel_reg_info_t * p_event,
+			   IN uint64_t min_tick)
+{
+	uint64_t cur = p_event_wheel->cur_tick;
+	uint64_t tick = __event_tick(p_event->aging_time);
+	unsigned level;
+
+	if (tick < min_tick)
+		tick = min_tick;
+
+	for (level = 0; level < CL_EVENT_WHEEL_LEVELS - 1; level++)
+		if (tick - cur < 1ULL << (CL_EVENT_WHEEL_BITS * (level + 1)))
+			break;
+	if (tick - cur >= 1ULL << (CL_EVENT_WHEEL_BITS * CL_EVENT_WHEEL_LEVELS))
+		tick = cur +
+		    (1ULL << (CL_EVENT_WHEEL_BITS * CL_EVENT_WHEEL_LEVELS)) - 1;
+
+	p_event->p_slot =
+	    &p_event_wheel->slots[level][__slot_index(tick, level)];
+	cl_qlist_insert_tail(p_event->p_slot, &p_event->list_item);
+	p_event_wheel->level_count[level]++;
+}
+
+static void __wheel_remove(IN cl_event_wheel_t * const p_event_wheel,
+			   IN cl_event_wheel_reg_info_t * p_event)
+{
+	if (!p_event->p_slot)
+		return;
+	cl_qlist_remove_item(p_event->p_slot, &p_event->list_item);
+	p_event_wheel->level_count[__slot_level(p_event_wheel,
+						p_event->p_slot)]--;
+	p_event->p_slot = NULL;
+}
+
+/*
+ * Advance the wheel to now_tick, moving the aged events to p_expired.
+ * Ticks at which no slot can cascade or expire are skipped.
+ */
+static void __wheel_advance(IN cl_event_wheel_t * const p_event_wheel,
+			    IN uint64_t now_tick, IN cl_qlist_t * p_expired)
 {
-	uint64_t aging_time = *((uint64_t *) context);
 	cl_event_wheel_reg_info_t *p_event;
+	cl_list_item_t *p_list_item;
+	cl_qlist_t cascade, *p_slot;
+	uint64_t tick;
+	unsigned level, top;
+
+	while (p_event_wheel->cur_tick < now_tick) {
+		for (level = 0; level < CL_EVENT_WHEEL_LEVELS; level++)
+			if (p_event_wheel->level_count[level])
+				break;
+		if (level == CL_EVENT_WHEEL_LEVELS) {
+			p_event_wheel->cur_tick = now_tick;
+			break;
+		}
 
-	p_event =
-	    PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t, list_item);
+		tick = ((p_event_wheel->cur_tick >> (CL_EVENT_WHEEL_BITS *
+						     level)) + 1) <<
+		    (CL_EVENT_WHEEL_BITS * level);
+		if (tick > now_tick) {
+			p_event_wheel->cur_tick = now_tick;
+			break;
+		}
+		p_event_wheel->cur_tick = tick;
+
+		/* cascade the slots starting at this tick, highest first */
+		for (top = 1; top < CL_EVENT_WHEEL_LEVELS; top++)
+			if (__slot_index(tick, top - 1))
+				break;
+		for (level = top - 1; level > 0; level--) {
+			p_slot = &p_event_wheel->slots[level]
+			    [__slot_index(tick, level)];
+			p_event_wheel->level_count[level] -=
+			    cl_qlist_count(p_slot);
+			cl_qlist_init(&cascade);
+			cl_qlist_insert_list_tail(&cascade, p_slot);
+			while ((p_list_item = cl_qlist_remove_head(&cascade))
+			       != cl_qlist_end(&cascade)) {
+				p_event = PARENT_STRUCT(p_list_item,
+							cl_event_wheel_reg_info_t,
+							list_item);
+				/* the current tick slot is expired below */
+				__wheel_insert(p_event_wheel, p_event, tick);
+			}
+		}
 
-	if (p_event->aging_time < aging_time)
-		return CL_SUCCESS;
-	else
-		return CL_NOT_FOUND;
+		p_slot = &p_event_wheel->slots[0][__slot_index(tick, 0)];
+		p_event_wheel->level_count[0] -= cl_qlist_count(p_slot);
+		for (p_list_item = cl_qlist_head(p_slot);
+		     p_list_item != cl_qlist_end(p_slot);
+		     p_list_item = cl_qlist_next(p_list_item))
+			PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t,
+				      list_item)->p_slot = NULL;
+		cl_qlist_insert_list_tail(p_expired, p_slot);
+	}
+}
+
+/*
+ * The earliest tick something happens on the wheel: the first non
+ * empty level 0 slot or the start of the first non empty slot of a
+ * higher level, whichever comes first. 0 if the wheel is empty.
+ */
+static uint64_t __wheel_next_tick(IN cl_event_wheel_t * const p_event_wheel)
+{
+	uint64_t cur = p_event_wheel->cur_tick, base, next = 0, tick;
+	unsigned level, i, shift;
+
+	for (level = 0; level < CL_EVENT_WHEEL_LEVELS; level++) {
+		if (!p_event_wheel->level_count[level])
+			continue;
+		shift = CL_EVENT_WHEEL_BITS * level;
+		base = cur >> shift;
+		for (i = 1; i <= CL_EVENT_WHEEL_SLOTS; i++) {
+			if (cl_is_qlist_empty(&p_event_wheel->slots[level]
+					      [(base + i) &
+					       (CL_EVENT_WHEEL_SLOTS - 1)]))
+				continue;
+			tick = (base + i) << shift;
+			if (!next || tick < next)
+				next = tick;
+			break;
+		}
+	}
+
+	return next;
+}
+
+static void __wheel_start_timer(IN cl_event_wheel_t * const p_event_wheel,
+				IN uint64_t tick, IN uint64_t current_time)
+{
+	uint64_t timeout = 0;
+	uint32_t to;
+	cl_status_t cl_status;
+
+	if (tick * 1000 > current_time)
+		timeout = (tick * 1000 - current_time + 999) / 1000;
+
+	/* The timeout for the cl_timer_start should be given as uint32_t.
+	   if there is an overflow - warn about it. */
+	to = (uint32_t) timeout;
+	if (timeout > (uint32_t) timeout) {
+		to = 0xffffffff;	/* max 32 bit timer */
+		CL_DBG("__wheel_start_timer: timeout requested is "
+		       "too large. Using timeout: %u\n", to);
+	}
+
+	p_event_wheel->next_tick = tick;
+	CL_DBG("__wheel_start_timer: Restart timer in: %u [msec]\n", to);
+	cl_status = cl_timer_start(&p_event_wheel->timer, to);
+	if (cl_status != CL_SUCCESS) {
+		CL_DBG("__wheel_start_timer: ERR 6200: "
+		       "Failed to start timer\n");
+	}
+}
+
+static void __hash_grow(IN cl_event_wheel_t * const p_event_wheel)
+{
+	cl_qlist_t *old_hash = p_event_wheel->hash;
+	unsigned old_size = 1 << p_event_wheel->hash_bits, i;
+	cl_list_item_t *p_list_item;
+	cl_event_wheel_reg_info_t *p_event;
+	cl_qlist_t *new_hash;
+
+	new_hash = malloc(2 * old_size * sizeof(*new_hash));
+	if (!new_hash)
+		return;		/* keep the longer chains */
+	for (i = 0; i < 2 * old_size; i++)
+		cl_qlist_init(&new_hash[i]);
+
+	p_event_wheel->hash = new_hash;
+	p_event_wheel->hash_bits++;
+	for (i = 0; i < old_size; i++)
+		while ((p_list_item = cl_qlist_remove_head(&old_hash[i])) !=
+		       cl_qlist_end(&old_hash[i])) {
+			p_event = PARENT_STRUCT(p_list_item,
+						cl_event_wheel_reg_info_t,
+						hash_item);
+			cl_qlist_insert_tail(__hash_bucket(p_event_wheel,
+							   p_event->key),
+					     &p_event->hash_item);
+		}
+	free(old_hash);
+}
+
+static cl_event_wheel_reg_info_t *__hash_get(IN cl_event_wheel_t *
+					     const p_event_wheel,
+					     IN uint64_t key)
+{
+	cl_qlist_t *p_bucket = __hash_bucket(p_event_wheel, key);
+	cl_list_item_t *p_list_item;
+	cl_event_wheel_reg_info_t *p_event;
+
+	for (p_list_item = cl_qlist_head(p_bucket);
+	     p_list_item != cl_qlist_end(p_bucket);
+	     p_list_item = cl_qlist_next(p_list_item)) {
+		p_event = PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t,
+					hash_item);
+		if (p_event->key == key)
+			return p_event;
+	}
+	return NULL;
+}
+
+static void __event_free(IN cl_event_wheel_t * const p_event_wheel,
+			 IN cl_event_wheel_reg_info_t * p_event)
+{
+	__wheel_remove(p_event_wheel, p_event);
+	cl_qlist_remove_item(__hash_bucket(p_event_wheel, p_event->key),
+			     &p_event->hash_item);
+	p_event_wheel->num_events--;
+	/* delete the event info object - allocated by cl_event_wheel_reg */
+	free(p_event);
 }
 
 static void __cl_event_wheel_callback(IN void *context)
 {
 	cl_event_wheel_t *p_event_wheel = (cl_event_wheel_t *) context;
-	cl_list_item_t *p_list_item, *p_prev_event_list_item;
-	cl_list_item_t *p_list_next_item;
 	cl_event_wheel_reg_info_t *p_event;
+	cl_list_item_t *p_list_item;
+	cl_qlist_t expired;
 	uint64_t current_time;
 	uint64_t next_aging_time;
-	uint32_t new_timeout;
-	cl_status_t cl_status;
+	uint64_t next_tick;
 
 	/* might be during closing ...  */
 	if (p_event_wheel->closing)
@@ -88,16 +320,15 @@ static void __cl_event_wheel_callback(IN void *context)
 
 	cl_spinlock_acquire(&p_event_wheel->lock);
 
-	p_list_item = cl_qlist_head(&p_event_wheel->events_wheel);
-	if (p_list_item == cl_qlist_end(&p_event_wheel->events_wheel))
-		/* the list is empty - nothing to do */
-		goto Exit;
+	p_event_wheel->next_tick = 0;
+	cl_qlist_init(&expired);
+	__wheel_advance(p_event_wheel, current_time / 1000, &expired);
 
-	/* we found such an item. get the p_event */
-	p_event =
-	    PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t, list_item);
+	while ((p_list_item = cl_qlist_remove_head(&expired)) !=
+	       cl_qlist_end(&expired)) {
+		p_event = PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t,
+					list_item);
 
-	while (p_event->aging_time <= current_time) {
 		/* this object has aged - invoke it's callback */
 		if (p_event->pfn_aged_callback)
 			next_aging_time =
@@ -107,81 +338,23 @@ static void __cl_event_wheel_callback(IN void *context)
 		else
 			next_aging_time = 0;
 
-		/* point to the next object in the wheel */
-		p_list_next_item = cl_qlist_next(p_list_item);
-
 		/* We need to retire the event if the next aging time passed */
-		if (next_aging_time < current_time) {
-			/* remove it from the map */
-			cl_qmap_remove_item(&p_event_wheel->events_map,
-					    &(p_event->map_item));
-
-			/* pop p_event from the wheel */
-			cl_qlist_remove_head(&p_event_wheel->events_wheel);
-
-			/* delete the event info object - allocated by cl_event_wheel_reg */
-			free(p_event);
-		} else {
+		if (next_aging_time < current_time)
+			__event_free(p_event_wheel, p_event);
+		else {
 			/* update the required aging time */
 			p_event->aging_time = next_aging_time;
 			p_event->num_regs++;
-
-			/* do not remove from the map  - but remove from the list head and
-			   place in the correct position */
-
-			/* pop p_event from the wheel */
-			cl_qlist_remove_head(&p_event_wheel->events_wheel);
-
-			/* find the event that ages just before */
-			p_prev_event_list_item =
-			    cl_qlist_find_from_tail(&p_event_wheel->
-						    events_wheel,
-						    __event_will_age_before,
-						    &p_event->aging_time);
-
-			/* insert just after */
-			cl_qlist_insert_next(&p_event_wheel->events_wheel,
-					     p_prev_event_list_item,
-					     &p_event->list_item);
-
-			/* as we have modified the list - restart from first item: */
-			p_list_next_item =
-			    cl_qlist_head(&p_event_wheel->events_wheel);
+			__wheel_insert(p_event_wheel, p_event,
+				       p_event_wheel->cur_tick + 1);
 		}
-
-		/* advance to next event */
-		p_list_item = p_list_next_item;
-		if (p_list_item == cl_qlist_end(&p_event_wheel->events_wheel))
-			/* the list is empty - nothing to do */
-			break;
-
-		/* get the p_event */
-		p_event =
-		    PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t,
-				  list_item);
 	}
 
-	/* We need to restart the timer only if the list is not empty now */
-	if (p_list_item != cl_qlist_end(&p_event_wheel->events_wheel)) {
-		/* get the p_event */
-		p_event =
-		    PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t,
-				  list_item);
-
-		/* start the timer to the timeout [msec] */
-		new_timeout =
-		    (uint32_t) ((p_event->aging_time - current_time + 500) / 1000);
-		CL_DBG("__cl_event_wheel_callback: Restart timer in: "
-		       "%u [msec]\n", new_timeout);
-		cl_status = cl_timer_start(&p_event_wheel->timer, new_timeout);
-		if (cl_status != CL_SUCCESS) {
-			CL_DBG("__cl_event_wheel_callback: ERR 6200: "
-			       "Failed to start timer\n");
-		}
-	}
+	/* We need to restart the timer only if the wheel is not empty now */
+	next_tick = __wheel_next_tick(p_event_wheel);
+	if (next_tick)
+		__wheel_start_timer(p_event_wheel, next_tick, current_time);
 
-	/* release the lock */
-Exit:
 	cl_spinlock_release(&p_event_wheel->lock);
 	if (NULL != p_event_wheel->p_external_lock)
 		cl_spinlock_release(p_event_wheel->p_external_lock);
@@ -194,11 +367,13 @@ void cl_event_wheel_construct(IN cl_event_wheel_t * const p_event_wheel)
 {
 	cl_spinlock_construct(&(p_event_wheel->lock));
 	cl_timer_construct(&(p_event_wheel->timer));
+	p_event_wheel->hash = NULL;
 }
 
 cl_status_t cl_event_wheel_init(IN cl_event_wheel_t * const p_event_wheel)
 {
 	cl_status_t cl_status = CL_SUCCESS;
+	unsigned level, i;
 
 	/* initialize */
 	p_event_wheel->p_external_lock = NULL;
@@ -206,8 +381,23 @@ cl_status_t cl_event_wheel_init(IN cl_event_wheel_t * const p_event_wheel)
 	cl_status = cl_spinlock_init(&(p_event_wheel->lock));
 	if (cl_status != CL_SUCCESS)
 		return cl_status;
-	cl_qlist_init(&p_event_wheel->events_wheel);
-	cl_qmap_init(&p_event_wheel->events_map);
+
+	for (level = 0; level < CL_EVENT_WHEEL_LEVELS; level++) {
+		for (i = 0; i < CL_EVENT_WHEEL_SLOTS; i++)
+			cl_qlist_init(&p_event_wheel->slots[level][i]);
+		p_event_wheel->level_count[level] = 0;
+	}
+	p_event_wheel->cur_tick = cl_get_time_stamp() / 1000;
+	p_event_wheel->next_tick = 0;
+	p_event_wheel->num_events = 0;
+
+	p_event_wheel->hash_bits = CL_EVENT_WHEEL_HASH_BITS_MIN;
+	p_event_wheel->hash = malloc((1 << p_event_wheel->hash_bits) *
+				     sizeof(*p_event_wheel->hash));
+	if (!p_event_wheel->hash)
+		return CL_INSUFFICIENT_MEMORY;
+	for (i = 0; i < 1 << p_event_wheel->hash_bits; i++)
+		cl_qlist_init(&p_event_wheel->hash[i]);
 
 	/* init the timer with timeout */
 	cl_status = cl_timer_init(&p_event_wheel->timer, __cl_event_wheel_callback, p_event_wheel);	/* cb context */
@@ -232,52 +422,50 @@ void cl_event_wheel_dump(IN cl_event_wheel_t * const p_event_wheel)
 {
 	cl_list_item_t *p_list_item;
 	cl_event_wheel_reg_info_t __attribute__((__unused__)) *p_event;
-
-	p_list_item = cl_qlist_head(&p_event_wheel->events_wheel);
-
-	while (p_list_item != cl_qlist_end(&p_event_wheel->events_wheel)) {
-		p_event =
-		    PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t,
-				  list_item);
-		CL_DBG("cl_event_wheel_dump: Found event key:<0x%"
-		       PRIx64 ">, num_regs:%d, aging time:%" PRIu64 "\n",
-		       p_event->key, p_event->num_regs, p_event->aging_time);
-		p_list_item = cl_qlist_next(p_list_item);
-	}
+	unsigned i;
+
+	for (i = 0; i < 1 << p_event_wheel->hash_bits; i++)
+		for (p_list_item = cl_qlist_head(&p_event_wheel->hash[i]);
+		     p_list_item != cl_qlist_end(&p_event_wheel->hash[i]);
+		     p_list_item = cl_qlist_next(p_list_item)) {
+			p_event = PARENT_STRUCT(p_list_item,
+						cl_event_wheel_reg_info_t,
+						hash_item);
+			CL_DBG("cl_event_wheel_dump: Found event key:<0x%"
+			       PRIx64 ">, num_regs:%d, aging time:%" PRIu64
+			       "\n", p_event->key, p_event->num_regs,
+			       p_event->aging_time);
+		}
 }
 
 void cl_event_wheel_destroy(IN cl_event_wheel_t * const p_event_wheel)
 {
 	cl_list_item_t *p_list_item;
-	cl_map_item_t *p_map_item;
 	cl_event_wheel_reg_info_t *p_event;
+	unsigned i;
 
 	/* we need to get a lock */
 	cl_spinlock_acquire(&p_event_wheel->lock);
 
-	cl_event_wheel_dump(p_event_wheel);
-
-	/* go over all the items in the list and remove them */
-	p_list_item = cl_qlist_remove_head(&p_event_wheel->events_wheel);
-	while (p_list_item != cl_qlist_end(&p_event_wheel->events_wheel)) {
-		p_event =
-		    PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t,
-				  list_item);
-
-		CL_DBG("cl_event_wheel_destroy: Found outstanding event"
-		       " key:<0x%" PRIx64 ">\n", p_event->key);
-
-		/* remove it from the map */
-		p_map_item = &(p_event->map_item);
-		cl_qmap_remove_item(&p_event_wheel->events_map, p_map_item);
-		free(p_event);	/* allocated by cl_event_wheel_reg */
-		p_list_item =
-		    cl_qlist_remove_head(&p_event_wheel->events_wheel);
-	}
+	/* go over all the events and remove them */
+	for (i = 0; p_event_wheel->hash && i < 1 << p_event_wheel->hash_bits;
+	     i++)
+		while ((p_list_item = cl_qlist_head(&p_event_wheel->hash[i]))
+		       != cl_qlist_end(&p_event_wheel->hash[i])) {
+			p_event = PARENT_STRUCT(p_list_item,
+						cl_event_wheel_reg_info_t,
+						hash_item);
+			CL_DBG("cl_event_wheel_destroy: Found outstanding event"
+			       " key:<0x%" PRIx64 ">\n", p_event->key);
+			__event_free(p_event_wheel, p_event);
+		}
 
 	/* destroy the timer */
 	cl_timer_destroy(&p_event_wheel->timer);
 
+	free(p_event_wheel->hash);
+	p_event_wheel->hash = NULL;
+
 	/* destroy the lock (this should be done without releasing - we don't want
 	   any other run to grab the lock at this point. */
 	cl_spinlock_release(&p_event_wheel->lock);
@@ -291,34 +479,26 @@ cl_status_t cl_event_wheel_reg(IN cl_event_wheel_t * const p_event_wheel,
 			       IN void *const context)
 {
 	cl_event_wheel_reg_info_t *p_event;
-	uint64_t timeout;
-	uint32_t to;
+	uint64_t current_time, tick;
 	cl_status_t cl_status = CL_SUCCESS;
-	cl_list_item_t *prev_event_list_item;
-	cl_map_item_t *p_map_item;
 
 	/* Get the lock on the manager */
 	cl_spinlock_acquire(&(p_event_wheel->lock));
 
-	cl_event_wheel_dump(p_event_wheel);
+	current_time = cl_get_time_stamp();
+
+	/* an idle wheel need not be advanced tick by tick later */
+	if (!p_event_wheel->num_events)
+		p_event_wheel->cur_tick = current_time / 1000;
 
 	/* Make sure such a key does not exists */
-	p_map_item = cl_qmap_get(&p_event_wheel->events_map, key);
-	if (p_map_item != cl_qmap_end(&p_event_wheel->events_map)) {
+	p_event = __hash_get(p_event_wheel, key);
+	if (p_event) {
 		CL_DBG("cl_event_wheel_reg: Already existing key:0x%"
 		       PRIx64 "\n", key);
 
-		/* already there - remove it from the list as it is getting a new time */
-		p_event =
-		    PARENT_STRUCT(p_map_item, cl_event_wheel_reg_info_t,
-				  map_item);
-
-		/* remove the item from the qlist */
-		cl_qlist_remove_item(&p_event_wheel->events_wheel,
-				     &p_event->list_item);
-		/* and the qmap */
-		cl_qmap_remove_item(&p_event_wheel->events_map,
-				    &p_event->map_item);
+		/* already there - remove it from the wheel as it is getting a new time */
+		__wheel_remove(p_event_wheel, p_event);
 	} else {
 		/* make a new one */
 		p_event = (cl_event_wheel_reg_info_t *)
@@ -328,9 +508,16 @@ cl_status_t cl_event_wheel_reg(IN cl_event_wheel_t * const p_event_wheel,
 			goto Exit;
 		}
 		p_event->num_regs = 0;
+		p_event->key = key;
+		p_event->p_slot = NULL;
+
+		if (++p_event_wheel->num_events >
+		    2U << p_event_wheel->hash_bits)
+			__hash_grow(p_event_wheel);
+		cl_qlist_insert_tail(__hash_bucket(p_event_wheel, key),
+				     &p_event->hash_item);
 	}
 
-	p_event->key = key;
 	p_event->aging_time = aging_time_usec;
 	p_event->pfn_aged_callback = pfn_callback;
 	p_event->context = context;
@@ -338,63 +525,26 @@ cl_status_t cl_event_wheel_reg(IN cl_event_wheel_t * const p_event_wheel,
 
 	CL_DBG("cl_event_wheel_reg: Registering event key:0x%" PRIx64
 	       " aging in %u [msec]\n", p_event->key,
-	       (uint32_t) ((p_event->aging_time - cl_get_time_stamp()) / 1000));
-
-	/* If the list is empty - need to start the timer */
-	if (cl_is_qlist_empty(&p_event_wheel->events_wheel)) {
-		/* Edward Bortnikov 03/29/2003
-		 * ++TBD Consider moving the timer manipulation behind the list manipulation.
-		 */
-
-		/* calculate the new timeout */
-		timeout =
-		    (p_event->aging_time - cl_get_time_stamp() + 500) / 1000;
-
-		/* stop the timer if it is running */
-
-		/* Edward Bortnikov 03/29/2003
-		 * Don't call cl_timer_stop() because it spins forever.
-		 * cl_timer_start() will invoke cl_timer_stop() by itself.
-		 *
-		 * The problematic scenario is when __cl_event_wheel_callback()
-		 * is in race condition with this code. It sets timer.in_timer_cb
-		 * to TRUE and then blocks on p_event_wheel->lock. Following this,
-		 * the call to cl_timer_stop() hangs. Following this, the whole system
-		 * enters into a deadlock.
-		 *
-		 * cl_timer_stop(&p_event_wheel->timer);
-		 */
-
-		/* The timeout for the cl_timer_start should be given as uint32_t.
-		   if there is an overflow - warn about it. */
-		to = (uint32_t) timeout;
-		if (timeout > (uint32_t) timeout) {
-			to = 0xffffffff;	/* max 32 bit timer */
-			CL_DBG("cl_event_wheel_reg: timeout requested is "
-			       "too large. Using timeout: %u\n", to);
-		}
-
-		/* start the timer to the timeout [msec] */
-		cl_status = cl_timer_start(&p_event_wheel->timer, to);
-		if (cl_status != CL_SUCCESS) {
-			CL_DBG("cl_event_wheel_reg : ERR 6203: "
-			       "Failed to start timer\n");
-			goto Exit;
-		}
-	}
-
-	/* insert the object to the qlist and the qmap */
-
-	/* BUT WE MUST INSERT IT IN A SORTED MANNER */
-	prev_event_list_item =
-	    cl_qlist_find_from_tail(&p_event_wheel->events_wheel,
-				    __event_will_age_before,
-				    &p_event->aging_time);
-
-	cl_qlist_insert_next(&p_event_wheel->events_wheel,
-			     prev_event_list_item, &p_event->list_item);
-
-	cl_qmap_insert(&p_event_wheel->events_map, key, &(p_event->map_item));
+	       (uint32_t) ((p_event->aging_time - current_time) / 1000));
+
+	__wheel_insert(p_event_wheel, p_event, p_event_wheel->cur_tick + 1);
+
+	/*
+	 * Edward Bortnikov 03/29/2003
+	 * Don't call cl_timer_stop() because it spins forever.
+	 * cl_timer_start() will invoke cl_timer_stop() by itself.
+	 *
+	 * The problematic scenario is when __cl_event_wheel_callback()
+	 * is in race condition with this code. It sets timer.in_timer_cb
+	 * to TRUE and then blocks on p_event_wheel->lock. Following this,
+	 * the call to cl_timer_stop() hangs. Following this, the whole system
+	 * enters into a deadlock.
+	 */
+	tick = __event_tick(aging_time_usec);
+	if (tick <= p_event_wheel->cur_tick)
+		tick = p_event_wheel->cur_tick + 1;
+	if (!p_event_wheel->next_tick || tick < p_event_wheel->next_tick)
+		__wheel_start_timer(p_event_wheel, tick, current_time);
 
 Exit:
 	cl_spinlock_release(&p_event_wheel->lock);
@@ -406,30 +556,16 @@ void cl_event_wheel_unreg(IN cl_event_wheel_t * const p_event_wheel,
 			  IN uint64_t key)
 {
 	cl_event_wheel_reg_info_t *p_event;
-	cl_map_item_t *p_map_item;
 
 	CL_DBG("cl_event_wheel_unreg: " "Removing key:0x%" PRIx64 "\n", key);
 
 	cl_spinlock_acquire(&p_event_wheel->lock);
-	p_map_item = cl_qmap_get(&p_event_wheel->events_map, key);
-	if (p_map_item != cl_qmap_end(&p_event_wheel->events_map)) {
-		/* we found such an item. */
-		p_event =
-		    PARENT_STRUCT(p_map_item, cl_event_wheel_reg_info_t,
-				  map_item);
-
-		/* remove the item from the qlist */
-		cl_qlist_remove_item(&p_event_wheel->events_wheel,
-				     &(p_event->list_item));
-		/* remove the item from the qmap */
-		cl_qmap_remove_item(&p_event_wheel->events_map,
-				    &(p_event->map_item));
-
+	p_event = __hash_get(p_event_wheel, key);
+	if (p_event) {
+		/* we found such an item - remove it from the wheel and hash */
+		__event_free(p_event_wheel, p_event);
 		CL_DBG("cl_event_wheel_unreg: Removed key:0x%" PRIx64 "\n",
 		       key);
-
-		/* free the item */
-		free(p_event);
 	} else {
 		CL_DBG("cl_event_wheel_unreg: did not find key:0x%" PRIx64
 		       "\n", key);
@@ -443,21 +579,16 @@ uint32_t cl_event_wheel_num_regs(IN cl_event_wheel_t * const p_event_wheel,
 {
 
 	cl_event_wheel_reg_info_t *p_event;
-	cl_map_item_t *p_map_item;
 	uint32_t num_regs = 0;
 
-	/* try to find the key in the map */
+	/* try to find the key in the hash */
 	CL_DBG("cl_event_wheel_num_regs: Looking for key:0x%" PRIx64 "\n", key);
 
 	cl_spinlock_acquire(&p_event_wheel->lock);
-	p_map_item = cl_qmap_get(&p_event_wheel->events_map, key);
-	if (p_map_item != cl_qmap_end(&p_event_wheel->events_map)) {
+	p_event = __hash_get(p_event_wheel, key);
+	if (p_event)
 		/* ok so we can simply return it's num_regs */
-		p_event =
-		    PARENT_STRUCT(p_map_item, cl_event_wheel_reg_info_t,
-				  map_item);
 		num_regs = p_event->num_regs;
-	}
 
 	cl_spinlock_release(&p_event_wheel->lock);
 	return (num_regs);
@@ -469,42 +600,31 @@ uint32_t cl_event_wheel_num_regs(IN cl_event_wheel_t * const p_event_wheel,
 void __cl_event_wheel_dump(IN cl_event_wheel_t * const p_event_wheel)
 {
 	cl_list_item_t *p_list_item;
-	cl_map_item_t *p_map_item;
 	cl_event_wheel_reg_info_t *p_event;
+	unsigned level, i;
 
 	printf("************** Event Wheel Dump ***********************\n");
-	printf("Event Wheel List has %u items:\n",
-	       cl_qlist_count(&p_event_wheel->events_wheel));
-
-	p_list_item = cl_qlist_head(&p_event_wheel->events_wheel);
-	while (p_list_item != cl_qlist_end(&p_event_wheel->events_wheel)) {
-		p_event =
-		    PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t,
-				  list_item);
-		printf("Event key:0x%" PRIx64 " Context:%s NumRegs:%u\n",
-		       p_event->key, (char *)p_event->context,
-		       p_event->num_regs);
-
-		/* next */
-		p_list_item = cl_qlist_next(p_list_item);
-	}
-
-	printf("Event Map has %u items:\n",
-	       cl_qmap_count(&p_event_wheel->events_map));
-
-	p_map_item = cl_qmap_head(&p_event_wheel->events_map);
-	while (p_map_item != cl_qmap_end(&p_event_wheel->events_map)) {
-		p_event =
-		    PARENT_STRUCT(p_map_item, cl_event_wheel_reg_info_t,
-				  map_item);
-		printf("Event key:0x%" PRIx64 " Context:%s NumRegs:%u\n",
-		       p_event->key, (char *)p_event->context,
-		       p_event->num_regs);
-
-		/* next */
-		p_map_item = cl_qmap_next(p_map_item);
-	}
-
+	printf("Event Wheel has %u items, current tick %" PRIu64 ":\n",
+	       p_event_wheel->num_events, p_event_wheel->cur_tick);
+
+	for (level = 0; level < CL_EVENT_WHEEL_LEVELS; level++)
+		for (i = 0; i < CL_EVENT_WHEEL_SLOTS; i++) {
+			cl_qlist_t *p_slot = &p_event_wheel->slots[level][i];
+
+			p_list_item = cl_qlist_head(p_slot);
+			while (p_list_item != cl_qlist_end(p_slot)) {
+				p_event = PARENT_STRUCT(p_list_item,
+							cl_event_wheel_reg_info_t,
+							list_item);
+				printf("Level %u slot %u: Event key:0x%" PRIx64
+				       " Context:%s NumRegs:%u\n", level, i,
+				       p_event->key, (char *)p_event->context,
+				       p_event->num_regs);
+
+				/* next */
+				p_list_item = cl_qlist_next(p_list_item);
+			}
+		}
 }
 
 /* The callback for aging event */
@@ -513,6 +633,37 @@ static uint64_t __test_event_aging(uint64_t key, uint32_t num_regs, void *contex
 {
 	printf("*****************************************************\n");
 	printf("Aged key: 0x%" PRIx64 " Context:%s\n", key, (char *) context);
+	return 0;
+}
+
+/* Register, look up and cancel a large number of events */
+static void __test_event_wheel_scale(IN cl_event_wheel_t * const p_event_wheel,
+				     IN uint32_t count)
+{
+	uint64_t start, now;
+	uint32_t i, found = 0;
+
+	now = cl_get_time_stamp();
+	start = now;
+	for (i = 0; i < count; i++)
+		/* spread over ~17 minutes so that all levels are used */
+		cl_event_wheel_reg(p_event_wheel, i + 100,
+				   now + 10000000 + (uint64_t) i * 1009,
+				   __test_event_aging, "Scale Event");
+	printf("Registered %u events in %" PRIu64 " usec\n", count,
+	       cl_get_time_stamp() - start);
+
+	start = cl_get_time_stamp();
+	for (i = 0; i < count; i++)
+		found += cl_event_wheel_num_regs(p_event_wheel, i + 100) == 1;
+	printf("Looked up %u events (%u found) in %" PRIu64 " usec\n", count,
+	       found, cl_get_time_stamp() - start);
+
+	start = cl_get_time_stamp();
+	for (i = 0; i < count; i++)
+		cl_event_wheel_unreg(p_event_wheel, i + 100);
+	printf("Unregistered %u events in %" PRIu64 " usec\n", count,
+	       cl_get_time_stamp() - start);
 }
 
 int main()
@@ -567,6 +718,9 @@ int main()
 	       cl_event_wheel_num_regs(&event_wheel, 2));
 
 	sleep(5);
+
+	__test_event_wheel_scale(&event_wheel, 1000000);
+
 	/* destroy */
 	cl_event_wheel_destroy(&event_wheel);
 
@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2026 The OpenSM contributors. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *	Implementation of the hash map.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <complib/cl_hmap.h>
+
+#define HMAP_MIN_SIZE	16
+
+static cl_status_t hmap_alloc(IN cl_hmap_t * const p_map, IN uint32_t size)
+{
+	cl_hmap_entry_t *p_table;
+	uint32_t shift = 64;
+
+	p_table = calloc(size, sizeof(*p_table));
+	if (!p_table)
+		return CL_INSUFFICIENT_MEMORY;
+
+	while ((1U << (64 - shift)) < size)
+		shift--;
+
+	p_map->p_table = p_table;
+	p_map->size = size;
+	p_map->shift = shift;
+	return CL_SUCCESS;
+}
+
+/* store a key known not to be in the map, the table must have room */
+static void hmap_place(IN cl_hmap_t * const p_map, IN const uint64_t key,
+		       IN void *const p_value)
+{
+	uint32_t i = __cl_hmap_home(p_map, key);
+
+	while (p_map->p_table[i].p_value)
+		i = (i + 1) & (p_map->size - 1);
+
+	p_map->p_table[i].key = key;
+	p_map->p_table[i].p_value = p_value;
+}
+
+static cl_status_t hmap_grow(IN cl_hmap_t * const p_map)
+{
+	cl_hmap_entry_t *p_old = p_map->p_table;
+	uint32_t old_size = p_map->size, i;
+	cl_status_t status;
+
+	status = hmap_alloc(p_map, old_size * 2);
+	if (status != CL_SUCCESS)
+		return status;
+
+	for (i = 0; i < old_size; i++)
+		if (p_old[i].p_value)
+			hmap_place(p_map, p_old[i].key, p_old[i].p_value);
+
+	free(p_old);
+	return CL_SUCCESS;
+}
+
+void cl_hmap_construct(IN cl_hmap_t * const p_map)
+{
+	CL_ASSERT(p_map);
+
+	memset(p_map, 0, sizeof(*p_map));
+	p_map->state = CL_UNINITIALIZED;
+}
+
+cl_status_t cl_hmap_init(IN cl_hmap_t * const p_map, IN const uint32_t min_items)
+{
+	uint32_t size = HMAP_MIN_SIZE;
+	cl_status_t status;
+
+	CL_ASSERT(p_map);
+
+	cl_hmap_construct(p_map);
+
+	/* keep the table at most half full */
+	while (size < 2 * min_items)
+		size <<= 1;
+
+	status = hmap_alloc(p_map, size);
+	if (status == CL_SUCCESS)
+		p_map->state = CL_INITIALIZED;
+	return status;
+}
+
+void cl_hmap_destroy(IN cl_hmap_t * const p_map)
+{
+	CL_ASSERT(p_map);
+	CL_ASSERT(cl_is_state_valid(p_map->state));
+
+	free(p_map->p_table);
+	p_map->p_table = NULL;
+	p_map->size = 0;
+	p_map->count = 0;
+	p_map->state = CL_UNINITIALIZED;
+}
+
+cl_status_t cl_hmap_insert(IN cl_hmap_t * const p_map, IN const uint64_t key,
+			   IN void *const p_value)
+{
+	cl_status_t status;
+
+	CL_ASSERT(p_map);
+	CL_ASSERT(p_map->state == CL_INITIALIZED);
+	CL_ASSERT(p_value);
+
+	if (cl_hmap_get(p_map, key))
+		return CL_DUPLICATE;
+
+	if (2 * (p_map->count + 1) > p_map->size) {
+		status = hmap_grow(p_map);
+		if (status != CL_SUCCESS)
+			return status;
+	}
+
+	hmap_place(p_map, key, p_value);
+	p_map->count++;
+	return CL_SUCCESS;
+}
+
+void *cl_hmap_remove(IN cl_hmap_t * const p_map, IN const uint64_t key)
+{
+	uint32_t mask = p_map->size - 1, i, j, home;
+	void *p_value;
+
+	CL_ASSERT(p_map);
+	CL_ASSERT(p_map->state == CL_INITIALIZED);
+
+	for (i = __cl_hmap_home(p_map, key);; i = (i + 1) & mask) {
+		if (!p_map->p_table[i].p_value)
+			return NULL;
+		if (p_map->p_table[i].key == key)
+			break;
+	}
+	p_value = p_map->p_table[i].p_value;
+
+	/*
+	 * Shift back the following entries of the cluster which may not
+	 * stay past the freed entry, so that probing stops at the first
+	 * free entry without missing any key.
+	 */
+	for (j = (i + 1) & mask; p_map->p_table[j].p_value; j = (j + 1) & mask) {
+		home = __cl_hmap_home(p_map, p_map->p_table[j].key);
+		if (((j - home) & mask) < ((j - i) & mask))
+			continue;	/* its home lies between i and j */
+		p_map->p_table[i] = p_map->p_table[j];
+		i = j;
+	}
+	p_map->p_table[i].p_value = NULL;
+	p_map->count--;
+
+	return p_value;
+}
+
+void cl_hmap_remove_all(IN cl_hmap_t * const p_map)
+{
+	CL_ASSERT(p_map);
+	CL_ASSERT(p_map->state == CL_INITIALIZED);
+
+	memset(p_map->p_table, 0, p_map->size * sizeof(*p_map->p_table));
+	p_map->count = 0;
+}
+
+#ifdef __CL_HMAP_TEST__
+
+#include <stdio.h>
+#include <complib/cl_qmap.h>
+#include <complib/cl_timer.h>
+
+#define TEST_ITEMS	100000
+#define TEST_ROUNDS	10
+
+/* time TEST_ROUNDS lookups of every key, misses included */
+static uint64_t __test_lookup(IN cl_qmap_t * p_map, IN cl_map_item_t * items)
+{
+	uint64_t start = cl_get_time_stamp();
+	unsigned i, r, found = 0;
+
+	for (r = 0; r < TEST_ROUNDS; r++)
+		for (i = 0; i < TEST_ITEMS; i++) {
+			found += cl_qmap_get(p_map, items[i].key) == &items[i];
+			found += cl_qmap_get(p_map, ~items[i].key) !=
+			    cl_qmap_end(p_map);
+		}
+	if (found != TEST_ROUNDS * TEST_ITEMS)
+		printf("lookup mismatch: %u\n", found);
+
+	return cl_get_time_stamp() - start;
+}
+
+int main()
+{
+	cl_map_item_t *items = calloc(TEST_ITEMS, sizeof(*items));
+	cl_qmap_t map;
+	cl_hmap_t index;
+	uint64_t t_tree, t_hash;
+	unsigned i;
+
+	cl_qmap_init(&map);
+	for (i = 0; i < TEST_ITEMS; i++)
+		/* GUIDs share a vendor prefix and differ in low bits */
+		cl_qmap_insert(&map, 0x0002c90300000000ULL + i * 7919, &items[i]);
+
+	t_tree = __test_lookup(&map, items);
+
+	cl_hmap_init(&index, 0);
+	cl_qmap_set_index(&map, &index);
+	t_hash = __test_lookup(&map, items);
+
+	printf("%u x %u lookups (half misses): qmap %" PRIu64
+	       " usec, indexed qmap %" PRIu64 " usec\n",
+	       TEST_ROUNDS, 2 * TEST_ITEMS, t_tree, t_hash);
+
+	/* remove every other item and check the index is still in sync */
+	for (i = 0; i < TEST_ITEMS; i += 2)
+		cl_qmap_remove_item(&map, &items[i]);
+	for (i = 0; i < TEST_ITEMS; i++)
+		if ((cl_qmap_get(&map, items[i].key) == &items[i]) != (i & 1))
+			printf("index out of sync at %u\n", i);
+	printf("%u items in map, %u in index\n",
+	       (unsigned)cl_qmap_count(&map), cl_hmap_count(&index));
+
+	cl_qmap_set_index(&map, NULL);
+	cl_hmap_destroy(&index);
+	free(items);
+	return 0;
+}
+
+#endif				/* __CL_HMAP_TEST__ */
@@ -223,6 +223,31 @@ void cl_qmap_init(IN cl_qmap_t * const p_map)
 	cl_qmap_remove_all(p_map);
 }
 
+cl_status_t cl_qmap_set_index(IN cl_qmap_t * const p_map,
+			      IN cl_hmap_t * const p_index)
+{
+	cl_map_item_t *p_item;
+
+	CL_ASSERT(p_map);
+	CL_ASSERT(p_map->state == CL_INITIALIZED);
+
+	p_map->p_index = NULL;
+	if (!p_index)
+		return CL_SUCCESS;
+
+	cl_hmap_remove_all(p_index);
+	for (p_item = cl_qmap_head(p_map); p_item != cl_qmap_end(p_map);
+	     p_item = cl_qmap_next(p_item))
+		if (cl_hmap_insert(p_index, p_item->key, p_item) !=
+		    CL_SUCCESS) {
+			cl_hmap_remove_all(p_index);
+			return CL_INSUFFICIENT_MEMORY;
+		}
+
+	p_map->p_index = p_index;
+	return CL_SUCCESS;
+}
+
 cl_map_item_t *cl_qmap_get(IN const cl_qmap_t * const p_map,
 			   IN const uint64_t key)
 {
@@ -231,6 +256,11 @@ cl_map_item_t *cl_qmap_get(IN const cl_qmap_t * const p_map,
 	CL_ASSERT(p_map);
 	CL_ASSERT(p_map->state == CL_INITIALIZED);
 
+	if (p_map->p_index) {
+		p_item = cl_hmap_get(p_map->p_index, key);
+		return p_item ? p_item : (cl_map_item_t *) & p_map->nil;
+	}
+
 	p_item = __cl_map_root(p_map);
 
 	while (p_item != &p_map->nil) {
@@ -429,6 +459,13 @@ cl_map_item_t *cl_qmap_insert(IN cl_qmap_t * const p_map,
 	p_item->p_map = p_map;
 #endif
 
+	/* without memory for the index fall back to tree lookups */
+	if (p_map->p_index &&
+	    cl_hmap_insert(p_map->p_index, key, p_item) != CL_SUCCESS) {
+		cl_hmap_remove_all(p_map->p_index);
+		p_map->p_index = NULL;
+	}
+
 	return (p_item);
 }
 
@@ -533,6 +570,9 @@ void cl_qmap_remove_item(IN cl_qmap_t * const p_map,
 	/* Decrement the item count. */
 	p_map->count--;
 
+	if (p_map->p_index)
+		cl_hmap_remove(p_map->p_index, p_item->key);
+
 	/* Get the pointer to the new root's child, if any. */
 	if (p_del_item->p_left != &p_map->nil)
 		p_child = p_del_item->p_left;
@@ -0,0 +1,588 @@
+/*
+ * Copyright (c) 2026 The OpenSM contributors. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *	Implementation of the work stealing pool.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <complib/cl_atomic.h>
+#include <complib/cl_thread.h>
+#include <complib/cl_work_pool.h>
+
+/* sub ranges (or map parts) created per worker when no grain is given */
+#define WORK_POOL_SPLIT	4
+
+typedef struct work_pool_worker_ctx {
+	cl_work_pool_t *p_pool;
+	unsigned index;
+} work_pool_worker_ctx_t;
+
+static inline unsigned current_worker(cl_work_pool_t * p_pool)
+{
+	return (unsigned)(uintptr_t) pthread_getspecific(p_pool->worker_key);
+}
+
+static cl_work_item_t *queue_pop(cl_work_queue_t * p_queue, boolean_t steal)
+{
+	cl_list_item_t *p_list_item;
+
+	cl_spinlock_acquire(&p_queue->lock);
+	p_list_item = steal ? cl_qlist_remove_head(&p_queue->list) :
+	    cl_qlist_remove_tail(&p_queue->list);
+	cl_spinlock_release(&p_queue->lock);
+
+	if (p_list_item == cl_qlist_end(&p_queue->list))
+		return NULL;
+	return PARENT_STRUCT(p_list_item, cl_work_item_t, list_item);
+}
+
+/*
+ * Take the newest item of the own queue, or steal the oldest item of
+ * another worker, starting with the next one so that thieves spread.
+ */
+static cl_work_item_t *get_work(cl_work_pool_t * p_pool, unsigned self)
+{
+	cl_work_item_t *p_item;
+	unsigned i;
+
+	if (!p_pool->queued)
+		return NULL;
+
+	p_item = queue_pop(&p_pool->queues[self], FALSE);
+	for (i = 1; !p_item && i < p_pool->count; i++)
+		p_item = queue_pop(&p_pool->queues[(self + i) % p_pool->count],
+				   TRUE);
+	if (p_item)
+		cl_atomic_dec(&p_pool->queued);
+
+	return p_item;
+}
+
+static void run_work(cl_work_pool_t * p_pool, cl_work_item_t * p_item,
+		     unsigned self)
+{
+	cl_work_group_t *p_group = p_item->p_group;
+
+	p_item->pfn_work(p_item->context, self);
+
+	/* the item and the group may be gone once pending drops to 0 */
+	if (cl_atomic_dec(&p_group->pending) == 0) {
+		pthread_mutex_lock(&p_pool->mutex);
+		pthread_cond_broadcast(&p_pool->done_cond);
+		/* workers waiting for nested groups sleep on work_cond */
+		pthread_cond_broadcast(&p_pool->work_cond);
+		pthread_mutex_unlock(&p_pool->mutex);
+	}
+}
+
+static void *work_pool_routine(void *context)
+{
+	work_pool_worker_ctx_t *p_ctx = context;
+	cl_work_pool_t *p_pool = p_ctx->p_pool;
+	unsigned self = p_ctx->index;
+	cl_work_item_t *p_item;
+
+	free(p_ctx);
+	pthread_setspecific(p_pool->worker_key, (void *)(uintptr_t) (self + 1));
+
+	for (;;) {
+		if ((p_item = get_work(p_pool, self))) {
+			run_work(p_pool, p_item, self);
+			continue;
+		}
+
+		pthread_mutex_lock(&p_pool->mutex);
+		while (!p_pool->exit && !p_pool->queued) {
+			p_pool->sleepers++;
+			pthread_cond_wait(&p_pool->work_cond, &p_pool->mutex);
+			p_pool->sleepers--;
+		}
+		if (p_pool->exit) {
+			pthread_mutex_unlock(&p_pool->mutex);
+			break;
+		}
+		pthread_mutex_unlock(&p_pool->mutex);
+	}
+
+	return NULL;
+}
+
+cl_status_t cl_work_pool_init(IN cl_work_pool_t * const p_pool,
+			      IN unsigned count)
+{
+	work_pool_worker_ctx_t *p_ctx;
+	unsigned i;
+
+	CL_ASSERT(p_pool);
+
+	memset(p_pool, 0, sizeof(*p_pool));
+
+	if (!count)
+		count = cl_proc_count();
+
+	pthread_mutex_init(&p_pool->mutex, NULL);
+	pthread_cond_init(&p_pool->work_cond, NULL);
+	pthread_cond_init(&p_pool->done_cond, NULL);
+	pthread_key_create(&p_pool->worker_key, NULL);
+
+	p_pool->queues = calloc(count, sizeof(*p_pool->queues));
+	p_pool->tid = calloc(count, sizeof(*p_pool->tid));
+	if (!p_pool->queues || !p_pool->tid) {
+		cl_work_pool_destroy(p_pool);
+		return CL_INSUFFICIENT_MEMORY;
+	}
+
+	for (i = 0; i < count; i++) {
+		cl_spinlock_construct(&p_pool->queues[i].lock);
+		cl_spinlock_init(&p_pool->queues[i].lock);
+		cl_qlist_init(&p_pool->queues[i].list);
+	}
+	p_pool->count = count;
+
+	for (i = 0; i < count; i++) {
+		p_ctx = malloc(sizeof(*p_ctx));
+		if (!p_ctx) {
+			cl_work_pool_destroy(p_pool);
+			return CL_INSUFFICIENT_MEMORY;
+		}
+		p_ctx->p_pool = p_pool;
+		p_ctx->index = i;
+		if (pthread_create(&p_pool->tid[i], NULL, work_pool_routine,
+				   p_ctx) != 0) {
+			free(p_ctx);
+			p_pool->tid[i] = 0;
+			cl_work_pool_destroy(p_pool);
+			return CL_INSUFFICIENT_RESOURCES;
+		}
+	}
+
+	return CL_SUCCESS;
+}
+
+void cl_work_pool_destroy(IN cl_work_pool_t * const p_pool)
+{
+	unsigned i;
+
+	CL_ASSERT(p_pool);
+	CL_ASSERT(!p_pool->queued);
+
+	pthread_mutex_lock(&p_pool->mutex);
+	p_pool->exit = TRUE;
+	pthread_cond_broadcast(&p_pool->work_cond);
+	pthread_mutex_unlock(&p_pool->mutex);
+
+	for (i = 0; i < p_pool->count; i++)
+		if (p_pool->tid[i])
+			pthread_join(p_pool->tid[i], NULL);
+
+	for (i = 0; i < p_pool->count; i++)
+		cl_spinlock_destroy(&p_pool->queues[i].lock);
+
+	free(p_pool->tid);
+	free(p_pool->queues);
+	p_pool->tid = NULL;
+	p_pool->queues = NULL;
+	p_pool->count = 0;
+
+	pthread_key_delete(p_pool->worker_key);
+	pthread_cond_destroy(&p_pool->done_cond);
+	pthread_cond_destroy(&p_pool->work_cond);
+	pthread_mutex_destroy(&p_pool->mutex);
+}
+
+static void queue_item(cl_work_pool_t * p_pool, unsigned self,
+		       cl_work_group_t * p_group, cl_work_item_t * p_item,
+		       cl_pfn_work_t pfn_work, void *context)
+{
+	cl_work_queue_t *p_queue;
+
+	p_item->pfn_work = pfn_work;
+	p_item->context = context;
+	p_item->p_group = p_group;
+	cl_atomic_inc(&p_group->pending);
+
+	if (self)
+		p_queue = &p_pool->queues[self - 1];
+	else
+		p_queue = &p_pool->queues[(uint32_t)
+					  cl_atomic_inc(&p_pool->next_queue) %
+					  p_pool->count];
+
+	/* counted first so that queued never drops below 0 */
+	cl_atomic_inc(&p_pool->queued);
+	cl_spinlock_acquire(&p_queue->lock);
+	cl_qlist_insert_tail(&p_queue->list, &p_item->list_item);
+	cl_spinlock_release(&p_queue->lock);
+}
+
+static void wake_workers(cl_work_pool_t * p_pool, boolean_t all)
+{
+	/* sleepers check queued under the mutex, so no wakeup is lost */
+	pthread_mutex_lock(&p_pool->mutex);
+	if (p_pool->sleepers) {
+		if (all)
+			pthread_cond_broadcast(&p_pool->work_cond);
+		else
+			pthread_cond_signal(&p_pool->work_cond);
+	}
+	pthread_mutex_unlock(&p_pool->mutex);
+}
+
+void cl_work_pool_submit(IN cl_work_pool_t * const p_pool,
+			 IN cl_work_group_t * const p_group,
+			 IN cl_work_item_t * const p_item,
+			 IN cl_pfn_work_t pfn_work, IN void *context)
+{
+	CL_ASSERT(p_pool && p_pool->count);
+
+	queue_item(p_pool, current_worker(p_pool), p_group, p_item, pfn_work,
+		   context);
+	wake_workers(p_pool, FALSE);
+}
+
+void cl_work_pool_wait(IN cl_work_pool_t * const p_pool,
+		       IN cl_work_group_t * const p_group)
+{
+	unsigned self = current_worker(p_pool);
+	cl_work_item_t *p_item;
+
+	if (!self) {
+		pthread_mutex_lock(&p_pool->mutex);
+		while (p_group->pending)
+			pthread_cond_wait(&p_pool->done_cond, &p_pool->mutex);
+		pthread_mutex_unlock(&p_pool->mutex);
+		return;
+	}
+
+	/* a worker keeps working while its nested group is in progress */
+	while (p_group->pending) {
+		if ((p_item = get_work(p_pool, self - 1))) {
+			run_work(p_pool, p_item, self - 1);
+			continue;
+		}
+		pthread_mutex_lock(&p_pool->mutex);
+		if (p_group->pending && !p_pool->queued) {
+			p_pool->sleepers++;
+			pthread_cond_wait(&p_pool->work_cond, &p_pool->mutex);
+			p_pool->sleepers--;
+		}
+		pthread_mutex_unlock(&p_pool->mutex);
+	}
+}
+
+typedef struct range_work {
+	cl_work_item_t item;
+	cl_pfn_range_work_t pfn_work;
+	void *context;
+	size_t begin;
+	size_t end;
+} range_work_t;
+
+static void range_work_routine(void *context, unsigned worker)
+{
+	range_work_t *p_work = context;
+
+	p_work->pfn_work(p_work->context, p_work->begin, p_work->end, worker);
+}
+
+static size_t work_pool_chunks(cl_work_pool_t * p_pool, size_t n,
+			       size_t * p_grain)
+{
+	if (!*p_grain) {
+		*p_grain = n / (p_pool->count * WORK_POOL_SPLIT);
+		if (!*p_grain)
+			*p_grain = 1;
+	}
+	return (n + *p_grain - 1) / *p_grain;
+}
+
+cl_status_t
+cl_work_pool_parallel_for(IN cl_work_pool_t * const p_pool, IN size_t begin,
+			  IN size_t end, IN size_t grain,
+			  IN cl_pfn_range_work_t pfn_work, IN void *context)
+{
+	cl_work_group_t group;
+	range_work_t *works;
+	size_t n, i;
+	unsigned self;
+
+	if (begin >= end)
+		return CL_SUCCESS;
+
+	if (!p_pool) {
+		pfn_work(context, begin, end, 0);
+		return CL_SUCCESS;
+	}
+
+	n = work_pool_chunks(p_pool, end - begin, &grain);
+	works = malloc(n * sizeof(*works));
+	if (!works)
+		return CL_INSUFFICIENT_MEMORY;
+
+	cl_work_group_init(&group);
+	self = current_worker(p_pool);
+	for (i = 0; i < n; i++) {
+		works[i].pfn_work = pfn_work;
+		works[i].context = context;
+		works[i].begin = begin + i * grain;
+		works[i].end = works[i].begin + grain < end ?
+		    works[i].begin + grain : end;
+		queue_item(p_pool, self, &group, &works[i].item,
+			   range_work_routine, &works[i]);
+	}
+	wake_workers(p_pool, TRUE);
+
+	cl_work_pool_wait(p_pool, &group);
+	free(works);
+
+	return CL_SUCCESS;
+}
+
+typedef struct qmap_work {
+	cl_work_item_t item;
+	cl_pfn_qmap_work_t pfn_work;
+	void *context;
+	cl_map_item_t *p_first;
+	size_t count;
+} qmap_work_t;
+
+static void qmap_work_routine(void *context, unsigned worker)
+{
+	qmap_work_t *p_work = context;
+	cl_map_item_t *p_map_item = p_work->p_first;
+	size_t i;
+
+	for (i = 0; i < p_work->count; i++) {
+		p_work->pfn_work(p_work->context, p_map_item, worker);
+		p_map_item = cl_qmap_next(p_map_item);
+	}
+}
+
+cl_status_t
+cl_work_pool_parallel_for_qmap(IN cl_work_pool_t * const p_pool,
+			       IN const cl_qmap_t * const p_map,
+			       IN size_t grain,
+			       IN cl_pfn_qmap_work_t pfn_work,
+			       IN void *context)
+{
+	cl_work_group_t group;
+	cl_map_item_t *p_map_item;
+	qmap_work_t *works;
+	size_t count, n, i, j;
+	unsigned self;
+
+	count = cl_qmap_count(p_map);
+	if (!count)
+		return CL_SUCCESS;
+
+	if (!p_pool) {
+		for (p_map_item = cl_qmap_head(p_map);
+		     p_map_item != cl_qmap_end(p_map);
+		     p_map_item = cl_qmap_next(p_map_item))
+			pfn_work(context, p_map_item, 0);
+		return CL_SUCCESS;
+	}
+
+	n = work_pool_chunks(p_pool, count, &grain);
+	works = malloc(n * sizeof(*works));
+	if (!works)
+		return CL_INSUFFICIENT_MEMORY;
+
+	/* a single walk finds the first item of every part */
+	p_map_item = cl_qmap_head(p_map);
+	for (i = 0; i < n; i++) {
+		works[i].pfn_work = pfn_work;
+		works[i].context = context;
+		works[i].p_first = p_map_item;
+		works[i].count = count - i * grain < grain ?
+		    count - i * grain : grain;
+		for (j = 0; j < works[i].count; j++)
+			p_map_item = cl_qmap_next(p_map_item);
+	}
+
+	cl_work_group_init(&group);
+	self = current_worker(p_pool);
+	for (i = 0; i < n; i++)
+		queue_item(p_pool, self, &group, &works[i].item,
+			   qmap_work_routine, &works[i]);
+	wake_workers(p_pool, TRUE);
+
+	cl_work_pool_wait(p_pool, &group);
+	free(works);
+
+	return CL_SUCCESS;
+}
+
+#ifdef __CL_WORK_POOL_TEST__
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <complib/cl_event.h>
+#include <complib/cl_threadpool.h>
+#include <complib/cl_timer.h>
+
+#define TEST_ITEMS	(1 << 20)
+#define TEST_ROUNDS	20
+
+typedef struct _test_ctx {
+	uint64_t *out;
+	size_t grain;
+	size_t chunks;
+	atomic32_t next;
+	atomic32_t done;
+	cl_event_t event;
+} test_ctx_t;
+
+static void __test_items(IN uint64_t * out, IN size_t begin, IN size_t end)
+{
+	uint64_t x;
+	size_t i;
+	int j;
+
+	for (i = begin; i < end; i++) {
+		x = i + 1;
+		for (j = 0; j < 16; j++) {
+			x ^= x << 13;
+			x ^= x >> 7;
+			x ^= x << 17;
+		}
+		out[i] = x;
+	}
+}
+
+static void __test_range(IN void *context, IN size_t begin, IN size_t end,
+			 IN unsigned worker)
+{
+	__test_items(((test_ctx_t *) context)->out, begin, end);
+}
+
+/* the thread pool runs one callback per signal, each takes one chunk */
+static void __test_thread_pool_cb(IN void *context)
+{
+	test_ctx_t *ctx = context;
+	size_t chunk = (uint32_t) cl_atomic_inc(&ctx->next) - 1;
+	size_t begin = chunk * ctx->grain;
+	size_t end = begin + ctx->grain < TEST_ITEMS ?
+	    begin + ctx->grain : TEST_ITEMS;
+
+	__test_items(ctx->out, begin, end);
+	if ((size_t) (uint32_t) cl_atomic_inc(&ctx->done) == ctx->chunks)
+		cl_event_signal(&ctx->event);
+}
+
+static uint64_t __test_checksum(IN const uint64_t * out)
+{
+	uint64_t sum = 0;
+	size_t i;
+
+	for (i = 0; i < TEST_ITEMS; i++)
+		sum += out[i];
+	return sum;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned count = argc > 1 ? atoi(argv[1]) : 0;
+	size_t grains[] = { 64, 1024, 16384 };
+	cl_thread_pool_t thread_pool;
+	cl_work_pool_t work_pool;
+	test_ctx_t ctx;
+	uint64_t start, t_thread, t_work, sum;
+	unsigned g, r;
+	size_t i;
+
+	ctx.out = calloc(TEST_ITEMS, sizeof(*ctx.out));
+	cl_event_construct(&ctx.event);
+	if (!ctx.out || cl_event_init(&ctx.event, FALSE) != CL_SUCCESS ||
+	    cl_work_pool_init(&work_pool, count) != CL_SUCCESS ||
+	    cl_thread_pool_init(&thread_pool, cl_work_pool_size(&work_pool),
+				__test_thread_pool_cb, &ctx,
+				"test_pool") != CL_SUCCESS) {
+		printf("init failed\n");
+		return 1;
+	}
+
+	__test_items(ctx.out, 0, TEST_ITEMS);
+	sum = __test_checksum(ctx.out);
+
+	for (g = 0; g < sizeof(grains) / sizeof(grains[0]); g++) {
+		ctx.grain = grains[g];
+		ctx.chunks = (TEST_ITEMS + ctx.grain - 1) / ctx.grain;
+
+		memset(ctx.out, 0, TEST_ITEMS * sizeof(*ctx.out));
+		start = cl_get_time_stamp();
+		for (r = 0; r < TEST_ROUNDS; r++) {
+			ctx.next = 0;
+			ctx.done = 0;
+			cl_event_reset(&ctx.event);
+			for (i = 0; i < ctx.chunks; i++)
+				cl_thread_pool_signal(&thread_pool);
+			cl_event_wait_on(&ctx.event, EVENT_NO_TIMEOUT, FALSE);
+		}
+		t_thread = cl_get_time_stamp() - start;
+		if (__test_checksum(ctx.out) != sum)
+			printf("thread pool result mismatch\n");
+
+		memset(ctx.out, 0, TEST_ITEMS * sizeof(*ctx.out));
+		start = cl_get_time_stamp();
+		for (r = 0; r < TEST_ROUNDS; r++)
+			cl_work_pool_parallel_for(&work_pool, 0, TEST_ITEMS,
+						  ctx.grain, __test_range,
+						  &ctx);
+		t_work = cl_get_time_stamp() - start;
+		if (__test_checksum(ctx.out) != sum)
+			printf("work pool result mismatch\n");
+
+		printf("%u threads, %u x %u items, grain %zu: thread pool %"
+		       PRIu64 " usec, work pool %" PRIu64 " usec\n",
+		       cl_work_pool_size(&work_pool), TEST_ROUNDS, TEST_ITEMS,
+		       ctx.grain, t_thread, t_work);
+	}
+
+	cl_thread_pool_destroy(&thread_pool);
+	cl_work_pool_destroy(&work_pool);
+	cl_event_destroy(&ctx.event);
+	free(ctx.out);
+	return 0;
+}
+
+#endif				/* __CL_WORK_POOL_TEST__ */
@@ -77,7 +77,11 @@ BEGIN_C_DECLS
 *		cl_disp_construct, cl_disp_init, cl_disp_shutdown, cl_disp_destroy
 *
 *	Manipulation:
-*		cl_disp_post, cl_disp_register, cl_disp_unregister
+*		cl_disp_post, cl_disp_register, cl_disp_unregister,
+*		cl_disp_set_prio
+*
+*	Statistics:
+*		cl_disp_get_queue_status, cl_disp_get_msg_stats
 *********/
 /****s* Component Library: Dispatcher/cl_disp_msgid_t
 * NAME
@@ -107,6 +111,30 @@ typedef uint32_t cl_disp_msgid_t;
 #define CL_DISP_MSGID_NONE	0xFFFFFFFF
 /**********/
 
+/****d* Component Library: Dispatcher/cl_disp_prio_t
+* NAME
+*	cl_disp_prio_t
+*
+* DESCRIPTION
+*	Scheduling priority of the messages of a registration.
+*
+*	Every registration has its own message queue. Worker threads pick
+*	the next message from the highest priority queue that still has
+*	scheduling credits; each priority level gets cl_disp_prio_weight
+*	credits per round, so lower priorities are slowed down by higher
+*	ones but never starved. Registrations of the same priority are
+*	served round robin.
+*
+* SYNOPSIS
+*/
+typedef enum _cl_disp_prio {
+	CL_DISP_PRIO_HIGH = 0,
+	CL_DISP_PRIO_NORMAL,
+	CL_DISP_PRIO_LOW,
+	CL_DISP_PRIO_MAX
+} cl_disp_prio_t;
+/**********/
+
 /****s* Component Library: Dispatcher/CL_DISP_INVALID_HANDLE
 * NAME
 *	CL_DISP_INVALID_HANDLE
@@ -214,7 +242,9 @@ typedef struct _cl_dispatcher {
 	cl_ptr_vector_t reg_vec;
 	cl_qlist_t reg_list;
 	cl_thread_pool_t worker_threads;
-	cl_qlist_t msg_fifo;
+	cl_qlist_t ready_list[CL_DISP_PRIO_MAX];
+	unsigned credits[CL_DISP_PRIO_MAX];
+	uint32_t msg_count;
 	cl_qpool_t msg_pool;
 	uint64_t last_msg_queue_time_us;
 } cl_dispatcher_t;
@@ -232,13 +262,20 @@ typedef struct _cl_dispatcher {
 *	worker_threads
 *		Thread pool of worker threads to dispose of posted messages.
 *
-*	msg_fifo
-*		FIFO of messages being processed by the Dispatcher.  New
-*		messages are posted to the tail of the FIFO.  Worker threads
-*		pull messages from the front.
+*	ready_list
+*		Per priority lists of the registrations with queued
+*		messages.  Worker threads take a message from the registration
+*		at the head and move it to the tail if it has more.
+*
+*	credits
+*		Messages each priority may still take in the current
+*		scheduling round.
+*
+*	msg_count
+*		Number of queued messages, of all registrations.
 *
 *	msg_pool
-*		Pool of message objects to be processed through the FIFO.
+*		Pool of message objects to be processed through the queues.
 *
 *	last_msg_queue_time_us
 *		The time that the last message spent in the Q in usec
@@ -266,6 +303,13 @@ typedef struct _cl_disp_reg_info {
 	atomic32_t ref_cnt;
 	cl_disp_msgid_t msg_id;
 	cl_dispatcher_t *p_disp;
+	cl_list_item_t ready_item;
+	cl_qlist_t msg_fifo;
+	cl_disp_prio_t prio;
+	uint32_t max_depth;
+	uint64_t msgs;
+	uint64_t total_queue_time_us;
+	uint64_t max_queue_time_us;
 } cl_disp_reg_info_t;
 /*
 * FIELDS
@@ -287,6 +331,19 @@ typedef struct _cl_disp_reg_info {
 *	p_disp
 *		Pointer to parent Dispatcher.
 *
+*	ready_item
+*		Linkage in the Dispatcher ready_list of the registration
+*		priority, while msg_fifo is not empty.
+*
+*	msg_fifo
+*		FIFO of the messages posted to this registration.
+*
+*	prio
+*		Scheduling priority of msg_fifo.
+*
+*	max_depth, msgs, total_queue_time_us, max_queue_time_us
+*		Queue statistics, see cl_disp_queue_stats_t.
+*
 * SEE ALSO
 *********/
 
@@ -618,5 +675,103 @@ cl_disp_get_queue_status(IN const cl_disp_reg_handle_t handle,
 *	Dispatcher
 *********/
 
+/****f* Component Library: Dispatcher/cl_disp_set_prio
+* NAME
+*	cl_disp_set_prio
+*
+* DESCRIPTION
+*	Sets the scheduling priority of the messages posted to a
+*	registration.
+*
+* SYNOPSIS
+*/
+void cl_disp_set_prio(IN const cl_disp_reg_handle_t handle,
+		      IN cl_disp_prio_t prio);
+/*
+* PARAMETERS
+*	handle
+*		[in] cl_disp_reg_handle_t value return by cl_disp_register.
+*
+*	prio
+*		[in] The new priority.
+*
+* NOTES
+*	Registrations start with CL_DISP_PRIO_NORMAL. Messages already
+*	queued are scheduled with the new priority.
+*
+* SEE ALSO
+*	Dispatcher, cl_disp_prio_t
+*********/
+
+/****s* Component Library: Dispatcher/cl_disp_queue_stats_t
+* NAME
+*	cl_disp_queue_stats_t
+*
+* DESCRIPTION
+*	Statistics of the message queue of a registration.
+*
+* SYNOPSIS
+*/
+typedef struct _cl_disp_queue_stats {
+	cl_disp_prio_t prio;
+	uint32_t depth;
+	uint32_t max_depth;
+	uint64_t msgs;
+	uint64_t total_queue_time_us;
+	uint64_t max_queue_time_us;
+} cl_disp_queue_stats_t;
+/*
+* FIELDS
+*	prio
+*		Scheduling priority of the queue.
+*
+*	depth
+*		Number of messages queued now.
+*
+*	max_depth
+*		Highest number of messages queued at a time.
+*
+*	msgs
+*		Number of messages dequeued.
+*
+*	total_queue_time_us
+*		Sum of the time the dequeued messages spent in the queue.
+*
+*	max_queue_time_us
+*		Longest time a message spent in the queue.
+*********/
+
+/****f* Component Library: Dispatcher/cl_disp_get_msg_stats
+* NAME
+*	cl_disp_get_msg_stats
+*
+* DESCRIPTION
+*	Gets the queue statistics of the registration of a message.
+*
+* SYNOPSIS
+*/
+cl_status_t
+cl_disp_get_msg_stats(IN cl_dispatcher_t * const p_disp,
+		      IN const cl_disp_msgid_t msg_id,
+		      OUT cl_disp_queue_stats_t * p_stats);
+/*
+* PARAMETERS
+*	p_disp
+*		[in] Pointer to a Dispatcher.
+*
+*	msg_id
+*		[in] Message identifier.
+*
+*	p_stats
+*		[out] Statistics of the queue of the registration of msg_id.
+*
+* RETURN VALUE
+*	CL_SUCCESS if the message has a registration, CL_NOT_FOUND
+*	otherwise.
+*
+* SEE ALSO
+*	Dispatcher, cl_disp_queue_stats_t
+*********/
+
 END_C_DECLS
 #endif				/* !defined(_CL_DISPATCHER_H_) */
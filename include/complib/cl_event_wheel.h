@@ -68,6 +68,12 @@ BEGIN_C_DECLS
 *  which should be treated as opaque and should be manipulated
 *  only through the provided functions.
 *
+*	Events are kept in a hierarchical timing wheel of 1 msec ticks:
+*  CL_EVENT_WHEEL_LEVELS levels of CL_EVENT_WHEEL_SLOTS slots, each level
+*  covering CL_EVENT_WHEEL_SLOTS times the range of the level below.
+*  Events move to lower levels as their time approaches, so registering
+*  and unregistering are O(1). Keys are found through a hash table.
+*
 * SEE ALSO
 *	Structures:
 *		cl_event_wheel_t
@@ -120,6 +126,10 @@ typedef uint64_t
 *	Event_Wheel, cl_event_wheel_reg
 *********/
 
+#define CL_EVENT_WHEEL_BITS	6
+#define CL_EVENT_WHEEL_SLOTS	(1 << CL_EVENT_WHEEL_BITS)
+#define CL_EVENT_WHEEL_LEVELS	4
+
 /****s* Component Library: Event_Wheel/cl_event_wheel_t
 * NAME
 *	cl_event_wheel_t
@@ -137,9 +147,14 @@ typedef uint64_t
 typedef struct _cl_event_wheel {
 	cl_spinlock_t lock;
 	cl_spinlock_t *p_external_lock;
-	cl_qmap_t events_map;
 	boolean_t closing;
-	cl_qlist_t events_wheel;
+	cl_qlist_t slots[CL_EVENT_WHEEL_LEVELS][CL_EVENT_WHEEL_SLOTS];
+	uint32_t level_count[CL_EVENT_WHEEL_LEVELS];
+	uint64_t cur_tick;
+	uint64_t next_tick;
+	cl_qlist_t *hash;
+	uint32_t hash_bits;
+	uint32_t num_events;
 	cl_timer_t timer;
 } cl_event_wheel_t;
 /*
@@ -151,15 +166,28 @@ typedef struct _cl_event_wheel {
 *		Reference to external spinlock to guard internal structures
 *		if the event wheel is part of a larger object protected by its own lock
 *
-*	events_map
-*		A Map holding all registered event items by their key.
-*
 *	closing
 *		A flag indicating the event wheel is closing. This means that
 *		callbacks that are called when closing == TRUE should just be ignored.
 *
-*	events_wheel
-*		A list of the events sorted by expiration time.
+*	slots
+*		The timing wheel: lists of events by level and slot.
+*
+*	level_count
+*		Number of events in the slots of each level.
+*
+*	cur_tick
+*		The tick (in msec) the wheel was advanced to.
+*
+*	next_tick
+*		The tick the timer is set to, 0 when it is not set.
+*
+*	hash
+*		Hash table of 1 << hash_bits lists holding all registered
+*		events by their key.
+*
+*	num_events
+*		Number of registered events.
 *
 *	timer
 *		The timer scheduling event time propagation.
@@ -181,8 +209,9 @@ typedef struct _cl_event_wheel {
 * SYNOPSIS
 */
 typedef struct _cl_event_wheel_reg_info {
-	cl_map_item_t map_item;
+	cl_list_item_t hash_item;
 	cl_list_item_t list_item;
+	cl_qlist_t *p_slot;
 	uint64_t key;
 	cl_pfn_event_aged_cb_t pfn_aged_callback;
 	uint64_t aging_time;
@@ -191,11 +220,15 @@ typedef struct _cl_event_wheel_reg_info {
 } cl_event_wheel_reg_info_t;
 /*
 * FIELDS
-*	map_item
-*		The map item of this event
+*	hash_item
+*		Linkage in the key hash table
 *
 *	list_item
-*		The sorted by aging time list item
+*		Linkage in the wheel slot
+*
+*	p_slot
+*		The wheel slot list holding the event, NULL while the event
+*		is being processed
 *
 *	key
 *		The key by which one can find the event
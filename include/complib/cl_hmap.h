@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2026 The OpenSM contributors. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *	Declaration of the hash map, an open addressing hash table
+ *	keyed by 64 bit values.
+ */
+
+#ifndef _CL_HMAP_H_
+#define _CL_HMAP_H_
+
+#include <complib/cl_types.h>
+
+#ifdef __cplusplus
+#  define BEGIN_C_DECLS extern "C" {
+#  define END_C_DECLS   }
+#else				/* !__cplusplus */
+#  define BEGIN_C_DECLS
+#  define END_C_DECLS
+#endif				/* __cplusplus */
+
+BEGIN_C_DECLS
+/****h* Component Library/Hash Map
+* NAME
+*	Hash Map
+*
+* DESCRIPTION
+*	Hash Map maps 64 bit keys (typically GUIDs) to non NULL pointers.
+*
+*	Entries are kept in a single array using open addressing with
+*	linear probing, so a lookup usually touches one cache line. The
+*	array doubles when it becomes half full. Removal shifts the
+*	following entries back, so no tombstones are left behind.
+*
+*	The hash map does not keep the keys in order. A cl_qmap_t may use
+*	a hash map as its index (see cl_qmap_set_index) to keep ordered
+*	iteration while looking up keys through the hash map.
+*
+*	The hash map functions operate on a cl_hmap_t structure which
+*	should be treated as opaque, and should be manipulated only through
+*	the provided functions.
+*
+* SEE ALSO
+*	Structures:
+*		cl_hmap_t
+*
+*	Initialization:
+*		cl_hmap_construct, cl_hmap_init, cl_hmap_destroy
+*
+*	Manipulation:
+*		cl_hmap_insert, cl_hmap_remove, cl_hmap_remove_all
+*
+*	Search:
+*		cl_hmap_get
+*
+*	Attributes:
+*		cl_hmap_count
+*********/
+/****s* Component Library: Hash Map/cl_hmap_t
+* NAME
+*	cl_hmap_t
+*
+* DESCRIPTION
+*	Hash map structure.
+*
+*	The cl_hmap_t structure should be treated as opaque and should
+*	be manipulated only through the provided functions.
+*
+* SYNOPSIS
+*/
+typedef struct _cl_hmap_entry {
+	uint64_t key;
+	void *p_value;
+} cl_hmap_entry_t;
+
+typedef struct _cl_hmap {
+	cl_hmap_entry_t *p_table;
+	uint32_t size;
+	uint32_t shift;
+	uint32_t count;
+	cl_state_t state;
+} cl_hmap_t;
+/*
+* FIELDS
+*	p_table
+*		Array of entries. Free entries have a NULL value.
+*
+*	size
+*		Number of entries in the table, a power of two.
+*
+*	shift
+*		64 minus log2 of size, used to derive the home entry of a key.
+*
+*	count
+*		Number of keys stored in the map.
+*
+*	state
+*		State of the map.
+*
+* SEE ALSO
+*	Hash Map
+*********/
+
+/* the home entry of a key - Fibonacci hashing spreads sequential GUIDs */
+static inline uint32_t __cl_hmap_home(IN const cl_hmap_t * const p_map,
+				      IN const uint64_t key)
+{
+	return (uint32_t) ((key * 0x9e3779b97f4a7c15ULL) >> p_map->shift);
+}
+
+/****f* Component Library: Hash Map/cl_hmap_construct
+* NAME
+*	cl_hmap_construct
+*
+* DESCRIPTION
+*	The cl_hmap_construct function constructs a hash map.
+*
+* SYNOPSIS
+*/
+void cl_hmap_construct(IN cl_hmap_t * const p_map);
+/*
+* PARAMETERS
+*	p_map
+*		[in] Pointer to a cl_hmap_t structure to construct.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* NOTES
+*	Allows calling cl_hmap_destroy without first calling cl_hmap_init.
+*
+* SEE ALSO
+*	Hash Map, cl_hmap_init, cl_hmap_destroy
+*********/
+
+/****f* Component Library: Hash Map/cl_hmap_init
+* NAME
+*	cl_hmap_init
+*
+* DESCRIPTION
+*	The cl_hmap_init function initializes a hash map for use.
+*
+* SYNOPSIS
+*/
+cl_status_t cl_hmap_init(IN cl_hmap_t * const p_map, IN const uint32_t min_items);
+/*
+* PARAMETERS
+*	p_map
+*		[in] Pointer to a cl_hmap_t structure to initialize.
+*
+*	min_items
+*		[in] Number of keys the map holds before it first grows.
+*
+* RETURN VALUES
+*	CL_SUCCESS if the hash map was initialized successfully.
+*
+*	CL_INSUFFICIENT_MEMORY if there was not enough memory for the table.
+*
+* SEE ALSO
+*	Hash Map, cl_hmap_construct, cl_hmap_destroy
+*********/
+
+/****f* Component Library: Hash Map/cl_hmap_destroy
+* NAME
+*	cl_hmap_destroy
+*
+* DESCRIPTION
+*	The cl_hmap_destroy function destroys a hash map.
+*
+* SYNOPSIS
+*/
+void cl_hmap_destroy(IN cl_hmap_t * const p_map);
+/*
+* PARAMETERS
+*	p_map
+*		[in] Pointer to a cl_hmap_t structure to destroy.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* NOTES
+*	The objects referenced by the map are not freed.
+*
+* SEE ALSO
+*	Hash Map, cl_hmap_construct, cl_hmap_init
+*********/
+
+/****f* Component Library: Hash Map/cl_hmap_count
+* NAME
+*	cl_hmap_count
+*
+* DESCRIPTION
+*	The cl_hmap_count function returns the number of keys stored
+*	in a hash map.
+*
+* SYNOPSIS
+*/
+static inline uint32_t cl_hmap_count(IN const cl_hmap_t * const p_map)
+{
+	CL_ASSERT(p_map);
+	return p_map->count;
+}
+/*
+* PARAMETERS
+*	p_map
+*		[in] Pointer to a cl_hmap_t structure whose key count to return.
+*
+* RETURN VALUE
+*	Returns the number of keys stored in the map.
+*
+* SEE ALSO
+*	Hash Map
+*********/
+
+/****f* Component Library: Hash Map/cl_hmap_get
+* NAME
+*	cl_hmap_get
+*
+* DESCRIPTION
+*	The cl_hmap_get function returns the value stored for a key.
+*
+* SYNOPSIS
+*/
+static inline void *cl_hmap_get(IN const cl_hmap_t * const p_map,
+				IN const uint64_t key)
+{
+	const cl_hmap_entry_t *p_entry;
+	uint32_t i;
+
+	CL_ASSERT(p_map);
+	CL_ASSERT(p_map->state == CL_INITIALIZED);
+
+	for (i = __cl_hmap_home(p_map, key);; i = (i + 1) & (p_map->size - 1)) {
+		p_entry = &p_map->p_table[i];
+		if (!p_entry->p_value)
+			return NULL;
+		if (p_entry->key == key)
+			return p_entry->p_value;
+	}
+}
+/*
+* PARAMETERS
+*	p_map
+*		[in] Pointer to a cl_hmap_t structure to search.
+*
+*	key
+*		[in] Key to look up.
+*
+* RETURN VALUES
+*	Pointer stored for the key.
+*
+*	NULL if the key is not in the map.
+*
+* SEE ALSO
+*	Hash Map, cl_hmap_insert, cl_hmap_remove
+*********/
+
+/****f* Component Library: Hash Map/cl_hmap_insert
+* NAME
+*	cl_hmap_insert
+*
+* DESCRIPTION
+*	The cl_hmap_insert function stores a value for a key.
+*
+* SYNOPSIS
+*/
+cl_status_t cl_hmap_insert(IN cl_hmap_t * const p_map, IN const uint64_t key,
+			   IN void *const p_value);
+/*
+* PARAMETERS
+*	p_map
+*		[in] Pointer to a cl_hmap_t structure into which to insert.
+*
+*	key
+*		[in] Key of the new entry.
+*
+*	p_value
+*		[in] Value to store, must not be NULL.
+*
+* RETURN VALUES
+*	CL_SUCCESS if the value was stored.
+*
+*	CL_DUPLICATE if the key is already in the map. The stored value is
+*	left unchanged.
+*
+*	CL_INSUFFICIENT_MEMORY if the table needed to grow and there was not
+*	enough memory.
+*
+* SEE ALSO
+*	Hash Map, cl_hmap_remove, cl_hmap_get
+*********/
+
+/****f* Component Library: Hash Map/cl_hmap_remove
+* NAME
+*	cl_hmap_remove
+*
+* DESCRIPTION
+*	The cl_hmap_remove function removes a key from a hash map.
+*
+* SYNOPSIS
+*/
+void *cl_hmap_remove(IN cl_hmap_t * const p_map, IN const uint64_t key);
+/*
+* PARAMETERS
+*	p_map
+*		[in] Pointer to a cl_hmap_t structure from which to remove.
+*
+*	key
+*		[in] Key to remove.
+*
+* RETURN VALUES
+*	Pointer that was stored for the key.
+*
+*	NULL if the key was not in the map.
+*
+* SEE ALSO
+*	Hash Map, cl_hmap_insert, cl_hmap_remove_all
+*********/
+
+/****f* Component Library: Hash Map/cl_hmap_remove_all
+* NAME
+*	cl_hmap_remove_all
+*
+* DESCRIPTION
+*	The cl_hmap_remove_all function removes all keys from a hash map.
+*
+* SYNOPSIS
+*/
+void cl_hmap_remove_all(IN cl_hmap_t * const p_map);
+/*
+* PARAMETERS
+*	p_map
+*		[in] Pointer to a cl_hmap_t structure to empty.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* SEE ALSO
+*	Hash Map, cl_hmap_remove
+*********/
+
+END_C_DECLS
+#endif				/* _CL_HMAP_H_ */
@@ -43,6 +43,7 @@
 #define _CL_QMAP_H_
 
 #include <complib/cl_qpool.h>
+#include <complib/cl_hmap.h>
 
 #ifdef __cplusplus
 #  define BEGIN_C_DECLS extern "C" {
@@ -85,7 +86,7 @@ BEGIN_C_DECLS
 *		cl_qmap_set_obj, cl_qmap_obj, cl_qmap_key
 *
 *	Initialization:
-*		cl_qmap_init
+*		cl_qmap_init, cl_qmap_set_index
 *
 *	Iteration:
 *		cl_qmap_end, cl_qmap_head, cl_qmap_tail, cl_qmap_next, cl_qmap_prev
@@ -244,6 +245,7 @@ typedef struct _cl_qmap {
 	cl_map_item_t nil;
 	cl_state_t state;
 	size_t count;
+	cl_hmap_t *p_index;
 } cl_qmap_t;
 /*
 * PARAMETERS
@@ -263,8 +265,11 @@ typedef struct _cl_qmap {
 *	count
 *		Number of items in the map.
 *
+*	p_index
+*		Optional hash map indexing the items by key.
+*
 * SEE ALSO
-*	Quick Map
+*	Quick Map, cl_qmap_set_index
 *********/
 
 /****d* Component Library: Quick Map/cl_pfn_qmap_apply_t
@@ -474,6 +479,43 @@ void cl_qmap_init(IN cl_qmap_t * const p_map);
 *	Quick Map, cl_qmap_insert, cl_qmap_remove
 *********/
 
+/****f* Component Library: Quick Map/cl_qmap_set_index
+* NAME
+*	cl_qmap_set_index
+*
+* DESCRIPTION
+*	The cl_qmap_set_index function makes a quick map keep its items in
+*	a hash map as well, so that cl_qmap_get and cl_qmap_remove find
+*	items in constant time while iteration stays ordered.
+*
+* SYNOPSIS
+*/
+cl_status_t cl_qmap_set_index(IN cl_qmap_t * const p_map,
+			      IN cl_hmap_t * const p_index);
+/*
+* PARAMETERS
+*	p_map
+*		[in] Pointer to a cl_qmap_t structure to index.
+*
+*	p_index
+*		[in] Pointer to an initialized, empty cl_hmap_t structure,
+*		or NULL to stop using an index.
+*
+* RETURN VALUES
+*	CL_SUCCESS if the items already in the map were indexed.
+*
+*	CL_INSUFFICIENT_MEMORY if the index could not hold them. The map
+*	then keeps working without an index.
+*
+* NOTES
+*	The index is maintained by all quick map functions and must not be
+*	modified directly. Should the index fail to grow when an item is
+*	inserted, the map drops it and falls back to tree lookups.
+*
+* SEE ALSO
+*	Quick Map, cl_qmap_init, Hash Map
+*********/
+
 /****f* Component Library: Quick Map/cl_qmap_end
 * NAME
 *	cl_qmap_end
@@ -836,6 +878,8 @@ static inline void cl_qmap_remove_all(IN cl_qmap_t * const p_map)
 	p_map->nil.pool_item.list_item.p_next = &p_map->nil.pool_item.list_item;
 	p_map->nil.pool_item.list_item.p_prev = &p_map->nil.pool_item.list_item;
 	p_map->count = 0;
+	if (p_map->p_index)
+		cl_hmap_remove_all(p_map->p_index);
 }
 
 /*
@@ -0,0 +1,585 @@
+/*
+ * Copyright (c) 2026 The OpenSM contributors. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *	Declaration of the work stealing pool.
+ */
+
+#ifndef _CL_WORK_POOL_H_
+#define _CL_WORK_POOL_H_
+
+#include <pthread.h>
+#include <complib/cl_types.h>
+#include <complib/cl_qlist.h>
+#include <complib/cl_qmap.h>
+#include <complib/cl_spinlock.h>
+
+#ifdef __cplusplus
+#  define BEGIN_C_DECLS extern "C" {
+#  define END_C_DECLS   }
+#else				/* !__cplusplus */
+#  define BEGIN_C_DECLS
+#  define END_C_DECLS
+#endif				/* __cplusplus */
+
+BEGIN_C_DECLS
+/****h* Component Library/Work Pool
+* NAME
+*	Work Pool
+*
+* DESCRIPTION
+*	The Work Pool runs short independent work items on a fixed set of
+*	worker threads.
+*
+*	Each worker owns a queue of work items. A worker runs the items it
+*	queued itself newest first, and when its queue is empty it steals
+*	the oldest item from the queue of another worker. Threads only meet
+*	on the pool mutex when a worker runs out of work to steal and goes
+*	to sleep.
+*
+*	Work items are grouped in work groups. A thread may wait for the
+*	completion of a group; a worker waiting for a group keeps running
+*	work items meanwhile, so work items may themselves submit and wait
+*	for nested groups.
+*
+*	The work pool functions operate on a cl_work_pool_t structure which
+*	should be treated as opaque, and should be manipulated only through
+*	the provided functions.
+*
+* SEE ALSO
+*	Structures:
+*		cl_work_pool_t, cl_work_group_t, cl_work_item_t
+*
+*	Callbacks:
+*		cl_pfn_work_t, cl_pfn_range_work_t, cl_pfn_qmap_work_t
+*
+*	Initialization:
+*		cl_work_pool_init, cl_work_pool_destroy, cl_work_group_init
+*
+*	Manipulation:
+*		cl_work_pool_submit, cl_work_pool_wait,
+*		cl_work_pool_parallel_for, cl_work_pool_parallel_for_qmap
+*
+*	Attributes:
+*		cl_work_pool_size
+*********/
+/****d* Component Library: Work Pool/cl_pfn_work_t
+* NAME
+*	cl_pfn_work_t
+*
+* DESCRIPTION
+*	The cl_pfn_work_t function type defines the prototype for
+*	functions run by work items.
+*
+* SYNOPSIS
+*/
+typedef void (*cl_pfn_work_t) (IN void *context, IN unsigned worker);
+/*
+* PARAMETERS
+*	context
+*		[in] Value specified when the work item was submitted.
+*
+*	worker
+*		[in] Index of the worker running the item, lower than
+*		cl_work_pool_size. No two items run concurrently with the
+*		same index, so it may be used to select per worker state.
+*		A worker waiting for a nested group runs other items with
+*		the same index, so such state must not be held across
+*		cl_work_pool_wait, cl_work_pool_parallel_for or
+*		cl_work_pool_parallel_for_qmap.
+*
+* SEE ALSO
+*	Work Pool, cl_work_pool_submit
+*********/
+
+/****d* Component Library: Work Pool/cl_pfn_range_work_t
+* NAME
+*	cl_pfn_range_work_t
+*
+* DESCRIPTION
+*	The cl_pfn_range_work_t function type defines the prototype for
+*	functions processing a sub range in cl_work_pool_parallel_for.
+*
+* SYNOPSIS
+*/
+typedef void
+ (*cl_pfn_range_work_t) (IN void *context, IN size_t begin, IN size_t end,
+			 IN unsigned worker);
+/*
+* PARAMETERS
+*	context
+*		[in] Value passed to cl_work_pool_parallel_for.
+*
+*	begin, end
+*		[in] Sub range [begin, end) to process.
+*
+*	worker
+*		[in] Index of the worker, see cl_pfn_work_t.
+*
+* SEE ALSO
+*	Work Pool, cl_work_pool_parallel_for
+*********/
+
+/****d* Component Library: Work Pool/cl_pfn_qmap_work_t
+* NAME
+*	cl_pfn_qmap_work_t
+*
+* DESCRIPTION
+*	The cl_pfn_qmap_work_t function type defines the prototype for
+*	functions processing one map item in cl_work_pool_parallel_for_qmap.
+*
+* SYNOPSIS
+*/
+typedef void
+ (*cl_pfn_qmap_work_t) (IN void *context, IN cl_map_item_t * p_map_item,
+			IN unsigned worker);
+/*
+* PARAMETERS
+*	context
+*		[in] Value passed to cl_work_pool_parallel_for_qmap.
+*
+*	p_map_item
+*		[in] The map item to process.
+*
+*	worker
+*		[in] Index of the worker, see cl_pfn_work_t.
+*
+* SEE ALSO
+*	Work Pool, cl_work_pool_parallel_for_qmap
+*********/
+
+/****s* Component Library: Work Pool/cl_work_group_t
+* NAME
+*	cl_work_group_t
+*
+* DESCRIPTION
+*	Tracks the completion of a set of work items.
+*
+* SYNOPSIS
+*/
+typedef struct _cl_work_group {
+	atomic32_t pending;
+} cl_work_group_t;
+/*
+* FIELDS
+*	pending
+*		Number of submitted work items not completed yet.
+*
+* SEE ALSO
+*	Work Pool, cl_work_group_init, cl_work_pool_wait
+*********/
+
+/****s* Component Library: Work Pool/cl_work_item_t
+* NAME
+*	cl_work_item_t
+*
+* DESCRIPTION
+*	A unit of work. The storage is provided by the submitter and must
+*	stay valid until the work group completes.
+*
+* SYNOPSIS
+*/
+typedef struct _cl_work_item {
+	cl_list_item_t list_item;
+	cl_pfn_work_t pfn_work;
+	void *context;
+	cl_work_group_t *p_group;
+} cl_work_item_t;
+/*
+* FIELDS
+*	list_item
+*		Linkage in the queue of a worker.
+*
+*	pfn_work
+*		Function to run.
+*
+*	context
+*		Value passed to pfn_work.
+*
+*	p_group
+*		The work group the item belongs to.
+*
+* SEE ALSO
+*	Work Pool, cl_work_pool_submit
+*********/
+
+/****s* Component Library: Work Pool/cl_work_queue_t
+* NAME
+*	cl_work_queue_t
+*
+* DESCRIPTION
+*	Work queue owned by a worker.
+*
+* SYNOPSIS
+*/
+typedef struct _cl_work_queue {
+	cl_spinlock_t lock;
+	cl_qlist_t list;
+} cl_work_queue_t;
+/*
+* FIELDS
+*	lock
+*		Protects the list against thieves.
+*
+*	list
+*		Queued work items. The owner pushes and pops at the tail,
+*		thieves take from the head.
+*********/
+
+/****s* Component Library: Work Pool/cl_work_pool_t
+* NAME
+*	cl_work_pool_t
+*
+* DESCRIPTION
+*	Work pool structure.
+*
+*	The cl_work_pool_t structure should be treated as opaque, and should
+*	be manipulated only through the provided functions.
+*
+* SYNOPSIS
+*/
+typedef struct _cl_work_pool {
+	unsigned count;
+	cl_work_queue_t *queues;
+	pthread_t *tid;
+	pthread_key_t worker_key;
+	atomic32_t queued;
+	atomic32_t next_queue;
+	unsigned sleepers;
+	boolean_t exit;
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+} cl_work_pool_t;
+/*
+* FIELDS
+*	count
+*		Number of worker threads.
+*
+*	queues
+*		Array of count work queues, one per worker.
+*
+*	tid
+*		Array of worker thread ids.
+*
+*	worker_key
+*		Thread specific key holding the worker index + 1, 0 for
+*		threads outside the pool.
+*
+*	queued
+*		Number of work items in all queues.
+*
+*	next_queue
+*		Round robin counter spreading items submitted by threads
+*		outside the pool over the worker queues.
+*
+*	sleepers
+*		Number of workers waiting on work_cond.
+*
+*	exit
+*		Set by cl_work_pool_destroy to stop the workers.
+*
+*	mutex
+*		Protects sleepers and the condition variables.
+*
+*	work_cond
+*		Signalled when work is queued.
+*
+*	done_cond
+*		Broadcast when a work group completes.
+*
+* SEE ALSO
+*	Work Pool
+*********/
+
+/****f* Component Library: Work Pool/cl_work_pool_init
+* NAME
+*	cl_work_pool_init
+*
+* DESCRIPTION
+*	The cl_work_pool_init function creates the worker threads of a
+*	work pool.
+*
+* SYNOPSIS
+*/
+cl_status_t cl_work_pool_init(IN cl_work_pool_t * const p_pool,
+			      IN unsigned count);
+/*
+* PARAMETERS
+*	p_pool
+*		[in] Pointer to a work pool structure to initialize.
+*
+*	count
+*		[in] Number of worker threads. If zero, as many workers as
+*		there are processors in the system are created.
+*
+* RETURN VALUES
+*	CL_SUCCESS if the work pool creation succeeded.
+*
+*	CL_INSUFFICIENT_MEMORY if there was not enough memory to initialize
+*	the work pool.
+*
+*	CL_INSUFFICIENT_RESOURCES if the threads could not be created.
+*
+* SEE ALSO
+*	Work Pool, cl_work_pool_destroy
+*********/
+
+/****f* Component Library: Work Pool/cl_work_pool_destroy
+* NAME
+*	cl_work_pool_destroy
+*
+* DESCRIPTION
+*	The cl_work_pool_destroy function stops the workers and frees the
+*	resources of a work pool.
+*
+* SYNOPSIS
+*/
+void cl_work_pool_destroy(IN cl_work_pool_t * const p_pool);
+/*
+* PARAMETERS
+*	p_pool
+*		[in] Pointer to a work pool structure to destroy.
+*
+* NOTES
+*	All submitted work groups must have completed. Must not be called
+*	from a worker of the pool.
+*
+* SEE ALSO
+*	Work Pool, cl_work_pool_init
+*********/
+
+/****f* Component Library: Work Pool/cl_work_pool_size
+* NAME
+*	cl_work_pool_size
+*
+* DESCRIPTION
+*	Returns the number of worker indexes passed to work functions.
+*
+* SYNOPSIS
+*/
+static inline unsigned cl_work_pool_size(IN const cl_work_pool_t * p_pool)
+{
+	return p_pool ? p_pool->count : 1;
+}
+/*
+* PARAMETERS
+*	p_pool
+*		[in] Pointer to a work pool or NULL.
+*
+* RETURN VALUE
+*	Size of per worker state arrays indexed by the worker parameter.
+*
+* NOTES
+*	cl_work_pool_parallel_for and cl_work_pool_parallel_for_qmap run
+*	in the calling thread with worker index 0 when p_pool is NULL.
+*
+* SEE ALSO
+*	Work Pool, cl_pfn_work_t
+*********/
+
+/****f* Component Library: Work Pool/cl_work_group_init
+* NAME
+*	cl_work_group_init
+*
+* DESCRIPTION
+*	Initializes an empty work group.
+*
+* SYNOPSIS
+*/
+static inline void cl_work_group_init(IN cl_work_group_t * const p_group)
+{
+	p_group->pending = 0;
+}
+/*
+* PARAMETERS
+*	p_group
+*		[in] Pointer to the work group to initialize.
+*
+* SEE ALSO
+*	Work Pool, cl_work_pool_submit, cl_work_pool_wait
+*********/
+
+/****f* Component Library: Work Pool/cl_work_pool_submit
+* NAME
+*	cl_work_pool_submit
+*
+* DESCRIPTION
+*	Queues a work item. Items submitted by a worker go to its own
+*	queue, items submitted by other threads are spread over the
+*	workers.
+*
+* SYNOPSIS
+*/
+void cl_work_pool_submit(IN cl_work_pool_t * const p_pool,
+			 IN cl_work_group_t * const p_group,
+			 IN cl_work_item_t * const p_item,
+			 IN cl_pfn_work_t pfn_work, IN void *context);
+/*
+* PARAMETERS
+*	p_pool
+*		[in] Pointer to a work pool.
+*
+*	p_group
+*		[in] Work group the item is accounted to.
+*
+*	p_item
+*		[in] Storage for the work item.
+*
+*	pfn_work
+*		[in] Function to run.
+*
+*	context
+*		[in] Value passed to pfn_work.
+*
+* SEE ALSO
+*	Work Pool, cl_work_pool_wait
+*********/
+
+/****f* Component Library: Work Pool/cl_work_pool_wait
+* NAME
+*	cl_work_pool_wait
+*
+* DESCRIPTION
+*	Waits until all items of a work group have completed.
+*
+* SYNOPSIS
+*/
+void cl_work_pool_wait(IN cl_work_pool_t * const p_pool,
+		       IN cl_work_group_t * const p_group);
+/*
+* PARAMETERS
+*	p_pool
+*		[in] Pointer to a work pool.
+*
+*	p_group
+*		[in] Work group to wait for.
+*
+* NOTES
+*	When called by a worker, the worker runs queued items (of any
+*	group) while it waits, under its own worker index.
+*
+* SEE ALSO
+*	Work Pool, cl_work_pool_submit
+*********/
+
+/****f* Component Library: Work Pool/cl_work_pool_parallel_for
+* NAME
+*	cl_work_pool_parallel_for
+*
+* DESCRIPTION
+*	Splits the range [begin, end) in sub ranges processed in parallel
+*	and waits for all of them.
+*
+* SYNOPSIS
+*/
+cl_status_t
+cl_work_pool_parallel_for(IN cl_work_pool_t * const p_pool, IN size_t begin,
+			  IN size_t end, IN size_t grain,
+			  IN cl_pfn_range_work_t pfn_work, IN void *context);
+/*
+* PARAMETERS
+*	p_pool
+*		[in] Pointer to a work pool or NULL to run in the caller.
+*
+*	begin, end
+*		[in] The range to process.
+*
+*	grain
+*		[in] Number of indexes per sub range. If zero, the range is
+*		split in about four sub ranges per worker.
+*
+*	pfn_work
+*		[in] Function processing a sub range.
+*
+*	context
+*		[in] Value passed to pfn_work.
+*
+* RETURN VALUES
+*	CL_SUCCESS once all sub ranges were processed.
+*
+*	CL_INSUFFICIENT_MEMORY if the work items could not be allocated;
+*	nothing was processed in that case.
+*
+* SEE ALSO
+*	Work Pool, cl_work_pool_parallel_for_qmap
+*********/
+
+/****f* Component Library: Work Pool/cl_work_pool_parallel_for_qmap
+* NAME
+*	cl_work_pool_parallel_for_qmap
+*
+* DESCRIPTION
+*	Calls a function for every item of a quick map, in parallel, and
+*	waits for all of them.
+*
+* SYNOPSIS
+*/
+cl_status_t
+cl_work_pool_parallel_for_qmap(IN cl_work_pool_t * const p_pool,
+			       IN const cl_qmap_t * const p_map,
+			       IN size_t grain,
+			       IN cl_pfn_qmap_work_t pfn_work,
+			       IN void *context);
+/*
+* PARAMETERS
+*	p_pool
+*		[in] Pointer to a work pool or NULL to run in the caller.
+*
+*	p_map
+*		[in] The map to iterate. It must not be modified until the
+*		function returns.
+*
+*	grain
+*		[in] Number of map items per work item. If zero, the map is
+*		split in about four parts per worker.
+*
+*	pfn_work
+*		[in] Function processing a map item.
+*
+*	context
+*		[in] Value passed to pfn_work.
+*
+* RETURN VALUES
+*	CL_SUCCESS once all map items were processed.
+*
+*	CL_INSUFFICIENT_MEMORY if the work items could not be allocated;
+*	nothing was processed in that case.
+*
+* SEE ALSO
+*	Work Pool, cl_work_pool_parallel_for
+*********/
+
+END_C_DECLS
+#endif				/* _CL_WORK_POOL_H_ */
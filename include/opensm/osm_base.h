@@ -318,6 +318,18 @@ BEGIN_C_DECLS
 #endif /* __WIN__ */
 /***********/
 
+/****d* OpenSM: Base/OSM_DEFAULT_MAD_TRACE_RECORDS
+* NAME
+*	OSM_DEFAULT_MAD_TRACE_RECORDS
+*
+* DESCRIPTION
+*	Default number of records in the binary MAD trace ring (2 MB).
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_MAD_TRACE_RECORDS 65536
+/***********/
+
 /****d* OpenSM: OSM_DEFAULT_SWEEP_INTERVAL_SECS
 * NAME
 *	OSM_DEFAULT_SWEEP_INTERVAL_SECS
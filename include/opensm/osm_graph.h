@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2026 The OpenSM contributors. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ * 	Declaration of osm_graph_t.
+ *	This object represents the switch graph of the subnet in
+ *	compressed sparse row form, for use by the routing engines.
+ *
+ * Environment:
+ * 	Linux User Mode
+ */
+
+#ifndef _OSM_GRAPH_H_
+#define _OSM_GRAPH_H_
+
+#include <iba/ib_types.h>
+#include <opensm/osm_switch.h>
+
+#ifdef __cplusplus
+#  define BEGIN_C_DECLS extern "C" {
+#  define END_C_DECLS   }
+#else				/* !__cplusplus */
+#  define BEGIN_C_DECLS
+#  define END_C_DECLS
+#endif				/* __cplusplus */
+
+BEGIN_C_DECLS
+
+struct osm_subn;
+
+/****h* OpenSM/Switch Graph
+* NAME
+*	Switch Graph
+*
+* DESCRIPTION
+*	The Switch Graph object is a snapshot of the switches of the
+*	subnet, of the links between them and of the end ports attached
+*	to them, built once per heavy sweep by the unicast manager and
+*	shared by the routing engines instead of each one walking the
+*	osm_physp_t links.
+*
+*	Switches are numbered by their order in the subnet switch GUID
+*	table, and the links leaving switch i are
+*	links[link_start[i]] to links[link_start[i + 1] - 1], sorted by
+*	local port number.  The CA and router ports of switch i are
+*	stored the same way in endports from endport_start[i].  Routing
+*	engines may keep per switch state in arrays indexed by switch
+*	number instead of through osm_switch_t.
+*
+*	The graph is read only once built, so it can be walked
+*	concurrently by routing worker threads.
+*
+*********/
+
+/****d* OpenSM: Switch Graph/OSM_GRAPH_NO_SW
+* NAME
+*	OSM_GRAPH_NO_SW
+*
+* DESCRIPTION
+*	Switch number returned by lookups for switches which are not in
+*	the graph.
+*
+* SYNOPSIS
+*/
+#define OSM_GRAPH_NO_SW 0xffffffff
+/***********/
+
+/****s* OpenSM: Switch Graph/osm_graph_link_t
+* NAME
+*	osm_graph_link_t
+*
+* DESCRIPTION
+*	Link of the switch graph, from a switch port to a port of
+*	another (or the same) switch.
+*
+* SYNOPSIS
+*/
+typedef struct osm_graph_link {
+	uint32_t sw;
+	uint8_t port;
+	uint8_t rem_port;
+	uint8_t healthy;
+	uint8_t throttled;
+} osm_graph_link_t;
+/*
+* FIELDS
+*	sw
+*		Number of the remote switch.
+*
+*	port
+*		Local port number.
+*
+*	rem_port
+*		Remote port number.
+*
+*	healthy
+*		Result of osm_link_is_healthy for the local port.
+*
+*	throttled
+*		Result of osm_link_is_throttled for the local port,
+*		honoring the fdr10 option.
+*
+*********/
+
+/****s* OpenSM: Switch Graph/osm_graph_endport_t
+* NAME
+*	osm_graph_endport_t
+*
+* DESCRIPTION
+*	CA or router port attached to a switch port.
+*
+* SYNOPSIS
+*/
+typedef struct osm_graph_endport {
+	osm_physp_t *p_physp;
+	uint16_t lid;
+	uint8_t lmc;
+	uint8_t port;
+	uint8_t healthy;
+} osm_graph_endport_t;
+/*
+* FIELDS
+*	p_physp
+*		The end port.
+*
+*	lid
+*		Base LID of the end port, in host order.
+*
+*	lmc
+*		LMC of the end port.
+*
+*	port
+*		Switch port number the end port is attached to.
+*
+*	healthy
+*		Result of osm_link_is_healthy for the switch port.
+*
+*********/
+
+/****s* OpenSM: Switch Graph/osm_graph_t
+* NAME
+*	osm_graph_t
+*
+* DESCRIPTION
+*	Switch graph of the subnet.
+*
+* SYNOPSIS
+*/
+typedef struct osm_graph {
+	uint32_t num_sw;
+	uint32_t num_links;
+	uint32_t num_endports;
+	uint16_t max_lid;
+	osm_switch_t **sw;
+	uint16_t *lid;
+	uint8_t *lmc;
+	uint32_t *link_start;
+	osm_graph_link_t *links;
+	uint32_t *endport_start;
+	osm_graph_endport_t *endports;
+	uint32_t *lid_sw;
+} osm_graph_t;
+/*
+* FIELDS
+*	num_sw
+*		Number of switches.
+*
+*	num_links
+*		Number of switch to switch links, counted in both
+*		directions.
+*
+*	num_endports
+*		Number of CA and router ports attached to the switches.
+*
+*	max_lid
+*		Largest LID in lid_sw.
+*
+*	sw
+*		Switches ordered by GUID.
+*
+*	lid
+*		Base LID of each switch, in host order.
+*
+*	lmc
+*		LMC of port 0 of each switch.
+*
+*	link_start
+*		Index in links of the first link of each switch, with
+*		link_start[num_sw] == num_links.
+*
+*	links
+*		Links of all the switches.
+*
+*	endport_start
+*		Index in endports of the first end port of each switch,
+*		with endport_start[num_sw] == num_endports.
+*
+*	endports
+*		End ports of all the switches.
+*
+*	lid_sw
+*		Number of the switch owning each LID, either one of its
+*		own LIDs or a LID of an end port attached to it, and
+*		OSM_GRAPH_NO_SW for unknown LIDs.  Indexed by host order
+*		LID up to max_lid.
+*
+* SEE ALSO
+*	osm_graph_build, osm_graph_find_sw, osm_graph_lid_to_sw
+*********/
+
+/****f* OpenSM: Switch Graph/osm_graph_construct
+* NAME
+*	osm_graph_construct
+*
+* DESCRIPTION
+*	Constructs an empty switch graph.
+*
+* SYNOPSIS
+*/
+void osm_graph_construct(IN osm_graph_t * p_graph);
+/*
+* PARAMETERS
+*	p_graph
+*		[in] Pointer to the graph to construct.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* SEE ALSO
+*	osm_graph_destroy
+*********/
+
+/****f* OpenSM: Switch Graph/osm_graph_destroy
+* NAME
+*	osm_graph_destroy
+*
+* DESCRIPTION
+*	Frees the arrays of a switch graph and leaves it empty.
+*
+* SYNOPSIS
+*/
+void osm_graph_destroy(IN osm_graph_t * p_graph);
+/*
+* PARAMETERS
+*	p_graph
+*		[in] Pointer to a constructed graph.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* SEE ALSO
+*	osm_graph_construct
+*********/
+
+/****f* OpenSM: Switch Graph/osm_graph_build
+* NAME
+*	osm_graph_build
+*
+* DESCRIPTION
+*	Replaces the content of the graph with the current switches of
+*	the subnet, the links between them and their end ports.
+*
+* SYNOPSIS
+*/
+int osm_graph_build(IN osm_graph_t * p_graph, IN struct osm_subn *p_subn);
+/*
+* PARAMETERS
+*	p_graph
+*		[in] Pointer to a constructed graph.
+*
+*	p_subn
+*		[in] Pointer to the subnet object.
+*
+* RETURN VALUE
+*	0 on success, -1 if memory could not be allocated, in which case
+*	the graph is left empty.
+*
+* NOTES
+*	The caller must hold the subnet lock.
+*
+*********/
+
+/****f* OpenSM: Switch Graph/osm_graph_find_sw
+* NAME
+*	osm_graph_find_sw
+*
+* DESCRIPTION
+*	Returns the number of a switch in the graph.
+*
+* SYNOPSIS
+*/
+uint32_t osm_graph_find_sw(IN const osm_graph_t * p_graph,
+			   IN ib_net64_t node_guid);
+/*
+* PARAMETERS
+*	p_graph
+*		[in] Pointer to the graph.
+*
+*	node_guid
+*		[in] Node GUID of the switch.
+*
+* RETURN VALUE
+*	The switch number, or OSM_GRAPH_NO_SW if the graph holds no
+*	switch with this GUID.
+*
+*********/
+/****f* OpenSM: Switch Graph/osm_graph_lid_to_sw
+* NAME
+*	osm_graph_lid_to_sw
+*
+* DESCRIPTION
+*	Returns the number of the switch owning a LID.
+*
+* SYNOPSIS
+*/
+static inline uint32_t osm_graph_lid_to_sw(IN const osm_graph_t * p_graph,
+					   IN uint16_t lid_ho)
+{
+	return lid_ho <= p_graph->max_lid ? p_graph->lid_sw[lid_ho] :
+	    OSM_GRAPH_NO_SW;
+}
+/*
+* PARAMETERS
+*	p_graph
+*		[in] Pointer to the graph.
+*
+*	lid_ho
+*		[in] LID in host order.
+*
+* RETURN VALUE
+*	The number of the switch the LID belongs to or the end port
+*	owning it is attached to, OSM_GRAPH_NO_SW otherwise.
+*
+*********/
+
+END_C_DECLS
+#endif				/* _OSM_GRAPH_H_ */
@@ -136,6 +136,9 @@ typedef struct osm_log {
 	char *log_file_name;
 	char *log_prefix;
 	osm_log_level_t per_mod_log_tbl[256];
+	struct osm_log_async *async;
+	cl_spinlock_t async_lock;
+	struct osm_mad_trace *mad_trace;
 } osm_log_t;
 /*********/
 
@@ -227,6 +230,9 @@ void osm_reset_log_per_module(IN osm_log_t * p_log);
 static inline void osm_log_construct(IN osm_log_t * p_log)
 {
 	cl_spinlock_construct(&p_log->lock);
+	cl_spinlock_construct(&p_log->async_lock);
+	p_log->async = NULL;
+	p_log->mad_trace = NULL;
 }
 
 /*
@@ -258,8 +264,14 @@ static inline void osm_log_construct(IN osm_log_t * p_log)
 *
 * SYNOPSIS
 */
+void osm_log_stop_async(IN osm_log_t * p_log);
+void osm_mad_trace_close(IN osm_log_t * p_log);
+
 static inline void osm_log_destroy(IN osm_log_t * p_log)
 {
+	osm_log_stop_async(p_log);
+	osm_mad_trace_close(p_log);
+	cl_spinlock_destroy(&p_log->async_lock);
 	cl_spinlock_destroy(&p_log->lock);
 	if (p_log->out_port != stdout) {
 		fclose(p_log->out_port);
@@ -331,6 +343,236 @@ ib_api_status_t osm_log_init_v2(IN osm_log_t * p_log, IN boolean_t flush,
 *	osm_log_destroy
 *********/
 
+/****f* OpenSM: Log/osm_log_start_async
+* NAME
+*	osm_log_start_async
+*
+* DESCRIPTION
+*	Switches the log to asynchronous mode: messages are copied into
+*	a ring of the given number of entries and written to the log
+*	file by a dedicated writer thread.
+*
+* SYNOPSIS
+*/
+ib_api_status_t osm_log_start_async(IN osm_log_t * p_log,
+				    IN unsigned entries);
+/*
+* PARAMETERS
+*	p_log
+*		[in] Pointer to an initialized osm_log_t object.
+*
+*	entries
+*		[in] Number of ring entries (rounded up to a power of 2).
+*
+* RETURN VALUES
+*	IB_SUCCESS if the writer thread was started.
+*
+* NOTES
+*	When the ring is full new messages are dropped and counted; the
+*	number of dropped messages is written to the log once there is
+*	room again. Syslog messages are still sent synchronously.
+*
+* SEE ALSO
+*	osm_log_stop_async
+*********/
+
+/****f* OpenSM: Log/osm_log_stop_async
+* NAME
+*	osm_log_stop_async
+*
+* DESCRIPTION
+*	Writes out all queued messages, stops the writer thread and
+*	switches the log back to synchronous mode.
+*
+* SYNOPSIS
+*/
+void osm_log_stop_async(IN osm_log_t * p_log);
+/*
+* PARAMETERS
+*	p_log
+*		[in] Pointer to an osm_log_t object.
+*
+* NOTES
+*	Does nothing if the log is not in asynchronous mode.
+*
+* SEE ALSO
+*	osm_log_start_async
+*********/
+
+/****d* OpenSM: Log/osm_mad_trace_event_t
+* NAME
+*	osm_mad_trace_event_t
+*
+* DESCRIPTION
+*	Event types recorded in the binary MAD trace.
+*
+* SYNOPSIS
+*/
+typedef enum _osm_mad_trace_event {
+	OSM_MAD_TRACE_SEND = 1,
+	OSM_MAD_TRACE_RECV,
+	OSM_MAD_TRACE_TIMEOUT,
+	OSM_MAD_TRACE_SEND_ERR,
+	OSM_MAD_TRACE_CANCEL
+} osm_mad_trace_event_t;
+/***********/
+
+/****s* OpenSM: Log/osm_mad_trace_rec_t
+* NAME
+*	osm_mad_trace_rec_t
+*
+* DESCRIPTION
+*	Fixed size record of the binary MAD trace file.
+*
+*	The trace file is an osm_mad_trace_hdr_t followed by a ring of
+*	num_recs records, all in host byte order except the fields
+*	copied from the MAD which are kept in network order.
+*
+* SYNOPSIS
+*/
+typedef struct osm_mad_trace_rec {
+	uint64_t time_usecs;
+	ib_net64_t trans_id;
+	uint32_t seq;
+	uint32_t latency_usecs;
+	ib_net32_t attr_mod;
+	ib_net16_t attr_id;
+	ib_net16_t status;
+	uint16_t lid;
+	uint8_t event;
+	uint8_t mgmt_class;
+	uint8_t method;
+	uint8_t reserved[3];
+} osm_mad_trace_rec_t;
+/*
+* FIELDS
+*	time_usecs
+*		Time stamp of the event in usecs since the Epoch.
+*
+*	seq
+*		Sequence number of the record starting at 1. Records with
+*		seq 0 were never written.
+*
+*	latency_usecs
+*		For responses, timeouts and canceled requests the time
+*		since the request was sent, 0 otherwise.
+*
+*	lid
+*		Remote LID of the MAD (host order).
+*
+*	event
+*		One of osm_mad_trace_event_t.
+*********/
+
+#define OSM_MAD_TRACE_MAGIC	0x4f534d54	/* "OSMT" */
+#define OSM_MAD_TRACE_VERSION	1
+
+typedef struct osm_mad_trace_hdr {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t rec_size;
+	uint32_t num_recs;
+	atomic32_t next_seq;
+	uint32_t reserved[3];
+} osm_mad_trace_hdr_t;
+
+/****f* OpenSM: Log/osm_mad_trace_open
+* NAME
+*	osm_mad_trace_open
+*
+* DESCRIPTION
+*	Creates the binary MAD trace file, maps it and attaches it to
+*	the log object.
+*
+* SYNOPSIS
+*/
+ib_api_status_t osm_mad_trace_open(IN osm_log_t * p_log,
+				   IN const char *file_name,
+				   IN unsigned num_recs);
+/*
+* PARAMETERS
+*	p_log
+*		[in] Pointer to an initialized osm_log_t object.
+*
+*	file_name
+*		[in] Name of the trace file. An existing file is overwritten.
+*
+*	num_recs
+*		[in] Number of records in the ring (rounded up to a power
+*		of 2). Once it wraps the oldest records are overwritten.
+*
+* RETURN VALUES
+*	IB_SUCCESS if the trace file was created and mapped.
+*
+* SEE ALSO
+*	osm_mad_trace_close, osm_mad_trace
+*********/
+
+/****f* OpenSM: Log/osm_mad_trace_close
+* NAME
+*	osm_mad_trace_close
+*
+* DESCRIPTION
+*	Detaches the MAD trace from the log object and unmaps the file.
+*
+* SYNOPSIS
+*/
+void osm_mad_trace_close(IN osm_log_t * p_log);
+/*
+* PARAMETERS
+*	p_log
+*		[in] Pointer to an osm_log_t object.
+*********/
+
+void osm_mad_trace_write(IN osm_log_t * p_log,
+			 IN osm_mad_trace_event_t event,
+			 IN const ib_mad_t * p_mad, IN ib_net16_t lid,
+			 IN uint64_t sent_usecs);
+
+/****f* OpenSM: Log/osm_mad_trace
+* NAME
+*	osm_mad_trace
+*
+* DESCRIPTION
+*	Appends a record for the given MAD to the binary MAD trace, if
+*	one is attached to the log.
+*
+* SYNOPSIS
+*/
+static inline void osm_mad_trace(IN osm_log_t * p_log,
+				 IN osm_mad_trace_event_t event,
+				 IN const ib_mad_t * p_mad, IN ib_net16_t lid,
+				 IN uint64_t sent_usecs)
+{
+	if (p_log->mad_trace)
+		osm_mad_trace_write(p_log, event, p_mad, lid, sent_usecs);
+}
+/*
+* PARAMETERS
+*	p_log
+*		[in] Pointer to an osm_log_t object.
+*
+*	event
+*		[in] The event to record.
+*
+*	p_mad
+*		[in] The MAD sent or received (the request for timeouts).
+*
+*	lid
+*		[in] Remote LID in network order.
+*
+*	sent_usecs
+*		[in] Time stamp at which the request was sent or 0.
+*
+* NOTES
+*	Records are claimed with cl_atomic_inc and filled without taking
+*	the log lock or formatting any text, so it may be called from
+*	any thread on the MAD fast path.
+*
+* SEE ALSO
+*	osm_mad_trace_open
+*********/
+
 /****f* OpenSM: Log/osm_log_reopen_file
 * NAME
 *	osm_log_reopen_file
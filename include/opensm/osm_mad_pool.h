@@ -45,6 +45,8 @@
 
 #include <iba/ib_types.h>
 #include <complib/cl_atomic.h>
+#include <complib/cl_qlist.h>
+#include <complib/cl_spinlock.h>
 #include <opensm/osm_base.h>
 #include <opensm/osm_madw.h>
 #include <vendor/osm_vendor.h>
@@ -76,6 +78,8 @@ BEGIN_C_DECLS
 *	Steve King, Intel
 *
 *********/
+#define OSM_MAD_POOL_MAX_FREE	1024
+
 /****s* OpenSM: MAD Pool/osm_mad_pool_t
 * NAME
 *	osm_mad_pool_t
@@ -90,12 +94,25 @@ BEGIN_C_DECLS
 */
 typedef struct osm_mad_pool {
 	atomic32_t mads_out;
+	uint32_t mads_out_max;
+	cl_spinlock_t lock;
+	cl_qlist_t free_list;
 } osm_mad_pool_t;
 /*
 * FIELDS
 *	mads_out
 *		Running total of the number of MADs outstanding.
 *
+*	mads_out_max
+*		High water mark of mads_out.
+*
+*	lock
+*		Spinlock protecting the free list.
+*
+*	free_list
+*		Cache of released MAD wrappers, reused before allocating
+*		new ones (up to OSM_MAD_POOL_MAX_FREE wrappers).
+*
 * SEE ALSO
 *	MAD Pool
 *********/
@@ -78,6 +78,7 @@ typedef struct osm_mcm_port {
 	cl_list_item_t list_item;
 	osm_port_t *port;
 	struct osm_mgrp *mgrp;
+	cl_qlist_t alias_list;
 } osm_mcm_port_t;
 /*
 * FIELDS
@@ -93,6 +94,10 @@ typedef struct osm_mcm_port {
 *	mgrp
 *		The pointer to multicast group where this port is member of
 *
+*	alias_list
+*		List of osm_mcm_alias_guid_t objects in the multicast group
+*		which have this MCM port as their base port.
+*
 * SEE ALSO
 *	MCM Port Object
 *********/
@@ -164,6 +169,7 @@ void osm_mcm_port_delete(IN osm_mcm_port_t * p_mcm);
 */
 typedef struct osm_mcm_alias_guid {
 	cl_map_item_t map_item;
+	cl_list_item_t list_item;
 	ib_net64_t alias_guid;
 	osm_mcm_port_t *p_base_mcm_port;
 	ib_gid_t port_gid;
@@ -175,6 +181,9 @@ typedef struct osm_mcm_alias_guid {
 *	map_item
 *		Linkage structure for cl_qmap.  MUST BE FIRST MEMBER!
 *
+*	list_item
+*		Linkage structure for the alias_list of the base MCM port.
+*
 *	alias_guid
 *		Alias GUID for port obtained from SM GUIDInfo attribute
 *
@@ -52,6 +52,8 @@
 #include <complib/cl_passivelock.h>
 #include <complib/cl_atomic.h>
 #include <complib/cl_nodenamemap.h>
+#include <complib/cl_spinlock.h>
+#include <complib/cl_work_pool.h>
 #include <opensm/osm_console_io.h>
 #include <opensm/osm_stats.h>
 #include <opensm/osm_log.h>
@@ -119,6 +121,95 @@ typedef enum _osm_routing_engine_type {
 } osm_routing_engine_type_t;
 /***********/
 
+/****s* OpenSM: OpenSM/osm_routing_scratch_t
+* NAME
+*	osm_routing_scratch_t
+*
+* DESCRIPTION
+*	Scratch memory of one routing worker.
+*
+* SYNOPSIS
+*/
+typedef struct osm_routing_scratch {
+	void *buf;
+	size_t size;
+} osm_routing_scratch_t;
+/*
+* FIELDS
+*	buf
+*		The memory, or NULL before the first use.
+*
+*	size
+*		Size of buf in bytes.
+*
+* SEE ALSO
+*	osm_routing_exec_t, osm_routing_exec_scratch
+*********/
+
+/****s* OpenSM: OpenSM/osm_routing_exec_t
+* NAME
+*	osm_routing_exec_t
+*
+* DESCRIPTION
+*	Execution context shared by the routing engines.
+*
+*	It hands the routing worker threads to the engines, keeps scratch
+*	memory for each worker between sweeps, and lets a routing in
+*	progress be cancelled.
+*
+* SYNOPSIS
+*/
+typedef struct osm_routing_exec {
+	cl_work_pool_t *pool;
+	unsigned num_workers;
+	osm_routing_scratch_t *scratch;
+	volatile boolean_t cancel;
+} osm_routing_exec_t;
+/*
+* FIELDS
+*	pool
+*		Worker threads to compute routes in parallel, or NULL when
+*		the routes are computed in the sweeping thread.  Passing
+*		pool to cl_work_pool_parallel_for works in both cases.
+*
+*	num_workers
+*		Number of workers of pool, 1 without a pool.  Worker
+*		indexes passed to the work functions are lower than this.
+*
+*	scratch
+*		Array of num_workers scratch buffers, one per worker.
+*
+*	cancel
+*		Set by osm_routing_exec_cancel, cleared when a heavy sweep
+*		starts.
+*
+* SEE ALSO
+*	osm_routing_exec_scratch, osm_routing_exec_cancel,
+*	osm_routing_exec_cancelled
+*********/
+
+/****d* OpenSM: OpenSM/Routing Engine Flags
+* NAME
+*	Routing Engine Flags
+*
+* DESCRIPTION
+*	Capabilities declared by a routing engine in the flags field of
+*	struct osm_routing_engine.
+*
+* SYNOPSIS
+*/
+#define OSM_ROUTING_ENGINE_PATH_SL_MT_SAFE	(1 << 0)
+/*
+* VALUES
+*	OSM_ROUTING_ENGINE_PATH_SL_MT_SAFE
+*		The path_sl callback may be called by several SA threads
+*		at a time.  Otherwise osm_routing_engine_path_sl serializes
+*		the calls.
+*
+* SEE ALSO
+*	struct osm_routing_engine
+*********/
+
 /****s* OpenSM: OpenSM/osm_routing_engine
 * NAME
 *	struct osm_routing_engine
@@ -149,6 +240,8 @@ typedef struct osm_routing_engine {
 					     IN OUT osm_mgrp_box_t *mgb);
 	void (*destroy) (void *context);
 	struct osm_routing_engine *next;
+	uint32_t flags;
+	osm_routing_exec_t *exec;
 } osm_routing_engine_t;
 /*
 * FIELDS
@@ -198,6 +291,21 @@ typedef struct osm_routing_engine {
 *
 *	next
 *		Pointer to next routing engine in the list.
+*
+*	flags
+*		Routing Engine Flags set by the setup function of the
+*		engine.
+*
+*	exec
+*		Execution context of the routing, set before the setup
+*		function of the engine is called.  Engines running work
+*		on exec->pool should check osm_routing_exec_cancelled
+*		regularly and fail when it returns TRUE.
+*
+* NOTES
+*	flags and exec follow the fields of earlier versions of this
+*	structure, so that routing plugins built against those still
+*	find their callbacks at the same offsets.
 */
 
 /****s* OpenSM: OpenSM/external_routing_engine_module_t
@@ -263,6 +371,8 @@ typedef struct osm_opensm {
 	cl_dispatcher_t disp;
 	cl_dispatcher_t sa_set_disp;
 	boolean_t sa_set_disp_initialized;
+	osm_routing_exec_t routing_exec;
+	cl_spinlock_t path_sl_lock;
 	cl_plock_t lock;
 	struct osm_routing_engine *routing_engine_list;
 	struct osm_routing_engine *routing_engine_used;
@@ -312,6 +422,15 @@ typedef struct osm_opensm {
 *	sa_set_disp_initialized.
 *		Indicator that sa_set_disp dispatcher was initialized.
 *
+*	routing_exec
+*		Execution context passed to the routing engines, holding
+*		the worker threads shared by them to compute forwarding
+*		tables in parallel.
+*
+*	path_sl_lock
+*		Serializes the calls to path_sl of routing engines which
+*		are not OSM_ROUTING_ENGINE_PATH_SL_MT_SAFE.
+*
 *	lock
 *		Shared lock guarding most OpenSM structures.
 *
@@ -713,6 +832,130 @@ osm_routing_engine_type_t osm_routing_engine_type(IN const char *str);
 * SEE ALSO
 *********/
 
+/****f* OpenSM: OpenSM/osm_routing_exec_scratch
+* NAME
+*	osm_routing_exec_scratch
+*
+* DESCRIPTION
+*	Returns the scratch memory of a routing worker, grown to at least
+*	the requested size.
+*
+* SYNOPSIS
+*/
+void *osm_routing_exec_scratch(IN osm_routing_exec_t * p_exec,
+			       IN unsigned worker, IN size_t size);
+/*
+* PARAMETERS
+*	p_exec
+*		[in] Pointer to the execution context.
+*
+*	worker
+*		[in] Index of the worker, as passed to the work function.
+*
+*	size
+*		[in] Number of bytes needed.
+*
+* RETURN VALUES
+*	Pointer to the memory, or NULL if it could not be allocated.
+*
+* NOTES
+*	The content of the memory is undefined.  It stays valid until the
+*	next call for the same worker.  A work function must not hold it
+*	across a nested cl_work_pool_parallel_for, since the worker runs
+*	other items meanwhile (see cl_pfn_work_t).
+*
+* SEE ALSO
+*	osm_routing_exec_t
+*********/
+
+/****f* OpenSM: OpenSM/osm_routing_exec_cancel
+* NAME
+*	osm_routing_exec_cancel
+*
+* DESCRIPTION
+*	Asks the routing engine computing routes to give up.
+*
+* SYNOPSIS
+*/
+void osm_routing_exec_cancel(IN osm_routing_exec_t * p_exec);
+/*
+* PARAMETERS
+*	p_exec
+*		[in] Pointer to the execution context.
+*
+* RETURN VALUES
+*	This function does not return a value.
+*
+* NOTES
+*	May be called from any thread, after setting force_heavy_sweep
+*	of the subnet.  The unicast manager then fails the routing in
+*	progress, or the next one if none is, without trying the other
+*	routing engines, and the next sweep is a heavy one.  Used when a
+*	heavy sweep is requested, since the routes being computed are
+*	for a topology which is about to be discovered again.
+*
+* SEE ALSO
+*	osm_routing_exec_cancelled
+*********/
+
+/****f* OpenSM: OpenSM/osm_routing_exec_cancelled
+* NAME
+*	osm_routing_exec_cancelled
+*
+* DESCRIPTION
+*	Checks if the routing in progress should be given up.
+*
+* SYNOPSIS
+*/
+boolean_t osm_routing_exec_cancelled(IN const osm_routing_exec_t * p_exec);
+/*
+* PARAMETERS
+*	p_exec
+*		[in] Pointer to the execution context.
+*
+* RETURN VALUES
+*	TRUE if the routing was cancelled or OpenSM is exiting.
+*
+* SEE ALSO
+*	osm_routing_exec_cancel
+*********/
+
+/****f* OpenSM: OpenSM/osm_routing_engine_path_sl
+* NAME
+*	osm_routing_engine_path_sl
+*
+* DESCRIPTION
+*	Calls the path_sl callback of a routing engine.
+*
+* SYNOPSIS
+*/
+uint8_t osm_routing_engine_path_sl(IN osm_opensm_t * p_osm,
+				   IN struct osm_routing_engine *p_re,
+				   IN uint8_t path_sl_hint,
+				   IN ib_net16_t slid, IN ib_net16_t dlid);
+/*
+* PARAMETERS
+*	p_osm
+*		[in] Pointer to an osm_opensm_t object.
+*
+*	p_re
+*		[in] Routing engine with a path_sl callback.
+*
+*	path_sl_hint
+*		[in] SL selected so far, passed as hint.
+*
+*	slid, dlid
+*		[in] Source and destination LIDs of the path.
+*
+* RETURN VALUES
+*	The SL returned by the routing engine.
+*
+* NOTES
+*	The calls are serialized unless the engine is
+*	OSM_ROUTING_ENGINE_PATH_SL_MT_SAFE.
+*
+*********/
+
 void osm_opensm_report_event(osm_opensm_t *osm, osm_epi_event_id_t event_id,
 			     void *event_data);
 
@@ -168,6 +168,33 @@ typedef struct osm_sa_item {
 #define SA_ITEM_RESP_SIZE(_m) offsetof(osm_sa_item_t, resp._m) + \
 			      sizeof(((osm_sa_item_t *)NULL)->resp._m)
 
+/****d* OpenSM: SA/osm_sa_db_section_t
+* NAME
+*	osm_sa_db_section_t
+*
+* DESCRIPTION
+*	Sections of the SA DB dump file, in the order they are written.
+*	Each section is rendered separately, so only the sections
+*	which were changed are rendered again on the next dump.
+*
+* SYNOPSIS
+*/
+typedef enum osm_sa_db_section {
+	OSM_SA_DB_GUIDINFO,
+	OSM_SA_DB_MCAST,
+	OSM_SA_DB_INFORM,
+	OSM_SA_DB_SERVICE,
+	OSM_SA_DB_SECTIONS
+} osm_sa_db_section_t;
+
+#define OSM_SA_DB_DIRTY_GUIDINFO	(1 << OSM_SA_DB_GUIDINFO)
+#define OSM_SA_DB_DIRTY_MCAST		(1 << OSM_SA_DB_MCAST)
+#define OSM_SA_DB_DIRTY_INFORM		(1 << OSM_SA_DB_INFORM)
+#define OSM_SA_DB_DIRTY_SERVICE		(1 << OSM_SA_DB_SERVICE)
+#define OSM_SA_DB_DIRTY_ALL		((1 << OSM_SA_DB_SECTIONS) - 1)
+#define OSM_SA_DB_DIRTY_FILE		(1 << OSM_SA_DB_SECTIONS)
+/***********/
+
 /****s* OpenSM: SM/osm_sa_t
 * NAME
 *	osm_sa_t
@@ -193,7 +220,9 @@ typedef struct osm_sa {
 	atomic32_t sa_trans_id;
 	osm_sa_mad_ctrl_t mad_ctrl;
 	cl_timer_t sr_timer;
-	boolean_t dirty;
+	unsigned dirty;
+	char *dump_buf[OSM_SA_DB_SECTIONS];
+	size_t dump_len[OSM_SA_DB_SECTIONS];
 	cl_disp_reg_handle_t cpi_disp_h;
 	cl_disp_reg_handle_t nr_disp_h;
 	cl_disp_reg_handle_t pir_disp_h;
@@ -255,8 +284,16 @@ typedef struct osm_sa {
 *		Mad Controller
 *
 *	dirty
-*		A flag that denotes that SA DB is dirty and needs
-*		to be written to the dump file (if dumping is enabled)
+*		Mask of OSM_SA_DB_DIRTY_* flags that denotes which SA DB
+*		sections are dirty and need to be written to the dump file
+*		(if dumping is enabled)
+*
+*	dump_buf
+*		Rendered text of each SA DB dump section, as of the last
+*		dump. NULL if the section was not rendered yet.
+*
+*	dump_len
+*		Length of the rendered text of each SA DB dump section.
 *
 * SEE ALSO
 *	SM object
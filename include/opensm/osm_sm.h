@@ -110,6 +110,7 @@ typedef struct osm_sm {
 	cl_event_t subnet_up_event;
 	cl_timer_t sweep_timer;
 	cl_timer_t polling_timer;
+	cl_timer_t mcast_batch_timer;
 	cl_event_wheel_t trap_aging_tracker;
 	cl_thread_t sweeper;
 	unsigned master_sm_found;
@@ -51,6 +51,7 @@
 
 #include <iba/ib_types.h>
 #include <complib/cl_qmap.h>
+#include <complib/cl_hmap.h>
 #include <complib/cl_fleximap.h>
 #include <complib/cl_map.h>
 #include <complib/cl_ptr_vector.h>
@@ -273,6 +274,7 @@ typedef struct osm_subn_opt {
 	boolean_t reassign_lids;
 	boolean_t ignore_other_sm;
 	boolean_t single_thread;
+	uint32_t routing_threads;
 	boolean_t disable_multicast;
 	boolean_t force_log_flush;
 	uint8_t subnet_timeout;
@@ -287,11 +289,15 @@ typedef struct osm_subn_opt {
 	uint32_t sminfo_polling_timeout;
 	uint32_t polling_retry_number;
 	uint32_t max_msg_fifo_timeout;
+	uint32_t mcast_join_batch_window;
 	boolean_t force_heavy_sweep;
 	uint8_t log_flags;
 	char *dump_files_dir;
 	char *log_file;
 	uint32_t log_max_size;
+	uint32_t log_async_entries;
+	char *mad_trace_file;
+	uint32_t mad_trace_records;
 	char *partition_config_file;
 	boolean_t no_partition_enforcement;
 	char *part_enforce;
@@ -327,6 +333,7 @@ typedef struct osm_subn_opt {
 	boolean_t guid_routing_order_no_scatter;
 	char *sa_db_file;
 	boolean_t sa_db_dump;
+	char *lft_snapshot_file;
 	char *torus_conf_file;
 	boolean_t do_mesh_analysis;
 	boolean_t exit_on_fatal;
@@ -467,12 +474,24 @@ typedef struct osm_subn_opt {
 *	disable_multicast
 *		This flag is TRUE if OpenSM should disable multicast support.
 *
+*	routing_threads
+*		Number of worker threads routing engines may use to compute
+*		forwarding tables in parallel. 0 (the default) uses one
+*		thread per CPU, 1 computes the tables in the sweeping thread.
+*		Ignored when single_thread is TRUE.
+*
 *	max_msg_fifo_timeout
 *		The maximal time a message can stay in the incoming message
 *		queue. If there is more than one message in the queue and the
 *		last message stayed in the queue more than this value the SA
 *		request will be immediately returned with a BUSY status.
 *
+*	mcast_join_batch_window
+*		The time in [msec] multicast rerouting requests caused by
+*		joins and leaves are collected before the multicast trees
+*		are recomputed and the MFTs are sent. A value of 0 processes
+*		every request immediately.
+*
 *	subnet_timeout
 *		The subnet_timeout that will be set for all the ports in the
 *		design SubnSet(PortInfo.vl_stall_life))
@@ -522,6 +541,22 @@ typedef struct osm_subn_opt {
 *		specified the log file will be truncated upon reaching
 *		this limit.
 *
+*	log_async_entries
+*		When non zero, log messages are queued in a ring of this
+*		many entries (rounded up to a power of 2) and written to
+*		the log file by a dedicated thread. Messages arriving while
+*		the ring is full are dropped and counted. Zero (default)
+*		keeps logging synchronous.
+*
+*	mad_trace_file
+*		When not NULL, a fixed size binary record of every MAD
+*		sent, received, timed out or canceled is written to a
+*		memory mapped ring in this file. Use osmtrace to decode it.
+*		The trace of the previous run is kept with a .1 suffix.
+*
+*	mad_trace_records
+*		Number of records in the MAD trace ring.
+*
 *	qos
 *		Boolean that specifies whether the OpenSM QoS functionality
 *		should be off or on.
@@ -599,6 +634,16 @@ typedef struct osm_subn_opt {
 *		When TRUE causes OpenSM to dump SA DB at the end of every
 *		light sweep regardless the current verbosity level.
 *
+*	lft_snapshot_file
+*		Name of the binary file the master SM writes switch LFTs to
+*		after programming them. A standby SM taking over from a
+*		master which stopped answering restores LFTs from it and
+*		only sends the blocks which differ. The file must be on
+*		storage shared by the SMs of the subnet, under the same
+*		name, otherwise it is never used: only a file written by
+*		the master the standby was polling is trusted, and the
+*		master removes it when leaving MASTER state.
+*
 *	torus_conf_file
 *		Name of the file with extra configuration info for torus-2QoS
 *		routing engine.
@@ -780,6 +825,10 @@ typedef struct osm_subn {
 	cl_qmap_t node_guid_tbl;
 	cl_qmap_t port_guid_tbl;
 	cl_qmap_t alias_port_guid_tbl;
+	cl_hmap_t sw_guid_idx;
+	cl_hmap_t node_guid_idx;
+	cl_hmap_t port_guid_idx;
+	cl_hmap_t alias_port_guid_idx;
 	cl_qmap_t assigned_guids_tbl;
 	cl_qmap_t rtr_guid_tbl;
 	cl_qlist_t prefix_routes_list;
@@ -831,6 +880,11 @@ typedef struct osm_subn {
 *		Container of pointers to all Port objects in the subnet.
 *		Indexed by port GUID.
 *
+*	sw_guid_idx, node_guid_idx, port_guid_idx, alias_port_guid_idx
+*		Hash indexes of the sw, node, port and alias port GUID
+*		tables, used by cl_qmap_get on these tables. Maintained by
+*		the quick map functions.
+*
 *	rtr_guid_tbl
 *		Container of pointers to all Router objects in the subnet.
 *		Indexed by node GUID.
@@ -109,6 +109,7 @@ typedef struct osm_switch {
 	uint32_t mft_position;
 	unsigned endport_links;
 	unsigned need_update;
+	boolean_t lft_preloaded;
 	void *priv;
 	cl_map_item_t mgrp_item;
 	uint32_t num_of_mcm;
@@ -155,6 +156,11 @@ typedef struct osm_switch {
 *		When set indicates that switch was probably reset, so
 *		fwd tables and rest cached data should be flushed
 *
+*	lft_preloaded
+*		When set indicates that lft was restored from the LFT
+*		snapshot written by the previous master, so it reflects
+*		the switch contents even though the subnet needs update
+*
 *	mgrp_item
 *		map item for switch in building mcast tree
 *
@@ -697,6 +703,42 @@ static inline void osm_switch_count_path(IN osm_switch_t * p_sw,
 * SEE ALSO
 *********/
 
+/****f* OpenSM: Switch/osm_lft_diff_blocks
+* NAME
+*	osm_lft_diff_blocks
+*
+* DESCRIPTION
+*	Lists the linear forwarding table blocks which differ between
+*	two tables.
+*
+* SYNOPSIS
+*/
+unsigned osm_lft_diff_blocks(IN const uint8_t * lft1, IN const uint8_t * lft2,
+			     IN unsigned num_blocks, OUT uint16_t * blocks);
+/*
+* PARAMETERS
+*	lft1, lft2
+*		[in] Tables to compare, at least num_blocks * IB_SMP_DATA_SIZE
+*		bytes long.
+*
+*	num_blocks
+*		[in] Number of blocks to compare.
+*
+*	blocks
+*		[out] Receives the IDs of the differing blocks in increasing
+*		order, must have room for num_blocks entries.
+*
+* RETURN VALUE
+*	The number of differing blocks.
+*
+* NOTES
+*	Blocks are compared with AVX2 or SSE2 instructions when the CPU
+*	supports them, the choice is made on the first call.
+*
+* SEE ALSO
+*	Switch object
+*********/
+
 /****f* OpenSM: Switch/osm_switch_set_lft_block
 * NAME
 *	osm_switch_set_lft_block
@@ -47,9 +47,6 @@
 #include <opensm/osm_mesh.h>
 
 enum {
-	UNQUEUED,
-	Q_MEMBER,
-	MST_MEMBER,
 	MAX_INT = 9999,
 	NONE = MAX_INT
 };
@@ -60,10 +57,12 @@ typedef struct _cdg_vertex {
 	int seen;
 	int temp;
 	int visiting_number;
+	unsigned visit_epoch;
 	struct _cdg_vertex *next;
 	int num_temp_depend;
 	int num_using_vertex;
 	int num_deps;
+	int max_deps;
 	struct vertex_deps {
 		struct _cdg_vertex *v;
 		int num_used;
@@ -73,9 +72,6 @@ typedef struct _cdg_vertex {
 typedef struct _switch {
 	osm_switch_t *p_sw;
 	int id;
-	int used_channels;
-	int *dij_channels;
-	int q_state;
 	mesh_node_t *node;
 	struct routing_table {
 		unsigned out_link;
@@ -89,9 +85,10 @@ typedef struct _lash {
 	uint8_t vl_min;
 	int balance_limit;
 	switch_t **switches;
-	cdg_vertex_t ****cdg_vertex_matrix;
+	cdg_vertex_t ****cdg_vertex_matrix;	/* [lane][switch][out link] */
+	unsigned cdg_epoch;
 	int num_mst_in_lane[IB_MAX_NUM_VLS];
-	int ***virtual_location;
+	uint32_t *virtual_location;	/* 2 bits per lane, [src][dst] */
 } lash_t;
 
 #endif
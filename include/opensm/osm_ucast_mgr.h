@@ -50,6 +50,7 @@
 #include <opensm/osm_switch.h>
 #include <opensm/osm_log.h>
 #include <opensm/osm_ucast_cache.h>
+#include <opensm/osm_graph.h>
 
 #ifdef __cplusplus
 #  define BEGIN_C_DECLS extern "C" {
@@ -101,6 +102,11 @@ typedef struct osm_ucast_mgr {
 	boolean_t some_hop_count_set;
 	cl_qmap_t cache_sw_tbl;
 	boolean_t cache_valid;
+	boolean_t lft_snapshot_stale;
+	boolean_t lft_snapshot_written;
+	uint32_t lft_snapshot_seq;
+	ib_net64_t lft_snapshot_master;
+	osm_graph_t graph;
 } osm_ucast_mgr_t;
 /*
 * FIELDS
@@ -136,6 +142,27 @@ typedef struct osm_ucast_mgr {
 *	cache_valid
 *		TRUE if the unicast cache is valid.
 *
+*	lft_snapshot_stale
+*		TRUE if LFT blocks were sent since the LFT snapshot file
+*		was last written (the file is removed at that point).
+*
+*	lft_snapshot_written
+*		TRUE if this SM wrote the LFT snapshot file and has not
+*		removed it since.
+*
+*	lft_snapshot_seq
+*		Number of LFT snapshots written by this SM.
+*
+*	lft_snapshot_master
+*		Port GUID of the master which stopped answering this SM
+*		as a standby. Only a snapshot written by it is restored
+*		on the next sweep; zero otherwise.
+*
+*	graph
+*		Switch graph of the subnet, rebuilt at the beginning of
+*		each osm_ucast_mgr_process and shared by the routing
+*		engines.
+*
 * SEE ALSO
 *	Unicast Manager object
 *********/
@@ -300,6 +327,66 @@ int osm_ucast_mgr_process(IN osm_ucast_mgr_t * p_mgr);
 *	Unicast Manager, Node Info Response Controller
 *********/
 
+/****f* OpenSM: Unicast Manager/osm_ucast_mgr_lft_snapshot_dump
+* NAME
+*	osm_ucast_mgr_lft_snapshot_dump
+*
+* DESCRIPTION
+*	Write the switches' LFTs, as acknowledged by the switches,
+*	to the LFT snapshot file.
+*
+* SYNOPSIS
+*/
+int osm_ucast_mgr_lft_snapshot_dump(IN osm_ucast_mgr_t * p_mgr);
+/*
+* PARAMETERS
+*	p_mgr
+*		[in] Pointer to an osm_ucast_mgr_t object.
+*
+* RETURN VALUES
+*	Returns zero on success and negative value on failure.
+*
+* NOTES
+*	Does nothing when lft_snapshot_file is not configured or when
+*	no LFT block was sent since the snapshot was last written.
+*	Should be called only after all pending LFT transactions are
+*	completed. A standby SM taking over as master restores switch
+*	LFTs from this file, so only the blocks which differ from it
+*	are sent to the switches.
+*
+* SEE ALSO
+*	Unicast Manager, osm_ucast_mgr_process,
+*	osm_ucast_mgr_lft_snapshot_drop
+*********/
+
+/****f* OpenSM: Unicast Manager/osm_ucast_mgr_lft_snapshot_drop
+* NAME
+*	osm_ucast_mgr_lft_snapshot_drop
+*
+* DESCRIPTION
+*	Remove the LFT snapshot file written by this SM, and forget the
+*	master whose snapshot could be restored.
+*
+* SYNOPSIS
+*/
+void osm_ucast_mgr_lft_snapshot_drop(IN osm_ucast_mgr_t * p_mgr);
+/*
+* PARAMETERS
+*	p_mgr
+*		[in] Pointer to an osm_ucast_mgr_t object.
+*
+* RETURN VALUES
+*	This function does not return a value.
+*
+* NOTES
+*	Called when this SM leaves MASTER state or finds another master,
+*	since the LFTs it wrote to the file may then be changed by
+*	another SM. A file written by another SM is not removed.
+*
+* SEE ALSO
+*	Unicast Manager, osm_ucast_mgr_lft_snapshot_dump
+*********/
+
 int ucast_dummy_build_lid_matrices(void *context);
 END_C_DECLS
 #endif				/* _OSM_UCAST_MGR_H_ */
@@ -61,6 +61,10 @@ static int log_exit_count = 0;
 #include <sys/time.h>
 #include <unistd.h>
 #include <complib/cl_timer.h>
+#include <complib/cl_thread.h>
+#include <complib/cl_event.h>
+#include <complib/cl_atomic.h>
+#include <sys/mman.h>
 
 static const char *month_str[] = {
 	"Jan",
@@ -109,6 +113,423 @@ static void truncate_log_file(osm_log_t * p_log)
 }
 #endif				/* ndef __WIN__ */
 
+#ifndef __WIN__
+
+/*
+ * Asynchronous logging: producers format the message on their own
+ * stack, as in synchronous mode, and only copy it into a ring slot
+ * under p_log->lock. The writer thread adds the time stamp prefix
+ * (localtime_r is called once per second) and does the file I/O.
+ */
+typedef struct osm_log_async_entry {
+	uint64_t time_usecs;
+	pthread_t pid;
+	osm_log_level_t verbosity;
+	unsigned len;
+	char text[LOG_ENTRY_SIZE_MAX];
+} osm_log_async_entry_t;
+
+struct osm_log_async {
+	osm_log_t *p_log;
+	cl_thread_t thread;
+	cl_event_t event;
+	cl_spinlock_t write_lock;
+	boolean_t exit;
+	unsigned mask;
+	unsigned head;
+	unsigned tail;
+	unsigned long dropped;
+	time_t last_sec;
+	struct tm last_tm;
+	osm_log_async_entry_t *ring;
+};
+
+static int log_async_put(IN osm_log_t * p_log, IN osm_log_level_t verbosity,
+			 IN const char *buffer)
+{
+	struct osm_log_async *async;
+	osm_log_async_entry_t *entry;
+	uint64_t time_usecs = cl_get_time_stamp();
+	boolean_t wake;
+	unsigned len;
+
+	cl_spinlock_acquire(&p_log->lock);
+	async = p_log->async;
+	if (!async) {
+		cl_spinlock_release(&p_log->lock);
+		return 0;
+	}
+
+	if (async->head - async->tail > async->mask) {
+		async->dropped++;
+		cl_spinlock_release(&p_log->lock);
+		return 1;
+	}
+
+	entry = &async->ring[async->head & async->mask];
+	len = strnlen(buffer, LOG_ENTRY_SIZE_MAX - 1);
+	memcpy(entry->text, buffer, len);
+	entry->text[len] = '\0';
+	entry->len = len;
+	entry->verbosity = verbosity;
+	entry->time_usecs = time_usecs;
+	entry->pid = pthread_self();
+	/* the writer drains everything once woken up */
+	wake = async->head == async->tail;
+	async->head++;
+	cl_spinlock_release(&p_log->lock);
+
+	if (wake)
+		cl_event_signal(&async->event);
+
+	return 1;
+}
+
+static int log_async_write_line(IN struct osm_log_async *async,
+				IN osm_log_level_t verbosity,
+				IN uint64_t time_usecs, IN pthread_t pid,
+				IN const char *buffer)
+{
+	osm_log_t *p_log = async->p_log;
+	time_t tim = time_usecs / 1000000;
+	uint32_t usecs = time_usecs % 1000000;
+	struct tm *result = &async->last_tm;
+	int ret;
+
+	if (tim != async->last_sec) {
+		localtime_r(&tim, result);
+		async->last_sec = tim;
+	}
+
+	if (p_log->max_size && p_log->count > p_log->max_size) {
+		/* truncate here */
+		fprintf(stderr,
+			"osm_log: log file exceeds the limit %lu. Truncating.\n",
+			p_log->max_size);
+		truncate_log_file(p_log);
+	}
+_retry:
+	ret =
+	    fprintf(p_log->out_port,
+		    "%s %02d %02d:%02d:%02d %06d [%04X] 0x%02x -> %s",
+		    (result->tm_mon <
+		     12 ? month_str[result->tm_mon] : "???"),
+		    result->tm_mday, result->tm_hour, result->tm_min,
+		    result->tm_sec, usecs, (unsigned)pid, verbosity, buffer);
+
+	if (ret >= 0) {
+		log_exit_count = 0;
+		p_log->count += ret;
+	} else if (log_exit_count < 3) {
+		log_exit_count++;
+		if (errno == ENOSPC && p_log->max_size) {
+			fprintf(stderr,
+				"osm_log: write failed: %s. Truncating log file.\n",
+				strerror(errno));
+			truncate_log_file(p_log);
+			goto _retry;
+		}
+		fprintf(stderr, "osm_log: write failed: %s\n", strerror(errno));
+	}
+
+	return ret;
+}
+
+static void log_async_drain(IN struct osm_log_async *async)
+{
+	osm_log_t *p_log = async->p_log;
+	osm_log_async_entry_t *entry;
+	unsigned head, tail;
+	unsigned long dropped;
+	boolean_t flush = p_log->flush;
+	char msg[64];
+
+	cl_spinlock_acquire(&async->write_lock);
+	for (;;) {
+		cl_spinlock_acquire(&p_log->lock);
+		head = async->head;
+		tail = async->tail;
+		dropped = async->dropped;
+		async->dropped = 0;
+		cl_spinlock_release(&p_log->lock);
+
+		if (head == tail && !dropped)
+			break;
+
+		/* slots in [tail, head) are not touched by producers */
+		for (; tail != head; tail++) {
+			entry = &async->ring[tail & async->mask];
+			if (entry->verbosity & (OSM_LOG_ERROR | OSM_LOG_SYS))
+				flush = TRUE;
+			log_async_write_line(async, entry->verbosity,
+					     entry->time_usecs, entry->pid,
+					     entry->text);
+		}
+
+		if (dropped) {
+			snprintf(msg, sizeof(msg),
+				 "osm_log: %lu log messages dropped\n",
+				 dropped);
+			log_async_write_line(async, OSM_LOG_ERROR,
+					     cl_get_time_stamp(),
+					     pthread_self(), msg);
+			flush = TRUE;
+		}
+
+		cl_spinlock_acquire(&p_log->lock);
+		async->tail = tail;
+		cl_spinlock_release(&p_log->lock);
+	}
+
+	if (flush)
+		fflush(p_log->out_port);
+	cl_spinlock_release(&async->write_lock);
+}
+
+static void log_async_writer(IN void *context)
+{
+	struct osm_log_async *async = context;
+
+	while (!async->exit) {
+		cl_event_wait_on(&async->event, EVENT_NO_TIMEOUT, TRUE);
+		log_async_drain(async);
+	}
+}
+
+ib_api_status_t osm_log_start_async(IN osm_log_t * p_log,
+				    IN unsigned entries)
+{
+	struct osm_log_async *async;
+	unsigned size = 1;
+
+	if (p_log->async || !entries)
+		return IB_INVALID_PARAMETER;
+
+	while (size < entries)
+		size <<= 1;
+
+	async = calloc(1, sizeof(*async));
+	if (!async)
+		return IB_INSUFFICIENT_MEMORY;
+	async->ring = malloc(size * sizeof(*async->ring));
+	if (!async->ring) {
+		free(async);
+		return IB_INSUFFICIENT_MEMORY;
+	}
+	async->p_log = p_log;
+	async->mask = size - 1;
+	async->last_sec = -1;
+	cl_event_construct(&async->event);
+	cl_spinlock_construct(&async->write_lock);
+	cl_thread_construct(&async->thread);
+	if (cl_event_init(&async->event, FALSE) != CL_SUCCESS ||
+	    cl_spinlock_init(&async->write_lock) != CL_SUCCESS ||
+	    cl_thread_init(&async->thread, log_async_writer, async,
+			   "opensm log") != CL_SUCCESS) {
+		cl_event_destroy(&async->event);
+		cl_spinlock_destroy(&async->write_lock);
+		free(async->ring);
+		free(async);
+		return IB_ERROR;
+	}
+
+	cl_spinlock_acquire(&p_log->lock);
+	p_log->async = async;
+	cl_spinlock_release(&p_log->lock);
+
+	return IB_SUCCESS;
+}
+
+void osm_log_stop_async(IN osm_log_t * p_log)
+{
+	struct osm_log_async *async;
+
+	/* keeps osm_log_reopen_file off the writer state while it is freed */
+	cl_spinlock_acquire(&p_log->async_lock);
+	cl_spinlock_acquire(&p_log->lock);
+	async = p_log->async;
+	p_log->async = NULL;
+	cl_spinlock_release(&p_log->lock);
+
+	if (!async) {
+		cl_spinlock_release(&p_log->async_lock);
+		return;
+	}
+
+	async->exit = TRUE;
+	cl_event_signal(&async->event);
+	cl_thread_destroy(&async->thread);
+
+	/* write whatever was queued before the log went synchronous */
+	log_async_drain(async);
+
+	cl_event_destroy(&async->event);
+	cl_spinlock_destroy(&async->write_lock);
+	free(async->ring);
+	free(async);
+	cl_spinlock_release(&p_log->async_lock);
+}
+
+/*
+ * Binary MAD trace: a file mapped MAP_SHARED holding a header and a
+ * ring of fixed size records. Writers claim a record with an atomic
+ * increment of the sequence number kept in the header and fill it
+ * without taking the log lock. The trace survives a crash of the
+ * process since the kernel owns the dirty pages.
+ */
+struct osm_mad_trace {
+	osm_mad_trace_hdr_t *hdr;
+	osm_mad_trace_rec_t *recs;
+	size_t map_size;
+	uint32_t mask;
+};
+
+ib_api_status_t osm_mad_trace_open(IN osm_log_t * p_log,
+				   IN const char *file_name,
+				   IN unsigned num_recs)
+{
+	struct osm_mad_trace *trace;
+	unsigned size = 1;
+	char *old_name;
+	void *map;
+	int fd;
+
+	if (p_log->mad_trace || !num_recs)
+		return IB_INVALID_PARAMETER;
+
+	while (size < num_recs)
+		size <<= 1;
+
+	trace = calloc(1, sizeof(*trace));
+	if (!trace)
+		return IB_INSUFFICIENT_MEMORY;
+	trace->map_size = sizeof(*trace->hdr) + size * sizeof(*trace->recs);
+	trace->mask = size - 1;
+
+	/* keep the trace of the previous run, it may hold the MADs which
+	   preceded a crash */
+	old_name = malloc(strlen(file_name) + 3);
+	if (!old_name) {
+		free(trace);
+		return IB_INSUFFICIENT_MEMORY;
+	}
+	sprintf(old_name, "%s.1", file_name);
+	if (rename(file_name, old_name) < 0 && errno != ENOENT)
+		fprintf(stderr, "osm_log: cannot rename MAD trace file "
+			"'%s' to '%s': %s\n", file_name, old_name,
+			strerror(errno));
+	free(old_name);
+
+	fd = open(file_name, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		fprintf(stderr, "osm_log: cannot create MAD trace file "
+			"'%s': %s\n", file_name, strerror(errno));
+		free(trace);
+		return IB_ERROR;
+	}
+	if (ftruncate(fd, trace->map_size) < 0 ||
+	    (map = mmap(NULL, trace->map_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		fprintf(stderr, "osm_log: cannot map MAD trace file "
+			"'%s': %s\n", file_name, strerror(errno));
+		close(fd);
+		unlink(file_name);
+		free(trace);
+		return IB_ERROR;
+	}
+	close(fd);
+
+	/* the file is zero filled, so every record starts with seq 0 */
+	trace->hdr = map;
+	trace->recs = (osm_mad_trace_rec_t *) (trace->hdr + 1);
+	trace->hdr->version = OSM_MAD_TRACE_VERSION;
+	trace->hdr->rec_size = sizeof(*trace->recs);
+	trace->hdr->num_recs = size;
+	trace->hdr->next_seq = 0;
+	trace->hdr->magic = OSM_MAD_TRACE_MAGIC;
+
+	p_log->mad_trace = trace;
+	return IB_SUCCESS;
+}
+
+void osm_mad_trace_close(IN osm_log_t * p_log)
+{
+	struct osm_mad_trace *trace = p_log->mad_trace;
+
+	if (!trace)
+		return;
+
+	p_log->mad_trace = NULL;
+	munmap(trace->hdr, trace->map_size);
+	free(trace);
+}
+
+void osm_mad_trace_write(IN osm_log_t * p_log,
+			 IN osm_mad_trace_event_t event,
+			 IN const ib_mad_t * p_mad, IN ib_net16_t lid,
+			 IN uint64_t sent_usecs)
+{
+	struct osm_mad_trace *trace = p_log->mad_trace;
+	osm_mad_trace_rec_t *rec;
+	uint64_t now = cl_get_time_stamp();
+	uint32_t seq;
+
+	seq = (uint32_t) cl_atomic_inc(&trace->hdr->next_seq);
+	rec = &trace->recs[(seq - 1) & trace->mask];
+
+	rec->seq = 0;
+	rec->time_usecs = now;
+	rec->trans_id = p_mad->trans_id;
+	rec->latency_usecs = sent_usecs && now > sent_usecs ?
+	    (uint32_t) (now - sent_usecs) : 0;
+	rec->attr_mod = p_mad->attr_mod;
+	rec->attr_id = p_mad->attr_id;
+	rec->status = p_mad->status;
+	rec->lid = cl_ntoh16(lid);
+	rec->event = (uint8_t) event;
+	rec->mgmt_class = p_mad->mgmt_class;
+	rec->method = p_mad->method;
+	/* a record with seq 0 is skipped by the decoder */
+	rec->seq = seq;
+}
+
+#else				/* Windows */
+
+static int log_async_put(IN osm_log_t * p_log, IN osm_log_level_t verbosity,
+			 IN const char *buffer)
+{
+	return 0;
+}
+
+ib_api_status_t osm_log_start_async(IN osm_log_t * p_log,
+				    IN unsigned entries)
+{
+	return IB_UNSUPPORTED;
+}
+
+void osm_log_stop_async(IN osm_log_t * p_log)
+{
+}
+
+ib_api_status_t osm_mad_trace_open(IN osm_log_t * p_log,
+				   IN const char *file_name,
+				   IN unsigned num_recs)
+{
+	return IB_UNSUPPORTED;
+}
+
+void osm_mad_trace_close(IN osm_log_t * p_log)
+{
+}
+
+void osm_mad_trace_write(IN osm_log_t * p_log,
+			 IN osm_mad_trace_event_t event,
+			 IN const ib_mad_t * p_mad, IN ib_net16_t lid,
+			 IN uint64_t sent_usecs)
+{
+}
+#endif				/* ndef __WIN__ */
+
 void osm_log(IN osm_log_t * p_log, IN osm_log_level_t verbosity,
 	     IN const char *p_str, ...)
 {
@@ -163,6 +584,9 @@ void osm_log(IN osm_log_t * p_log, IN osm_log_level_t verbosity,
 	}
 
 	/* regular log to default out_port */
+	if (p_log->async && log_async_put(p_log, verbosity, buffer))
+		return;
+
 	cl_spinlock_acquire(&p_log->lock);
 
 	if (p_log->max_size && p_log->count > p_log->max_size) {
@@ -277,6 +701,9 @@ void osm_log_v2(IN osm_log_t * p_log, IN osm_log_level_t verbosity,
 	}
 
 	/* regular log to default out_port */
+	if (p_log->async && log_async_put(p_log, verbosity, buffer))
+		return;
+
 	cl_spinlock_acquire(&p_log->lock);
 
 	if (p_log->max_size && p_log->count > p_log->max_size) {
@@ -451,14 +878,28 @@ static int open_out_port(IN osm_log_t * p_log)
 
 int osm_log_reopen_file(osm_log_t * p_log)
 {
+	struct osm_log_async *async;
 	int ret;
 
 	if (p_log->out_port == stdout || p_log->out_port == stderr)
 		return 0;
+
+	/* osm_log_stop_async cannot free the writer state meanwhile */
+	cl_spinlock_acquire(&p_log->async_lock);
+	cl_spinlock_acquire(&p_log->lock);
+	async = p_log->async;
+	cl_spinlock_release(&p_log->lock);
+
+	/* the writer thread takes write_lock before lock */
+	if (async)
+		cl_spinlock_acquire(&async->write_lock);
 	cl_spinlock_acquire(&p_log->lock);
 	fclose(p_log->out_port);
 	ret = open_out_port(p_log);
 	cl_spinlock_release(&p_log->lock);
+	if (async)
+		cl_spinlock_release(&async->write_lock);
+	cl_spinlock_release(&p_log->async_lock);
 	return ret;
 }
 
@@ -473,6 +914,7 @@ ib_api_status_t osm_log_init_v2(IN osm_log_t * p_log, IN boolean_t flush,
 	p_log->max_size = max_size << 20; /* convert size in MB to bytes */
 	p_log->accum_log_file = accum_log_file;
 	p_log->log_file_name = (char *)log_file;
+	p_log->async = NULL;
 	memset(p_log->per_mod_log_tbl, 0, sizeof(p_log->per_mod_log_tbl));
 
 	openlog("OpenSM", LOG_CONS | LOG_PID, LOG_USER);
@@ -485,7 +927,8 @@ ib_api_status_t osm_log_init_v2(IN osm_log_t * p_log, IN boolean_t flush,
 	else if (open_out_port(p_log))
 		return IB_ERROR;
 
-	if (cl_spinlock_init(&p_log->lock) == CL_SUCCESS)
+	if (cl_spinlock_init(&p_log->lock) == CL_SUCCESS &&
+	    cl_spinlock_init(&p_log->async_lock) == CL_SUCCESS)
 		return IB_SUCCESS;
 	else
 		return IB_ERROR;
@@ -57,20 +57,73 @@ void osm_mad_pool_construct(IN osm_mad_pool_t * p_pool)
 	CL_ASSERT(p_pool);
 
 	memset(p_pool, 0, sizeof(*p_pool));
+	cl_spinlock_construct(&p_pool->lock);
+	cl_qlist_init(&p_pool->free_list);
 }
 
 void osm_mad_pool_destroy(IN osm_mad_pool_t * p_pool)
 {
+	cl_list_item_t *item;
+
 	CL_ASSERT(p_pool);
+
+	while ((item = cl_qlist_remove_head(&p_pool->free_list)) !=
+	       cl_qlist_end(&p_pool->free_list))
+		free(item);
+	cl_spinlock_destroy(&p_pool->lock);
 }
 
 ib_api_status_t osm_mad_pool_init(IN osm_mad_pool_t * p_pool)
 {
 	p_pool->mads_out = 0;
+	p_pool->mads_out_max = 0;
+
+	if (cl_spinlock_init(&p_pool->lock) != CL_SUCCESS)
+		return IB_ERROR;
 
 	return IB_SUCCESS;
 }
 
+/*
+ * Wrappers are recycled through a LIFO free list, so steady state MAD
+ * traffic reuses (cache hot) wrappers instead of calling malloc/free.
+ */
+static osm_madw_t *mad_pool_alloc_wrapper(IN osm_mad_pool_t * p_pool)
+{
+	cl_list_item_t *item;
+
+	cl_spinlock_acquire(&p_pool->lock);
+	item = cl_qlist_remove_head(&p_pool->free_list);
+	cl_spinlock_release(&p_pool->lock);
+
+	if (item != cl_qlist_end(&p_pool->free_list))
+		return (osm_madw_t *) item;
+
+	return malloc(sizeof(osm_madw_t));
+}
+
+static void mad_pool_free_wrapper(IN osm_mad_pool_t * p_pool,
+				  IN osm_madw_t * p_madw)
+{
+	cl_spinlock_acquire(&p_pool->lock);
+	if (cl_qlist_count(&p_pool->free_list) < OSM_MAD_POOL_MAX_FREE) {
+		cl_qlist_insert_head(&p_pool->free_list, &p_madw->list_item);
+		p_madw = NULL;
+	}
+	cl_spinlock_release(&p_pool->lock);
+
+	free(p_madw);
+}
+
+static void mad_pool_inc_out(IN osm_mad_pool_t * p_pool)
+{
+	uint32_t out = cl_atomic_inc(&p_pool->mads_out);
+
+	/* racy, but good enough for a statistic */
+	if (out > p_pool->mads_out_max)
+		p_pool->mads_out_max = out;
+}
+
 osm_madw_t *osm_mad_pool_get(IN osm_mad_pool_t * p_pool,
 			     IN osm_bind_handle_t h_bind,
 			     IN uint32_t total_size,
@@ -85,7 +138,7 @@ osm_madw_t *osm_mad_pool_get(IN osm_mad_pool_t * p_pool,
 	/*
 	   First, acquire a mad wrapper from the mad wrapper pool.
 	 */
-	p_madw = malloc(sizeof(*p_madw));
+	p_madw = mad_pool_alloc_wrapper(p_pool);
 	if (p_madw == NULL)
 		goto Exit;
 
@@ -97,12 +150,12 @@ osm_madw_t *osm_mad_pool_get(IN osm_mad_pool_t * p_pool,
 	p_mad = osm_vendor_get(h_bind, total_size, &p_madw->vend_wrap);
 	if (p_mad == NULL) {
 		/* Don't leak wrappers! */
-		free(p_madw);
+		mad_pool_free_wrapper(p_pool, p_madw);
 		p_madw = NULL;
 		goto Exit;
 	}
 
-	cl_atomic_inc(&p_pool->mads_out);
+	mad_pool_inc_out(p_pool);
 	/*
 	   Finally, attach the wire MAD to this wrapper.
 	 */
@@ -127,14 +180,14 @@ osm_madw_t *osm_mad_pool_get_wrapper(IN osm_mad_pool_t * p_pool,
 	/*
 	   First, acquire a mad wrapper from the mad wrapper pool.
 	 */
-	p_madw = malloc(sizeof(*p_madw));
+	p_madw = mad_pool_alloc_wrapper(p_pool);
 	if (p_madw == NULL)
 		goto Exit;
 
 	/*
 	   Finally, initialize the wrapper object.
 	 */
-	cl_atomic_inc(&p_pool->mads_out);
+	mad_pool_inc_out(p_pool);
 	osm_madw_init(p_madw, h_bind, total_size, p_mad_addr);
 	osm_madw_set_mad(p_madw, p_mad);
 
@@ -146,13 +199,13 @@ osm_madw_t *osm_mad_pool_get_wrapper_raw(IN osm_mad_pool_t * p_pool)
 {
 	osm_madw_t *p_madw;
 
-	p_madw = malloc(sizeof(*p_madw));
+	p_madw = mad_pool_alloc_wrapper(p_pool);
 	if (!p_madw)
 		return NULL;
 
 	osm_madw_init(p_madw, NULL, 0, NULL);
 	osm_madw_set_mad(p_madw, NULL);
-	cl_atomic_inc(&p_pool->mads_out);
+	mad_pool_inc_out(p_pool);
 
 	return p_madw;
 }
@@ -170,6 +223,6 @@ void osm_mad_pool_put(IN osm_mad_pool_t * p_pool, IN osm_madw_t * p_madw)
 	/*
 	   Return the mad wrapper to the wrapper pool
 	 */
-	free(p_madw);
+	mad_pool_free_wrapper(p_pool, p_madw);
 	cl_atomic_dec(&p_pool->mads_out);
 }
@@ -62,6 +62,7 @@
 #include <complib/cl_qlist.h>
 #include <complib/cl_math.h>
 #include <complib/cl_debug.h>
+#include <complib/cl_timer.h>
 #include <opensm/osm_file_ids.h>
 #define FILE_ID OSM_FILE_VENDOR_IBUMAD_C
 #include <opensm/osm_madw.h>
@@ -97,6 +98,9 @@ typedef struct _umad_receiver {
 	pthread_t tid;
 	osm_vendor_t *p_vend;
 	osm_log_t *p_log;
+	uint64_t batches;
+	uint64_t batch_mads;
+	unsigned batch_max;
 } umad_receiver_t;
 
 static void osm_vendor_close_port(osm_vendor_t * const p_vend);
@@ -130,31 +134,98 @@ static void log_send_error(osm_vendor_t * const p_vend, osm_madw_t *p_madw)
 	}
 }
 
+static inline boolean_t is_smp_class(uint8_t mgmt_class)
+{
+	return mgmt_class == IB_MCLASS_SUBN_DIR ||
+	    mgmt_class == IB_MCLASS_SUBN_LID;
+}
+
+static inline cl_qlist_t *match_hash_bucket(vendor_match_tbl_t * p_mtbl,
+					    ib_net64_t tid)
+{
+	return &p_mtbl->hash[cl_ntoh64(tid) & p_mtbl->hash_mask];
+}
+
+static inline cl_qlist_t *match_lru_list(vendor_match_tbl_t * p_mtbl,
+					 uint8_t mgmt_class)
+{
+	return is_smp_class(mgmt_class) ? &p_mtbl->lru_smp : &p_mtbl->lru_gs;
+}
+
+/* unlink an in use entry and return it to the free list */
+static void match_release(vendor_match_tbl_t * p_mtbl, umad_match_t * m)
+{
+	cl_qlist_remove_item(match_hash_bucket(p_mtbl, m->tid), &m->hash_item);
+	cl_qlist_remove_item(match_lru_list(p_mtbl, m->mgmt_class),
+			     &m->list_item);
+	m->tid = 0;
+	m->mgmt_class = 0;
+	cl_qlist_insert_tail(&p_mtbl->free_list, &m->list_item);
+}
+
+static int match_tbl_init(vendor_match_tbl_t * p_mtbl)
+{
+	uint32_t i, buckets = 1;
+
+	while (buckets < (uint32_t) p_mtbl->max)
+		buckets <<= 1;
+
+	p_mtbl->tbl = calloc(p_mtbl->max, sizeof(*p_mtbl->tbl));
+	p_mtbl->hash = calloc(buckets, sizeof(*p_mtbl->hash));
+	if (!p_mtbl->tbl || !p_mtbl->hash) {
+		free(p_mtbl->tbl);
+		free(p_mtbl->hash);
+		p_mtbl->tbl = NULL;
+		p_mtbl->hash = NULL;
+		return -1;
+	}
+
+	p_mtbl->hash_mask = buckets - 1;
+	for (i = 0; i < buckets; i++)
+		cl_qlist_init(&p_mtbl->hash[i]);
+	cl_qlist_init(&p_mtbl->free_list);
+	cl_qlist_init(&p_mtbl->lru_smp);
+	cl_qlist_init(&p_mtbl->lru_gs);
+	for (i = 0; i < (uint32_t) p_mtbl->max; i++)
+		cl_qlist_insert_tail(&p_mtbl->free_list,
+				     &p_mtbl->tbl[i].list_item);
+
+	return 0;
+}
+
 static void clear_madw(osm_vendor_t * p_vend)
 {
-	umad_match_t *m, *e, *old_m;
+	vendor_match_tbl_t *p_mtbl = &p_vend->mtbl;
+	umad_match_t *m;
+	cl_list_item_t *item;
 	ib_net64_t old_tid;
 	uint8_t old_mgmt_class;
+	osm_madw_t *p_madw;
 
 	OSM_LOG_ENTER(p_vend->p_log);
 	pthread_mutex_lock(&p_vend->match_tbl_mutex);
-	for (m = p_vend->mtbl.tbl, e = m + p_vend->mtbl.max; m < e; m++) {
-		if (m->tid) {
-			old_m = m;
-			old_tid = m->tid;
-			old_mgmt_class = m->mgmt_class;
-			m->tid = 0;
-			osm_mad_pool_put(((osm_umad_bind_info_t
-					   *) ((osm_madw_t *) m->v)->h_bind)->
-					 p_mad_pool, m->v);
-			pthread_mutex_unlock(&p_vend->match_tbl_mutex);
-			OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5401: "
-				"evicting entry %p (tid was 0x%" PRIx64
-				" mgmt class 0x%x)\n",
-				old_m, cl_ntoh64(old_tid), old_mgmt_class);
-			goto Exit;
-		}
+	if (!p_mtbl->tbl)
+		goto Unlock;
+	item = cl_qlist_head(&p_mtbl->lru_gs);
+	if (item == cl_qlist_end(&p_mtbl->lru_gs))
+		item = cl_qlist_head(&p_mtbl->lru_smp);
+	if (item != cl_qlist_end(&p_mtbl->lru_smp) &&
+	    item != cl_qlist_end(&p_mtbl->lru_gs)) {
+		m = PARENT_STRUCT(item, umad_match_t, list_item);
+		old_tid = m->tid;
+		old_mgmt_class = m->mgmt_class;
+		p_madw = m->v;
+		match_release(p_mtbl, m);
+		osm_mad_pool_put(((osm_umad_bind_info_t *) p_madw->h_bind)->
+				 p_mad_pool, p_madw);
+		pthread_mutex_unlock(&p_vend->match_tbl_mutex);
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5401: "
+			"evicting entry %p (tid was 0x%" PRIx64
+			" mgmt class 0x%x)\n",
+			m, cl_ntoh64(old_tid), old_mgmt_class);
+		goto Exit;
 	}
+Unlock:
 	pthread_mutex_unlock(&p_vend->match_tbl_mutex);
 
 Exit:
@@ -164,8 +235,11 @@ Exit:
 static osm_madw_t *get_madw(osm_vendor_t * p_vend, ib_net64_t * tid,
 			    uint8_t mgmt_class)
 {
-	umad_match_t *m, *e;
+	vendor_match_tbl_t *p_mtbl = &p_vend->mtbl;
 	ib_net64_t mtid = (*tid & CL_HTON64(0x00000000ffffffffULL));
+	cl_qlist_t *bucket;
+	cl_list_item_t *item;
+	umad_match_t *m;
 	osm_madw_t *res;
 
 	/*
@@ -176,12 +250,14 @@ static osm_madw_t *get_madw(osm_vendor_t * p_vend, ib_net64_t * tid,
 		return 0;
 
 	pthread_mutex_lock(&p_vend->match_tbl_mutex);
-	for (m = p_vend->mtbl.tbl, e = m + p_vend->mtbl.max; m < e; m++) {
+	bucket = match_hash_bucket(p_mtbl, mtid);
+	for (item = cl_qlist_head(bucket); item != cl_qlist_end(bucket);
+	     item = cl_qlist_next(item)) {
+		m = PARENT_STRUCT(item, umad_match_t, hash_item);
 		if (m->tid == mtid && m->mgmt_class == mgmt_class) {
-			m->tid = 0;
-			m->mgmt_class = 0;
 			*tid = mtid;
 			res = m->v;
+			match_release(p_mtbl, m);
 			pthread_mutex_unlock(&p_vend->match_tbl_mutex);
 			return res;
 		}
@@ -201,75 +277,57 @@ static void
 put_madw(osm_vendor_t * p_vend, osm_madw_t * p_madw, ib_net64_t tid,
 	 uint8_t mgmt_class)
 {
-	umad_match_t *m, *e, *old_lru, *lru = 0, *lru_smp = 0;
+	vendor_match_tbl_t *p_mtbl = &p_vend->mtbl;
+	umad_match_t *m;
+	cl_list_item_t *item;
 	osm_madw_t *p_req_madw;
 	osm_umad_bind_info_t *p_bind;
-	ib_net64_t old_tid;
-	uint32_t oldest = ~0, oldest_smp = ~0;
-	uint8_t old_mgmt_class;
+	ib_net64_t old_tid = 0;
+	uint8_t old_mgmt_class = 0;
 
 	pthread_mutex_lock(&p_vend->match_tbl_mutex);
-	for (m = p_vend->mtbl.tbl, e = m + p_vend->mtbl.max; m < e; m++) {
-		if (m->tid == 0 && m->mgmt_class == 0) {
-			m->tid = tid;
-			m->mgmt_class = mgmt_class;
-			m->v = p_madw;
-			m->version =
-			    cl_atomic_inc((atomic32_t *) & p_vend->mtbl.
-					  last_version);
-			pthread_mutex_unlock(&p_vend->match_tbl_mutex);
-			return;
-		}
-		if (m->mgmt_class == IB_MCLASS_SUBN_DIR ||
-		    m->mgmt_class == IB_MCLASS_SUBN_LID) {
-			if (oldest_smp >= m->version) {
-				oldest_smp = m->version;
-				lru_smp = m;
-			}
-		} else {
-			if (oldest >= m->version) {
-				oldest = m->version;
-				lru = m;
-			}
+	item = cl_qlist_remove_head(&p_mtbl->free_list);
+	if (item != cl_qlist_end(&p_mtbl->free_list))
+		m = PARENT_STRUCT(item, umad_match_t, list_item);
+	else {
+		item = cl_qlist_head(&p_mtbl->lru_gs);
+		if (item == cl_qlist_end(&p_mtbl->lru_gs)) {
+			CL_ASSERT(!cl_is_qlist_empty(&p_mtbl->lru_smp));
+			item = cl_qlist_head(&p_mtbl->lru_smp);
 		}
+		m = PARENT_STRUCT(item, umad_match_t, list_item);
+		old_tid = m->tid;
+		old_mgmt_class = m->mgmt_class;
+		p_req_madw = m->v;
+		match_release(p_mtbl, m);
+		cl_qlist_remove_item(&p_mtbl->free_list, &m->list_item);
+
+		p_bind = p_req_madw->h_bind;
+		p_req_madw->status = IB_CANCELED;
+		log_send_error(p_vend, p_req_madw);
+		osm_mad_trace(p_vend->p_log, OSM_MAD_TRACE_CANCEL,
+			      osm_madw_get_mad_ptr(p_req_madw),
+			      p_req_madw->mad_addr.dest_lid,
+			      p_req_madw->vend_wrap.send_time);
+		pthread_mutex_lock(&p_vend->cb_mutex);
+		(*p_bind->send_err_callback) (p_bind->client_context,
+					      p_req_madw);
+		pthread_mutex_unlock(&p_vend->cb_mutex);
 	}
 
-	if (oldest != ~0) {
-		old_lru = lru;
-		old_tid = lru->tid;
-		old_mgmt_class = lru->mgmt_class;
-	} else {
-		CL_ASSERT(oldest_smp != ~0);
-		old_lru = lru_smp;
-		old_tid = lru_smp->tid;
-		old_mgmt_class = lru_smp->mgmt_class;
-	}
-	p_req_madw = old_lru->v;
-	p_bind = p_req_madw->h_bind;
-	p_req_madw->status = IB_CANCELED;
-	log_send_error(p_vend, p_req_madw);
-	pthread_mutex_lock(&p_vend->cb_mutex);
-	(*p_bind->send_err_callback) (p_bind->client_context, p_req_madw);
-	pthread_mutex_unlock(&p_vend->cb_mutex);
-	if (mgmt_class == IB_MCLASS_SUBN_DIR ||
-	    mgmt_class == IB_MCLASS_SUBN_LID) {
-		lru_smp->tid = tid;
-		lru_smp->mgmt_class = mgmt_class;
-		lru_smp->v = p_madw;
-		lru_smp->version =
-		    cl_atomic_inc((atomic32_t *) & p_vend->mtbl.last_version);
-	} else {
-		lru->tid = tid;
-		lru->mgmt_class = mgmt_class;
-		lru->v = p_madw;
-		lru->version =
-		    cl_atomic_inc((atomic32_t *) & p_vend->mtbl.last_version);
-	}
+	m->tid = tid;
+	m->mgmt_class = mgmt_class;
+	m->v = p_madw;
+	cl_qlist_insert_tail(match_hash_bucket(p_mtbl, tid), &m->hash_item);
+	cl_qlist_insert_tail(match_lru_list(p_mtbl, mgmt_class),
+			     &m->list_item);
 	pthread_mutex_unlock(&p_vend->match_tbl_mutex);
-	OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5402: "
-		"evicting entry %p (tid was 0x%" PRIx64
-		" mgmt class 0x%x)\n", old_lru,
-		cl_ntoh64(old_tid), old_mgmt_class);
+
+	if (old_mgmt_class)
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5402: "
+			"evicting entry %p (tid was 0x%" PRIx64
+			" mgmt class 0x%x)\n", m,
+			cl_ntoh64(old_tid), old_mgmt_class);
 }
 
 static void
@@ -320,6 +378,38 @@ static void unlock_mutex(void *arg)
 	pthread_mutex_unlock(arg);
 }
 
+/*
+ * Put the umad fd in non blocking mode, so after each wakeup the
+ * receiver drains all the MADs already queued with a single read()
+ * per MAD, and polls only once the queue is empty.
+ */
+static int umad_receiver_set_drain(umad_receiver_t * p_ur)
+{
+	int fd, flags;
+
+	fd = umad_get_fd(p_ur->p_vend->umad_port_id);
+	if (fd < 0 || (flags = fcntl(fd, F_GETFL)) < 0 ||
+	    fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+		OSM_LOG(p_ur->p_log, OSM_LOG_VERBOSE,
+			"cannot set umad fd non blocking (%m), "
+			"receiving one MAD per wakeup\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+static void umad_receiver_end_batch(umad_receiver_t * p_ur, unsigned batch)
+{
+	if (!batch)
+		return;
+
+	p_ur->batches++;
+	p_ur->batch_mads += batch;
+	if (batch > p_ur->batch_max)
+		p_ur->batch_max = batch;
+}
+
 static void *umad_receiver(void *p_ptr)
 {
 	umad_receiver_t *const p_ur = (umad_receiver_t *) p_ptr;
@@ -329,10 +419,13 @@ static void *umad_receiver(void *p_ptr)
 	osm_madw_t *p_madw, *p_req_madw;
 	ib_mad_t *p_mad, *p_req_mad;
 	void *umad = 0;
-	int mad_agent, length;
+	int mad_agent, length, timeout = -1, drain;
+	unsigned batch = 0;
 
 	OSM_LOG_ENTER(p_ur->p_log);
 
+	drain = umad_receiver_set_drain(p_ur);
+
 	for (;;) {
 		if (!umad &&
 		    !(umad = umad_alloc(1, umad_size() + MAD_BLOCK_SIZE))) {
@@ -343,7 +436,14 @@ static void *umad_receiver(void *p_ptr)
 
 		length = MAD_BLOCK_SIZE;
 		if ((mad_agent = umad_recv(p_vend->umad_port_id, umad,
-					   &length, -1)) < 0) {
+					   &length, timeout)) < 0) {
+			if (mad_agent == -EAGAIN || mad_agent == -EWOULDBLOCK) {
+				/* queue drained - wait for the next wakeup */
+				umad_receiver_end_batch(p_ur, batch);
+				batch = 0;
+				timeout = -1;
+				continue;
+			}
 			if (length <= MAD_BLOCK_SIZE) {
 				OSM_LOG(p_ur->p_log, OSM_LOG_ERROR, "ERR 5404: "
 					"recv error on MAD sized umad (%m)\n");
@@ -362,7 +462,7 @@ static void *umad_receiver(void *p_ptr)
 
 				if ((mad_agent = umad_recv(p_vend->umad_port_id,
 							   umad, &length,
-							   -1)) < 0) {
+							   timeout)) < 0) {
 					OSM_LOG(p_ur->p_log, OSM_LOG_ERROR,
 						"ERR 5406: "
 						"recv error on umad length %d (%m)\n",
@@ -372,6 +472,12 @@ static void *umad_receiver(void *p_ptr)
 			}
 		}
 
+		if (drain) {
+			batch++;
+			timeout = 0;
+		} else
+			umad_receiver_end_batch(p_ur, 1);
+
 		if (mad_agent >= OSM_UMAD_MAX_AGENTS ||
 		    !(p_bind = p_vend->agents[mad_agent])) {
 			OSM_LOG(p_ur->p_log, OSM_LOG_ERROR, "ERR 5407: "
@@ -418,6 +524,11 @@ static void *umad_receiver(void *p_ptr)
 			} else {
 				p_req_madw->status = IB_TIMEOUT;
 				log_send_error(p_vend, p_req_madw);
+				osm_mad_trace(p_vend->p_log,
+					      OSM_MAD_TRACE_TIMEOUT,
+					      osm_madw_get_mad_ptr(p_req_madw),
+					      p_req_madw->mad_addr.dest_lid,
+					      p_req_madw->vend_wrap.send_time);
 				/* cb frees req_madw */
 				pthread_mutex_lock(&p_vend->cb_mutex);
 				pthread_cleanup_push(unlock_mutex,
@@ -503,6 +614,10 @@ static void *umad_receiver(void *p_ptr)
 		}
 #endif
 
+		osm_mad_trace(p_vend->p_log, OSM_MAD_TRACE_RECV, p_mad,
+			      osm_addr.dest_lid,
+			      p_req_madw ? p_req_madw->vend_wrap.send_time : 0);
+
 		/* call the CB */
 		pthread_mutex_lock(&p_vend->cb_mutex);
 		pthread_cleanup_push(unlock_mutex, &p_vend->cb_mutex);
@@ -532,6 +647,10 @@ static void umad_receiver_stop(umad_receiver_t * p_ur)
 {
 	pthread_cancel(p_ur->tid);
 	pthread_join(p_ur->tid, NULL);
+	OSM_LOG(p_ur->p_log, OSM_LOG_VERBOSE,
+		"umad receiver: %" PRIu64 " MADs in %" PRIu64
+		" batches, largest batch %u\n",
+		p_ur->batch_mads, p_ur->batches, p_ur->batch_max);
 	p_ur->tid = 0;
 	p_ur->p_vend = NULL;
 	p_ur->p_log = NULL;
@@ -551,6 +670,7 @@ osm_vendor_init(IN osm_vendor_t * const p_vend,
 	p_vend->max_retries = OSM_DEFAULT_RETRY_COUNT;
 	pthread_mutex_init(&p_vend->cb_mutex, NULL);
 	pthread_mutex_init(&p_vend->match_tbl_mutex, NULL);
+	pthread_mutex_init(&p_vend->umad_cache_mutex, NULL);
 	p_vend->umad_port_id = -1;
 	p_vend->issmfd = -1;
 
@@ -586,8 +706,7 @@ osm_vendor_init(IN osm_vendor_t * const p_vend,
 	OSM_LOG(p_vend->p_log, OSM_LOG_INFO, "%d pending umads specified\n",
 		p_vend->mtbl.max);
 
-	p_vend->mtbl.tbl = calloc(p_vend->mtbl.max, sizeof(*(p_vend->mtbl.tbl)));
-	if (!p_vend->mtbl.tbl) {
+	if (match_tbl_init(&p_vend->mtbl)) {
 		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "Error:"
 			"failed to allocate vendor match table\n");
 		r = IB_INSUFFICIENT_MEMORY;
@@ -641,7 +760,11 @@ void osm_vendor_delete(IN osm_vendor_t ** const pp_vend)
 
 	pthread_mutex_destroy(&(*pp_vend)->cb_mutex);
 	pthread_mutex_destroy(&(*pp_vend)->match_tbl_mutex);
+	while ((*pp_vend)->umad_cache_count)
+		umad_free((*pp_vend)->umad_cache[--(*pp_vend)->umad_cache_count]);
+	pthread_mutex_destroy(&(*pp_vend)->umad_cache_mutex);
 	free((*pp_vend)->mtbl.tbl);
+	free((*pp_vend)->mtbl.hash);
 	free(*pp_vend);
 	*pp_vend = NULL;
 }
@@ -1063,7 +1186,18 @@ ib_mad_t *osm_vendor_get(IN osm_bind_handle_t h_bind,
 		"Acquiring UMAD for p_madw = %p, size = %u\n", p_vw, mad_size);
 	CL_ASSERT(p_vw);
 	p_vw->size = mad_size;
-	p_vw->umad = umad_alloc(1, mad_size + umad_size());
+	p_vw->umad = NULL;
+	if (mad_size == MAD_BLOCK_SIZE) {
+		pthread_mutex_lock(&p_vend->umad_cache_mutex);
+		if (p_vend->umad_cache_count)
+			p_vw->umad =
+			    p_vend->umad_cache[--p_vend->umad_cache_count];
+		pthread_mutex_unlock(&p_vend->umad_cache_mutex);
+		if (p_vw->umad)
+			memset(p_vw->umad, 0, mad_size + umad_size());
+	}
+	if (!p_vw->umad)
+		p_vw->umad = umad_alloc(1, mad_size + umad_size());
 
 	/* track locally */
 	p_vw->h_bind = h_bind;
@@ -1093,7 +1227,20 @@ osm_vendor_put(IN osm_bind_handle_t h_bind, IN osm_vend_wrap_t * const p_vw)
 	 * it was looked up.
 	 */
 
-	/* free the mad but the wrapper is part of the madw object */
+	/*
+	 * Free the mad but the wrapper is part of the madw object.
+	 * MAD sized buffers are kept for reuse; a buffer swapped in by
+	 * the receiver is always at least p_vw->size long.
+	 */
+	if (p_vw->size == MAD_BLOCK_SIZE) {
+		pthread_mutex_lock(&p_vend->umad_cache_mutex);
+		if (p_vend->umad_cache_count < OSM_UMAD_CACHE_MAX) {
+			p_vend->umad_cache[p_vend->umad_cache_count++] =
+			    p_vw->umad;
+			p_vw->umad = NULL;
+		}
+		pthread_mutex_unlock(&p_vend->umad_cache_mutex);
+	}
 	umad_free(p_vw->umad);
 	p_vw->umad = 0;
 	p_madw = PARENT_STRUCT(p_vw, osm_madw_t, vend_wrap);
@@ -1182,6 +1329,11 @@ osm_vendor_send(IN osm_bind_handle_t h_bind,
 	}
 
 Resp:
+	/* the response may be received before umad_send() returns */
+	p_vw->send_time = resp_expected && p_vend->p_log->mad_trace ?
+	    cl_get_time_stamp() : 0;
+	osm_mad_trace(p_vend->p_log, OSM_MAD_TRACE_SEND, p_mad,
+		      p_mad_addr->dest_lid, 0);
 	if (resp_expected)
 		put_madw(p_vend, p_madw, p_mad->trans_id, p_mad->mgmt_class);
 
@@ -1206,6 +1358,8 @@ Resp:
 			"Attr 0x%X, TID 0x%" PRIx64 " failed %d (%m)\n",
 			p_madw, sent_mad_size, p_mad->mgmt_class,
 			p_mad->method, cl_ntoh16(p_mad->attr_id), tid, ret);
+		osm_mad_trace(p_vend->p_log, OSM_MAD_TRACE_SEND_ERR, p_mad,
+			      p_mad_addr->dest_lid, 0);
 		if (resp_expected) {
 			get_madw(p_vend, &p_mad->trans_id,
 				 p_mad->mgmt_class);	/* remove from aging table */
@@ -602,6 +602,7 @@ int osm_manager_loop(osm_subn_opt_t * p_opt, osm_opensm_t * p_osm)
 			osm_hup_flag = 0;
 			/* a HUP signal should only start a new heavy sweep */
 			p_osm->subn.force_heavy_sweep = TRUE;
+			osm_routing_exec_cancel(&p_osm->routing_exec);
 			osm_opensm_sweep(p_osm);
 		}
 	}
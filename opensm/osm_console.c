@@ -57,6 +57,7 @@
 #include <complib/cl_passivelock.h>
 #include <opensm/osm_perfmgr.h>
 #include <opensm/osm_subnet.h>
+#include <opensm/osm_helper.h>
 
 extern void osm_update_node_desc(IN osm_opensm_t *osm);
 
@@ -441,6 +442,29 @@ static void dump_sms(osm_opensm_t * p_osm, FILE * out)
 	CL_PLOCK_RELEASE(p_osm->sm.p_lock);
 }
 
+static void dump_disp_queues(osm_opensm_t * p_osm, FILE * out)
+{
+	static const char *prio_str[] = { "high", "normal", "low" };
+	cl_disp_queue_stats_t stats;
+	cl_disp_msgid_t msg_id;
+
+	fprintf(out, "\n   Dispatcher queues\n"
+		     "   -----------------\n");
+	fprintf(out, "   %-32s %-6s %6s %6s %10s %10s %10s\n", "Message",
+		"Prio", "Depth", "Max", "Msgs", "Avg us", "Max us");
+	for (msg_id = OSM_MSG_NONE + 1; msg_id < OSM_MSG_MAX; msg_id++) {
+		if (cl_disp_get_msg_stats(&p_osm->disp, msg_id, &stats) !=
+		    CL_SUCCESS || (!stats.msgs && !stats.depth))
+			continue;
+		fprintf(out, "   %-32s %-6s %6u %6u %10" PRIu64 " %10" PRIu64
+			" %10" PRIu64 "\n", osm_get_disp_msg_str(msg_id),
+			prio_str[stats.prio], stats.depth, stats.max_depth,
+			stats.msgs, stats.msgs ?
+			stats.total_queue_time_us / stats.msgs : 0,
+			stats.max_queue_time_us);
+	}
+}
+
 static void print_status(osm_opensm_t * p_osm, FILE * out)
 {
 	cl_list_item_t *item;
@@ -491,7 +515,9 @@ static void print_status(osm_opensm_t * p_osm, FILE * out)
 			"   SA MADs rcvd                   : %u\n"
 			"   SA MADs sent                   : %u\n"
 			"   SA unknown MADs rcvd           : %u\n"
-			"   SA MADs ignored                : %u\n",
+			"   SA MADs ignored                : %u\n"
+			"   MAD pool wrappers out          : %u\n"
+			"   MAD pool wrappers out (max)    : %u\n",
 			(uint32_t)p_osm->stats.qp0_mads_outstanding,
 			(uint32_t)p_osm->stats.qp0_mads_outstanding_on_wire,
 			(uint32_t)p_osm->stats.qp0_mads_rcvd,
@@ -502,7 +528,10 @@ static void print_status(osm_opensm_t * p_osm, FILE * out)
 			(uint32_t)p_osm->stats.sa_mads_rcvd,
 			(uint32_t)p_osm->stats.sa_mads_sent,
 			(uint32_t)p_osm->stats.sa_mads_rcvd_unknown,
-			(uint32_t)p_osm->stats.sa_mads_ignored);
+			(uint32_t)p_osm->stats.sa_mads_ignored,
+			(uint32_t)p_osm->mad_pool.mads_out,
+			p_osm->mad_pool.mads_out_max);
+		dump_disp_queues(p_osm, out);
 		fprintf(out, "\n   Subnet flags\n"
 			"   ------------\n"
 			"   Sweeping enabled               : %d\n"
@@ -565,8 +594,10 @@ static void resweep_parse(char **p_last, osm_opensm_t * p_osm, FILE * out)
 		fprintf(out, "Invalid resweep command\n");
 		help_resweep(out, 1);
 	} else {
-		if (strcmp(p_cmd, "heavy") == 0)
+		if (strcmp(p_cmd, "heavy") == 0) {
 			p_osm->subn.force_heavy_sweep = TRUE;
+			osm_routing_exec_cancel(&p_osm->routing_exec);
+		}
 		osm_opensm_sweep(p_osm);
 	}
 }
@@ -36,7 +36,9 @@
 
 /*
  * Abstract:
- * Implementation of the osm_db interface using simple text files
+ * Implementation of the osm_db interface using simple text files.
+ * Changes are appended to the domain file as a log of records which is
+ * compacted (rewritten) once it grows well beyond the number of entries.
  */
 
 #if HAVE_CONFIG_H
@@ -67,6 +69,31 @@
 #define OSM_DB_MAX_LINE_LEN 1024
 /**********/
 
+/****d* Database/OSM_DB_DELETE_MARK
+ * NAME
+ * OSM_DB_DELETE_MARK
+ *
+ * DESCRIPTION
+ * Prefix of a key marking a record that deletes that key
+ *
+ * SYNOPSIS
+ */
+#define OSM_DB_DELETE_MARK '-'
+/**********/
+
+/****d* Database/OSM_DB_COMPACT_MIN_RECORDS
+ * NAME
+ * OSM_DB_COMPACT_MIN_RECORDS
+ *
+ * DESCRIPTION
+ * The file is compacted when it holds more than twice the number of
+ * entries in the domain plus this number of records
+ *
+ * SYNOPSIS
+ */
+#define OSM_DB_COMPACT_MIN_RECORDS 1024
+/**********/
+
 /****s* OpenSM: Database/osm_db_domain_imp
  * NAME
  * osm_db_domain_imp
@@ -80,12 +107,25 @@
 typedef struct osm_db_domain_imp {
 	char *file_name;
 	st_table *p_hash;
+	st_table *p_changes;
+	unsigned num_records;
 	cl_spinlock_t lock;
 	boolean_t dirty;
+	boolean_t compact;
 } osm_db_domain_imp_t;
 /*
  * FIELDS
  *
+ * p_changes
+ *   The keys updated or deleted since the last store
+ *
+ * num_records
+ *   The number of records (including superseded ones) in the file
+ *
+ * compact
+ *   The next store must rewrite the whole file (until the file is restored,
+ *   or after its last record was found truncated)
+ *
  * SEE ALSO
  * osm_db_domain_t
  *********/
@@ -127,6 +167,7 @@ void osm_db_domain_destroy(IN osm_db_domain_t * p_db_domain)
 
 	cl_spinlock_destroy(&p_domain_imp->lock);
 
+	st_free_table(p_domain_imp->p_changes);
 	st_free_table(p_domain_imp->p_hash);
 	free(p_domain_imp->file_name);
 	free(p_domain_imp);
@@ -258,7 +299,12 @@ osm_db_domain_t *osm_db_domain_init(IN osm_db_t * p_db, IN const char *domain_na
 	/* initialize the hash table object */
 	p_domain_imp->p_hash = st_init_strtable();
 	CL_ASSERT(p_domain_imp->p_hash != NULL);
+	p_domain_imp->p_changes = st_init_strtable();
+	CL_ASSERT(p_domain_imp->p_changes != NULL);
+	p_domain_imp->num_records = 0;
 	p_domain_imp->dirty = FALSE;
+	/* the file may only be appended to once it has been restored */
+	p_domain_imp->compact = TRUE;
 
 	p_domain->p_db = p_db;
 	cl_list_insert_tail(&p_db->domains, p_domain);
@@ -271,6 +317,28 @@ Exit:
 	return p_domain;
 }
 
+static int clear_change_entry(st_data_t key, st_data_t val, st_data_t arg)
+{
+	free((char *)key);
+	return ST_DELETE;
+}
+
+/* remember that the key changed since the last store */
+static void note_change(IN osm_db_domain_imp_t * p_domain_imp, IN char *p_key)
+{
+	char *p_new_key;
+
+	if (p_domain_imp->compact ||
+	    st_is_member(p_domain_imp->p_changes, (st_data_t) p_key))
+		return;
+
+	p_new_key = strdup(p_key);
+	if (p_new_key)
+		st_insert(p_domain_imp->p_changes, (st_data_t) p_new_key, 0);
+	else
+		p_domain_imp->compact = TRUE;
+}
+
 int osm_db_restore(IN osm_db_domain_t * p_domain)
 {
 
@@ -282,10 +350,12 @@ int osm_db_restore(IN osm_db_domain_t * p_domain)
 	char sLine[OSM_DB_MAX_LINE_LEN];
 	boolean_t before_key;
 	char *p_first_word, *p_rest_of_line, *p_last;
-	char *p_key = NULL;
+	char *p_key = NULL, *p_prev_key;
 	char *p_prev_val = NULL, *p_accum_val = NULL;
 	char *endptr = NULL;
 	unsigned int line_num;
+	boolean_t is_delete;
+	boolean_t torn = FALSE;
 
 	OSM_LOG_ENTER(p_log);
 
@@ -316,10 +386,8 @@ int osm_db_restore(IN osm_db_domain_t * p_domain)
 	status = 0;
 	before_key = TRUE;
 	line_num = 0;
-	/* if we got to EOF in the middle of a key we add a last newline */
-	while ((fgets(sLine, OSM_DB_MAX_LINE_LEN, p_file) != NULL) ||
-	       ((before_key == FALSE) && strcpy(sLine, "\n"))
-	    ) {
+	p_domain_imp->num_records = 0;
+	while (fgets(sLine, OSM_DB_MAX_LINE_LEN, p_file) != NULL) {
 		line_num++;
 		if (before_key) {
 			if ((sLine[0] != ' ') && (sLine[0] != '\t')
@@ -368,47 +436,56 @@ int osm_db_restore(IN osm_db_domain_t * p_domain)
 			if (sLine[0] == '\n') {
 				/* got an end of key */
 				before_key = TRUE;
+				p_domain_imp->num_records++;
 
-				/* make sure the key was not previously used */
-				if (st_lookup(p_domain_imp->p_hash,
-					      (st_data_t) p_key,
-					      (void *)&p_prev_val)) {
-					/* if previously used we ignore this guid */
-					OSM_LOG(p_log, OSM_LOG_ERROR,
-						"ERR 6106: "
-						"Key:%s already exists in:%s with value:%s."
-						" Removing it\n", p_key,
-						p_domain_imp->file_name,
-						p_prev_val);
-						free(p_key);
-						p_key = NULL;
-						free(p_accum_val);
-						p_accum_val = NULL;
-						continue;
-				} else {
-					p_prev_val = NULL;
-				}
+				/*
+				 * The file is a log: a later record of a key
+				 * supersedes the earlier ones.
+				 */
+				is_delete = (p_key[0] == OSM_DB_DELETE_MARK);
 
 				OSM_LOG(p_log, OSM_LOG_DEBUG,
 					"Got key:%s value:%s\n", p_key,
 					p_accum_val);
 
 				/* check that the key is a number */
-				if (!strtouq(p_key, &endptr, 0)
+				if (!strtouq(p_key + is_delete, &endptr, 0)
 				    && *endptr != '\0') {
 					OSM_LOG(p_log, OSM_LOG_ERROR,
 						"ERR 610B: "
 						"Key:%s is invalid\n", p_key);
-						free(p_key);
-						p_key = NULL;
-						free(p_accum_val);
-						p_accum_val = NULL;
+				} else if (is_delete) {
+					p_prev_key = p_key + 1;
+					if (st_delete(p_domain_imp->p_hash,
+						      (void *)&p_prev_key,
+						      (void *)&p_prev_val)) {
+						free(p_prev_key);
+						free(p_prev_val);
+					}
+				} else if (st_lookup(p_domain_imp->p_hash,
+						     (st_data_t) p_key,
+						     (void *)&p_prev_val)) {
+					OSM_LOG(p_log, OSM_LOG_DEBUG,
+						"Key:%s value:%s replaced by:%s\n",
+						p_key, p_prev_val, p_accum_val);
+					st_insert(p_domain_imp->p_hash,
+						  (st_data_t) p_key,
+						  (st_data_t) p_accum_val);
+					free(p_prev_val);
+					p_accum_val = NULL;
 				} else {
 					/* store our key and value */
 					st_insert(p_domain_imp->p_hash,
 						  (st_data_t) p_key,
 						  (st_data_t) p_accum_val);
+					p_key = NULL;
+					p_accum_val = NULL;
 				}
+				free(p_key);
+				p_key = NULL;
+				free(p_accum_val);
+				p_accum_val = NULL;
+				p_prev_val = NULL;
 			} else {
 				/* accumulate into the value */
 				p_prev_val = p_accum_val;
@@ -420,11 +497,35 @@ int osm_db_restore(IN osm_db_domain_t * p_domain)
 				strcat(p_accum_val, sLine);
 			}
 		}		/* in key */
-	}			/* while lines or last line */
+	}			/* while lines */
+
+	/*
+	 * A record is only complete once its closing empty line is written.
+	 * One cut short by a crash while appending is dropped, and the file
+	 * is rewritten on the next store so that later records do not get
+	 * appended to it.
+	 */
+	if (before_key == FALSE) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6116: "
+			"Dropping the truncated last record of key:%s "
+			"(file:%s)\n", p_key, p_domain_imp->file_name);
+		free(p_key);
+		p_key = NULL;
+		free(p_accum_val);
+		p_accum_val = NULL;
+		torn = TRUE;
+	}
 
 EndParsing:
 	fclose(p_file);
 
+	/* the cache now matches the file, unless it could not be parsed */
+	st_foreach(p_domain_imp->p_changes, clear_change_entry,
+		   (st_data_t) NULL);
+	p_domain_imp->compact = (status != 0) || torn;
+	if (torn)
+		p_domain_imp->dirty = TRUE;
+
 Exit:
 	cl_spinlock_release(&p_domain_imp->lock);
 	OSM_LOG_EXIT(p_log);
@@ -441,34 +542,97 @@ static int dump_tbl_entry(st_data_t key, st_data_t val, st_data_t arg)
 	return ST_CONTINUE;
 }
 
-int osm_db_store(IN osm_db_domain_t * p_domain,
-		 IN boolean_t fsync_high_avail_files)
+typedef struct db_append_ctx {
+	FILE *p_file;
+	st_table *p_hash;
+} db_append_ctx_t;
+
+static int append_change_entry(st_data_t key, st_data_t val, st_data_t arg)
 {
-	osm_log_t *p_log = p_domain->p_db->p_log;
-	osm_db_domain_imp_t *p_domain_imp;
-	FILE *p_file = NULL;
-	int fd, status = 0;
-	char *p_tmp_file_name = NULL;
+	db_append_ctx_t *p_ctx = (db_append_ctx_t *) arg;
+	char *p_key = (char *)key;
+	char *p_val;
 
-	OSM_LOG_ENTER(p_log);
+	if (st_lookup(p_ctx->p_hash, key, (void *)&p_val))
+		fprintf(p_ctx->p_file, "%s %s\n\n", p_key, p_val);
+	else
+		fprintf(p_ctx->p_file, "%c%s\n\n", OSM_DB_DELETE_MARK, p_key);
+	return ST_CONTINUE;
+}
 
-	p_domain_imp = (osm_db_domain_imp_t *) p_domain->p_domain_imp;
+static void sync_db_file(IN osm_log_t * p_log, IN FILE * p_file,
+			 IN const char *file_name)
+{
+	int fd;
+
+	if (fflush(p_file) == 0) {
+		fd = fileno(p_file);
+		if (fd != -1) {
+			if (fsync(fd) == -1)
+				OSM_LOG(p_log, OSM_LOG_ERROR,
+					"ERR 6110: fsync() failed (%s) for %s\n",
+					strerror(errno), file_name);
+		} else
+			OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6111: "
+				"fileno() failed for %s\n", file_name);
+	} else
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6112: "
+			"fflush() failed (%s) for %s\n",
+			strerror(errno), file_name);
+}
+
+/* append the changed keys to the end of the file */
+static int db_append(IN osm_log_t * p_log,
+		     IN osm_db_domain_imp_t * p_domain_imp,
+		     IN boolean_t fsync_high_avail_files)
+{
+	db_append_ctx_t ctx;
+
+	ctx.p_hash = p_domain_imp->p_hash;
+	ctx.p_file = fopen(p_domain_imp->file_name, "a");
+	if (!ctx.p_file) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6114: "
+			"Failed to open the db file:%s for appending: err:%s\n",
+			p_domain_imp->file_name, strerror(errno));
+		return 1;
+	}
+
+	st_foreach(p_domain_imp->p_changes, append_change_entry,
+		   (st_data_t) & ctx);
+
+	if (fsync_high_avail_files)
+		sync_db_file(p_log, ctx.p_file, p_domain_imp->file_name);
+
+	if (fclose(ctx.p_file)) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6115: "
+			"Failed to write the db file:%s: err:%s\n",
+			p_domain_imp->file_name, strerror(errno));
+		return 1;
+	}
+
+	p_domain_imp->num_records += p_domain_imp->p_changes->num_entries;
+	return 0;
+}
+
+/* rewrite the whole file through a temporary file */
+static int db_compact(IN osm_log_t * p_log,
+		      IN osm_db_domain_imp_t * p_domain_imp,
+		      IN boolean_t fsync_high_avail_files)
+{
+	FILE *p_file;
+	char *p_tmp_file_name;
+	int status;
 
 	p_tmp_file_name = malloc(sizeof(char) *
 				 (strlen(p_domain_imp->file_name) + 8));
 	if (!p_tmp_file_name) {
 		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6113: "
 			"Failed to allocate memory for temporary file name\n");
-		goto Exit2;
+		return 1;
 	}
 	strcpy(p_tmp_file_name, p_domain_imp->file_name);
 	strcat(p_tmp_file_name, ".tmp");
 
-	cl_spinlock_acquire(&p_domain_imp->lock);
-
-	if (p_domain_imp->dirty == FALSE)
-		goto Exit;
-
 	/* open up the output file */
 	p_file = fopen(p_tmp_file_name, "w");
 	if (!p_file) {
@@ -481,24 +645,8 @@ int osm_db_store(IN osm_db_domain_t * p_domain,
 
 	st_foreach(p_domain_imp->p_hash, dump_tbl_entry, (st_data_t) p_file);
 
-	if (fsync_high_avail_files) {
-		if (fflush(p_file) == 0) {
-			fd = fileno(p_file);
-			if (fd != -1) {
-				if (fsync(fd) == -1)
-					OSM_LOG(p_log, OSM_LOG_ERROR,
-						"ERR 6110: fsync() failed (%s) for %s\n",
-						strerror(errno),
-						p_domain_imp->file_name);
-			} else
-				OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6111: "
-					"fileno() failed for %s\n",
-					p_domain_imp->file_name);
-		} else
-			OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 6112: "
-				"fflush() failed (%s) for %s\n",
-				strerror(errno), p_domain_imp->file_name);
-	}
+	if (fsync_high_avail_files)
+		sync_db_file(p_log, p_file, p_domain_imp->file_name);
 
 	fclose(p_file);
 
@@ -509,11 +657,52 @@ int osm_db_store(IN osm_db_domain_t * p_domain,
 			p_domain_imp->file_name, strerror(errno));
 		goto Exit;
 	}
+	p_domain_imp->num_records = p_domain_imp->p_hash->num_entries;
+	p_domain_imp->compact = FALSE;
+Exit:
+	free(p_tmp_file_name);
+	return status;
+}
+
+int osm_db_store(IN osm_db_domain_t * p_domain,
+		 IN boolean_t fsync_high_avail_files)
+{
+	osm_log_t *p_log = p_domain->p_db->p_log;
+	osm_db_domain_imp_t *p_domain_imp;
+	unsigned num_records;
+	int status = 0;
+
+	OSM_LOG_ENTER(p_log);
+
+	p_domain_imp = (osm_db_domain_imp_t *) p_domain->p_domain_imp;
+
+	cl_spinlock_acquire(&p_domain_imp->lock);
+
+	if (p_domain_imp->dirty == FALSE)
+		goto Exit;
+
+	/*
+	 * Only the changed keys are appended, unless the file would hold
+	 * too many superseded records - then it is rewritten from scratch.
+	 */
+	num_records = p_domain_imp->num_records +
+	    p_domain_imp->p_changes->num_entries;
+	if (p_domain_imp->compact ||
+	    num_records > 2 * p_domain_imp->p_hash->num_entries +
+	    OSM_DB_COMPACT_MIN_RECORDS)
+		status = db_compact(p_log, p_domain_imp,
+				    fsync_high_avail_files);
+	else
+		status = db_append(p_log, p_domain_imp,
+				   fsync_high_avail_files);
+	if (status)
+		goto Exit;
+
+	st_foreach(p_domain_imp->p_changes, clear_change_entry,
+		   (st_data_t) NULL);
 	p_domain_imp->dirty = FALSE;
 Exit:
 	cl_spinlock_release(&p_domain_imp->lock);
-	free(p_tmp_file_name);
-Exit2:
 	OSM_LOG_EXIT(p_log);
 	return status;
 }
@@ -534,6 +723,10 @@ int osm_db_clear(IN osm_db_domain_t * p_domain)
 
 	cl_spinlock_acquire(&p_domain_imp->lock);
 	st_foreach(p_domain_imp->p_hash, clear_tbl_entry, (st_data_t) NULL);
+	/* deleted keys are not logged - the next store rewrites the file */
+	st_foreach(p_domain_imp->p_changes, clear_change_entry,
+		   (st_data_t) NULL);
+	p_domain_imp->compact = TRUE;
 	cl_spinlock_release(&p_domain_imp->lock);
 
 	return 0;
@@ -613,6 +806,7 @@ int osm_db_update(IN osm_db_domain_t * p_domain, IN char *p_key, IN char *p_val)
 	if (p_prev_val)
 		free(p_prev_val);
 
+	note_change(p_domain_imp, p_key);
 	p_domain_imp->dirty = TRUE;
 
 Exit:
@@ -641,6 +835,7 @@ int osm_db_delete(IN osm_db_domain_t * p_domain, IN char *p_key)
 				p_key, p_domain_imp->file_name, p_prev_val);
 			res = 1;
 		} else {
+			note_change(p_domain_imp, p_key);
 			free(p_key);
 			free(p_prev_val);
 			p_domain_imp->dirty = TRUE;
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2026 The OpenSM contributors. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+/*
+ * Abstract:
+ *    Implementation of osm_graph_t.
+ *    This object represents the switch graph of the subnet.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <complib/cl_qmap.h>
+#include <opensm/osm_file_ids.h>
+#define FILE_ID OSM_FILE_GRAPH_C
+#include <opensm/osm_opensm.h>
+#include <opensm/osm_graph.h>
+
+void osm_graph_construct(IN osm_graph_t * p_graph)
+{
+	memset(p_graph, 0, sizeof(*p_graph));
+}
+
+void osm_graph_destroy(IN osm_graph_t * p_graph)
+{
+	free(p_graph->sw);
+	free(p_graph->lid);
+	free(p_graph->lmc);
+	free(p_graph->link_start);
+	free(p_graph->links);
+	free(p_graph->endport_start);
+	free(p_graph->endports);
+	free(p_graph->lid_sw);
+	osm_graph_construct(p_graph);
+}
+
+uint32_t osm_graph_find_sw(IN const osm_graph_t * p_graph,
+			   IN ib_net64_t node_guid)
+{
+	uint32_t lo = 0, hi = p_graph->num_sw, mid;
+	uint64_t key;
+
+	/* switches are in sw_guid_tbl order, that is sorted by key */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		key = cl_qmap_key(&p_graph->sw[mid]->map_item);
+		if (key == node_guid)
+			return mid;
+		if (key < node_guid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return OSM_GRAPH_NO_SW;
+}
+
+static void set_lid_sw(IN osm_graph_t * p_graph, IN uint16_t lid,
+		       IN uint8_t lmc, IN uint32_t sw)
+{
+	unsigned i;
+
+	for (i = 0; i < (1U << lmc); i++)
+		if (lid + i <= p_graph->max_lid)
+			p_graph->lid_sw[lid + i] = sw;
+}
+
+int osm_graph_build(IN osm_graph_t * p_graph, IN osm_subn_t * p_subn)
+{
+	cl_qmap_t *p_sw_tbl = &p_subn->sw_guid_tbl;
+	boolean_t has_fdr10 = p_subn->opt.fdr10 == 1;
+	osm_graph_link_t *link;
+	osm_graph_endport_t *endport;
+	osm_switch_t *p_sw;
+	osm_node_t *p_remote_node;
+	osm_physp_t *p_physp;
+	uint32_t i, n, max_lid;
+	uint8_t port, rem_port;
+
+	osm_graph_destroy(p_graph);
+
+	n = cl_qmap_count(p_sw_tbl);
+	max_lid = cl_ptr_vector_get_size(&p_subn->port_lid_tbl);
+	max_lid = max_lid ? max_lid - 1 : 0;
+	p_graph->sw = malloc(n * sizeof(*p_graph->sw));
+	p_graph->lid = malloc(n * sizeof(*p_graph->lid));
+	p_graph->lmc = malloc(n * sizeof(*p_graph->lmc));
+	p_graph->link_start = malloc((n + 1) * sizeof(*p_graph->link_start));
+	p_graph->endport_start =
+	    malloc((n + 1) * sizeof(*p_graph->endport_start));
+	p_graph->lid_sw = malloc((max_lid + 1) * sizeof(*p_graph->lid_sw));
+	if (!p_graph->sw || !p_graph->lid || !p_graph->lmc ||
+	    !p_graph->link_start || !p_graph->endport_start ||
+	    !p_graph->lid_sw)
+		goto Exit_Mem_Error;
+	p_graph->max_lid = max_lid;
+	memset(p_graph->lid_sw, 0xff, (max_lid + 1) * sizeof(*p_graph->lid_sw));
+
+	/* first pass numbers the switches and counts their ports */
+	i = 0;
+	p_graph->link_start[0] = 0;
+	p_graph->endport_start[0] = 0;
+	for (p_sw = (osm_switch_t *) cl_qmap_head(p_sw_tbl);
+	     p_sw != (osm_switch_t *) cl_qmap_end(p_sw_tbl);
+	     p_sw = (osm_switch_t *) cl_qmap_next(&p_sw->map_item)) {
+		p_graph->sw[i] = p_sw;
+		p_graph->lid[i] =
+		    cl_ntoh16(osm_node_get_base_lid(p_sw->p_node, 0));
+		p_graph->lmc[i] = osm_node_get_lmc(p_sw->p_node, 0);
+		set_lid_sw(p_graph, p_graph->lid[i], p_graph->lmc[i], i);
+		p_graph->link_start[i + 1] = p_graph->link_start[i];
+		p_graph->endport_start[i + 1] = p_graph->endport_start[i];
+		for (port = 1; port < p_sw->num_ports; port++) {
+			p_remote_node =
+			    osm_node_get_remote_node(p_sw->p_node, port,
+						     &rem_port);
+			if (!p_remote_node)
+				continue;
+			if (p_remote_node->sw)
+				p_graph->link_start[i + 1]++;
+			else
+				p_graph->endport_start[i + 1]++;
+		}
+		i++;
+	}
+	p_graph->num_sw = n;
+	p_graph->num_links = p_graph->link_start[n];
+	p_graph->num_endports = p_graph->endport_start[n];
+
+	p_graph->links = malloc((p_graph->num_links ? p_graph->num_links : 1) *
+				sizeof(*p_graph->links));
+	p_graph->endports =
+	    malloc((p_graph->num_endports ? p_graph->num_endports : 1) *
+		   sizeof(*p_graph->endports));
+	if (!p_graph->links || !p_graph->endports)
+		goto Exit_Mem_Error;
+
+	link = p_graph->links;
+	endport = p_graph->endports;
+	for (i = 0; i < n; i++) {
+		p_sw = p_graph->sw[i];
+		for (port = 1; port < p_sw->num_ports; port++) {
+			p_remote_node =
+			    osm_node_get_remote_node(p_sw->p_node, port,
+						     &rem_port);
+			if (!p_remote_node)
+				continue;
+			p_physp = osm_node_get_physp_ptr(p_sw->p_node, port);
+			if (!p_remote_node->sw) {
+				endport->p_physp =
+				    osm_node_get_physp_ptr(p_remote_node,
+							   rem_port);
+				endport->lid = cl_ntoh16(osm_physp_get_base_lid
+							 (endport->p_physp));
+				endport->lmc =
+				    osm_physp_get_lmc(endport->p_physp);
+				endport->port = port;
+				endport->healthy =
+				    osm_link_is_healthy(p_physp);
+				set_lid_sw(p_graph, endport->lid,
+					   endport->lmc, i);
+				endport++;
+				continue;
+			}
+			link->sw = osm_graph_find_sw(p_graph,
+						     cl_qmap_key(&p_remote_node->
+								 sw->map_item));
+			link->port = port;
+			link->rem_port = rem_port;
+			link->healthy = osm_link_is_healthy(p_physp);
+			link->throttled =
+			    osm_link_is_throttled(p_physp, has_fdr10);
+			link++;
+		}
+	}
+
+	OSM_LOG(&p_subn->p_osm->log, OSM_LOG_VERBOSE,
+		"Switch graph has %u switches, %u links and %u end ports\n",
+		n, p_graph->num_links, p_graph->num_endports);
+	return 0;
+
+Exit_Mem_Error:
+	OSM_LOG(&p_subn->p_osm->log, OSM_LOG_ERROR, "ERR 7F01: "
+		"cannot allocate switch graph of %u switches\n", n);
+	osm_graph_destroy(p_graph);
+	return -1;
+}
@@ -81,8 +81,8 @@ static uint8_t link_mgr_get_smsl(IN osm_sm_t * sm, IN osm_physp_t * p_physp)
 	smlid = sm->p_subn->sm_base_lid;
 
 	/* Call into routing engine to find proper SL */
-	sl = re->path_sl(re->context, sm->p_subn->opt.sm_sl,
-			 slid, smlid);
+	sl = osm_routing_engine_path_sl(p_osm, re, sm->p_subn->opt.sm_sl,
+					slid, smlid);
 
 	OSM_LOG_EXIT(sm->p_log);
 	return sl;
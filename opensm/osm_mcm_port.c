@@ -60,6 +60,7 @@ osm_mcm_port_t *osm_mcm_port_new(IN osm_port_t *port, IN osm_mgrp_t *mgrp)
 		memset(p_mcm, 0, sizeof(*p_mcm));
 		p_mcm->port = port;
 		p_mcm->mgrp = mgrp;
+		cl_qlist_init(&p_mcm->alias_list);
 	}
 
 	return p_mcm;
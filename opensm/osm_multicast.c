@@ -143,7 +143,7 @@ osm_mgrp_t *osm_mgrp_new(IN osm_subn_t * subn, IN ib_net16_t mlid,
 	cl_fmap_insert(&subn->mgrp_mgid_tbl, &p_mgrp->mcmember_rec.mgid,
 		       &p_mgrp->map_item);
 
-	subn->p_osm->sa.dirty = TRUE;
+	subn->p_osm->sa.dirty |= OSM_SA_DB_DIRTY_MCAST;
 	return p_mgrp;
 }
 
@@ -183,7 +183,7 @@ void osm_mgrp_cleanup(osm_subn_t * subn, osm_mgrp_t * mgrp)
 	}
 	free(mgrp);
 
-	subn->p_osm->sa.dirty = TRUE;
+	subn->p_osm->sa.dirty |= OSM_SA_DB_DIRTY_MCAST;
 }
 
 static void mgrp_send_notice(osm_subn_t * subn, osm_log_t * log,
@@ -213,43 +213,6 @@ static void mgrp_send_notice(osm_subn_t * subn, osm_log_t * log,
 			ib_get_err_str(status));
 }
 
-static boolean_t is_qmap_empty_for_port(IN const cl_qmap_t * const p_map,
-					IN const osm_port_t *port)
-{
-	size_t count = 0;
-	cl_map_item_t *item;
-	osm_mcm_alias_guid_t *mcm_alias_guid;
-
-	for (item = cl_qmap_head(p_map); item != cl_qmap_end(p_map);
-	     item = cl_qmap_next(item)) {
-		mcm_alias_guid = (osm_mcm_alias_guid_t *) item;
-		if (mcm_alias_guid->p_base_mcm_port->port == port) {
-			count++;
-			break;
-		}
-	}
-
-	return (count == 0);
-}
-
-static boolean_t is_qmap_empty_for_mcm_port(IN const cl_qmap_t * const p_map,
-					    IN const osm_mcm_port_t *mcm_port)
-{
-	size_t count = 0;
-	cl_map_item_t *item;
-	osm_mcm_alias_guid_t *mcm_alias_guid;
-
-	for (item = cl_qmap_head(p_map); item != cl_qmap_end(p_map);
-	     item = cl_qmap_next(item)) {
-		mcm_alias_guid = (osm_mcm_alias_guid_t *) item;
-		if (mcm_alias_guid->p_base_mcm_port == mcm_port) {
-			count++;
-			break;
-		}
-	}
-
-	return (count == 0);
-}
 static osm_mcm_alias_guid_t *insert_alias_guid(IN osm_mgrp_t * mgrp,
 					       IN osm_mcm_alias_guid_t * p_mcm_alias_guid)
 {
@@ -265,6 +228,8 @@ static osm_mcm_alias_guid_t *insert_alias_guid(IN osm_mgrp_t * mgrp,
 		osm_mcm_alias_guid_delete(&p_mcm_alias_guid);
 		return p_mcm_alias_guid_check;
 	}
+	cl_qlist_insert_tail(&p_mcm_alias_guid->p_base_mcm_port->alias_list,
+			     &p_mcm_alias_guid->list_item);
 	return NULL;
 }
 
@@ -338,7 +303,7 @@ osm_mcm_port_t *osm_mgrp_add_port(IN osm_subn_t * subn, osm_log_t * log,
 	    ++mgrp->full_members == 1)
 		mgrp_send_notice(subn, log, mgrp, SM_MGID_CREATED_TRAP); /* 66 */
 
-	subn->p_osm->sa.dirty = TRUE;
+	subn->p_osm->sa.dirty |= OSM_SA_DB_DIRTY_MCAST;
 	return mcm_port;
 }
 
@@ -388,17 +353,16 @@ boolean_t osm_mgrp_remove_port(osm_subn_t * subn, osm_log_t * log, osm_mgrp_t *
 			cl_ntoh64(mcm_alias_guid->alias_guid));
 		cl_qmap_remove_item(&mgrp->mcm_alias_port_tbl,
 				    &mcm_alias_guid->map_item);
-		if (is_qmap_empty_for_port(&mgrp->mcm_alias_port_tbl,
-					   mcm_alias_guid->p_base_mcm_port->port)) { /* last alias in mcast group for this port */
+		cl_qlist_remove_item(&mcm_alias_guid->p_base_mcm_port->alias_list,
+				     &mcm_alias_guid->list_item);
+		if (cl_is_qlist_empty(&mcm_alias_guid->p_base_mcm_port->alias_list)) { /* last alias in mcast group for this port */
 			OSM_LOG(log, OSM_LOG_DEBUG, "removing port 0x%" PRIx64 "\n",
 				cl_ntoh64(mcm_alias_guid->p_base_mcm_port->port->guid));
 			cl_qmap_remove_item(&mgrp->mcm_port_tbl,
 					    &mcm_alias_guid->p_base_mcm_port->map_item);
 			cl_qlist_remove_item(&mcm_alias_guid->p_base_mcm_port->port->mcm_list,
 					     &mcm_alias_guid->p_base_mcm_port->list_item);
-			if (is_qmap_empty_for_mcm_port(&mgrp->mcm_alias_port_tbl,
-						       mcm_alias_guid->p_base_mcm_port)) /* last alias in mcast group for this mcm port */
-				osm_mcm_port_delete(mcm_alias_guid->p_base_mcm_port);
+			osm_mcm_port_delete(mcm_alias_guid->p_base_mcm_port);
 			osm_sm_reroute_mlid(&subn->p_osm->sm, mgrp->mlid);
 		}
 		osm_mcm_alias_guid_delete(&mcm_alias_guid);
@@ -415,7 +379,7 @@ boolean_t osm_mgrp_remove_port(osm_subn_t * subn, osm_log_t * log, osm_mgrp_t *
 		mgrp_deleted = TRUE;
 	}
 
-	subn->p_osm->sa.dirty = TRUE;
+	subn->p_osm->sa.dirty |= OSM_SA_DB_DIRTY_MCAST;
 
 	return (mgrp_deleted);
 }
@@ -423,20 +387,20 @@ boolean_t osm_mgrp_remove_port(osm_subn_t * subn, osm_log_t * log, osm_mgrp_t *
 void osm_mgrp_delete_port(osm_subn_t * subn, osm_log_t * log, osm_mgrp_t * mgrp,
 			  osm_port_t * port)
 {
-	osm_mcm_alias_guid_t *mcm_alias_guid, *next_mcm_alias_guid;
+	osm_mcm_port_t *mcm_port;
+	osm_mcm_alias_guid_t *mcm_alias_guid;
 	ib_member_rec_t mcmrec;
 	boolean_t mgrp_deleted = FALSE;
 
-	next_mcm_alias_guid = (osm_mcm_alias_guid_t *) cl_qmap_head(&mgrp->mcm_alias_port_tbl);
+	/* the MCM port is freed together with its last alias GUID */
 	while (!mgrp_deleted &&
-	       next_mcm_alias_guid != (osm_mcm_alias_guid_t *) cl_qmap_end(&mgrp->mcm_alias_port_tbl)) {
-		mcm_alias_guid = next_mcm_alias_guid;
-		next_mcm_alias_guid = (osm_mcm_alias_guid_t *) cl_qmap_next(&next_mcm_alias_guid->map_item);
-		if (mcm_alias_guid->p_base_mcm_port->port == port) {
-			mcmrec.scope_state = 0xf;
-			mgrp_deleted = osm_mgrp_remove_port(subn, log, mgrp, mcm_alias_guid,
-					     &mcmrec);
-		}
+	       (mcm_port = osm_mgrp_get_mcm_port(mgrp, port->guid)) &&
+	       !cl_is_qlist_empty(&mcm_port->alias_list)) {
+		mcm_alias_guid = cl_item_obj(cl_qlist_head(&mcm_port->alias_list),
+					     mcm_alias_guid, list_item);
+		mcmrec.scope_state = 0xf;
+		mgrp_deleted = osm_mgrp_remove_port(subn, log, mgrp,
+						    mcm_alias_guid, &mcmrec);
 	}
 }
 
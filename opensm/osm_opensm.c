@@ -452,6 +452,7 @@ static struct osm_routing_engine *setup_routing_engine(osm_opensm_t *osm,
 
 			re->name = m->name;
 			re->context = m->context;
+			re->exec = &osm->routing_exec;
 
 			OSM_LOG(&osm->log, OSM_LOG_VERBOSE,
 				"setup of routing engine \'%s\' ...\n", name);
@@ -563,6 +564,78 @@ void osm_routing_modules_destroy(IN osm_opensm_t *p_osm)
 	cl_list_destroy(&routing_modules);
 }
 
+static ib_api_status_t routing_exec_init(osm_routing_exec_t * p_exec)
+{
+	p_exec->num_workers = p_exec->pool ? cl_work_pool_size(p_exec->pool) :
+	    1;
+	p_exec->cancel = FALSE;
+	p_exec->scratch = calloc(p_exec->num_workers,
+				 sizeof(*p_exec->scratch));
+	if (!p_exec->scratch) {
+		p_exec->num_workers = 0;
+		return IB_INSUFFICIENT_MEMORY;
+	}
+	return IB_SUCCESS;
+}
+
+static void routing_exec_destroy(osm_routing_exec_t * p_exec)
+{
+	unsigned i;
+
+	for (i = 0; p_exec->scratch && i < p_exec->num_workers; i++)
+		free(p_exec->scratch[i].buf);
+	free(p_exec->scratch);
+	p_exec->scratch = NULL;
+	p_exec->num_workers = 0;
+	if (p_exec->pool) {
+		cl_work_pool_destroy(p_exec->pool);
+		free(p_exec->pool);
+		p_exec->pool = NULL;
+	}
+}
+
+void *osm_routing_exec_scratch(IN osm_routing_exec_t * p_exec,
+			       IN unsigned worker, IN size_t size)
+{
+	osm_routing_scratch_t *p_scratch;
+
+	CL_ASSERT(worker < p_exec->num_workers);
+	p_scratch = &p_exec->scratch[worker];
+	if (p_scratch->size < size) {
+		/* the content need not be kept, so avoid the copy of realloc */
+		free(p_scratch->buf);
+		p_scratch->buf = malloc(size);
+		p_scratch->size = p_scratch->buf ? size : 0;
+	}
+	return p_scratch->buf;
+}
+
+void osm_routing_exec_cancel(IN osm_routing_exec_t * p_exec)
+{
+	p_exec->cancel = TRUE;
+}
+
+boolean_t osm_routing_exec_cancelled(IN const osm_routing_exec_t * p_exec)
+{
+	return p_exec->cancel || osm_exit_flag;
+}
+
+uint8_t osm_routing_engine_path_sl(IN osm_opensm_t * p_osm,
+				   IN struct osm_routing_engine *p_re,
+				   IN uint8_t path_sl_hint,
+				   IN ib_net16_t slid, IN ib_net16_t dlid)
+{
+	uint8_t sl;
+
+	if (p_re->flags & OSM_ROUTING_ENGINE_PATH_SL_MT_SAFE)
+		return p_re->path_sl(p_re->context, path_sl_hint, slid, dlid);
+
+	cl_spinlock_acquire(&p_osm->path_sl_lock);
+	sl = p_re->path_sl(p_re->context, path_sl_hint, slid, dlid);
+	cl_spinlock_release(&p_osm->path_sl_lock);
+	return sl;
+}
+
 void osm_opensm_construct(IN osm_opensm_t * p_osm)
 {
 	memset(p_osm, 0, sizeof(*p_osm));
@@ -571,6 +644,7 @@ void osm_opensm_construct(IN osm_opensm_t * p_osm)
 	osm_subn_construct(&p_osm->subn);
 	osm_db_construct(&p_osm->db);
 	osm_log_construct(&p_osm->log);
+	cl_spinlock_construct(&p_osm->path_sl_lock);
 }
 
 void osm_opensm_construct_finish(IN osm_opensm_t * p_osm)
@@ -688,6 +762,8 @@ void osm_opensm_destroy_finish(IN osm_opensm_t * p_osm)
 	cl_disp_destroy(&p_osm->disp);
 	if (p_osm->sa_set_disp_initialized)
 		cl_disp_destroy(&p_osm->sa_set_disp);
+	routing_exec_destroy(&p_osm->routing_exec);
+	cl_spinlock_destroy(&p_osm->path_sl_lock);
 #ifdef HAVE_LIBPTHREAD
 	pthread_cond_destroy(&p_osm->stats.cond);
 	pthread_mutex_destroy(&p_osm->stats.mutex);
@@ -724,6 +800,7 @@ static void load_plugins(osm_opensm_t *osm, const char *plugin_names)
 ib_api_status_t osm_opensm_init(IN osm_opensm_t * p_osm,
 				IN const osm_subn_opt_t * p_opt)
 {
+	cl_work_pool_t *p_pool;
 	ib_api_status_t status;
 
 	/* Can't use log macros here, since we're initializing the log */
@@ -738,6 +815,15 @@ ib_api_status_t osm_opensm_init(IN osm_opensm_t * p_osm,
 	if (status != IB_SUCCESS)
 		return status;
 	p_osm->log.log_prefix = p_opt->log_prefix;
+	if (p_opt->log_async_entries &&
+	    osm_log_start_async(&p_osm->log, p_opt->log_async_entries) !=
+	    IB_SUCCESS)
+		fprintf(stderr, "osm_log: failed to start asynchronous "
+			"logging, logging synchronously\n");
+	if (p_opt->mad_trace_file &&
+	    osm_mad_trace_open(&p_osm->log, p_opt->mad_trace_file,
+			       p_opt->mad_trace_records) != IB_SUCCESS)
+		fprintf(stderr, "osm_log: MAD trace disabled\n");
 
 	/* If there is a log level defined - add the OSM_VERSION to it */
 	osm_log_v2(&p_osm->log,
@@ -786,6 +872,33 @@ ib_api_status_t osm_opensm_init(IN osm_opensm_t * p_osm,
 		p_osm->sa_set_disp_initialized = TRUE;
 	}
 
+	/* Routing engines compute forwarding tables on their own pool of
+	 * workers, so a long routing does not hold up the dispatcher.
+	 */
+	if (!p_opt->single_thread && p_opt->routing_threads != 1) {
+		p_pool = malloc(sizeof(*p_pool));
+		if (!p_pool) {
+			status = IB_INSUFFICIENT_MEMORY;
+			goto Exit;
+		}
+		if (cl_work_pool_init(p_pool, p_opt->routing_threads) !=
+		    CL_SUCCESS) {
+			free(p_pool);
+			status = IB_INSUFFICIENT_RESOURCES;
+			goto Exit;
+		}
+		p_osm->routing_exec.pool = p_pool;
+		OSM_LOG(&p_osm->log, OSM_LOG_VERBOSE,
+			"Using %u routing threads\n", cl_work_pool_size(p_pool));
+	}
+	status = routing_exec_init(&p_osm->routing_exec);
+	if (status != IB_SUCCESS)
+		goto Exit;
+
+	status = cl_spinlock_init(&p_osm->path_sl_lock);
+	if (status != IB_SUCCESS)
+		goto Exit;
+
 	/* the DB is in use by subn so init before */
 	status = osm_db_init(&p_osm->db, &p_osm->log);
 	if (status != IB_SUCCESS)
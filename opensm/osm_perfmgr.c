@@ -1958,6 +1958,7 @@ ib_api_status_t osm_perfmgr_init(osm_perfmgr_t * pm, osm_opensm_t * osm,
 		perfmgr_db_destroy(pm->db);
 		goto Exit;
 	}
+	cl_disp_set_prio(pm->pc_disp_h, CL_DISP_PRIO_LOW);
 
 	init_monitored_nodes(pm);
 
@@ -45,6 +45,7 @@
 #  include <config.h>
 #endif				/* HAVE_CONFIG_H */
 
+#include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
@@ -147,12 +148,20 @@ void osm_sa_shutdown(IN osm_sa_t * p_sa)
 
 void osm_sa_destroy(IN osm_sa_t * p_sa)
 {
+	int i;
+
 	OSM_LOG_ENTER(p_sa->p_log);
 
 	p_sa->state = OSM_SA_STATE_INIT;
 
 	cl_timer_destroy(&p_sa->sr_timer);
 
+	for (i = 0; i < OSM_SA_DB_SECTIONS; i++) {
+		free(p_sa->dump_buf[i]);
+		p_sa->dump_buf[i] = NULL;
+		p_sa->dump_len[i] = 0;
+	}
+
 	OSM_LOG_EXIT(p_sa->p_log);
 }
 
@@ -288,6 +297,29 @@ ib_api_status_t osm_sa_init(IN osm_sm_t * p_sm, IN osm_sa_t * p_sa,
 	if (p_sa->mft_disp_h == CL_DISP_INVALID_HANDLE)
 		goto Exit;
 
+	/*
+	 * SA queries are bulk traffic, they must not delay the SMP
+	 * responses the sweep is waiting for on the same dispatcher.
+	 */
+	{
+		cl_disp_reg_handle_t sa_disp_h[] = {
+			p_sa->cpi_disp_h, p_sa->nr_disp_h, p_sa->pir_disp_h,
+			p_sa->gir_disp_h, p_sa->lr_disp_h, p_sa->pr_disp_h,
+#if defined (VENDOR_RMPP_SUPPORT) && defined (DUAL_SIDED_RMPP)
+			p_sa->mpr_disp_h,
+#endif
+			p_sa->smir_disp_h, p_sa->mcmr_disp_h, p_sa->sr_disp_h,
+			p_sa->infr_disp_h, p_sa->infir_disp_h,
+			p_sa->vlarb_disp_h, p_sa->slvl_disp_h,
+			p_sa->pkey_disp_h, p_sa->lft_disp_h, p_sa->sir_disp_h,
+			p_sa->mft_disp_h
+		};
+		unsigned i;
+
+		for (i = 0; i < sizeof(sa_disp_h) / sizeof(sa_disp_h[0]); i++)
+			cl_disp_set_prio(sa_disp_h[i], CL_DISP_PRIO_LOW);
+	}
+
 	/*
 	 * When p_set_disp is defined, it means that we use different dispatcher
 	 * for SA Set requests, and we need to register handlers for it.
@@ -790,42 +822,138 @@ static void sa_dump_one_port_guidinfo(cl_map_item_t * p_map_item, void *cxt)
 	}
 }
 
-static void sa_dump_all_sa(osm_opensm_t * p_osm, FILE * file)
+static void sa_dump_guidinfo(osm_opensm_t * p_osm, FILE * file)
 {
 	struct opensm_dump_context dump_context;
-	osm_mgrp_t *p_mgrp;
 
 	dump_context.p_osm = p_osm;
 	dump_context.file = file;
 	OSM_LOG(&p_osm->log, OSM_LOG_DEBUG, "Dump guidinfo\n");
 	cl_qmap_apply_func(&p_osm->subn.port_guid_tbl,
 			   sa_dump_one_port_guidinfo, &dump_context);
+}
+
+static void sa_dump_mcast(osm_opensm_t * p_osm, FILE * file)
+{
+	struct opensm_dump_context dump_context;
+	osm_mgrp_t *p_mgrp;
+
+	dump_context.p_osm = p_osm;
+	dump_context.file = file;
 	OSM_LOG(&p_osm->log, OSM_LOG_DEBUG, "Dump multicast\n");
 	for (p_mgrp = (osm_mgrp_t *) cl_fmap_head(&p_osm->subn.mgrp_mgid_tbl);
 	     p_mgrp != (osm_mgrp_t *) cl_fmap_end(&p_osm->subn.mgrp_mgid_tbl);
 	     p_mgrp = (osm_mgrp_t *) cl_fmap_next(&p_mgrp->map_item))
 		sa_dump_one_mgrp(p_mgrp, &dump_context);
+}
+
+static void sa_dump_inform(osm_opensm_t * p_osm, FILE * file)
+{
+	struct opensm_dump_context dump_context;
+
+	dump_context.p_osm = p_osm;
+	dump_context.file = file;
 	OSM_LOG(&p_osm->log, OSM_LOG_DEBUG, "Dump inform\n");
 	cl_qlist_apply_func(&p_osm->subn.sa_infr_list,
 			    sa_dump_one_inform, &dump_context);
+}
+
+static void sa_dump_services(osm_opensm_t * p_osm, FILE * file)
+{
+	struct opensm_dump_context dump_context;
+
+	dump_context.p_osm = p_osm;
+	dump_context.file = file;
 	OSM_LOG(&p_osm->log, OSM_LOG_DEBUG, "Dump services\n");
 	cl_qlist_apply_func(&p_osm->subn.sa_sr_list,
 			    sa_dump_one_service, &dump_context);
 }
 
+static void (*const sa_dump_section[OSM_SA_DB_SECTIONS])
+    (osm_opensm_t * p_osm, FILE * file) = {
+	[OSM_SA_DB_GUIDINFO] = sa_dump_guidinfo,
+	[OSM_SA_DB_MCAST] = sa_dump_mcast,
+	[OSM_SA_DB_INFORM] = sa_dump_inform,
+	[OSM_SA_DB_SERVICE] = sa_dump_services,
+};
+
+/**********************************************************************
+ Render a single SA DB section into its in-memory buffer. Sections
+ which did not change since the last dump keep their previous text,
+ so large service or multicast tables are not formatted again when
+ only another section changed.
+ **********************************************************************/
+static int sa_db_render_section(osm_opensm_t * p_osm,
+				osm_sa_db_section_t section)
+{
+	char *buf = NULL;
+	size_t len = 0;
+	FILE *file;
+
+	file = open_memstream(&buf, &len);
+	if (!file) {
+		OSM_LOG(&p_osm->log, OSM_LOG_ERROR, "ERR 4C0D: "
+			"cannot open memory stream for SA DB dump: %s\n",
+			strerror(errno));
+		return -1;
+	}
+
+	sa_dump_section[section](p_osm, file);
+
+	if (fclose(file)) {
+		OSM_LOG(&p_osm->log, OSM_LOG_ERROR, "ERR 4C0E: "
+			"cannot render SA DB dump section %d: %s\n",
+			section, strerror(errno));
+		free(buf);
+		return -1;
+	}
+
+	free(p_osm->sa.dump_buf[section]);
+	p_osm->sa.dump_buf[section] = buf;
+	p_osm->sa.dump_len[section] = len;
+	return 0;
+}
+
+static void sa_dump_all_sa(osm_opensm_t * p_osm, FILE * file)
+{
+	int i;
+
+	for (i = 0; i < OSM_SA_DB_SECTIONS; i++)
+		if (p_osm->sa.dump_len[i])
+			fwrite(p_osm->sa.dump_buf[i], 1,
+			       p_osm->sa.dump_len[i], file);
+}
+
 int osm_sa_db_file_dump(osm_opensm_t * p_osm)
 {
-	int res = 1;
+	int i, res = 0;
 
 	cl_plock_acquire(&p_osm->lock);
-	if (p_osm->sa.dirty) {
-		res = opensm_dump_to_file(
-			p_osm, "opensm-sa.dump", sa_dump_all_sa);
-		if (!res)
-			p_osm->sa.dirty = FALSE;
+	if (!p_osm->sa.dirty) {
+		cl_plock_release(&p_osm->lock);
+		return 1;
 	}
+	/* GUIDInfo records also carry port LIDs and follow ports dropped
+	   by the sweep, so that section is always rendered again */
+	p_osm->sa.dirty |= OSM_SA_DB_DIRTY_GUIDINFO;
+	for (i = 0; i < OSM_SA_DB_SECTIONS && !res; i++)
+		if ((p_osm->sa.dirty & (1 << i)) || !p_osm->sa.dump_buf[i])
+			res = sa_db_render_section(p_osm, i);
+	if (!res)
+		p_osm->sa.dirty = 0;
 	cl_plock_release(&p_osm->lock);
 
+	if (res)
+		return res;
+
+	/* the sections are rendered, so the file is written unlocked */
+	res = opensm_dump_to_file(p_osm, "opensm-sa.dump", sa_dump_all_sa);
+	if (res) {
+		cl_plock_excl_acquire(&p_osm->lock);
+		p_osm->sa.dirty |= OSM_SA_DB_DIRTY_FILE;
+		cl_plock_release(&p_osm->lock);
+	}
+
 	return res;
 }
 
@@ -1369,7 +1497,7 @@ int osm_sa_db_file_load(osm_opensm_t * p_osm)
 		p_osm->subn.opt.no_clients_rereg = FALSE;
 
 	/* We've just finished loading SA DB file - clear the "dirty" flag */
-	p_osm->sa.dirty = FALSE;
+	p_osm->sa.dirty = 0;
 
 _error:
 	fclose(file);
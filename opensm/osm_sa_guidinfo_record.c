@@ -476,7 +476,7 @@ static void del_guidinfo(IN osm_sa_t *sa, IN osm_madw_t *p_madw,
 	if (dirty) {
 		if (osm_queue_guidinfo(sa, p_port, block_num))
 			osm_sm_signal(sa->sm, OSM_SIGNAL_GUID_PROCESS_REQUEST);
-		sa->dirty = TRUE;
+		sa->dirty |= OSM_SA_DB_DIRTY_GUIDINFO;
 	}
 
 	memcpy(&p_rcvd_rec->guid_info,
@@ -705,7 +705,7 @@ add_alias_guid:
 	if (dirty) {
 		if (osm_queue_guidinfo(sa, p_port, block_num))
 			osm_sm_signal(sa->sm, OSM_SIGNAL_GUID_PROCESS_REQUEST);
-		sa->dirty = TRUE;
+		sa->dirty |= OSM_SA_DB_DIRTY_GUIDINFO;
 	}
 
 	memcpy(&p_rcvd_rec->guid_info,
@@ -1627,6 +1627,9 @@ static void mcmr_query_mgrp(IN osm_sa_t * sa, IN osm_madw_t * p_madw)
 	osm_physp_t *p_req_physp;
 	boolean_t trusted_req;
 	osm_mgrp_t *p_mgrp;
+	osm_port_t *p_port = NULL;
+	osm_mcm_port_t *p_mcm_port;
+	cl_list_item_t *p_list_item;
 
 	OSM_LOG_ENTER(sa->p_log);
 
@@ -1663,12 +1666,36 @@ static void mcmr_query_mgrp(IN osm_sa_t * sa, IN osm_madw_t * p_madw)
 
 	cl_qlist_init(&rec_list);
 
-	/* simply go over all MCGs and match */
-	for (p_mgrp = (osm_mgrp_t *) cl_fmap_head(&sa->p_subn->mgrp_mgid_tbl);
-	     p_mgrp != (osm_mgrp_t *) cl_fmap_end(&sa->p_subn->mgrp_mgid_tbl);
-	     p_mgrp = (osm_mgrp_t *) cl_fmap_next(&p_mgrp->map_item))
-		mcmr_by_comp_mask(sa, p_rcvd_rec, comp_mask, p_mgrp,
-				  p_req_physp, trusted_req, &rec_list);
+	if (comp_mask & IB_MCR_COMPMASK_PORT_GID)
+		p_port = osm_get_port_by_alias_guid(sa->p_subn,
+						    p_rcvd_rec->port_gid.unicast.interface_id);
+
+	if (comp_mask & IB_MCR_COMPMASK_MGID) {
+		/* at most one MCG can match - look it up directly */
+		p_mgrp = osm_get_mgrp_by_mgid(sa->p_subn,
+					      (ib_gid_t *) &p_rcvd_rec->mgid);
+		if (p_mgrp)
+			mcmr_by_comp_mask(sa, p_rcvd_rec, comp_mask, p_mgrp,
+					  p_req_physp, trusted_req, &rec_list);
+	} else if (p_port) {
+		/* only the MCGs the port is member of can match */
+		for (p_list_item = cl_qlist_head(&p_port->mcm_list);
+		     p_list_item != cl_qlist_end(&p_port->mcm_list);
+		     p_list_item = cl_qlist_next(p_list_item)) {
+			p_mcm_port = cl_item_obj(p_list_item, p_mcm_port,
+						 list_item);
+			mcmr_by_comp_mask(sa, p_rcvd_rec, comp_mask,
+					  p_mcm_port->mgrp, p_req_physp,
+					  trusted_req, &rec_list);
+		}
+	} else {
+		/* simply go over all MCGs and match */
+		for (p_mgrp = (osm_mgrp_t *) cl_fmap_head(&sa->p_subn->mgrp_mgid_tbl);
+		     p_mgrp != (osm_mgrp_t *) cl_fmap_end(&sa->p_subn->mgrp_mgid_tbl);
+		     p_mgrp = (osm_mgrp_t *) cl_fmap_next(&p_mgrp->map_item))
+			mcmr_by_comp_mask(sa, p_rcvd_rec, comp_mask, p_mgrp,
+					  p_req_physp, trusted_req, &rec_list);
+	}
 
 	CL_PLOCK_RELEASE(sa->p_lock);
 
@@ -811,8 +811,9 @@ static ib_api_status_t pr_rcv_get_path_parms(IN osm_sa_t * sa,
 		uint8_t pr_sl;
 		pr_sl = sl;
 
-		sl = p_re->path_sl(p_re->context, sl,
-				   cl_hton16(src_lid_ho), cl_hton16(dest_lid_ho));
+		sl = osm_routing_engine_path_sl(p_osm, p_re, sl,
+						cl_hton16(src_lid_ho),
+						cl_hton16(dest_lid_ho));
 
 		if ((comp_mask & IB_PR_COMPMASK_SL) && (sl != pr_sl)) {
 			OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F2A: "
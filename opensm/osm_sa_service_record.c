@@ -565,8 +565,10 @@ static void sr_rcv_process_set_method(osm_sa_t * sa, IN osm_madw_t * p_madw)
 		/* Add this new osm_svcr_t object to subnet object */
 		osm_svcr_insert_to_db(sa->p_subn, sa->p_log, p_svcr);
 
-	} else			/* Update the old instance of the osm_svcr_t object */
+	} else {		/* Update the old instance of the osm_svcr_t object */
 		osm_svcr_init(p_svcr, p_recvd_service_rec);
+		sa->dirty |= OSM_SA_DB_DIRTY_SERVICE;
+	}
 
 	cl_plock_release(sa->p_lock);
 
@@ -125,7 +125,7 @@ void osm_svcr_insert_to_db(IN osm_subn_t * p_subn, IN osm_log_t * p_log,
 		"Inserting new Service Record into Database\n");
 
 	cl_qlist_insert_head(&p_subn->sa_sr_list, &p_svcr->list_item);
-	p_subn->p_osm->sa.dirty = TRUE;
+	p_subn->p_osm->sa.dirty |= OSM_SA_DB_DIRTY_SERVICE;
 
 	OSM_LOG_EXIT(p_log);
 }
@@ -141,7 +141,7 @@ void osm_svcr_remove_from_db(IN osm_subn_t * p_subn, IN osm_log_t * p_log,
 		cl_ntoh64(p_svcr->service_record.service_id));
 
 	cl_qlist_remove_item(&p_subn->sa_sr_list, &p_svcr->list_item);
-	p_subn->p_osm->sa.dirty = TRUE;
+	p_subn->p_osm->sa.dirty |= OSM_SA_DB_DIRTY_SERVICE;
 
 	OSM_LOG_EXIT(p_log);
 }
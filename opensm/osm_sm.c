@@ -145,6 +145,13 @@ static void sm_sweep(void *arg)
 	cl_timer_start(&sm->sweep_timer, sm->p_subn->opt.sweep_interval * 1000);
 }
 
+static void sm_mcast_batch(void *arg)
+{
+	osm_sm_t *sm = arg;
+
+	osm_sm_signal(sm, OSM_SIGNAL_IDLE_TIME_PROCESS_REQUEST);
+}
+
 static void sweep_fail_process(IN void *context, IN void *p_data)
 {
 	osm_sm_t *sm = context;
@@ -161,6 +168,7 @@ void osm_sm_construct(IN osm_sm_t * p_sm)
 	cl_spinlock_construct(&p_sm->signal_lock);
 	cl_spinlock_construct(&p_sm->state_lock);
 	cl_timer_construct(&p_sm->polling_timer);
+	cl_timer_construct(&p_sm->mcast_batch_timer);
 	cl_event_construct(&p_sm->signal_event);
 	cl_event_construct(&p_sm->subnet_up_event);
 	cl_event_wheel_construct(&p_sm->trap_aging_tracker);
@@ -193,6 +201,7 @@ void osm_sm_shutdown(IN osm_sm_t * p_sm)
 
 	cl_timer_stop(&p_sm->polling_timer);
 	cl_timer_stop(&p_sm->sweep_timer);
+	cl_timer_stop(&p_sm->mcast_batch_timer);
 	cl_thread_destroy(&p_sm->sweeper);
 
 	/*
@@ -227,6 +236,7 @@ void osm_sm_destroy(IN osm_sm_t * p_sm)
 	cl_event_wheel_destroy(&p_sm->trap_aging_tracker);
 	cl_timer_destroy(&p_sm->sweep_timer);
 	cl_timer_destroy(&p_sm->polling_timer);
+	cl_timer_destroy(&p_sm->mcast_batch_timer);
 	cl_event_destroy(&p_sm->signal_event);
 	cl_event_destroy(&p_sm->subnet_up_event);
 	cl_spinlock_destroy(&p_sm->signal_lock);
@@ -282,6 +292,10 @@ ib_api_status_t osm_sm_init(IN osm_sm_t * p_sm, IN osm_subn_t * p_subn,
 	if (status != CL_SUCCESS)
 		goto Exit;
 
+	status = cl_timer_init(&p_sm->mcast_batch_timer, sm_mcast_batch, p_sm);
+	if (status != CL_SUCCESS)
+		goto Exit;
+
 	p_sm->mlids_req_max = 0;
 	p_sm->mlids_req = malloc((IB_LID_MCAST_END_HO - IB_LID_MCAST_START_HO +
 				  1) * sizeof(p_sm->mlids_req[0]));
@@ -383,6 +397,25 @@ ib_api_status_t osm_sm_init(IN osm_sm_t * p_sm, IN osm_subn_t * p_subn,
 	if (p_sm->mlnx_epi_disp_h == CL_DISP_INVALID_HANDLE)
 		goto Exit;
 
+	/*
+	 * SMP responses the sweep is waiting for and traps are scheduled
+	 * ahead of SA queries sharing the dispatcher.
+	 */
+	{
+		cl_disp_reg_handle_t sm_disp_h[] = {
+			p_sm->sweep_fail_disp_h, p_sm->ni_disp_h,
+			p_sm->pi_disp_h, p_sm->gi_disp_h, p_sm->si_disp_h,
+			p_sm->nd_disp_h, p_sm->lft_disp_h, p_sm->mft_disp_h,
+			p_sm->sm_info_disp_h, p_sm->trap_disp_h,
+			p_sm->slvl_disp_h, p_sm->vla_disp_h,
+			p_sm->pkey_disp_h, p_sm->mlnx_epi_disp_h
+		};
+		unsigned i;
+
+		for (i = 0; i < sizeof(sm_disp_h) / sizeof(sm_disp_h[0]); i++)
+			cl_disp_set_prio(sm_disp_h[i], CL_DISP_PRIO_HIGH);
+	}
+
 	p_subn->sm_state = p_subn->opt.sm_inactive ?
 	    IB_SMINFO_STATE_NOTACTIVE : IB_SMINFO_STATE_DISCOVERING;
 	osm_report_sm_state(p_sm);
@@ -447,7 +480,16 @@ void osm_sm_reroute_mlid(osm_sm_t * sm, ib_net16_t mlid)
 	sm->mlids_req[mlid] = 1;
 	if (sm->mlids_req_max < mlid)
 		sm->mlids_req_max = mlid;
-	osm_sm_signal(sm, OSM_SIGNAL_IDLE_TIME_PROCESS_REQUEST);
+	/*
+	 * With a batch window, let joins and leaves arriving within the
+	 * window share a single multicast tree recomputation and MFT update.
+	 * The timer is only armed by the first request of a batch.
+	 */
+	if (sm->p_subn->opt.mcast_join_batch_window)
+		cl_timer_trim(&sm->mcast_batch_timer,
+			      sm->p_subn->opt.mcast_join_batch_window);
+	else
+		osm_sm_signal(sm, OSM_SIGNAL_IDLE_TIME_PROCESS_REQUEST);
 	OSM_LOG(sm->p_log, OSM_LOG_DEBUG, "rerouting requested for MLID 0x%x\n",
 		mlid + IB_LID_MCAST_START_HO);
 }
@@ -322,6 +322,7 @@ ib_api_status_t osm_sm_state_mgr_process(osm_sm_t * sm,
 			 */
 			CL_PLOCK_EXCL_ACQUIRE(sm->p_lock);
 			sm->p_subn->ignore_existing_lfts = FALSE;
+			osm_ucast_mgr_lft_snapshot_drop(&sm->ucast_mgr);
 			CL_PLOCK_RELEASE(sm->p_lock);
 			sm_state_mgr_start_polling(sm);
 			break;
@@ -356,6 +357,8 @@ ib_api_status_t osm_sm_state_mgr_process(osm_sm_t * sm,
 			osm_report_sm_state(sm);
 			CL_PLOCK_EXCL_ACQUIRE(sm->p_lock);
 			sm->p_subn->coming_out_of_standby = TRUE;
+			/* the LFT snapshot of this master may be restored */
+			sm->ucast_mgr.lft_snapshot_master = sm->master_sm_guid;
 			CL_PLOCK_RELEASE(sm->p_lock);
 			osm_sm_signal(sm, OSM_SIGNAL_SWEEP);
 			break;
@@ -365,6 +368,9 @@ ib_api_status_t osm_sm_state_mgr_process(osm_sm_t * sm,
 			 */
 			sm->p_subn->sm_state = IB_SMINFO_STATE_NOTACTIVE;
 			osm_report_sm_state(sm);
+			CL_PLOCK_EXCL_ACQUIRE(sm->p_lock);
+			osm_ucast_mgr_lft_snapshot_drop(&sm->ucast_mgr);
+			CL_PLOCK_RELEASE(sm->p_lock);
 			break;
 		case OSM_SM_SIGNAL_HANDOVER:
 			/*
@@ -462,6 +468,9 @@ ib_api_status_t osm_sm_state_mgr_process(osm_sm_t * sm,
 			 */
 			sm->p_subn->sm_state = IB_SMINFO_STATE_STANDBY;
 			osm_report_sm_state(sm);
+			CL_PLOCK_EXCL_ACQUIRE(sm->p_lock);
+			osm_ucast_mgr_lft_snapshot_drop(&sm->ucast_mgr);
+			CL_PLOCK_RELEASE(sm->p_lock);
 			sm_state_mgr_start_polling(sm);
 			break;
 		case OSM_SM_SIGNAL_WAIT_FOR_HANDOVER:
@@ -471,12 +480,19 @@ ib_api_status_t osm_sm_state_mgr_process(osm_sm_t * sm,
 			 * polling that SM, to make sure it is alive, if it
 			 * isn't - then we should move back to discovering,
 			 * since something must have happened to it.
+			 * The remote master may change the LFTs meanwhile.
 			 */
+			CL_PLOCK_EXCL_ACQUIRE(sm->p_lock);
+			osm_ucast_mgr_lft_snapshot_drop(&sm->ucast_mgr);
+			CL_PLOCK_RELEASE(sm->p_lock);
 			sm_state_mgr_start_polling(sm);
 			break;
 		case OSM_SM_SIGNAL_DISCOVER:
 			sm->p_subn->sm_state = IB_SMINFO_STATE_DISCOVERING;
 			osm_report_sm_state(sm);
+			CL_PLOCK_EXCL_ACQUIRE(sm->p_lock);
+			osm_ucast_mgr_lft_snapshot_drop(&sm->ucast_mgr);
+			CL_PLOCK_RELEASE(sm->p_lock);
 			break;
 		default:
 			sm_state_mgr_signal_error(sm, signal);
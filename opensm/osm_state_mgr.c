@@ -384,7 +384,7 @@ static ib_api_status_t state_mgr_sa_clean(IN osm_sm_t * sm)
 		}
 	}
 
-	p_subn->p_osm->sa.dirty = TRUE;
+	p_subn->p_osm->sa.dirty |= OSM_SA_DB_DIRTY_ALL;
 
 	CL_PLOCK_RELEASE(sm->p_lock);
 	OSM_LOG_EXIT(sm->p_log);
@@ -1379,6 +1379,8 @@ static void do_sweep(osm_sm_t * sm)
 		if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
 			return;
 
+		osm_ucast_mgr_lft_snapshot_dump(&sm->ucast_mgr);
+
 		osm_congestion_control_setup(sm->p_subn->p_osm);
 
 		if (osm_congestion_control_wait_pending_transactions(sm->p_subn->p_osm))
@@ -1400,7 +1402,9 @@ static void do_sweep(osm_sm_t * sm)
 	/* go to heavy sweep */
 repeat_discovery:
 
-	/* First of all - unset all flags */
+	/* First of all - unset all flags; this sweep serves the heavy
+	   sweep requests made so far, so they need not cancel its routing */
+	sm->p_subn->p_osm->routing_exec.cancel = FALSE;
 	sm->p_subn->force_heavy_sweep = FALSE;
 	sm->p_subn->force_reroute = FALSE;
 	sm->p_subn->subnet_initialization_error = FALSE;
@@ -1597,6 +1601,8 @@ repeat_discovery:
 	 * take into account these lfts. */
 	sm->p_subn->ignore_existing_lfts = FALSE;
 
+	osm_ucast_mgr_lft_snapshot_dump(&sm->ucast_mgr);
+
 	OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE,
 			"SWITCHES CONFIGURED FOR UNICAST");
 	osm_opensm_report_event(sm->p_subn->p_osm,
@@ -188,9 +188,10 @@ static const char *module_name_str[] = {
 	"osm_ucast_dfsssp.c",
 	"osm_congestion_control.c",
 	"osm_ucast_nue.c",
+	"osm_graph.c",
 	/* Add new module names here ... */
 	/* FILE_ID define in those modules must be identical to index here */
-	/* last FILE_ID is currently 90 */
+	/* last FILE_ID is currently 91 */
 };
 
 #define MOD_NAME_STR_UNKNOWN_VAL (ARR_SIZE(module_name_str))
@@ -778,6 +779,7 @@ static const opt_rec_t opt_tbl[] = {
 	{ "transaction_retries", OPT_OFFSET(transaction_retries), opts_parse_uint32, NULL, 0 },
 	{ "long_transaction_timeout", OPT_OFFSET(long_transaction_timeout), opts_parse_uint32, NULL, 0 },
 	{ "max_msg_fifo_timeout", OPT_OFFSET(max_msg_fifo_timeout), opts_parse_uint32, NULL, 1 },
+	{ "mcast_join_batch_window", OPT_OFFSET(mcast_join_batch_window), opts_parse_uint32, NULL, 1 },
 	{ "sm_priority", OPT_OFFSET(sm_priority), opts_parse_uint8, opts_setup_sm_priority, 1 },
 	{ "lmc", OPT_OFFSET(lmc), opts_parse_uint8, NULL, 0 },
 	{ "lmc_esp0", OPT_OFFSET(lmc_esp0), opts_parse_boolean, NULL, 0 },
@@ -789,6 +791,7 @@ static const opt_rec_t opt_tbl[] = {
 	{ "reassign_lids", OPT_OFFSET(reassign_lids), opts_parse_boolean, NULL, 1 },
 	{ "ignore_other_sm", OPT_OFFSET(ignore_other_sm), opts_parse_boolean, NULL, 1 },
 	{ "single_thread", OPT_OFFSET(single_thread), opts_parse_boolean, NULL, 0 },
+	{ "routing_threads", OPT_OFFSET(routing_threads), opts_parse_uint32, NULL, 0 },
 	{ "disable_multicast", OPT_OFFSET(disable_multicast), opts_parse_boolean, NULL, 1 },
 	{ "subnet_timeout", OPT_OFFSET(subnet_timeout), opts_parse_uint8, NULL, 1 },
 	{ "packet_life_time", OPT_OFFSET(packet_life_time), opts_parse_uint8, NULL, 1 },
@@ -814,6 +817,9 @@ static const opt_rec_t opt_tbl[] = {
 	{ "use_ucast_cache", OPT_OFFSET(use_ucast_cache), opts_parse_boolean, NULL, 0 },
 	{ "log_file", OPT_OFFSET(log_file), opts_parse_charp, NULL, 0 },
 	{ "log_max_size", OPT_OFFSET(log_max_size), opts_parse_uint32, opts_setup_log_max_size, 1 },
+	{ "log_async_entries", OPT_OFFSET(log_async_entries), opts_parse_uint32, NULL, 0 },
+	{ "mad_trace_file", OPT_OFFSET(mad_trace_file), opts_parse_charp, NULL, 0 },
+	{ "mad_trace_records", OPT_OFFSET(mad_trace_records), opts_parse_uint32, NULL, 0 },
 	{ "log_flags", OPT_OFFSET(log_flags), opts_parse_uint8, opts_setup_log_flags, 1 },
 	{ "force_log_flush", OPT_OFFSET(force_log_flush), opts_parse_boolean, opts_setup_force_log_flush, 1 },
 	{ "accum_log_file", OPT_OFFSET(accum_log_file), opts_parse_boolean, opts_setup_accum_log_file, 1 },
@@ -840,6 +846,7 @@ static const opt_rec_t opt_tbl[] = {
 	{ "guid_routing_order_no_scatter", OPT_OFFSET(guid_routing_order_no_scatter), opts_parse_boolean, NULL, 0 },
 	{ "sa_db_file", OPT_OFFSET(sa_db_file), opts_parse_charp, NULL, 0 },
 	{ "sa_db_dump", OPT_OFFSET(sa_db_dump), opts_parse_boolean, NULL, 1 },
+	{ "lft_snapshot_file", OPT_OFFSET(lft_snapshot_file), opts_parse_charp, NULL, 0 },
 	{ "torus_config", OPT_OFFSET(torus_conf_file), opts_parse_charp, NULL, 1 },
 	{ "do_mesh_analysis", OPT_OFFSET(do_mesh_analysis), opts_parse_boolean, NULL, 1 },
 	{ "exit_on_fatal", OPT_OFFSET(exit_on_fatal), opts_parse_boolean, NULL, 1 },
@@ -1072,6 +1079,10 @@ void osm_subn_construct(IN osm_subn_t * p_subn)
 	cl_qmap_init(&p_subn->node_guid_tbl);
 	cl_qmap_init(&p_subn->port_guid_tbl);
 	cl_qmap_init(&p_subn->alias_port_guid_tbl);
+	cl_hmap_construct(&p_subn->sw_guid_idx);
+	cl_hmap_construct(&p_subn->node_guid_idx);
+	cl_hmap_construct(&p_subn->port_guid_idx);
+	cl_hmap_construct(&p_subn->alias_port_guid_idx);
 	cl_qmap_init(&p_subn->assigned_guids_tbl);
 	cl_qmap_init(&p_subn->sm_guid_tbl);
 	cl_qlist_init(&p_subn->sa_sr_list);
@@ -1110,6 +1121,7 @@ static void subn_opt_destroy(IN osm_subn_opt_t * p_opt)
 	free(p_opt->ids_guid_file);
 	free(p_opt->guid_routing_order_file);
 	free(p_opt->sa_db_file);
+	free(p_opt->lft_snapshot_file);
 	free(p_opt->torus_conf_file);
 #ifdef ENABLE_OSM_PERF_MGR
 	free(p_opt->event_db_dump_file);
@@ -1120,6 +1132,7 @@ static void subn_opt_destroy(IN osm_subn_opt_t * p_opt)
 	free(p_opt->prefix_routes_file);
 	free(p_opt->log_prefix);
 	free(p_opt->per_module_logging_file);
+	free(p_opt->mad_trace_file);
 	subn_destroy_qos_options(&p_opt->qos_options);
 	subn_destroy_qos_options(&p_opt->qos_ca_options);
 	subn_destroy_qos_options(&p_opt->qos_sw0_options);
@@ -1225,6 +1238,15 @@ void osm_subn_destroy(IN osm_subn_t * p_subn)
 
 	cl_ptr_vector_destroy(&p_subn->port_lid_tbl);
 
+	cl_qmap_set_index(&p_subn->sw_guid_tbl, NULL);
+	cl_qmap_set_index(&p_subn->node_guid_tbl, NULL);
+	cl_qmap_set_index(&p_subn->port_guid_tbl, NULL);
+	cl_qmap_set_index(&p_subn->alias_port_guid_tbl, NULL);
+	cl_hmap_destroy(&p_subn->sw_guid_idx);
+	cl_hmap_destroy(&p_subn->node_guid_idx);
+	cl_hmap_destroy(&p_subn->port_guid_idx);
+	cl_hmap_destroy(&p_subn->alias_port_guid_idx);
+
 	osm_qos_policy_destroy(p_subn->p_qos_policy);
 
 	while (!cl_is_qlist_empty(&p_subn->prefix_routes_list)) {
@@ -1236,6 +1258,17 @@ void osm_subn_destroy(IN osm_subn_t * p_subn)
 	free(p_subn->opt.file_opts);
 }
 
+static cl_status_t subn_init_guid_idx(IN cl_qmap_t * p_tbl,
+				      IN cl_hmap_t * p_idx)
+{
+	cl_status_t status;
+
+	status = cl_hmap_init(p_idx, 0);
+	if (status != CL_SUCCESS)
+		return status;
+	return cl_qmap_set_index(p_tbl, p_idx);
+}
+
 ib_api_status_t osm_subn_init(IN osm_subn_t * p_subn, IN osm_opensm_t * p_osm,
 			      IN const osm_subn_opt_t * p_opt)
 {
@@ -1260,6 +1293,20 @@ ib_api_status_t osm_subn_init(IN osm_subn_t * p_subn, IN osm_opensm_t * p_osm,
 	 */
 	cl_ptr_vector_set(&p_subn->port_lid_tbl, 0, NULL);
 
+	/* GUID lookups are done per received MAD, hash the GUID tables */
+	status = subn_init_guid_idx(&p_subn->sw_guid_tbl, &p_subn->sw_guid_idx);
+	if (status == CL_SUCCESS)
+		status = subn_init_guid_idx(&p_subn->node_guid_tbl,
+					    &p_subn->node_guid_idx);
+	if (status == CL_SUCCESS)
+		status = subn_init_guid_idx(&p_subn->port_guid_tbl,
+					    &p_subn->port_guid_idx);
+	if (status == CL_SUCCESS)
+		status = subn_init_guid_idx(&p_subn->alias_port_guid_tbl,
+					    &p_subn->alias_port_guid_idx);
+	if (status != CL_SUCCESS)
+		return status;
+
 	p_subn->opt = *p_opt;
 	p_subn->max_ucast_lid_ho = IB_LID_UCAST_END_HO;
 	p_subn->max_mcast_lid_ho = IB_LID_MCAST_END_HO;
@@ -1567,6 +1614,7 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 				  p_opt->transaction_retries;
 	/* by default we will consider waiting for 50x transaction timeout normal */
 	p_opt->max_msg_fifo_timeout = 50 * OSM_DEFAULT_TRANS_TIMEOUT_MILLISEC;
+	p_opt->mcast_join_batch_window = 0;
 	p_opt->sm_priority = OSM_DEFAULT_SM_PRIORITY;
 	p_opt->lmc = OSM_DEFAULT_LMC;
 	p_opt->lmc_esp0 = FALSE;
@@ -1578,6 +1626,7 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 	p_opt->reassign_lids = FALSE;
 	p_opt->ignore_other_sm = FALSE;
 	p_opt->single_thread = FALSE;
+	p_opt->routing_threads = 0;
 	p_opt->disable_multicast = FALSE;
 	p_opt->force_log_flush = FALSE;
 	p_opt->subnet_timeout = OSM_DEFAULT_SUBNET_TIMEOUT;
@@ -1631,6 +1680,9 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 		p_opt->dump_files_dir = strdup(p_opt->dump_files_dir);
 	p_opt->log_file = strdup(OSM_DEFAULT_LOG_FILE);
 	p_opt->log_max_size = 0;
+	p_opt->log_async_entries = 0;
+	p_opt->mad_trace_file = NULL;
+	p_opt->mad_trace_records = OSM_DEFAULT_MAD_TRACE_RECORDS;
 	p_opt->partition_config_file = strdup(OSM_DEFAULT_PARTITION_CONFIG_FILE);
 	p_opt->no_partition_enforcement = FALSE;
 	p_opt->part_enforce = strdup(OSM_PARTITION_ENFORCE_BOTH);
@@ -1663,6 +1715,7 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 	p_opt->guid_routing_order_no_scatter = FALSE;
 	p_opt->sa_db_file = NULL;
 	p_opt->sa_db_dump = FALSE;
+	p_opt->lft_snapshot_file = NULL;
 	p_opt->torus_conf_file = strdup(OSM_DEFAULT_TORUS_CONF_FILE);
 	p_opt->do_mesh_analysis = FALSE;
 	p_opt->exit_on_fatal = TRUE;
@@ -2741,6 +2794,13 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"sa_db_dump %s\n\n",
 		p_opts->sa_db_dump ? "TRUE" : "FALSE");
 
+	fprintf(out,
+		"# LFT snapshot file name. A standby SM taking over from\n"
+		"# a failed master restores LFTs from it, so the file must\n"
+		"# be on storage shared by all the SMs of the subnet\n"
+		"lft_snapshot_file %s\n\n",
+		p_opts->lft_snapshot_file ? p_opts->lft_snapshot_file : null_str);
+
 	fprintf(out,
 		"# Torus-2QoS configuration file name\ntorus_config %s\n\n",
 		p_opts->torus_conf_file ? p_opts->torus_conf_file : null_str);
@@ -2787,8 +2847,15 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"# stayed in the queue more than this value, any SA request will be\n"
 		"# immediately be dropped but BUSY status is not currently returned.\n"
 		"max_msg_fifo_timeout %u\n\n"
+		"# Time in [msec] to collect multicast join/leave rerouting requests\n"
+		"# before recomputing the multicast trees and sending the MFTs.\n"
+		"# 0 (the default) reroutes on every request.\n"
+		"mcast_join_batch_window %u\n\n"
 		"# Use a single thread for handling SA queries\n"
-		"single_thread %s\n\n",
+		"single_thread %s\n\n"
+		"# Number of threads used to compute forwarding tables\n"
+		"# (0 = one per CPU, 1 = compute them in the sweeping thread)\n"
+		"routing_threads %u\n\n",
 		p_opts->max_wire_smps,
 		p_opts->max_wire_smps2,
 		p_opts->max_smps_timeout,
@@ -2796,7 +2863,9 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		p_opts->transaction_retries,
 		p_opts->long_transaction_timeout,
 		p_opts->max_msg_fifo_timeout,
-		p_opts->single_thread ? "TRUE" : "FALSE");
+		p_opts->mcast_join_batch_window,
+		p_opts->single_thread ? "TRUE" : "FALSE",
+		p_opts->routing_threads);
 
 	fprintf(out,
 		"#\n# MISC OPTIONS\n#\n"
@@ -2920,6 +2989,14 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"log_file %s\n\n"
 		"# Limit the size of the log file in MB. If overrun, log is restarted\n"
 		"log_max_size %u\n\n"
+		"# Number of log messages queued for the asynchronous log writer\n"
+		"# thread (0 logs synchronously)\n"
+		"log_async_entries %u\n\n"
+		"# Binary trace of MAD sends, receives and timeouts\n"
+		"# (decode with osmtrace)\n"
+		"mad_trace_file %s\n\n"
+		"# Number of records kept in the MAD trace ring\n"
+		"mad_trace_records %u\n\n"
 		"# If TRUE will accumulate the log over multiple OpenSM sessions\n"
 		"accum_log_file %s\n\n"
 		"# Per module logging configuration file\n"
@@ -2954,6 +3031,9 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		p_opts->force_log_flush ? "TRUE" : "FALSE",
 		p_opts->log_file,
 		p_opts->log_max_size,
+		p_opts->log_async_entries,
+		p_opts->mad_trace_file ? p_opts->mad_trace_file : null_str,
+		p_opts->mad_trace_records,
 		p_opts->accum_log_file ? "TRUE" : "FALSE",
 		p_opts->per_module_logging_file ?
 			p_opts->per_module_logging_file : null_str,
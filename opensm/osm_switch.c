@@ -53,6 +53,12 @@
 #define FILE_ID OSM_FILE_SWITCH_C
 #include <opensm/osm_switch.h>
 
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define OSM_LFT_DIFF_X86
+#include <immintrin.h>
+#endif
+
 struct switch_port_path {
 	uint8_t port_num;
 	uint32_t path_count;
@@ -173,6 +179,104 @@ boolean_t osm_switch_get_lft_block(IN const osm_switch_t * p_sw,
 	return TRUE;
 }
 
+typedef unsigned (*lft_diff_fn_t) (const uint8_t *, const uint8_t *,
+				   unsigned, uint16_t *);
+
+static unsigned lft_diff_scalar(IN const uint8_t * lft1,
+				IN const uint8_t * lft2, IN unsigned num_blocks,
+				OUT uint16_t * blocks)
+{
+	uint64_t w1, w2, diff;
+	unsigned b, i, n = 0;
+
+	for (b = 0; b < num_blocks; b++) {
+		diff = 0;
+		for (i = 0; i < IB_SMP_DATA_SIZE; i += sizeof(w1)) {
+			memcpy(&w1, lft1 + i, sizeof(w1));
+			memcpy(&w2, lft2 + i, sizeof(w2));
+			diff |= w1 ^ w2;
+		}
+		if (diff)
+			blocks[n++] = b;
+		lft1 += IB_SMP_DATA_SIZE;
+		lft2 += IB_SMP_DATA_SIZE;
+	}
+
+	return n;
+}
+
+#ifdef OSM_LFT_DIFF_X86
+__attribute__ ((target("sse2")))
+static unsigned lft_diff_sse2(IN const uint8_t * lft1, IN const uint8_t * lft2,
+			      IN unsigned num_blocks, OUT uint16_t * blocks)
+{
+	__m128i eq;
+	unsigned b, i, n = 0;
+
+	for (b = 0; b < num_blocks; b++) {
+		eq = _mm_set1_epi8(-1);
+		for (i = 0; i < IB_SMP_DATA_SIZE; i += sizeof(eq))
+			eq = _mm_and_si128(eq, _mm_cmpeq_epi8(
+				_mm_loadu_si128((const __m128i *)(lft1 + i)),
+				_mm_loadu_si128((const __m128i *)(lft2 + i))));
+		if (_mm_movemask_epi8(eq) != 0xffff)
+			blocks[n++] = b;
+		lft1 += IB_SMP_DATA_SIZE;
+		lft2 += IB_SMP_DATA_SIZE;
+	}
+
+	return n;
+}
+
+__attribute__ ((target("avx2")))
+static unsigned lft_diff_avx2(IN const uint8_t * lft1, IN const uint8_t * lft2,
+			      IN unsigned num_blocks, OUT uint16_t * blocks)
+{
+	__m256i eq;
+	unsigned b, n = 0;
+
+	/* an LFT block is two AVX2 vectors */
+	for (b = 0; b < num_blocks; b++) {
+		eq = _mm256_and_si256(_mm256_cmpeq_epi8(
+			_mm256_loadu_si256((const __m256i *)lft1),
+			_mm256_loadu_si256((const __m256i *)lft2)),
+				      _mm256_cmpeq_epi8(
+			_mm256_loadu_si256((const __m256i *)(lft1 + 32)),
+			_mm256_loadu_si256((const __m256i *)(lft2 + 32))));
+		if (_mm256_movemask_epi8(eq) != -1)
+			blocks[n++] = b;
+		lft1 += IB_SMP_DATA_SIZE;
+		lft2 += IB_SMP_DATA_SIZE;
+	}
+
+	return n;
+}
+#endif
+
+static lft_diff_fn_t lft_diff_select(void)
+{
+#ifdef OSM_LFT_DIFF_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return lft_diff_avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return lft_diff_sse2;
+#endif
+	return lft_diff_scalar;
+}
+
+unsigned osm_lft_diff_blocks(IN const uint8_t * lft1, IN const uint8_t * lft2,
+			     IN unsigned num_blocks, OUT uint16_t * blocks)
+{
+	/* every thread selects the same kernel, so racing here is harmless */
+	static lft_diff_fn_t lft_diff;
+
+	if (!lft_diff)
+		lft_diff = lft_diff_select();
+
+	return lft_diff(lft1, lft2, num_blocks, blocks);
+}
+
 static struct osm_remote_node *
 switch_find_guid_common(IN const osm_switch_t * p_sw,
 			IN struct osm_remote_guids_count *r,
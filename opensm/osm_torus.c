@@ -54,6 +54,7 @@
 #include <opensm/osm_switch.h>
 #include <opensm/osm_node.h>
 #include <opensm/osm_opensm.h>
+#include <complib/cl_hmap.h>
 
 #define TORUS_MAX_DIM        3
 #define PORTGRP_MAX_PORTS    16
@@ -217,6 +218,7 @@ struct t_switch {
 
 	struct port_grp ptgrp[SWITCH_MAX_PORTGRPS];
 	struct endpoint **port;
+	uint64_t lft_sig;	/* hash of the LFT last computed for it */
 };
 
 /*
@@ -247,6 +249,7 @@ struct fabric {
 
 	struct link **link;
 	struct f_switch **sw;
+	cl_hmap_t sw_idx;	/* f_switch by node GUID, valid when sw != NULL */
 };
 
 struct coord_dirs {
@@ -307,6 +310,16 @@ struct torus {
 	unsigned flags;
 	unsigned max_changes;
 	int debug;
+	/*
+	 * Path SL loop VL bits for each pair of switch coordinates along
+	 * each dimension, indexed by src * size + dst (see torus_path_sl).
+	 */
+	uint8_t *loop_vl[TORUS_MAX_DIM];
+	/*
+	 * Hash of everything torus_lft() uses besides the switch links:
+	 * port order and each switch's local ports and LIDs.
+	 */
+	uint64_t dest_sig;
 };
 
 /*
@@ -315,6 +328,7 @@ struct torus {
 #define X_MESH (1U << 0)
 #define Y_MESH (1U << 1)
 #define Z_MESH (1U << 2)
+#define PREV_COORDS (1U << 28)
 #define MSG_DEADLOCK (1U << 29)
 #define NOTIFY_CHANGES (1U << 30)
 
@@ -326,6 +340,13 @@ struct torus_context {
 	osm_opensm_t *osm;
 	struct torus *torus;
 	struct fabric fabric;
+	/*
+	 * Switch each data port LID is attached to, and the port owning
+	 * the LID when it was resolved.  Rebuilt after each routing.
+	 */
+	unsigned sl_lid_cnt;
+	osm_port_t **sl_port;
+	struct t_switch **sl_sw;
 };
 
 static
@@ -356,6 +377,7 @@ void teardown_fabric(struct fabric *f)
 			free(sw);
 		}
 		free(f->sw);
+		cl_hmap_destroy(&f->sw_idx);
 	}
 	if (f->link) {
 		for (l = 0; l < f->link_cnt; l++)
@@ -404,6 +426,9 @@ void teardown_torus(struct torus *t)
 	if (t->seed)
 		free(t->seed);
 
+	for (p = 0; p < TORUS_MAX_DIM; p++)
+		free(t->loop_vl[p]);
+
 	free(t);
 }
 
@@ -430,6 +455,8 @@ void torus_context_delete(void *context)
 	teardown_fabric(&ctx->fabric);
 	if (ctx->torus)
 		teardown_torus(ctx->torus);
+	free(ctx->sl_port);
+	free(ctx->sl_sw);
 	free(ctx);
 }
 
@@ -456,40 +483,40 @@ bool grow_seed_array(struct torus *t, int new_seeds)
 static
 struct f_switch *find_f_sw(struct fabric *f, guid_t sw_guid)
 {
-	unsigned s;
-	struct f_switch *sw;
+	if (f->sw)
+		return cl_hmap_get(&f->sw_idx, sw_guid);
 
-	if (f->sw) {
-		for (s = 0; s < f->switch_cnt; s++) {
-			sw = f->sw[s];
-			if (sw->n_id == sw_guid)
-				return sw;
-		}
-	}
 	return NULL;
 }
 
+/*
+ * guid0 must be a switch; every fabric link is attached to the port
+ * array of the switches it connects, so there is no need to search
+ * the whole link list.
+ */
 static
 struct link *find_f_link(struct fabric *f,
 			 guid_t guid0, int port0, guid_t guid1, int port1)
 {
-	unsigned l;
+	struct f_switch *sw;
 	struct link *link;
 
-	if (f->link) {
-		for (l = 0; l < f->link_cnt; l++) {
-			link = f->link[l];
-			if ((link->end[0].n_id == guid0 &&
-			     link->end[0].port == port0 &&
-			     link->end[1].n_id == guid1 &&
-			     link->end[1].port == port1) ||
-			    (link->end[0].n_id == guid1 &&
-			     link->end[0].port == port1 &&
-			     link->end[1].n_id == guid0 &&
-			     link->end[1].port == port0))
-				return link;
-		}
-	}
+	sw = find_f_sw(f, guid0);
+	if (!(sw && port0 >= 0 && (unsigned)port0 < sw->port_cnt &&
+	      sw->port[port0] && sw->port[port0]->link))
+		return NULL;
+
+	link = sw->port[port0]->link;
+	if ((link->end[0].n_id == guid0 &&
+	     link->end[0].port == port0 &&
+	     link->end[1].n_id == guid1 &&
+	     link->end[1].port == port1) ||
+	    (link->end[0].n_id == guid1 &&
+	     link->end[0].port == port1 &&
+	     link->end[1].n_id == guid0 &&
+	     link->end[1].port == port0))
+		return link;
+
 	return NULL;
 }
 
@@ -502,6 +529,11 @@ struct f_switch *alloc_fswitch(struct fabric *f,
 	struct f_switch *sw = NULL;
 	void *ptr;
 
+	if (!f->sw && cl_hmap_init(&f->sw_idx, 0) != CL_SUCCESS) {
+		OSM_LOG(&f->osm->log, OSM_LOG_ERROR,
+			"ERR 4E59: allocating switch index\n");
+		goto out;
+	}
 	if (f->switch_cnt >= f->switch_cnt_max) {
 
 		cnt_max = 16 + 5 * f->switch_cnt_max / 4;
@@ -509,6 +541,8 @@ struct f_switch *alloc_fswitch(struct fabric *f,
 		if (!ptr) {
 			OSM_LOG(&f->osm->log, OSM_LOG_ERROR,
 				"ERR 4E02: realloc: %s\n", strerror(errno));
+			if (!f->sw)
+				cl_hmap_destroy(&f->sw_idx);
 			goto out;
 		}
 		f->sw = ptr;
@@ -526,6 +560,14 @@ struct f_switch *alloc_fswitch(struct fabric *f,
 	sw->port = (void *)(sw + 1);
 	sw->n_id = sw_id;
 	sw->port_cnt = port_cnt;
+	if (cl_hmap_insert(&f->sw_idx, sw_id, sw) != CL_SUCCESS) {
+		OSM_LOG(&f->osm->log, OSM_LOG_ERROR,
+			"ERR 4E5A: indexing switch GUID 0x%04"PRIx64"\n",
+			cl_ntoh64(sw_id));
+		free(sw);
+		sw = NULL;
+		goto out;
+	}
 	f->sw[f->switch_cnt++] = sw;
 out:
 	return sw;
@@ -7258,8 +7300,129 @@ out:
 	return success;
 }
 
+/*
+ * Returns true if a link between switches a and b of torus t does not
+ * contradict their coordinates, i.e. they are neighbors in a single
+ * coordinate direction.
+ */
+static
+bool tsw_adjacent(struct torus *t, struct t_switch *a, struct t_switch *b)
+{
+	const int delta[TORUS_MAX_DIM] = { b->i - a->i, b->j - a->j,
+					   b->k - a->k };
+	const int sz[TORUS_MAX_DIM] = { t->x_sz, t->y_sz, t->z_sz };
+	const unsigned mesh[TORUS_MAX_DIM] = { X_MESH, Y_MESH, Z_MESH };
+	unsigned d, steps = 0;
+
+	for (d = 0; d < TORUS_MAX_DIM; d++) {
+		if (!delta[d])
+			continue;
+		if (delta[d] == 1 || delta[d] == -1 ||
+		    (!(t->flags & mesh[d]) &&
+		     (delta[d] == sz[d] - 1 || delta[d] == 1 - sz[d])))
+			steps++;
+		else
+			return false;
+	}
+	return steps <= 1;
+}
+
+/*
+ * Installs every fabric switch that was part of the previous torus at
+ * its previous coordinates.  locate_sw() then only has to connect the
+ * links that are still present and place the switches which were not
+ * in the previous torus, instead of growing the whole torus from the
+ * seed through the handle_case_0x*() deductions again.
+ *
+ * This is only done when the seed switches kept their coordinates and
+ * every interswitch link still joins switches that were neighbors in
+ * the previous torus; otherwise the fabric was recabled and the torus
+ * is found from the seed alone.
+ */
+static
+bool install_prev_tswitches(struct fabric *f, struct torus *t,
+			    struct torus *prev)
+{
+	cl_hmap_t prev_idx;
+	struct t_switch *tsw, *psw0, *psw1;
+	struct f_switch *fsw;
+	struct link *l;
+	unsigned s;
+	bool success = true;
+
+	if (!prev || prev->x_sz != t->x_sz || prev->y_sz != t->y_sz ||
+	    prev->z_sz != t->z_sz ||
+	    (prev->flags & (X_MESH | Y_MESH | Z_MESH)) !=
+	    (t->flags & (X_MESH | Y_MESH | Z_MESH)))
+		return true;
+
+	/*
+	 * At this point only the seed switches are installed.
+	 */
+	for (s = 0; s < t->switch_cnt; s++) {
+		tsw = t->sw_pool[s];
+		psw0 = prev->sw[tsw->i][tsw->j][tsw->k];
+		if (!psw0 || psw0->n_id != tsw->n_id) {
+			OSM_LOG(&t->osm->log, OSM_LOG_VERBOSE,
+				"Seed sw 0x%04"PRIx64" (%d,%d,%d) moved, "
+				"not reusing previous torus coordinates\n",
+				cl_ntoh64(tsw->n_id), tsw->i, tsw->j, tsw->k);
+			return true;
+		}
+	}
+
+	if (cl_hmap_init(&prev_idx, prev->switch_cnt) != CL_SUCCESS)
+		return true;
+
+	for (s = 0; s < prev->switch_cnt; s++)
+		if (cl_hmap_insert(&prev_idx, prev->sw_pool[s]->n_id,
+				   prev->sw_pool[s]) != CL_SUCCESS)
+			goto out;
+
+	for (s = 0; s < f->link_cnt; s++) {
+		l = f->link[s];
+		if (l->end[0].type != PASSTHRU || l->end[1].type != PASSTHRU)
+			continue;
+
+		psw0 = cl_hmap_get(&prev_idx, l->end[0].n_id);
+		psw1 = cl_hmap_get(&prev_idx, l->end[1].n_id);
+		if (psw0 && psw1 && !tsw_adjacent(prev, psw0, psw1)) {
+			OSM_LOG(&t->osm->log, OSM_LOG_INFO,
+				"Link 0x%04"PRIx64"/%d <-> 0x%04"PRIx64"/%d "
+				"does not match previous torus coordinates, "
+				"not reusing them\n",
+				cl_ntoh64(l->end[0].n_id), l->end[0].port,
+				cl_ntoh64(l->end[1].n_id), l->end[1].port);
+			goto out;
+		}
+	}
+
+	for (s = 0; s < prev->switch_cnt; s++) {
+		psw0 = prev->sw_pool[s];
+		if (t->sw[psw0->i][psw0->j][psw0->k])
+			continue;
+
+		fsw = find_f_sw(f, psw0->n_id);
+		if (!fsw)
+			continue;
+
+		if (!install_tswitch(t, psw0->i, psw0->j, psw0->k, fsw)) {
+			success = false;
+			goto out;
+		}
+	}
+	t->flags |= PREV_COORDS;
+
+	OSM_LOG(&t->osm->log, OSM_LOG_INFO,
+		"Placed %u switches at their previous torus coordinates\n",
+		t->switch_cnt);
+out:
+	cl_hmap_destroy(&prev_idx);
+	return success;
+}
+
 static
-bool build_torus(struct fabric *f, struct torus *t)
+bool build_torus(struct fabric *f, struct torus *t, struct torus *prev)
 {
 	int i, j, k;
 	int im1, jm1, km1;
@@ -7352,6 +7515,11 @@ bool build_torus(struct fabric *f, struct torus *t)
 			"(seed sw %d,%d,%d GUID 0x%04"PRIx64").\n",
 			t->seed_idx, i, j, k, cl_ntoh64(sw[i][j][k]->n_id));
 
+	if (!install_prev_tswitches(f, t, prev)) {
+		success = false;
+		goto out;
+	}
+
 	/*
 	 * Search the fabric and construct the expected torus topology.
 	 *
@@ -9160,19 +9328,393 @@ out:
 	return success;
 }
 
-int route_torus(struct torus *t)
+/*
+ * FNV-1a, one 64 bit word at a time.
+ */
+#define SIG_INIT 0xcbf29ce484222325ULL
+
+static
+uint64_t sig_add(uint64_t sig, uint64_t v)
+{
+	return (sig ^ v) * 0x100000001b3ULL;
+}
+
+static
+uint64_t lft_sig(const uint8_t *lft, unsigned size)
+{
+	uint64_t sig = SIG_INIT, v;
+	unsigned i;
+
+	for (i = 0; i + sizeof(v) <= size; i += sizeof(v)) {
+		memcpy(&v, lft + i, sizeof(v));
+		sig = sig_add(sig, v);
+	}
+	for (; i < size; i++)
+		sig = sig_add(sig, lft[i]);
+
+	return sig;
+}
+
+/*
+ * Returns the hash of the destinations torus_lft() routes to, in the
+ * order it routes them, or 0 if some destination has no valid LID.
+ */
+static
+uint64_t torus_dest_sig(struct torus *t)
 {
-	int s;
+	uint64_t sig = SIG_INIT;
+	struct endpoint *ep;
+	struct port_grp *pg;
+	osm_port_t *osm_port;
+	unsigned p, s;
+	bool ca;
+
+	for (p = 0; p < ARRAY_SIZE(t->port_order); p++)
+		sig = sig_add(sig, t->port_order[p]);
+
+	for (s = 0; s < t->switch_cnt; s++) {
+		pg = &t->sw_pool[s]->ptgrp[2 * TORUS_MAX_DIM];
+		sig = sig_add(sig, t->sw_pool[s]->n_id);
+
+		for (p = 0; p < pg->port_cnt; p++) {
+			ep = pg->port[p];
+			if (ep->type == SRCSINK)
+				ca = false;
+			else if (ep->type == PASSTHRU &&
+				 ep->link->end[1].type == SRCSINK) {
+				ep = &ep->link->end[1];
+				ca = true;
+			} else
+				return 0;
+
+			osm_port = ep->osm_port;
+			if (!(osm_port && osm_port->priv == ep))
+				return 0;
+
+			sig = sig_add(sig, pg->port[p]->port);
+			sig = sig_add(sig, ca);
+			sig = sig_add(sig, cl_ntoh16(
+				osm_physp_get_base_lid(osm_port->p_physp)));
+			sig = sig_add(sig, osm_physp_get_lmc(osm_port->p_physp));
+		}
+	}
+	return sig ? sig : 1;
+}
+
+/*
+ * Returns an array telling which switches may keep the LFT computed
+ * for them by the previous torus, or NULL if all must be routed.
+ *
+ * The next hop from a switch only depends on its own port groups, on
+ * the switches and links along the three rings through it (see
+ * next_hop_x() and ring_dir_path()), and on the destinations (see
+ * torus_dest_sig()).  So when the torus was built on the previous
+ * coordinates from the same switches and destinations, only switches
+ * on a ring where some link changed need to be routed again.
+ */
+static
+uint8_t *torus_lft_reuse(struct torus *t, struct torus *prev)
+{
+	struct t_switch *sw, *psw;
+	struct port_grp *pg, *ppg;
+	osm_switch_t *osm_sw;
+	uint8_t *reuse, *x_ring, *y_ring, *z_ring;
+	unsigned g, p, s;
+	bool changed;
+
+	if (!(prev && (t->flags & PREV_COORDS) && t->dest_sig &&
+	      t->dest_sig == prev->dest_sig &&
+	      t->switch_cnt == prev->switch_cnt))
+		return NULL;
+
+	for (s = 0; s < t->switch_cnt; s++) {
+		sw = t->sw_pool[s];
+		psw = prev->sw_pool[s];
+		if (sw->n_id != psw->n_id ||
+		    sw->i != psw->i || sw->j != psw->j || sw->k != psw->k)
+			return NULL;
+	}
+
+	x_ring = calloc(t->y_sz * t->z_sz + t->x_sz * t->z_sz +
+			t->x_sz * t->y_sz, sizeof(*x_ring));
+	if (!x_ring)
+		return NULL;
+	y_ring = x_ring + t->y_sz * t->z_sz;
+	z_ring = y_ring + t->x_sz * t->z_sz;
+
+	for (s = 0; s < t->switch_cnt; s++) {
+		sw = t->sw_pool[s];
+		psw = prev->sw_pool[s];
+		for (g = 0; g < 2 * TORUS_MAX_DIM; g++) {
+			pg = &sw->ptgrp[g];
+			ppg = &psw->ptgrp[g];
+
+			changed = pg->port_cnt != ppg->port_cnt;
+			for (p = 0; !changed && p < pg->port_cnt; p++)
+				changed = pg->port[p]->port != ppg->port[p]->port;
+			if (!changed)
+				continue;
+
+			if (g / 2 == 0)
+				x_ring[sw->j + t->y_sz * sw->k] = 1;
+			else if (g / 2 == 1)
+				y_ring[sw->i + t->x_sz * sw->k] = 1;
+			else
+				z_ring[sw->i + t->x_sz * sw->j] = 1;
+		}
+	}
+
+	reuse = calloc(t->switch_cnt, sizeof(*reuse));
+	if (reuse)
+		for (s = 0; s < t->switch_cnt; s++) {
+			sw = t->sw_pool[s];
+			osm_sw = sw->osm_switch;
+			reuse[s] = !x_ring[sw->j + t->y_sz * sw->k] &&
+				   !y_ring[sw->i + t->x_sz * sw->k] &&
+				   !z_ring[sw->i + t->x_sz * sw->j] &&
+				   osm_sw && osm_sw->priv == sw &&
+				   osm_sw->lft && osm_sw->new_lft &&
+				   !osm_sw->need_update &&
+				   (!t->osm->subn.need_update ||
+				    osm_sw->lft_preloaded);
+		}
+	free(x_ring);
+	return reuse;
+}
+
+enum lft_result { LFT_FAILED = 0, LFT_ROUTED, LFT_REUSED };
+
+/*
+ * A switch LFT is only copied from what the switch holds when that is
+ * still exactly what the previous torus computed for it.
+ */
+static
+enum lft_result route_tswitch(struct torus *t, struct torus *prev,
+			      unsigned s, bool reuse)
+{
+	struct t_switch *sw = t->sw_pool[s], *psw;
+	osm_switch_t *osm_sw = sw->osm_switch;
+	unsigned g;
+
+	if (reuse &&
+	    lft_sig(osm_sw->lft, osm_sw->lft_size) == prev->sw_pool[s]->lft_sig) {
+		psw = prev->sw_pool[s];
+		memcpy(osm_sw->new_lft, osm_sw->lft, osm_sw->lft_size);
+		for (g = 0; g < 2 * TORUS_MAX_DIM; g++) {
+			sw->ptgrp[g].sw_dlid_cnt = psw->ptgrp[g].sw_dlid_cnt;
+			sw->ptgrp[g].ca_dlid_cnt = psw->ptgrp[g].ca_dlid_cnt;
+		}
+		sw->lft_sig = psw->lft_sig;
+		return LFT_REUSED;
+	}
+
+	if (!torus_lft(t, sw))
+		return LFT_FAILED;
+
+	sw->lft_sig = lft_sig(osm_sw->new_lft, osm_sw->lft_size);
+	return LFT_ROUTED;
+}
+
+struct torus_lft_work {
+	struct torus *t;
+	struct torus *prev;
+	uint8_t *reuse;
+	uint8_t *result;
+};
+
+/*
+ * Each switch LFT only depends on the torus and on the port group
+ * counters of that switch, so switches can be routed concurrently
+ * and the result does not depend on how they are spread on workers.
+ */
+static
+void torus_lft_range(void *context, size_t begin, size_t end, unsigned worker)
+{
+	struct torus_lft_work *w = context;
+	size_t s;
+
+	for (s = begin; s < end; s++)
+		w->result[s] = route_tswitch(w->t, w->prev, s,
+					     w->reuse && w->reuse[s]);
+}
+
+int route_torus(struct torus *t, struct torus *prev)
+{
+	struct torus_lft_work w;
+	enum lft_result r;
+	unsigned s, reused = 0;
 	bool success = true;
 
-	for (s = 0; s < (int)t->switch_cnt; s++)
-		success = torus_lft(t, t->sw_pool[s]) && success;
+	t->dest_sig = torus_dest_sig(t);
+
+	w.t = t;
+	w.prev = prev;
+	w.reuse = torus_lft_reuse(t, prev);
+	w.result = calloc(t->switch_cnt, sizeof(*w.result));
+	if (!(w.result &&
+	      cl_work_pool_parallel_for(t->osm->routing_exec.pool, 0,
+					t->switch_cnt, 0, torus_lft_range,
+					&w) == CL_SUCCESS)) {
+		free(w.result);
+		w.result = NULL;
+	}
+	for (s = 0; s < t->switch_cnt; s++) {
+		if (w.result)
+			r = w.result[s];
+		else
+			r = route_tswitch(t, prev, s, w.reuse && w.reuse[s]);
+		success = r != LFT_FAILED && success;
+		reused += r == LFT_REUSED;
+	}
+	free(w.result);
+
+	if (w.reuse) {
+		OSM_LOG(&t->osm->log, OSM_LOG_INFO,
+			"Kept LFTs of %u of %u switches from previous torus\n",
+			reused, t->switch_cnt);
+		free(w.reuse);
+	}
 
 	success = success && torus_master_stree(t);
 
 	return success ? 0 : -1;
 }
 
+/*
+ * Returns the switch a data source/sink port is attached to, or NULL
+ * if the port is not part of the torus.  Reasons are logged when log
+ * is not NULL.
+ */
+static
+struct t_switch *path_sl_port_sw(osm_log_t *log, osm_port_t *osm_port,
+				 const char *name)
+{
+	struct endpoint *port;
+	guid_t guid;
+
+	port = osm_port->priv;
+	if (!(port && port->osm_port == osm_port)) {
+		port = osm_port_relink_endpoint(osm_port);
+		if (!port) {
+			guid = osm_node_get_node_guid(osm_port->p_node);
+			if (log)
+				OSM_LOG(log, OSM_LOG_INFO,
+					"Note: %s (GUID 0x%04"PRIx64") "
+					"not in torus fabric description\n",
+					name, cl_ntoh64(guid));
+			return NULL;
+		}
+	}
+	/*
+	 * We're only supposed to be called for CA ports, and maybe
+	 * switch management ports.
+	 */
+	if (port->type != SRCSINK) {
+		guid = osm_node_get_node_guid(osm_port->p_node);
+		if (log)
+			OSM_LOG(log, OSM_LOG_INFO,
+				"Error: %s (GUID 0x%04"PRIx64") "
+				"not a data src/sink port\n",
+				name, cl_ntoh64(guid));
+		return NULL;
+	}
+	/*
+	 * By definition, a CA port is connected to end[1] of a link, and
+	 * the switch port is end[0].  See build_ca_link() and link_srcsink().
+	 */
+	if (port->link)
+		return port->link->end[0].sw;
+	else
+		return port->sw;
+}
+
+/*
+ * Precompute the loop VL bits of the path SL for every pair of
+ * coordinates along each torus dimension.
+ */
+static
+bool build_loop_vl_tables(struct torus *t)
+{
+	unsigned sz[TORUS_MAX_DIM] = { t->x_sz, t->y_sz, t->z_sz };
+	unsigned d, src, dst;
+
+	for (d = 0; d < TORUS_MAX_DIM; d++) {
+		t->loop_vl[d] = malloc(sz[d] * sz[d]);
+		if (!t->loop_vl[d])
+			return false;
+		for (src = 0; src < sz[d]; src++)
+			for (dst = 0; dst < sz[d]; dst++)
+				t->loop_vl[d][src * sz[d] + dst] =
+				    sl_set_use_loop_vl(use_vl1(src, dst, sz[d]),
+						       d);
+	}
+	return true;
+}
+
+/*
+ * Resolve the switch of every data port LID once after routing, so
+ * that torus_path_sl does not need to for each PathRecord.
+ */
+static
+void build_path_sl_lookup(struct torus_context *ctx)
+{
+	osm_subn_t *subn = &ctx->osm->subn;
+	unsigned cnt = subn->max_ucast_lid_ho + 1;
+	cl_map_item_t *item;
+	osm_port_t *osm_port;
+	struct t_switch *sw;
+	uint16_t lid, min_lid_ho, max_lid_ho;
+
+	free(ctx->sl_port);
+	free(ctx->sl_sw);
+	ctx->sl_lid_cnt = 0;
+	ctx->sl_port = calloc(cnt, sizeof(*ctx->sl_port));
+	ctx->sl_sw = calloc(cnt, sizeof(*ctx->sl_sw));
+	if (!ctx->sl_port || !ctx->sl_sw ||
+	    !build_loop_vl_tables(ctx->torus)) {
+		OSM_LOG(&ctx->osm->log, OSM_LOG_ERROR, "ERR 4E58: "
+			"No memory for path SL lookup tables, "
+			"SLs will be computed per path\n");
+		free(ctx->sl_port);
+		free(ctx->sl_sw);
+		ctx->sl_port = NULL;
+		ctx->sl_sw = NULL;
+		return;
+	}
+
+	for (item = cl_qmap_head(&subn->port_guid_tbl);
+	     item != cl_qmap_end(&subn->port_guid_tbl);
+	     item = cl_qmap_next(item)) {
+		osm_port = (osm_port_t *) item;
+		sw = path_sl_port_sw(NULL, osm_port, NULL);
+		if (!sw || sw->torus != ctx->torus)
+			continue;
+		osm_port_get_lid_range_ho(osm_port, &min_lid_ho, &max_lid_ho);
+		for (lid = min_lid_ho; lid && lid <= max_lid_ho && lid < cnt;
+		     lid++) {
+			ctx->sl_port[lid] = osm_port;
+			ctx->sl_sw[lid] = sw;
+		}
+	}
+	ctx->sl_lid_cnt = cnt;
+}
+
+/*
+ * Returns the switch of a LID resolved by build_path_sl_lookup(), or
+ * NULL if the LID was unknown then or has moved to another port since.
+ */
+static inline
+struct t_switch *path_sl_lookup(struct torus_context *ctx, ib_net16_t lid)
+{
+	uint16_t lid_ho = cl_ntoh16(lid);
+
+	if (lid_ho >= ctx->sl_lid_cnt || !ctx->sl_sw[lid_ho] ||
+	    osm_get_port_by_lid_ho(&ctx->osm->subn, lid_ho) !=
+	    ctx->sl_port[lid_ho])
+		return NULL;
+	return ctx->sl_sw[lid_ho];
+}
+
 uint8_t torus_path_sl(void *context, uint8_t path_sl_hint,
 		      const ib_net16_t slid, const ib_net16_t dlid)
 {
@@ -9180,12 +9722,21 @@ uint8_t torus_path_sl(void *context, uint8_t path_sl_hint,
 	osm_opensm_t *p_osm = ctx->osm;
 	osm_log_t *log = &p_osm->log;
 	osm_port_t *osm_sport, *osm_dport;
-	struct endpoint *sport, *dport;
 	struct t_switch *ssw, *dsw;
 	struct torus *t;
-	guid_t guid;
 	unsigned sl = 0;
 
+	ssw = path_sl_lookup(ctx, slid);
+	dsw = ssw ? path_sl_lookup(ctx, dlid) : NULL;
+	if (ssw && dsw) {
+		t = ssw->torus;
+		sl  = t->loop_vl[0][ssw->i * t->x_sz + dsw->i];
+		sl |= t->loop_vl[1][ssw->j * t->y_sz + dsw->j];
+		sl |= t->loop_vl[2][ssw->k * t->z_sz + dsw->k];
+		sl |= sl_set_qos(sl_get_qos(path_sl_hint));
+		return sl;
+	}
+
 	osm_sport = osm_get_port_by_lid(&p_osm->subn, slid);
 	if (!osm_sport)
 		goto out;
@@ -9194,61 +9745,12 @@ uint8_t torus_path_sl(void *context, uint8_t path_sl_hint,
 	if (!osm_dport)
 		goto out;
 
-	sport = osm_sport->priv;
-	if (!(sport && sport->osm_port == osm_sport)) {
-		sport = osm_port_relink_endpoint(osm_sport);
-		if (!sport) {
-			guid = osm_node_get_node_guid(osm_sport->p_node);
-			OSM_LOG(log, OSM_LOG_INFO,
-				"Note: osm_sport (GUID 0x%04"PRIx64") "
-				"not in torus fabric description\n",
-				cl_ntoh64(guid));
-			goto out;
-		}
-	}
-	dport = osm_dport->priv;
-	if (!(dport && dport->osm_port == osm_dport)) {
-		dport = osm_port_relink_endpoint(osm_dport);
-		if (!dport) {
-			guid = osm_node_get_node_guid(osm_dport->p_node);
-			OSM_LOG(log, OSM_LOG_INFO,
-				"Note: osm_dport (GUID 0x%04"PRIx64") "
-				"not in torus fabric description\n",
-				cl_ntoh64(guid));
-			goto out;
-		}
-	}
-	/*
-	 * We're only supposed to be called for CA ports, and maybe
-	 * switch management ports.
-	 */
-	if (sport->type != SRCSINK) {
-		guid = osm_node_get_node_guid(osm_sport->p_node);
-		OSM_LOG(log, OSM_LOG_INFO,
-			"Error: osm_sport (GUID 0x%04"PRIx64") "
-			"not a data src/sink port\n", cl_ntoh64(guid));
+	ssw = path_sl_port_sw(log, osm_sport, "osm_sport");
+	if (!ssw)
 		goto out;
-	}
-	if (dport->type != SRCSINK) {
-		guid = osm_node_get_node_guid(osm_dport->p_node);
-		OSM_LOG(log, OSM_LOG_INFO,
-			"Error: osm_dport (GUID 0x%04"PRIx64") "
-			"not a data src/sink port\n", cl_ntoh64(guid));
+	dsw = path_sl_port_sw(log, osm_dport, "osm_dport");
+	if (!dsw)
 		goto out;
-	}
-	/*
-	 * By definition, a CA port is connected to end[1] of a link, and
-	 * the switch port is end[0].  See build_ca_link() and link_srcsink().
-	 */
-	if (sport->link) {
-		ssw = sport->link->end[0].sw;
-	} else {
-		ssw = sport->sw;
-	}
-	if (dport->link)
-		dsw = dport->link->end[0].sw;
-	else
-		dsw = dport->sw;
 
 	t = ssw->torus;
 
@@ -9493,7 +9995,7 @@ int torus_build_lfts(void *context)
 		(int)torus->x_sz, (int)torus->y_sz, (int)torus->z_sz,
 		(ALL_MESH(torus->flags) ? "mesh" : "torus"));
 
-	if (!build_torus(fabric, torus)) {
+	if (!build_torus(fabric, torus, ctx->torus)) {
 		OSM_LOG(&torus->osm->log, OSM_LOG_ERROR, "ERR 4E57: "
 			"build_torus finished with errors\n");
 		goto out;
@@ -9515,7 +10017,7 @@ int torus_build_lfts(void *context)
 		report_torus_changes(torus, ctx->torus);
 
 	if (routable_torus(torus, fabric))
-		status = route_torus(torus);
+		status = route_torus(torus, ctx->torus);
 
 out:
 	if (status) {		/* bad torus!! */
@@ -9528,6 +10030,7 @@ out:
 		if (ctx->torus)
 			teardown_torus(ctx->torus);
 		ctx->torus = torus;
+		build_path_sl_lookup(ctx);
 
 		check_qos_swe_config(&opt->qos_swe_options, &opt->qos_options,
 				     log);
@@ -9553,6 +10056,7 @@ int osm_ucast_torus2QoS_setup(struct osm_routing_engine *r,
 		return -1;
 
 	r->context = ctx;
+	r->flags = OSM_ROUTING_ENGINE_PATH_SL_MT_SAFE;
 	r->ucast_build_fwd_tables = torus_build_lfts;
 	r->build_lid_matrices = ucast_dummy_build_lid_matrices;
 	r->update_sl2vl = torus_update_osm_sl2vl;
@@ -102,9 +102,14 @@ typedef struct vertex {
 typedef struct vltable {
 	uint64_t num_lids;	/* size of the lids array */
 	uint16_t *lids;		/* sorted array of all lids in the subnet */
-	uint8_t *vls;		/* matrix form assignment lid X lid -> virtual lane */
+	uint16_t max_lid_ho;	/* largest lid in the lids array */
+	uint32_t *lid_index;	/* lid (host order) -> index in the lids array */
+	uint8_t *vls;		/* matrix form assignment lid X lid -> virtual lane,
+				   4 bit per lane */
 } vltable_t;
 
+#define VLTABLE_NO_INDEX	0xffffffff
+
 typedef struct cdg_link {
 	struct cdg_node *node;
 	uint32_t num_pairs;	/* number of src->dest pairs incremented in path adding step */
@@ -191,26 +196,58 @@ static int cmp_lids(const void *l1, const void *l2)
 		return 0;
 }
 
-/* use stdlib to sort the lid array */
-static inline void vltable_sort_lids(vltable_t * vltable)
+/* read and write the lane of the src/dest pair at index ind of the
+   packed matrix
+*/
+static inline uint8_t vltable_get_at(vltable_t * vltable, uint64_t ind)
+{
+	return (vltable->vls[ind >> 1] >> ((ind & 1) << 2)) & 0xf;
+}
+
+static inline void vltable_set_at(vltable_t * vltable, uint64_t ind,
+				  uint8_t vl)
+{
+	uint8_t shift = (ind & 1) << 2;
+
+	vltable->vls[ind >> 1] = (vltable->vls[ind >> 1] & ~(0xf << shift)) |
+	    ((vl & 0xf) << shift);
+}
+
+/* use stdlib to sort the lid array, and index the lids by their value */
+static int vltable_sort_lids(vltable_t * vltable)
 {
+	uint64_t i;
+
 	qsort(vltable->lids, vltable->num_lids, sizeof(ib_net16_t), cmp_lids);
+
+	vltable->max_lid_ho = 0;
+	for (i = 0; i < vltable->num_lids; i++)
+		if (cl_ntoh16(vltable->lids[i]) > vltable->max_lid_ho)
+			vltable->max_lid_ho = cl_ntoh16(vltable->lids[i]);
+
+	vltable->lid_index = (uint32_t *)
+	    malloc((vltable->max_lid_ho + 1) * sizeof(uint32_t));
+	if (!vltable->lid_index)
+		return 1;
+	memset(vltable->lid_index, 0xff,
+	       (vltable->max_lid_ho + 1) * sizeof(uint32_t));
+	for (i = 0; i < vltable->num_lids; i++)
+		vltable->lid_index[cl_ntoh16(vltable->lids[i])] = (uint32_t) i;
+
+	return 0;
 }
 
-/* use stdlib to get index of key in lid array;
+/* get index of key in lid array;
    return -1 if lid isn't found in lids array
 */
 static inline int64_t vltable_get_lidindex(ib_net16_t * key, vltable_t * vltable)
 {
-	ib_net16_t *found_lid = NULL;
+	uint16_t lid_ho = cl_ntoh16(*key);
 
-	found_lid =
-	    (ib_net16_t *) bsearch(key, vltable->lids, vltable->num_lids,
-				   sizeof(ib_net16_t), cmp_lids);
-	if (found_lid)
-		return found_lid - vltable->lids;
-	else
+	if (lid_ho > vltable->max_lid_ho ||
+	    vltable->lid_index[lid_ho] == VLTABLE_NO_INDEX)
 		return -1;
+	return vltable->lid_index[lid_ho];
 }
 
 /* get virtual lane from src lid X dest lid combination;
@@ -222,8 +259,8 @@ static int32_t vltable_get_vl(vltable_t * vltable, ib_net16_t slid, ib_net16_t d
 	int64_t ind2 = vltable_get_lidindex(&dlid, vltable);
 
 	if (ind1 > -1 && ind2 > -1)
-		return (int32_t) (vltable->
-				  vls[ind1 + ind2 * vltable->num_lids]);
+		return (int32_t) vltable_get_at(vltable,
+						ind1 + ind2 * vltable->num_lids);
 	else
 		return -1;
 }
@@ -236,7 +273,7 @@ static inline void vltable_insert(vltable_t * vltable, ib_net16_t slid,
 	int64_t ind2 = vltable_get_lidindex(&dlid, vltable);
 
 	if (ind1 > -1 && ind2 > -1)
-		vltable->vls[ind1 + ind2 * vltable->num_lids] = vl;
+		vltable_set_at(vltable, ind1 + ind2 * vltable->num_lids, vl);
 }
 
 /* change a number of lanes from lane xy to lane yz */
@@ -253,12 +290,13 @@ static void vltable_change_vl(vltable_t * vltable, uint8_t from, uint8_t to,
 				break;
 			}
 			if (ind1 != ind2) {
-				if (vltable->
-				    vls[ind1 + ind2 * vltable->num_lids] ==
-				    from) {
-					vltable->vls[ind1 +
-						     ind2 * vltable->num_lids] =
-					    to;
+				if (vltable_get_at(vltable,
+						   ind1 + ind2 * vltable->num_lids)
+				    == from) {
+					vltable_set_at(vltable,
+						       ind1 +
+						       ind2 * vltable->num_lids,
+						       to);
 					set++;
 				}
 			}
@@ -280,8 +318,8 @@ static void vltable_print(osm_ucast_mgr_t * p_mgr, vltable_t * vltable)
 					" to dest_lid=%" PRIu16 " on vl=%" PRIu8
 					"\n", cl_ntoh16(vltable->lids[ind1]),
 					cl_ntoh16(vltable->lids[ind2]),
-					vltable->vls[ind1 +
-						     ind2 * vltable->num_lids]);
+					vltable_get_at(vltable, ind1 +
+						       ind2 * vltable->num_lids));
 			}
 		}
 	}
@@ -292,6 +330,8 @@ static void vltable_dealloc(vltable_t ** vltable)
 	if (*vltable) {
 		if ((*vltable)->lids)
 			free((*vltable)->lids);
+		if ((*vltable)->lid_index)
+			free((*vltable)->lid_index);
 		if ((*vltable)->vls)
 			free((*vltable)->vls);
 		free(*vltable);
@@ -301,18 +341,21 @@ static void vltable_dealloc(vltable_t ** vltable)
 
 static int vltable_alloc(vltable_t ** vltable, uint64_t size)
 {
+	uint64_t vls_size = (size * size + 1) / 2;
+
 	/* allocate VL table and indexing array */
-	*vltable = (vltable_t *) malloc(sizeof(vltable_t));
+	*vltable = (vltable_t *) calloc(1, sizeof(vltable_t));
 	if (!(*vltable))
 		goto ERROR;
 	(*vltable)->num_lids = size;
 	(*vltable)->lids = (ib_net16_t *) malloc(size * sizeof(ib_net16_t));
 	if (!((*vltable)->lids))
 		goto ERROR;
-	(*vltable)->vls = (uint8_t *) malloc(size * size * sizeof(uint8_t));
+	(*vltable)->vls = (uint8_t *) malloc(vls_size * sizeof(uint8_t));
 	if (!((*vltable)->vls))
 		goto ERROR;
-	memset((*vltable)->vls, OSM_DEFAULT_SL, size * size);
+	memset((*vltable)->vls, OSM_DEFAULT_SL | (OSM_DEFAULT_SL << 4),
+	       vls_size);
 
 	return 0;
 
@@ -1042,18 +1085,16 @@ static int dfsssp_build_graph(void *context)
 {
 	dfsssp_context_t *dfsssp_ctx = (dfsssp_context_t *) context;
 	osm_ucast_mgr_t *p_mgr = (osm_ucast_mgr_t *) (dfsssp_ctx->p_mgr);
-	boolean_t has_fdr10 = (1 == p_mgr->p_subn->opt.fdr10) ? TRUE : FALSE;
+	osm_graph_t *g = &p_mgr->graph;
 	cl_qmap_t *port_tbl = &p_mgr->p_subn->port_guid_tbl;	/* 1 management port per switch + 1 or 2 ports for each Hca */
 	osm_port_t *p_port = NULL;
-	cl_qmap_t *sw_tbl = &p_mgr->p_subn->sw_guid_tbl;
 	cl_map_item_t *item = NULL;
 	osm_switch_t *sw = NULL;
-	osm_node_t *remote_node = NULL;
-	uint8_t port = 0, remote_port = 0;
-	uint32_t i = 0, j = 0, err = 0, undiscov = 0, max_num_undiscov = 0;
+	osm_graph_link_t *g_link;
+	osm_graph_endport_t *g_endport;
+	uint32_t i = 0, err = 0, undiscov = 0, max_num_undiscov = 0;
 	uint64_t total_num_hca = 0;
 	vertex_t *adj_list = NULL;
-	osm_physp_t *p_physp = NULL;
 	link_t *link = NULL, *head = NULL;
 	uint32_t num_sw = 0, adj_list_size = 0;
 	uint8_t lmc = 0;
@@ -1073,7 +1114,7 @@ static int dfsssp_build_graph(void *context)
 	/* construct the generic heap opject to use it in dijkstra */
 	cl_heap_construct(&heap);
 
-	num_sw = cl_qmap_count(sw_tbl);
+	num_sw = g->num_sw;
 	adj_list_size = num_sw + 1;
 	/* allocate an adjazenz list (array), 0. element is reserved for the source (Hca) in the routing algo, others are switches */
 	adj_list = (vertex_t *) malloc(adj_list_size * sizeof(vertex_t));
@@ -1101,18 +1142,16 @@ static int dfsssp_build_graph(void *context)
 		}
 	}
 
-	i = 1;			/* fill adj_list -> start with index 1 */
-	for (item = cl_qmap_head(sw_tbl); item != cl_qmap_end(sw_tbl);
-	     item = cl_qmap_next(item), i++) {
-		sw = (osm_switch_t *) item;
+	/* fill adj_list -> switch number i of the graph has index i + 1 */
+	for (i = 1; i < adj_list_size; i++) {
+		sw = g->sw[i - 1];
 		OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
 			"Processing switch with GUID 0x%" PRIx64 "\n",
 			cl_ntoh64(osm_node_get_node_guid(sw->p_node)));
 
 		adj_list[i].guid =
 		    cl_ntoh64(osm_node_get_node_guid(sw->p_node));
-		adj_list[i].lid =
-		    cl_ntoh16(osm_node_get_base_lid(sw->p_node, 0));
+		adj_list[i].lid = g->lid[i - 1];
 		adj_list[i].sw = sw;
 
 		link = (link_t *) malloc(sizeof(link_t));
@@ -1125,47 +1164,41 @@ static int dfsssp_build_graph(void *context)
 		head->next = NULL;
 
 		/* add SP0 to number of CA connected to a switch */
-		lmc = osm_node_get_lmc(sw->p_node, 0);
-		adj_list[i].num_hca += (1 << lmc);
-
-		/* iterate over all ports in the switch, start with port 1 (port 0 is a management port) */
-		for (port = 1; port < sw->num_ports; port++) {
-			/* get the node behind the port */
-			remote_node =
-			    osm_node_get_remote_node(sw->p_node, port,
-						     &remote_port);
-			/* if there is no remote node on this port or it's the same switch -> try next port */
-			if (!remote_node || remote_node->sw == sw)
-				continue;
-			/* make sure the link is healthy */
-			p_physp = osm_node_get_physp_ptr(sw->p_node, port);
-			if (!p_physp || !osm_link_is_healthy(p_physp))
-				continue;
-			/* if there is a Hca connected -> count and cycle */
-			if (!remote_node->sw) {
-				lmc = osm_node_get_lmc(remote_node, (uint32_t)remote_port);
-				adj_list[i].num_hca += (1 << lmc);
+		adj_list[i].num_hca += (1 << g->lmc[i - 1]);
+
+		/* count the Hca connected through healthy links */
+		for (g_endport = &g->endports[g->endport_start[i - 1]];
+		     g_endport < &g->endports[g->endport_start[i]]; g_endport++)
+			if (g_endport->healthy)
+				adj_list[i].num_hca += (1 << g_endport->lmc);
+
+		/* iterate over all links to other switches */
+		for (g_link = &g->links[g->link_start[i - 1]];
+		     g_link < &g->links[g->link_start[i]]; g_link++) {
+			/* if it's the same switch or the link is not healthy -> try next link */
+			if (g_link->sw == i - 1 || !g_link->healthy)
 				continue;
-			}
 			/* filter out throttled links to improve performance */
 			if (p_mgr->p_subn->opt.avoid_throttled_links &&
-			    osm_link_is_throttled(p_physp, has_fdr10)) {
+			    g_link->throttled) {
 				OSM_LOG(p_mgr->p_log, OSM_LOG_INFO,
 					"Detected and ignoring throttled link:"
 					" 0x%" PRIx64 "/P%" PRIu8
 					" <--> 0x%" PRIx64 "/P%" PRIu8 "\n",
 					cl_ntoh64(osm_node_get_node_guid(sw->p_node)),
-					port,
-					cl_ntoh64(osm_node_get_node_guid(remote_node)),
-					remote_port);
+					g_link->port,
+					cl_ntoh64(osm_node_get_node_guid
+						  (g->sw[g_link->sw]->p_node)),
+					g_link->rem_port);
 				continue;
 			}
 			OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
 				"Node 0x%" PRIx64 ", remote node 0x%" PRIx64
 				", port %" PRIu8 ", remote port %" PRIu8 "\n",
 				cl_ntoh64(osm_node_get_node_guid(sw->p_node)),
-				cl_ntoh64(osm_node_get_node_guid(remote_node)),
-				port, remote_port);
+				cl_ntoh64(osm_node_get_node_guid
+					  (g->sw[g_link->sw]->p_node)),
+				g_link->port, g_link->rem_port);
 
 			link->next = (link_t *) malloc(sizeof(link_t));
 			if (!link->next) {
@@ -1181,29 +1214,18 @@ static int dfsssp_build_graph(void *context)
 			link = link->next;
 			set_default_link(link);
 			link->guid =
-			    cl_ntoh64(osm_node_get_node_guid(remote_node));
+			    cl_ntoh64(osm_node_get_node_guid
+				      (g->sw[g_link->sw]->p_node));
 			link->from = i;
-			link->from_port = port;
-			link->to_port = remote_port;
+			link->from_port = g_link->port;
+			link->to = g_link->sw + 1;
+			link->to_port = g_link->rem_port;
 			link->weight = total_num_hca * total_num_hca;	/* initialize with P^2 to force shortest paths */
 		}
 
 		adj_list[i].links = head->next;
 		free(head);
 	}
-	/* connect the links with it's second adjacent node in the list */
-	for (i = 1; i < adj_list_size; i++) {
-		link = adj_list[i].links;
-		while (link) {
-			for (j = 1; j < adj_list_size; j++) {
-				if (link->guid == adj_list[j].guid) {
-					link->to = j;
-					break;
-				}
-			}
-			link = link->next;
-		}
-	}
 
 	/* do one dry run to determine connectivity issues */
 	sm_lid = p_mgr->p_subn->master_sm_base_lid;
@@ -1862,8 +1884,14 @@ static int dfsssp_remove_deadlocks(dfsssp_context_t * dfsssp_ctx)
 				srcdest2vl_table->lids[i] = cl_hton16(dlid);
 		}
 	}
-	/* sort lids */
-	vltable_sort_lids(srcdest2vl_table);
+	/* sort and index lids */
+	if (vltable_sort_lids(srcdest2vl_table)) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR,
+			"ERR AD54: cannot allocate memory to sort the "
+			"srcdest2vl_table LIDs\n");
+		err = 1;
+		goto ERROR;
+	}
 
 	test_vl = 0;
 	/* fill cdg[0] with routes from each src/dest port combination for all Hca/SP0 in the subnet */
@@ -2642,6 +2670,7 @@ static uint8_t get_dfsssp_sl(void *context, uint8_t hint_for_default_sl,
 	else
 		return hint_for_default_sl;
 
+	/* the table still holds the lids of ports gone since routing */
 	src_port = osm_get_port_by_lid(p_mgr->p_subn, slid);
 	if (!src_port)
 		return hint_for_default_sl;
@@ -2746,6 +2775,7 @@ int osm_ucast_dfsssp_setup(struct osm_routing_engine *r, osm_opensm_t * p_osm)
 
 	/* reset function pointers to dfsssp routines */
 	r->context = (void *)dfsssp_context;
+	r->flags = OSM_ROUTING_ENGINE_PATH_SL_MT_SAFE;
 	r->build_lid_matrices = dfsssp_build_graph;
 	r->ucast_build_fwd_tables = dfsssp_do_dijkstra_routing;
 	r->mcast_build_stree = dfsssp_do_mcast_routing;
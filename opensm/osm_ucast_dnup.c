@@ -69,14 +69,22 @@ typedef enum dnup_switch_dir {
 /* dnup structure */
 typedef struct dnup {
 	osm_opensm_t *p_osm;
+	osm_graph_t *graph;
+	unsigned *rank;		/* indexed by graph switch number */
 } dnup_t;
 
-struct dnup_node {
-	cl_list_item_t list;
-	osm_switch_t *sw;
-	dnup_switch_dir_t dir;
-	unsigned rank;
-	unsigned visited;
+/* per worker BFS state, the queue is a ring of graph->num_sw entries */
+struct dnup_bfs_scratch {
+	uint32_t *queue;
+	uint8_t *dir;
+	uint8_t *visited;
+	uint8_t max_hops;
+};
+
+struct dnup_bfs_work {
+	dnup_t *p_dnup;
+	struct dnup_bfs_scratch *scratch;
+	uint8_t prune_weight;
 };
 
 /* This function returns direction based on rank and guid info of current &
@@ -102,65 +110,57 @@ static dnup_switch_dir_t dnup_get_dir(unsigned cur_rank, unsigned rem_rank)
  * This function does the bfs of min hop table calculation by guid index
  * as a starting point.
  **********************************************************************/
-static int dnup_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
-			    IN osm_switch_t * p_sw, IN uint8_t prune_weight,
+static int dnup_bfs_by_node(IN osm_log_t * p_log, IN dnup_t * p_dnup,
+			    IN uint32_t root, IN uint8_t prune_weight,
+			    IN struct dnup_bfs_scratch *s,
 			    OUT uint8_t * max_hops)
 {
-	uint8_t pn, pn_rem;
-	cl_qlist_t list;
+	osm_graph_t *g = p_dnup->graph;
+	osm_graph_link_t *link;
+	uint32_t u, rem_u, head = 0, count = 0;
 	uint16_t lid;
-	struct dnup_node *u;
 	dnup_switch_dir_t next_dir, current_dir;
 
 	OSM_LOG_ENTER(p_log);
 
-	lid = osm_node_get_base_lid(p_sw->p_node, 0);
-	lid = cl_ntoh16(lid);
-	osm_switch_set_hops(p_sw, lid, 0, 0);
+	lid = g->lid[root];
+	osm_switch_set_hops(g->sw[root], lid, 0, 0);
 
 	OSM_LOG(p_log, OSM_LOG_DEBUG,
 		"Starting from switch - port GUID 0x%" PRIx64 " lid %u\n",
-		cl_ntoh64(p_sw->p_node->node_info.port_guid), lid);
+		cl_ntoh64(g->sw[root]->p_node->node_info.port_guid), lid);
 
-	u = p_sw->priv;
-	u->dir = DOWN;
+	s->dir[root] = DOWN;
 
 	/* Update list with the new element */
-	cl_qlist_init(&list);
-	cl_qlist_insert_tail(&list, &u->list);
+	s->queue[count++] = root;
 
 	/* BFS the list till no next element */
-	while (!cl_is_qlist_empty(&list)) {
-		u = (struct dnup_node *)cl_qlist_remove_head(&list);
-		u->visited = 0;	/* cleanup */
-		current_dir = u->dir;
-		/* Go over all ports of the switch and find unvisited remote nodes */
-		for (pn = 1; pn < u->sw->num_ports; pn++) {
-			osm_node_t *p_remote_node;
-			struct dnup_node *rem_u;
+	while (count) {
+		u = s->queue[head];
+		head = head + 1 < g->num_sw ? head + 1 : 0;
+		count--;
+		s->visited[u] = 0;	/* cleanup */
+		current_dir = s->dir[u];
+		/* Go over all links of the switch and find unvisited remote nodes */
+		for (link = &g->links[g->link_start[u]];
+		     link < &g->links[g->link_start[u + 1]]; link++) {
 			uint8_t current_min_hop, remote_min_hop,
 			    set_hop_return_value;
 			osm_switch_t *p_remote_sw;
 
-			p_remote_node =
-			    osm_node_get_remote_node(u->sw->p_node, pn,
-						     &pn_rem);
-			/* If no remote node OR remote node is not a SWITCH
-			   continue to next pn */
-			if (!p_remote_node || !p_remote_node->sw)
-				continue;
-			/* Fetch remote guid only after validation of remote node */
-			p_remote_sw = p_remote_node->sw;
-			rem_u = p_remote_sw->priv;
+			rem_u = link->sw;
+			p_remote_sw = g->sw[rem_u];
 			/* Decide which direction to mark it (UP/DOWN) */
-			next_dir = dnup_get_dir(u->rank, rem_u->rank);
+			next_dir = dnup_get_dir(p_dnup->rank[u], p_dnup->rank[rem_u]);
 
 			/* Set MinHop value for the current lid */
-			current_min_hop = osm_switch_get_least_hops(u->sw, lid);
+			current_min_hop = osm_switch_get_least_hops(g->sw[u], lid);
 			/* Check hop count if better insert into list && update
 			   the remote node Min Hop Table */
 			remote_min_hop =
-			    osm_switch_get_hop_count(p_remote_sw, lid, pn_rem);
+			    osm_switch_get_hop_count(p_remote_sw, lid,
+						     link->rem_port);
 
 			/* Check if this is a legal step : the only illegal step is going
 			   from UP to DOWN */
@@ -168,8 +168,8 @@ static int dnup_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
 				OSM_LOG(p_log, OSM_LOG_DEBUG,
 					"Avoiding move from 0x%016" PRIx64
 					" to 0x%016" PRIx64 "\n",
-					cl_ntoh64(osm_node_get_node_guid(u->sw->p_node)),
-					cl_ntoh64(osm_node_get_node_guid(p_remote_node)));
+					cl_ntoh64(osm_node_get_node_guid(g->sw[u]->p_node)),
+					cl_ntoh64(osm_node_get_node_guid(p_remote_sw->p_node)));
 				/* Illegal step. If prune_weight is set, allow it with an
 				 * additional weight
 				 */
@@ -180,7 +180,8 @@ static int dnup_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
 							"ERR AE02: Too many hops on subnet,"
 							" can't relax illegal Dn/Up transition.");
 						osm_switch_set_hops(p_remote_sw, lid,
-								    pn_rem, OSM_NO_PATH);
+								    link->rem_port,
+								    OSM_NO_PATH);
 					}
 				} else {
 					continue;
@@ -189,7 +190,7 @@ static int dnup_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
 			if (current_min_hop + 1 < remote_min_hop) {
 				set_hop_return_value =
 				    osm_switch_set_hops(p_remote_sw, lid,
-							pn_rem,
+							link->rem_port,
 							current_min_hop + 1);
 				if(max_hops && current_min_hop + 1 > *max_hops) {
 					*max_hops = current_min_hop + 1;
@@ -200,12 +201,13 @@ static int dnup_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
 						set_hop_return_value);
 				}
 				/* Check if remote port has already been visited */
-				if (!rem_u->visited) {
+				if (!s->visited[rem_u]) {
 					/* Insert dnup_switch item into the list */
-					rem_u->dir = next_dir;
-					rem_u->visited = 1;
-					cl_qlist_insert_tail(&list,
-							     &rem_u->list);
+					s->dir[rem_u] = next_dir;
+					s->visited[rem_u] = 1;
+					s->queue[(head + count) % g->num_sw] =
+					    rem_u;
+					count++;
 				}
 			}
 		}
@@ -215,76 +217,75 @@ static int dnup_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
 	return 0;
 }
 
+static void dnup_bfs_range(void *context, size_t begin, size_t end,
+			   unsigned worker)
+{
+	struct dnup_bfs_work *w = context;
+	struct dnup_bfs_scratch *s = &w->scratch[worker];
+	size_t i;
+
+	for (i = begin; i < end; i++) {
+		if (osm_routing_exec_cancelled(&w->p_dnup->p_osm->
+					       routing_exec))
+			break;
+		dnup_bfs_by_node(&w->p_dnup->p_osm->log, w->p_dnup, i,
+				 w->prune_weight, s,
+				 w->prune_weight ? NULL : &s->max_hops);
+	}
+}
+
 /* NOTE : PLS check if we need to decide that the first */
 /*        rank is a SWITCH for BFS purpose */
 static int dnup_subn_rank(IN dnup_t * p_dnup)
 {
-	osm_switch_t *p_sw;
-	osm_physp_t *p_physp, *p_remote_physp;
-	cl_qlist_t list;
-	cl_map_item_t *item;
-	struct dnup_node *u, *remote_u;
-	uint8_t num_ports, port_num;
+	osm_graph_t *g = p_dnup->graph;
+	osm_graph_link_t *link;
+	uint32_t *queue;
+	uint32_t u, rem_u, head = 0, tail = 0;
 	osm_log_t *p_log = &p_dnup->p_osm->log;
 	unsigned max_rank = 0;
 
 	OSM_LOG_ENTER(p_log);
-	cl_qlist_init(&list);
 
-	/* add all node level switches to the list */
-	for (item = cl_qmap_head(&p_dnup->p_osm->subn.sw_guid_tbl);
-	     item != cl_qmap_end(&p_dnup->p_osm->subn.sw_guid_tbl);
-	     item = cl_qmap_next(item)) {
-		p_sw = (osm_switch_t *)item;
-		u = p_sw->priv;
-		if (u->rank == 0)
-			cl_qlist_insert_tail(&list, &u->list);
+	/* a switch is queued once, when it is ranked */
+	queue = malloc(g->num_sw * sizeof(*queue));
+	if (!queue) {
+		OSM_LOG_EXIT(p_log);
+		return -1;
 	}
 
+	/* add all node level switches to the list */
+	for (u = 0; u < g->num_sw; u++)
+		if (p_dnup->rank[u] == 0)
+			queue[tail++] = u;
+
 	/* BFS the list till it's empty */
-	while (!cl_is_qlist_empty(&list)) {
-		u = (struct dnup_node *)cl_qlist_remove_head(&list);
+	while (head < tail) {
+		u = queue[head++];
 		/* Go over all remote nodes and rank them (if not already visited) */
-		p_sw = u->sw;
-		num_ports = p_sw->num_ports;
 		OSM_LOG(p_log, OSM_LOG_DEBUG,
 			"Handling switch GUID 0x%" PRIx64 "\n",
-			cl_ntoh64(osm_node_get_node_guid(p_sw->p_node)));
-		for (port_num = 1; port_num < num_ports; port_num++) {
-			ib_net64_t port_guid;
-
-			/* Current port fetched in order to get remote side */
-			p_physp =
-			    osm_node_get_physp_ptr(p_sw->p_node, port_num);
-
-			if (!p_physp)
-				continue;
-
-			p_remote_physp = p_physp->p_remote_physp;
-
-			/*
-			   make sure that all the following occur on p_remote_physp:
-			   1. The port isn't NULL
-			   2. It is a switch
-			 */
-			if (p_remote_physp && p_remote_physp->p_node->sw) {
-				remote_u = p_remote_physp->p_node->sw->priv;
-				port_guid = p_remote_physp->port_guid;
-
-				if (remote_u->rank > u->rank + 1) {
-					remote_u->rank = u->rank + 1;
-					max_rank = remote_u->rank;
-					cl_qlist_insert_tail(&list,
-							     &remote_u->list);
-					OSM_LOG(p_log, OSM_LOG_DEBUG,
-						"Rank of port GUID 0x%" PRIx64
-						" = %u\n", cl_ntoh64(port_guid),
-						remote_u->rank);
-				}
+			cl_ntoh64(osm_node_get_node_guid(g->sw[u]->p_node)));
+		for (link = &g->links[g->link_start[u]];
+		     link < &g->links[g->link_start[u + 1]]; link++) {
+			rem_u = link->sw;
+			if (p_dnup->rank[rem_u] > p_dnup->rank[u] + 1) {
+				p_dnup->rank[rem_u] = p_dnup->rank[u] + 1;
+				max_rank = p_dnup->rank[rem_u];
+				queue[tail++] = rem_u;
+				OSM_LOG(p_log, OSM_LOG_DEBUG,
+					"Rank of port GUID 0x%" PRIx64
+					" = %u\n",
+					cl_ntoh64(osm_node_get_physp_ptr
+						  (g->sw[rem_u]->p_node,
+						   link->rem_port)->port_guid),
+					p_dnup->rank[rem_u]);
 			}
 		}
 	}
 
+	free(queue);
+
 	/* Print Summary of ranking */
 	OSM_LOG(p_log, OSM_LOG_VERBOSE,
 		"Subnet ranking completed. Max Node Rank = %d\n", max_rank);
@@ -292,14 +293,67 @@ static int dnup_subn_rank(IN dnup_t * p_dnup)
 	return 0;
 }
 
+/*
+ * Runs the BFS of every switch, spread over the routing workers since
+ * each BFS only sets the hops to the LID of its own root.
+ */
+static int dnup_bfs_all(IN dnup_t * p_dnup, IN uint8_t prune_weight,
+			OUT uint8_t * max_hops)
+{
+	osm_routing_exec_t *exec = &p_dnup->p_osm->routing_exec;
+	unsigned workers = exec->num_workers;
+	uint32_t num_sw = p_dnup->graph->num_sw;
+	struct dnup_bfs_work w;
+	uint32_t *buf;
+	unsigned i;
+	int status = 0;
+
+	w.p_dnup = p_dnup;
+	w.prune_weight = prune_weight;
+	w.scratch = calloc(workers, sizeof(*w.scratch));
+	if (!w.scratch) {
+		status = -1;
+		goto Exit;
+	}
+	for (i = 0; i < workers; i++) {
+		buf = osm_routing_exec_scratch(exec, i, num_sw *
+					       (sizeof(uint32_t) + 2));
+		if (!buf) {
+			status = -1;
+			goto Exit;
+		}
+		w.scratch[i].queue = buf;
+		w.scratch[i].dir = (uint8_t *) (buf + num_sw);
+		w.scratch[i].visited = w.scratch[i].dir + num_sw;
+		memset(w.scratch[i].visited, 0, num_sw);
+	}
+
+	if (cl_work_pool_parallel_for(exec->pool, 0, num_sw, 1,
+				      dnup_bfs_range, &w) != CL_SUCCESS)
+		cl_work_pool_parallel_for(NULL, 0, num_sw, 1, dnup_bfs_range,
+					  &w);
+
+	for (i = 0; max_hops && i < workers; i++)
+		if (w.scratch[i].max_hops > *max_hops)
+			*max_hops = w.scratch[i].max_hops;
+Exit:
+	if (status)
+		OSM_LOG(&p_dnup->p_osm->log, OSM_LOG_ERROR, "ERR AE0E: "
+			"cannot allocate BFS state for %u workers\n", workers);
+	else if (osm_routing_exec_cancelled(exec))
+		status = -1;
+	free(w.scratch);
+	return status;
+}
+
 static int dnup_set_min_hop_table(IN dnup_t * p_dnup)
 {
 	osm_subn_t *p_subn = &p_dnup->p_osm->subn;
 	osm_log_t *p_log = &p_dnup->p_osm->log;
 	osm_switch_t *p_sw;
-	struct dnup_node *u;
 	cl_map_item_t *item;
 	uint8_t max_hops = 0;
+	int status;
 
 	OSM_LOG_ENTER(p_log);
 
@@ -323,13 +377,8 @@ static int dnup_set_min_hop_table(IN dnup_t * p_dnup)
 	OSM_LOG(p_log, OSM_LOG_VERBOSE,
 		"BFS through all port guids in the subnet [\n");
 
-	for (item = cl_qmap_head(&p_dnup->p_osm->subn.sw_guid_tbl);
-	     item != cl_qmap_end(&p_dnup->p_osm->subn.sw_guid_tbl);
-	     item = cl_qmap_next(item)) {
-		p_sw = (osm_switch_t *)item;
-		dnup_bfs_by_node(p_log, p_subn, p_sw, 0, &max_hops);
-	}
-	if(p_subn->opt.connect_roots) {
+	status = dnup_bfs_all(p_dnup, 0, &max_hops);
+	if(!status && p_subn->opt.connect_roots) {
 		/*This is probably not necessary, by I am more comfortable
 		 * clearing any possible side effects from the previous
 		 * dnup routing pass
@@ -339,22 +388,15 @@ static int dnup_set_min_hop_table(IN dnup_t * p_dnup)
 		     item = cl_qmap_next(item)) {
 			p_sw = (osm_switch_t *)item;
 			osm_switch_clear_hops(p_sw);
-			u = (struct dnup_node *) p_sw->priv;
-			u->visited = 0;
-		}
-		for (item = cl_qmap_head(&p_dnup->p_osm->subn.sw_guid_tbl);
-		     item != cl_qmap_end(&p_dnup->p_osm->subn.sw_guid_tbl);
-		     item = cl_qmap_next(item)) {
-			p_sw = (osm_switch_t *)item;
-			dnup_bfs_by_node(p_log, p_subn, p_sw, max_hops + 1, NULL);
 		}
+		status = dnup_bfs_all(p_dnup, max_hops + 1, NULL);
 	}
 
 	OSM_LOG(p_log, OSM_LOG_VERBOSE,
 		"BFS through all port guids in the subnet ]\n");
 	/* Cleanup */
 	OSM_LOG_EXIT(p_log);
-	return 0;
+	return status;
 }
 
 static int dnup_build_lid_matrices(IN dnup_t * p_dnup)
@@ -374,7 +416,10 @@ static int dnup_build_lid_matrices(IN dnup_t * p_dnup)
 	}
 
 	/* Rank the subnet switches */
-	dnup_subn_rank(p_dnup);
+	if (dnup_subn_rank(p_dnup)) {
+		status = -1;
+		goto _exit;
+	}
 
 	/* After multiple ranking need to set Min Hop Table by DnUp algorithm  */
 	OSM_LOG(&p_dnup->p_osm->log, OSM_LOG_VERBOSE,
@@ -386,63 +431,38 @@ _exit:
 	return status;
 }
 
-static struct dnup_node *create_dnup_node(osm_switch_t * sw)
-{
-	struct dnup_node *u;
-
-	u = malloc(sizeof(*u));
-	if (!u)
-		return NULL;
-	memset(u, 0, sizeof(*u));
-	u->sw = sw;
-	u->rank = 0xffffffff;
-	return u;
-}
-
-static void delete_dnup_node(struct dnup_node *u)
-{
-	u->sw->priv = NULL;
-	free(u);
-}
-
 /* DNUP callback function */
 static int dnup_lid_matrices(void *ctx)
 {
 	dnup_t *p_dnup = ctx;
-	cl_map_item_t *item;
+	osm_graph_t *g = &p_dnup->p_osm->sm.ucast_mgr.graph;
 	osm_switch_t *p_sw;
+	uint32_t sw;
 	int ret = 0;
 	int num_leafs = 0;
 	uint8_t pn, pn_rem;
 
 	OSM_LOG_ENTER(&p_dnup->p_osm->log);
 
-	for (item = cl_qmap_head(&p_dnup->p_osm->subn.sw_guid_tbl);
-	     item != cl_qmap_end(&p_dnup->p_osm->subn.sw_guid_tbl);
-	     item = cl_qmap_next(item)) {
-		p_sw = (osm_switch_t *)item;
-		p_sw->priv = create_dnup_node(p_sw);
-		if (!p_sw->priv) {
-			OSM_LOG(&(p_dnup->p_osm->log), OSM_LOG_ERROR, "ERR AE0C: "
-				"cannot create dnup node\n");
-			OSM_LOG_EXIT(&p_dnup->p_osm->log);
-			return -1;
-		}
+	p_dnup->graph = g;
+	p_dnup->rank = malloc(g->num_sw * sizeof(*p_dnup->rank));
+	if (!p_dnup->rank) {
+		OSM_LOG(&(p_dnup->p_osm->log), OSM_LOG_ERROR, "ERR AE0C: "
+			"cannot create dnup nodes\n");
+		OSM_LOG_EXIT(&p_dnup->p_osm->log);
+		return -1;
 	}
 
-
 	/* First setup node level nodes */
-	for (item = cl_qmap_head(&p_dnup->p_osm->subn.sw_guid_tbl);
-	     item != cl_qmap_end(&p_dnup->p_osm->subn.sw_guid_tbl);
-	     item = cl_qmap_next(item)) {
-		p_sw = (osm_switch_t *)item;
+	for (sw = 0; sw < g->num_sw; sw++) {
+		p_sw = g->sw[sw];
+		p_dnup->rank[sw] = 0xffffffff;
 
 		for (pn = 0; pn < p_sw->num_ports; pn++) {
 			osm_node_t *p_remote_node;
 			p_remote_node = osm_node_get_remote_node(p_sw->p_node, pn, &pn_rem);
 			if(p_remote_node && !p_remote_node->sw) {
-				struct dnup_node *u = p_sw->priv;
-				u->rank = 0;
+				p_dnup->rank[sw] = 0;
 				OSM_LOG(&(p_dnup->p_osm->log),
 					OSM_LOG_VERBOSE, "(%s) rank 0 leaf switch\n",
 					p_sw->p_node->print_desc);
@@ -455,18 +475,12 @@ static int dnup_lid_matrices(void *ctx)
 	if(num_leafs == 0) {
 		OSM_LOG(&(p_dnup->p_osm->log),
 			OSM_LOG_ERROR, "ERR AE0D: No leaf switches found, DnUp routing failed\n");
-		OSM_LOG_EXIT(&p_dnup->p_osm->log);
-		return -1;
-	}
-
-	ret = dnup_build_lid_matrices(p_dnup);
+		ret = -1;
+	} else
+		ret = dnup_build_lid_matrices(p_dnup);
 
-	for (item = cl_qmap_head(&p_dnup->p_osm->subn.sw_guid_tbl);
-	     item != cl_qmap_end(&p_dnup->p_osm->subn.sw_guid_tbl);
-	     item = cl_qmap_next(item)) {
-		p_sw = (osm_switch_t *) item;
-		delete_dnup_node(p_sw->priv);
-	}
+	free(p_dnup->rank);
+	p_dnup->rank = NULL;
 
 	OSM_LOG_EXIT(&p_dnup->p_osm->log);
 	return ret;
@@ -60,10 +60,11 @@
 #include <opensm/osm_mesh.h>
 #include <opensm/osm_ucast_lash.h>
 
-typedef struct _reachable_dest {
-	int switch_id;
-	struct _reachable_dest *next;
-} reachable_dest_t;
+/* BFS trees computed at once by lash_shortest_paths() */
+#define LASH_SP_BATCH 64
+
+#define SP_UNVISITED -2
+#define SP_ROOT -1
 
 static void connect_switches(lash_t * p_lash, int sw1, int sw2, int phy_port_1)
 {
@@ -126,12 +127,28 @@ static osm_switch_t *get_osm_switch_from_port(const osm_port_t * port)
 	return NULL;
 }
 
+/*
+ * Vertices not visited yet in the search identified by epoch still
+ * carry the state of an older search, reset it when reaching them
+ * instead of clearing the whole CDG before each search.
+ */
+static inline void cdg_vertex_visit(cdg_vertex_t * v, unsigned epoch)
+{
+	if (v->visit_epoch != epoch) {
+		v->visit_epoch = epoch;
+		v->visiting_number = 0;
+		v->seen = 0;
+	}
+}
+
 static int cycle_exists(cdg_vertex_t * start, cdg_vertex_t * current,
-			cdg_vertex_t * prev, int visit_num)
+			cdg_vertex_t * prev, int visit_num, unsigned epoch)
 {
 	int i, new_visit_num;
 	int cycle_found = 0;
 
+	cdg_vertex_visit(current ? current : start, epoch);
+
 	if (current != NULL && current->visiting_number > 0) {
 		if (visit_num > current->visiting_number && current->seen == 0) {
 			cycle_found = 1;
@@ -155,7 +172,7 @@ static int cycle_exists(cdg_vertex_t * start, cdg_vertex_t * current,
 		for (i = 0; i < current->num_deps; i++) {
 			cycle_found =
 			    cycle_exists(start, current->deps[i].v, current,
-					 new_visit_num);
+					 new_visit_num, epoch);
 			if (cycle_found == 1)
 				i = current->num_deps;
 		}
@@ -178,8 +195,7 @@ static void remove_semipermanent_depend_for_sp(lash_t * p_lash, int sw,
 {
 	switch_t **switches = p_lash->switches;
 	cdg_vertex_t ****cdg_vertex_matrix = p_lash->cdg_vertex_matrix;
-	int i_next_switch, output_link, i, next_link, i_next_next_switch,
-	    depend = 0;
+	int i_next_switch, output_link, i, next_link, depend = 0;
 	cdg_vertex_t *v;
 	int __attribute__((unused)) found;
 
@@ -187,12 +203,12 @@ static void remove_semipermanent_depend_for_sp(lash_t * p_lash, int sw,
 	i_next_switch = get_next_switch(p_lash, sw, output_link);
 
 	while (sw != dest_switch) {
-		v = cdg_vertex_matrix[lane][sw][i_next_switch];
+		v = cdg_vertex_matrix[lane][sw][output_link];
 		CL_ASSERT(v != NULL);
 
 		if (v->num_using_vertex == 1) {
 
-			cdg_vertex_matrix[lane][sw][i_next_switch] = NULL;
+			cdg_vertex_matrix[lane][sw][output_link] = NULL;
 
 			free(v);
 		} else {
@@ -200,13 +216,12 @@ static void remove_semipermanent_depend_for_sp(lash_t * p_lash, int sw,
 			if (i_next_switch != dest_switch) {
 				next_link =
 				    switches[i_next_switch]->routing_table[dest_switch].out_link;
-				i_next_next_switch = get_next_switch(p_lash, i_next_switch, next_link);
 				found = 0;
 
 				for (i = 0; i < v->num_deps; i++)
 					if (v->deps[i].v ==
 					    cdg_vertex_matrix[lane][i_next_switch]
-					    [i_next_next_switch]) {
+					    [next_link]) {
 						found = 1;
 						depend = i;
 					}
@@ -235,20 +250,6 @@ static void remove_semipermanent_depend_for_sp(lash_t * p_lash, int sw,
 	}
 }
 
-inline static void enqueue(cl_list_t * bfsq, switch_t * sw)
-{
-	CL_ASSERT(sw->q_state == UNQUEUED);
-	sw->q_state = Q_MEMBER;
-	cl_list_insert_tail(bfsq, sw);
-}
-
-inline static void dequeue(cl_list_t * bfsq, switch_t ** sw)
-{
-	*sw = (switch_t *) cl_list_remove_head(bfsq);
-	CL_ASSERT((*sw)->q_state == Q_MEMBER);
-	(*sw)->q_state = MST_MEMBER;
-}
-
 static int get_phys_connection(switch_t *sw, int switch_to)
 {
 	unsigned int i;
@@ -259,78 +260,144 @@ static int get_phys_connection(switch_t *sw, int switch_to)
 	return i;
 }
 
-static void shortest_path(lash_t * p_lash, int ir)
+/*
+ * Stores in parent[] the BFS tree of the switches rooted at ir,
+ * visiting the links of each switch in order.
+ */
+static void shortest_path(lash_t * p_lash, int ir, int *parent, int *queue)
 {
-	switch_t **switches = p_lash->switches, *sw, *swi;
-	unsigned int i;
-	cl_list_t bfsq;
-
-	cl_list_construct(&bfsq);
-	cl_list_init(&bfsq, 20);
-
-	enqueue(&bfsq, switches[ir]);
-
-	while (!cl_is_list_empty(&bfsq)) {
-		dequeue(&bfsq, &sw);
-		for (i = 0; i < sw->node->num_links; i++) {
-			swi = switches[sw->node->links[i]->switch_id];
-			if (swi->q_state == UNQUEUED) {
-				enqueue(&bfsq, swi);
-				sw->dij_channels[sw->used_channels++] = swi->id;
+	switch_t **switches = p_lash->switches;
+	mesh_node_t *node;
+	unsigned int i, head = 0, tail = 0;
+	int sw, swi;
+
+	for (i = 0; i < (unsigned)p_lash->num_switches; i++)
+		parent[i] = SP_UNVISITED;
+
+	parent[ir] = SP_ROOT;
+	queue[tail++] = ir;
+
+	while (head < tail) {
+		sw = queue[head++];
+		node = switches[sw]->node;
+		for (i = 0; i < node->num_links; i++) {
+			swi = node->links[i]->switch_id;
+			if (parent[swi] == SP_UNVISITED) {
+				parent[swi] = sw;
+				queue[tail++] = swi;
 			}
 		}
 	}
-
-	cl_list_destroy(&bfsq);
 }
 
-static int generate_routing_func_for_mst(lash_t * p_lash, int sw_id,
-					 reachable_dest_t ** destinations)
+typedef struct lash_sp_work {
+	lash_t *p_lash;
+	unsigned first;
+	unsigned count;
+	int *parent;
+} lash_sp_work_t;
+
+static void sp_tree_range(void *context, size_t begin, size_t end,
+			  unsigned worker)
 {
-	int i, next_switch;
-	switch_t *sw = p_lash->switches[sw_id];
-	int num_channels = sw->used_channels;
-	reachable_dest_t *dest, *i_dest, *concat_dest = NULL, *prev;
-
-	for (i = 0; i < num_channels; i++) {
-		next_switch = sw->dij_channels[i];
-		if (generate_routing_func_for_mst(p_lash, next_switch, &dest))
-			return -1;
+	lash_sp_work_t *w = context;
+	unsigned num_switches = w->p_lash->num_switches;
+	int *queue;
+	size_t ir;
+
+	/* already grown to this size by lash_shortest_paths */
+	queue = osm_routing_exec_scratch(&w->p_lash->p_osm->routing_exec,
+					 worker, num_switches * sizeof(*queue));
+	for (ir = begin; ir < end; ir++)
+		shortest_path(w->p_lash, ir,
+			      w->parent + (ir - w->first) * num_switches,
+			      queue);
+}
 
-		i_dest = dest;
-		prev = i_dest;
+/*
+ * Every switch on the tree path to a destination routes towards it
+ * through the tree, unless a tree of a lower root already decided.
+ * Each destination only updates its own routing table column.
+ */
+static void sp_merge_range(void *context, size_t begin, size_t end,
+			   unsigned worker)
+{
+	lash_sp_work_t *w = context;
+	switch_t **switches = w->p_lash->switches;
+	unsigned num_switches = w->p_lash->num_switches;
+	unsigned b;
+	size_t dest;
+	int *parent, sw, next_switch;
+
+	for (dest = begin; dest < end; dest++)
+		for (b = 0; b < w->count; b++) {
+			parent = w->parent + b * num_switches;
+			next_switch = dest;
+			for (sw = parent[dest]; sw >= 0; sw = parent[sw]) {
+				if (switches[sw]->routing_table[dest].out_link ==
+				    NONE)
+					switches[sw]->routing_table[dest].out_link =
+					    get_phys_connection(switches[sw],
+								next_switch);
+				next_switch = sw;
+			}
+		}
+}
 
-		while (i_dest != NULL) {
-			if (sw->routing_table[i_dest->switch_id].out_link ==
-			    NONE)
-				sw->routing_table[i_dest->switch_id].out_link =
-				    get_phys_connection(sw, next_switch);
+/*
+ * Fills the out links of the routing tables from the BFS trees rooted
+ * at each switch, trees of lower roots taking precedence.  Batches of
+ * trees are computed in parallel, then merged in root order so the
+ * result does not depend on the number of routing threads.
+ */
+static int lash_shortest_paths(lash_t * p_lash)
+{
+	osm_routing_exec_t *exec = &p_lash->p_osm->routing_exec;
+	cl_work_pool_t *pool = exec->pool;
+	unsigned num_switches = p_lash->num_switches;
+	lash_sp_work_t w;
+	unsigned i;
+	int status = -1;
 
-			prev = i_dest;
-			i_dest = i_dest->next;
-		}
+	w.p_lash = p_lash;
+	w.parent = malloc(LASH_SP_BATCH * num_switches * sizeof(*w.parent));
+	if (!w.parent)
+		goto Exit;
+	for (i = 0; i < exec->num_workers; i++)
+		if (!osm_routing_exec_scratch(exec, i,
+					      num_switches * sizeof(int)))
+			goto Exit;
 
-		CL_ASSERT(prev->next == NULL);
-		prev->next = concat_dest;
-		concat_dest = dest;
+	for (w.first = 0; w.first < num_switches; w.first += w.count) {
+		w.count = num_switches - w.first;
+		if (w.count > LASH_SP_BATCH)
+			w.count = LASH_SP_BATCH;
+
+		if (cl_work_pool_parallel_for(pool, w.first,
+					      w.first + w.count, 1,
+					      sp_tree_range, &w) != CL_SUCCESS)
+			cl_work_pool_parallel_for(NULL, w.first,
+						  w.first + w.count, 1,
+						  sp_tree_range, &w);
+
+		if (cl_work_pool_parallel_for(pool, 0, num_switches, 0,
+					      sp_merge_range, &w) != CL_SUCCESS)
+			cl_work_pool_parallel_for(NULL, 0, num_switches, 0,
+						  sp_merge_range, &w);
 	}
+	status = 0;
 
-	i_dest = (reachable_dest_t *) malloc(sizeof(reachable_dest_t));
-	if (!i_dest)
-		return -1;
-	i_dest->switch_id = sw->id;
-	i_dest->next = concat_dest;
-	*destinations = i_dest;
-	return 0;
+Exit:
+	free(w.parent);
+	return status;
 }
 
 static int generate_cdg_for_sp(lash_t * p_lash, int sw, int dest_switch,
 			       int lane)
 {
-	unsigned num_switches = p_lash->num_switches;
 	switch_t **switches = p_lash->switches;
 	cdg_vertex_t ****cdg_vertex_matrix = p_lash->cdg_vertex_matrix;
-	int next_switch, output_link, j, exists;
+	int next_switch, output_link, j, exists, max_deps;
 	cdg_vertex_t *v, *prev = NULL;
 
 	output_link = switches[sw]->routing_table[dest_switch].out_link;
@@ -338,16 +405,19 @@ static int generate_cdg_for_sp(lash_t * p_lash, int sw, int dest_switch,
 
 	while (sw != dest_switch) {
 
-		if (cdg_vertex_matrix[lane][sw][next_switch] == NULL) {
-			v = calloc(1, sizeof(*v) + (num_switches - 1) * sizeof(v->deps[0]));
+		if (cdg_vertex_matrix[lane][sw][output_link] == NULL) {
+			/* depends at most on the channels leaving next_switch */
+			max_deps = switches[next_switch]->node->num_links;
+			v = calloc(1, sizeof(*v) + max_deps * sizeof(v->deps[0]));
 			if (!v)
 				return -1;
 			v->from = sw;
 			v->to = next_switch;
 			v->temp = 1;
-			cdg_vertex_matrix[lane][sw][next_switch] = v;
+			v->max_deps = max_deps;
+			cdg_vertex_matrix[lane][sw][output_link] = v;
 		} else
-			v = cdg_vertex_matrix[lane][sw][next_switch];
+			v = cdg_vertex_matrix[lane][sw][output_link];
 
 		v->num_using_vertex++;
 
@@ -365,7 +435,7 @@ static int generate_cdg_for_sp(lash_t * p_lash, int sw, int dest_switch,
 				prev->deps[prev->num_deps].num_used++;
 				prev->num_deps++;
 
-				CL_ASSERT(prev->num_deps < (int)num_switches);
+				CL_ASSERT(prev->num_deps <= prev->max_deps);
 
 				if (prev->temp == 0)
 					prev->num_temp_depend++;
@@ -398,7 +468,7 @@ static void set_temp_depend_to_permanent_for_sp(lash_t * p_lash, int sw,
 	next_switch = get_next_switch(p_lash, sw, output_link);
 
 	while (sw != dest_switch) {
-		v = cdg_vertex_matrix[lane][sw][next_switch];
+		v = cdg_vertex_matrix[lane][sw][output_link];
 		CL_ASSERT(v != NULL);
 
 		if (v->temp == 1)
@@ -427,11 +497,11 @@ static void remove_temp_depend_for_sp(lash_t * p_lash, int sw, int dest_switch,
 	next_switch = get_next_switch(p_lash, sw, output_link);
 
 	while (sw != dest_switch) {
-		v = cdg_vertex_matrix[lane][sw][next_switch];
+		v = cdg_vertex_matrix[lane][sw][output_link];
 		CL_ASSERT(v != NULL);
 
 		if (v->temp == 1) {
-			cdg_vertex_matrix[lane][sw][next_switch] = NULL;
+			cdg_vertex_matrix[lane][sw][output_link] = NULL;
 			free(v);
 		} else {
 			CL_ASSERT(v->num_temp_depend <= v->num_deps);
@@ -439,7 +509,7 @@ static void remove_temp_depend_for_sp(lash_t * p_lash, int sw, int dest_switch,
 			v->num_temp_depend = 0;
 			v->num_using_vertex--;
 
-			for (i = v->num_deps; i < p_lash->num_switches - 1; i++)
+			for (i = v->num_deps; i < v->max_deps; i++)
 				v->deps[i].num_used = 0;
 		}
 
@@ -452,18 +522,37 @@ static void remove_temp_depend_for_sp(lash_t * p_lash, int sw, int dest_switch,
 	}
 }
 
+/*
+ * virtual_location keeps for each (src, dest) pair the state of every
+ * lane in 2 bits: 1 when the pair is routed on it, 2 when it could not
+ * be moved off it during balancing, 0 otherwise.
+ */
+static inline unsigned get_vloc(lash_t * p_lash, int src, int dest,
+				unsigned lane)
+{
+	return (p_lash->virtual_location[src * p_lash->num_switches + dest] >>
+		(2 * lane)) & 3;
+}
+
+static inline void set_vloc(lash_t * p_lash, int src, int dest,
+			    unsigned lane, unsigned val)
+{
+	uint32_t *vloc =
+	    &p_lash->virtual_location[src * p_lash->num_switches + dest];
+
+	*vloc = (*vloc & ~(3U << (2 * lane))) | (val << (2 * lane));
+}
+
 static int balance_virtual_lanes(lash_t * p_lash, unsigned lanes_needed)
 {
 	unsigned num_switches = p_lash->num_switches;
 	cdg_vertex_t ****cdg_vertex_matrix = p_lash->cdg_vertex_matrix;
 	int *num_mst_in_lane = p_lash->num_mst_in_lane;
-	int ***virtual_location = p_lash->virtual_location;
 	int min_filled_lane, max_filled_lane, trials;
 	int old_min_filled_lane, old_max_filled_lane, new_num_min_lane,
 	    new_num_max_lane;
 	unsigned int i, j;
-	int src, dest, start, next_switch, output_link;
-	int next_switch2, output_link2;
+	int src, dest, start, output_link, output_link2;
 	int stop = 0, cycle_found;
 	int cycle_found2;
 	unsigned start_vl = p_lash->p_osm->subn.opt.lash_start_vl;
@@ -479,7 +568,7 @@ static int balance_virtual_lanes(lash_t * p_lash, unsigned lanes_needed)
 		src = abs(rand()) % (num_switches);
 		dest = abs(rand()) % (num_switches);
 
-		while (virtual_location[src][dest][max_filled_lane] != 1) {
+		while (get_vloc(p_lash, src, dest, max_filled_lane) != 1) {
 			start = dest;
 			if (dest == num_switches - 1)
 				dest = 0;
@@ -487,7 +576,7 @@ static int balance_virtual_lanes(lash_t * p_lash, unsigned lanes_needed)
 				dest++;
 
 			while (dest != start
-			       && virtual_location[src][dest][max_filled_lane]
+			       && get_vloc(p_lash, src, dest, max_filled_lane)
 			       != 1) {
 				if (dest == num_switches - 1)
 					dest = 0;
@@ -495,7 +584,7 @@ static int balance_virtual_lanes(lash_t * p_lash, unsigned lanes_needed)
 					dest++;
 			}
 
-			if (virtual_location[src][dest][max_filled_lane] != 1) {
+			if (get_vloc(p_lash, src, dest, max_filled_lane) != 1) {
 				if (src == num_switches - 1)
 					src = 0;
 				else
@@ -508,35 +597,25 @@ static int balance_virtual_lanes(lash_t * p_lash, unsigned lanes_needed)
 			return -1;
 
 		output_link = p_lash->switches[src]->routing_table[dest].out_link;
-		next_switch = get_next_switch(p_lash, src, output_link);
-
 		output_link2 = p_lash->switches[dest]->routing_table[src].out_link;
-		next_switch2 = get_next_switch(p_lash, dest, output_link2);
 
-		CL_ASSERT(cdg_vertex_matrix[min_filled_lane][src][next_switch] != NULL);
-		CL_ASSERT(cdg_vertex_matrix[min_filled_lane][dest][next_switch2] != NULL);
+		CL_ASSERT(cdg_vertex_matrix[min_filled_lane][src][output_link] != NULL);
+		CL_ASSERT(cdg_vertex_matrix[min_filled_lane][dest][output_link2] != NULL);
 
+		p_lash->cdg_epoch++;
 		cycle_found =
-		    cycle_exists(cdg_vertex_matrix[min_filled_lane][src][next_switch], NULL, NULL,
-				 1);
+		    cycle_exists(cdg_vertex_matrix[min_filled_lane][src][output_link], NULL, NULL,
+				 1, p_lash->cdg_epoch);
 		cycle_found2 =
-		    cycle_exists(cdg_vertex_matrix[min_filled_lane][dest][next_switch2], NULL, NULL,
-				 1);
-
-		for (i = 0; i < num_switches; i++)
-			for (j = 0; j < num_switches; j++)
-				if (cdg_vertex_matrix[min_filled_lane][i][j] != NULL) {
-					cdg_vertex_matrix[min_filled_lane][i][j]->visiting_number =
-					    0;
-					cdg_vertex_matrix[min_filled_lane][i][j]->seen = 0;
-				}
+		    cycle_exists(cdg_vertex_matrix[min_filled_lane][dest][output_link2], NULL, NULL,
+				 1, p_lash->cdg_epoch);
 
 		if (cycle_found == 1 || cycle_found2 == 1) {
 			remove_temp_depend_for_sp(p_lash, src, dest, min_filled_lane);
 			remove_temp_depend_for_sp(p_lash, dest, src, min_filled_lane);
 
-			virtual_location[src][dest][max_filled_lane] = 2;
-			virtual_location[dest][src][max_filled_lane] = 2;
+			set_vloc(p_lash, src, dest, max_filled_lane, 2);
+			set_vloc(p_lash, dest, src, max_filled_lane, 2);
 			trials--;
 			trials--;
 		} else {
@@ -550,10 +629,10 @@ static int balance_virtual_lanes(lash_t * p_lash, unsigned lanes_needed)
 
 			remove_semipermanent_depend_for_sp(p_lash, src, dest, max_filled_lane);
 			remove_semipermanent_depend_for_sp(p_lash, dest, src, max_filled_lane);
-			virtual_location[src][dest][max_filled_lane] = 0;
-			virtual_location[dest][src][max_filled_lane] = 0;
-			virtual_location[src][dest][min_filled_lane] = 1;
-			virtual_location[dest][src][min_filled_lane] = 1;
+			set_vloc(p_lash, src, dest, max_filled_lane, 0);
+			set_vloc(p_lash, dest, src, max_filled_lane, 0);
+			set_vloc(p_lash, src, dest, min_filled_lane, 1);
+			set_vloc(p_lash, dest, src, min_filled_lane, 1);
 			p_lash->switches[src]->routing_table[dest].lane = min_filled_lane + start_vl;
 			p_lash->switches[dest]->routing_table[src].lane = min_filled_lane + start_vl;
 		}
@@ -589,16 +668,16 @@ static int balance_virtual_lanes(lash_t * p_lash, unsigned lanes_needed)
 			trials = num_mst_in_lane[max_filled_lane];
 			for (i = 0; i < num_switches; i++)
 				for (j = 0; j < num_switches; j++)
-					if (virtual_location[i][j][max_filled_lane] == 2)
-						virtual_location[i][j][max_filled_lane] = 1;
+					if (get_vloc(p_lash, i, j, max_filled_lane) == 2)
+						set_vloc(p_lash, i, j, max_filled_lane, 1);
 		}
 
 		if (old_max_filled_lane != max_filled_lane) {
 			trials = num_mst_in_lane[max_filled_lane];
 			for (i = 0; i < num_switches; i++)
 				for (j = 0; j < num_switches; j++)
-					if (virtual_location[i][j][old_max_filled_lane] == 2)
-						virtual_location[i][j][old_max_filled_lane] = 1;
+					if (get_vloc(p_lash, i, j, old_max_filled_lane) == 2)
+						set_vloc(p_lash, i, j, old_max_filled_lane, 1);
 		}
 	}
 	return 0;
@@ -607,7 +686,6 @@ static int balance_virtual_lanes(lash_t * p_lash, unsigned lanes_needed)
 static switch_t *switch_create(lash_t * p_lash, unsigned id, osm_switch_t * p_sw)
 {
 	unsigned num_switches = p_lash->num_switches;
-	unsigned num_ports = p_sw->num_ports;
 	switch_t *sw;
 	unsigned int i;
 
@@ -622,17 +700,10 @@ static switch_t *switch_create(lash_t * p_lash, unsigned id, osm_switch_t * p_sw
 	}
 
 	sw->id = id;
-	sw->dij_channels = malloc(num_ports * sizeof(int));
-	if (!sw->dij_channels) {
-		free(sw);
-		return NULL;
-	}
-
 	sw->p_sw = p_sw;
 	p_sw->priv = sw;
 
 	if (osm_mesh_node_create(p_lash, sw)) {
-		free(sw->dij_channels);
 		free(sw);
 		return NULL;
 	}
@@ -642,8 +713,6 @@ static switch_t *switch_create(lash_t * p_lash, unsigned id, osm_switch_t * p_sw
 
 static void switch_delete(lash_t *p_lash, switch_t * sw)
 {
-	if (sw->dij_channels)
-		free(sw->dij_channels);
 	free(sw);
 }
 
@@ -666,16 +735,16 @@ static void free_lash_structures(lash_t * p_lash)
 
 	OSM_LOG_ENTER(p_log);
 
-	delete_mesh_switches(p_lash);
-
-	/* free cdg_vertex_matrix */
-	for (i = 0; i < p_lash->vl_min; i++) {
-		for (j = 0; j < num_switches; j++) {
-			for (k = 0; k < num_switches; k++)
+	/* free cdg_vertex_matrix, rows are sized by the switch ports */
+	for (i = 0; p_lash->cdg_vertex_matrix && i < p_lash->vl_min; i++) {
+		for (j = 0; p_lash->cdg_vertex_matrix[i] && j < num_switches;
+		     j++) {
+			if (!p_lash->cdg_vertex_matrix[i][j])
+				continue;
+			for (k = 0; k < p_lash->switches[j]->p_sw->num_ports; k++)
 				if (p_lash->cdg_vertex_matrix[i][j][k])
 					free(p_lash->cdg_vertex_matrix[i][j][k]);
-			if (p_lash->cdg_vertex_matrix[i][j])
-				free(p_lash->cdg_vertex_matrix[i][j]);
+			free(p_lash->cdg_vertex_matrix[i][j]);
 		}
 		if (p_lash->cdg_vertex_matrix[i])
 			free(p_lash->cdg_vertex_matrix[i]);
@@ -683,18 +752,13 @@ static void free_lash_structures(lash_t * p_lash)
 
 	if (p_lash->cdg_vertex_matrix)
 		free(p_lash->cdg_vertex_matrix);
+	p_lash->cdg_vertex_matrix = NULL;
 
-	/* free virtual_location */
-	for (i = 0; i < num_switches; i++) {
-		for (j = 0; j < num_switches; j++) {
-			if (p_lash->virtual_location[i][j])
-				free(p_lash->virtual_location[i][j]);
-		}
-		if (p_lash->virtual_location[i])
-			free(p_lash->virtual_location[i]);
-	}
 	if (p_lash->virtual_location)
 		free(p_lash->virtual_location);
+	p_lash->virtual_location = NULL;
+
+	delete_mesh_switches(p_lash);
 
 	OSM_LOG_EXIT(p_log);
 }
@@ -705,18 +769,21 @@ static int init_lash_structures(lash_t * p_lash)
 	unsigned num_switches = p_lash->num_switches;
 	osm_log_t *p_log = &p_lash->p_osm->log;
 	int status = 0;
-	unsigned int i, j, k;
+	unsigned int i, j;
 
 	OSM_LOG_ENTER(p_log);
 
-	/* initialise cdg_vertex_matrix[num_layers][num_switches][num_switches] */
+	/*
+	 * initialise cdg_vertex_matrix[num_layers][num_switches][num_ports],
+	 * a channel being identified by its switch and out link
+	 */
 	p_lash->cdg_vertex_matrix =
-	    (cdg_vertex_t ****) malloc(vl_min * sizeof(cdg_vertex_t ***));
+	    (cdg_vertex_t ****) calloc(vl_min, sizeof(cdg_vertex_t ***));
 	if (p_lash->cdg_vertex_matrix == NULL)
 		goto Exit_Mem_Error;
 	for (i = 0; i < vl_min; i++) {
 		p_lash->cdg_vertex_matrix[i] =
-		    (cdg_vertex_t ***) malloc(num_switches *
+		    (cdg_vertex_t ***) calloc(num_switches,
 					      sizeof(cdg_vertex_t **));
 
 		if (p_lash->cdg_vertex_matrix[i] == NULL)
@@ -726,43 +793,24 @@ static int init_lash_structures(lash_t * p_lash)
 	for (i = 0; i < vl_min; i++) {
 		for (j = 0; j < num_switches; j++) {
 			p_lash->cdg_vertex_matrix[i][j] =
-			    (cdg_vertex_t **) malloc(num_switches *
+			    (cdg_vertex_t **) calloc(p_lash->switches[j]->p_sw->num_ports,
 						     sizeof(cdg_vertex_t *));
 			if (p_lash->cdg_vertex_matrix[i][j] == NULL)
 				goto Exit_Mem_Error;
-
-			for (k = 0; k < num_switches; k++)
-				p_lash->cdg_vertex_matrix[i][j][k] = NULL;
 		}
 	}
+	p_lash->cdg_epoch = 0;
 
 	/*
-	 * initialise virtual_location[num_switches][num_switches][num_layers],
-	 * default value = 0
+	 * initialise virtual_location[num_switches][num_switches],
+	 * default value = 0 for all lanes
 	 */
 	p_lash->virtual_location =
-	    (int ***)malloc(num_switches * sizeof(int ***));
+	    calloc(num_switches * num_switches,
+		   sizeof(p_lash->virtual_location[0]));
 	if (p_lash->virtual_location == NULL)
 		goto Exit_Mem_Error;
 
-	for (i = 0; i < num_switches; i++) {
-		p_lash->virtual_location[i] =
-		    (int **)malloc(num_switches * sizeof(int **));
-		if (p_lash->virtual_location[i] == NULL)
-			goto Exit_Mem_Error;
-	}
-
-	for (i = 0; i < num_switches; i++) {
-		for (j = 0; j < num_switches; j++) {
-			p_lash->virtual_location[i][j] =
-			    (int *)malloc(vl_min * sizeof(int *));
-			if (p_lash->virtual_location[i][j] == NULL)
-				goto Exit_Mem_Error;
-			for (k = 0; k < vl_min; k++)
-				p_lash->virtual_location[i][j][k] = 0;
-		}
-	}
-
 	/* initialise num_mst_in_lane[num_switches], default 0 */
 	memset(p_lash->num_mst_in_lane, 0,
 	       IB_MAX_NUM_VLS * sizeof(p_lash->num_mst_in_lane[0]));
@@ -786,15 +834,12 @@ static int lash_core(lash_t * p_lash)
 	unsigned num_switches = p_lash->num_switches;
 	switch_t **switches = p_lash->switches;
 	unsigned lanes_needed = 1;
-	unsigned int i, j, k, dest_switch = 0;
-	reachable_dest_t *dests, *idest;
+	unsigned int i, dest_switch = 0;
 	int cycle_found = 0;
 	unsigned v_lane;
-	int stop = 0, output_link, i_next_switch;
-	int output_link2, i_next_switch2;
+	int stop = 0, output_link, output_link2;
 	int cycle_found2 = 0;
 	int status = -1;
-	int *switch_bitmap = NULL;	/* Bitmap to check if we have processed this pair */
 	unsigned start_vl = p_lash->p_osm->subn.opt.lash_start_vl;
 
 	OSM_LOG_ENTER(p_log);
@@ -804,132 +849,95 @@ static int lash_core(lash_t * p_lash)
 		goto Exit;
 	}
 
-	for (i = 0; i < num_switches; i++) {
-
-		shortest_path(p_lash, i);
-		if (generate_routing_func_for_mst(p_lash, i, &dests)) {
-			OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 4D06: "
-				"generate_routing_func_for_mst failed\n");
-			goto Exit;
-		}
-
-		idest = dests;
-		while (idest != NULL) {
-			dests = dests->next;
-			free(idest);
-			idest = dests;
-		}
-
-		for (j = 0; j < num_switches; j++) {
-			switches[j]->used_channels = 0;
-			switches[j]->q_state = UNQUEUED;
-		}
-	}
-
-	switch_bitmap = calloc(num_switches * num_switches, sizeof(int));
-	if (!switch_bitmap) {
-		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 4D04: "
-			"Failed allocating switch_bitmap - out of memory\n");
+	if (lash_shortest_paths(p_lash)) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 4D06: "
+			"Failed allocating shortest path trees - out of memory\n");
 		goto Exit;
 	}
 
+	/* both directions of a pair are placed at once */
 	for (i = 0; i < num_switches; i++) {
-		for (dest_switch = 0; dest_switch < num_switches; dest_switch++)
-			if (dest_switch != i && switch_bitmap[i * num_switches + dest_switch] == 0) {
-				v_lane = 0;
-				stop = 0;
-				while (v_lane < lanes_needed && stop == 0) {
-					if (generate_cdg_for_sp(p_lash, i, dest_switch, v_lane) ||
-					    generate_cdg_for_sp(p_lash, dest_switch, i, v_lane)) {
-						OSM_LOG(p_log, OSM_LOG_ERROR,
-							"ERR 4D07: generate_cdg_for_sp failed\n");
-						goto Exit;
-					}
-
-					output_link =
-					    switches[i]->routing_table[dest_switch].out_link;
-					output_link2 =
-					    switches[dest_switch]->routing_table[i].out_link;
-
-					i_next_switch = get_next_switch(p_lash, i, output_link);
-					i_next_switch2 = get_next_switch(p_lash, dest_switch, output_link2);
-
-					CL_ASSERT(p_lash->
-						  cdg_vertex_matrix[v_lane][i][i_next_switch] !=
-						  NULL);
-					CL_ASSERT(p_lash->
-						  cdg_vertex_matrix[v_lane][dest_switch]
-						  [i_next_switch2] != NULL);
-
-					cycle_found =
-					    cycle_exists(p_lash->
-							 cdg_vertex_matrix[v_lane][i]
-							 [i_next_switch], NULL, NULL, 1);
-					cycle_found2 =
-					    cycle_exists(p_lash->
-							 cdg_vertex_matrix[v_lane][dest_switch]
-							 [i_next_switch2], NULL, NULL, 1);
-
-					for (j = 0; j < num_switches; j++)
-						for (k = 0; k < num_switches; k++)
-							if (p_lash->
-							    cdg_vertex_matrix[v_lane][j][k] !=
-							    NULL) {
-								p_lash->
-								    cdg_vertex_matrix[v_lane][j]
-								    [k]->visiting_number = 0;
-								p_lash->
-								    cdg_vertex_matrix[v_lane][j]
-								    [k]->seen = 0;
-							}
-
-					if (cycle_found == 1 || cycle_found2 == 1) {
-						remove_temp_depend_for_sp(p_lash, i, dest_switch,
-									  v_lane);
-						remove_temp_depend_for_sp(p_lash, dest_switch, i,
-									  v_lane);
-						v_lane++;
-					} else {
-						set_temp_depend_to_permanent_for_sp(p_lash, i,
-										    dest_switch,
-										    v_lane);
-						set_temp_depend_to_permanent_for_sp(p_lash,
-										    dest_switch, i,
-										    v_lane);
-						stop = 1;
-						p_lash->num_mst_in_lane[v_lane]++;
-						p_lash->num_mst_in_lane[v_lane]++;
-					}
+		if (osm_routing_exec_cancelled(&p_lash->p_osm->routing_exec))
+			goto Exit;
+		for (dest_switch = i + 1; dest_switch < num_switches; dest_switch++) {
+			v_lane = 0;
+			stop = 0;
+			while (v_lane < lanes_needed && stop == 0) {
+				if (generate_cdg_for_sp(p_lash, i, dest_switch, v_lane) ||
+				    generate_cdg_for_sp(p_lash, dest_switch, i, v_lane)) {
+					OSM_LOG(p_log, OSM_LOG_ERROR,
+						"ERR 4D07: generate_cdg_for_sp failed\n");
+					goto Exit;
 				}
 
-				switches[i]->routing_table[dest_switch].lane = v_lane + start_vl;
-				switches[dest_switch]->routing_table[i].lane = v_lane + start_vl;
+				output_link =
+				    switches[i]->routing_table[dest_switch].out_link;
+				output_link2 =
+				    switches[dest_switch]->routing_table[i].out_link;
+
+				CL_ASSERT(p_lash->
+					  cdg_vertex_matrix[v_lane][i][output_link] !=
+					  NULL);
+				CL_ASSERT(p_lash->
+					  cdg_vertex_matrix[v_lane][dest_switch]
+					  [output_link2] != NULL);
+
+				p_lash->cdg_epoch++;
+				cycle_found =
+				    cycle_exists(p_lash->
+						 cdg_vertex_matrix[v_lane][i]
+						 [output_link], NULL, NULL, 1,
+						 p_lash->cdg_epoch);
+				cycle_found2 =
+				    cycle_exists(p_lash->
+						 cdg_vertex_matrix[v_lane][dest_switch]
+						 [output_link2], NULL, NULL, 1,
+						 p_lash->cdg_epoch);
 
 				if (cycle_found == 1 || cycle_found2 == 1) {
-					if (++lanes_needed > p_lash->vl_min)
-						goto Error_Not_Enough_Lanes;
-
-					if (generate_cdg_for_sp(p_lash, i, dest_switch, v_lane) ||
-					    generate_cdg_for_sp(p_lash, dest_switch, i, v_lane)) {
-						OSM_LOG(p_log, OSM_LOG_ERROR,
-							"ERR 4D08: generate_cdg_for_sp failed\n");
-						goto Exit;
-					}
-
-					set_temp_depend_to_permanent_for_sp(p_lash, i, dest_switch,
+					remove_temp_depend_for_sp(p_lash, i, dest_switch,
+								  v_lane);
+					remove_temp_depend_for_sp(p_lash, dest_switch, i,
+								  v_lane);
+					v_lane++;
+				} else {
+					set_temp_depend_to_permanent_for_sp(p_lash, i,
+									    dest_switch,
 									    v_lane);
-					set_temp_depend_to_permanent_for_sp(p_lash, dest_switch, i,
+					set_temp_depend_to_permanent_for_sp(p_lash,
+									    dest_switch, i,
 									    v_lane);
-
+					stop = 1;
 					p_lash->num_mst_in_lane[v_lane]++;
 					p_lash->num_mst_in_lane[v_lane]++;
 				}
-				p_lash->virtual_location[i][dest_switch][v_lane] = 1;
-				p_lash->virtual_location[dest_switch][i][v_lane] = 1;
+			}
+
+			switches[i]->routing_table[dest_switch].lane = v_lane + start_vl;
+			switches[dest_switch]->routing_table[i].lane = v_lane + start_vl;
+
+			if (cycle_found == 1 || cycle_found2 == 1) {
+				if (++lanes_needed > p_lash->vl_min)
+					goto Error_Not_Enough_Lanes;
 
-				switch_bitmap[i * num_switches + dest_switch] = 1;
-				switch_bitmap[dest_switch * num_switches + i] = 1;
+				if (generate_cdg_for_sp(p_lash, i, dest_switch, v_lane) ||
+				    generate_cdg_for_sp(p_lash, dest_switch, i, v_lane)) {
+					OSM_LOG(p_log, OSM_LOG_ERROR,
+						"ERR 4D08: generate_cdg_for_sp failed\n");
+					goto Exit;
+				}
+
+				set_temp_depend_to_permanent_for_sp(p_lash, i, dest_switch,
+								    v_lane);
+				set_temp_depend_to_permanent_for_sp(p_lash, dest_switch, i,
+								    v_lane);
+
+				p_lash->num_mst_in_lane[v_lane]++;
+				p_lash->num_mst_in_lane[v_lane]++;
 			}
+			set_vloc(p_lash, i, dest_switch, v_lane, 1);
+			set_vloc(p_lash, dest_switch, i, v_lane, 1);
+		}
 	}
 
 	for (i = 0; i < lanes_needed; i++)
@@ -957,8 +965,6 @@ Error_Not_Enough_Lanes:
 		" with starting lane (%d)\n",
 		lanes_needed, p_lash->vl_min, start_vl);
 Exit:
-	if (switch_bitmap)
-		free(switch_bitmap);
 	OSM_LOG_EXIT(p_log);
 	return status;
 }
@@ -1054,47 +1060,30 @@ static void populate_fwd_tbls(lash_t * p_lash)
 	OSM_LOG_EXIT(p_log);
 }
 
-static void osm_lash_process_switch(lash_t * p_lash, osm_switch_t * p_sw)
+static void osm_lash_process_switch(lash_t * p_lash, unsigned sw)
 {
 	osm_log_t *p_log = &p_lash->p_osm->log;
-	int i, port_count;
-	osm_physp_t *p_current_physp, *p_remote_physp;
-	unsigned switch_a_lash_id, switch_b_lash_id;
+	osm_graph_t *g = &p_lash->p_osm->sm.ucast_mgr.graph;
+	osm_graph_link_t *link;
 
 	OSM_LOG_ENTER(p_log);
 
-	switch_a_lash_id = get_lash_id(p_sw);
-	port_count = osm_node_get_num_physp(p_sw->p_node);
-
-	/* starting at port 1, ignoring management port on switch */
-	for (i = 1; i < port_count; i++) {
-
-		p_current_physp = osm_node_get_physp_ptr(p_sw->p_node, i);
-		if (p_current_physp) {
-			p_remote_physp = p_current_physp->p_remote_physp;
-			if (p_remote_physp && p_remote_physp->p_node->sw) {
-				int physical_port_a_num =
-				    osm_physp_get_port_num(p_current_physp);
-				int physical_port_b_num =
-				    osm_physp_get_port_num(p_remote_physp);
-				switch_b_lash_id =
-				    get_lash_id(p_remote_physp->p_node->sw);
-
-				connect_switches(p_lash, switch_a_lash_id,
-						 switch_b_lash_id,
-						 physical_port_a_num);
-				OSM_LOG(p_log, OSM_LOG_VERBOSE,
-					"LASH SUCCESS connected G 0x%016" PRIx64
-					" , lash_id(%u), P(%u) " " to G 0x%016"
-					PRIx64 " , lash_id(%u) , P(%u)\n",
-					cl_ntoh64(osm_physp_get_port_guid
-						  (p_current_physp)),
-					switch_a_lash_id, physical_port_a_num,
-					cl_ntoh64(osm_physp_get_port_guid
-						  (p_remote_physp)),
-					switch_b_lash_id, physical_port_b_num);
-			}
-		}
+	/* LASH ids are the switch graph numbers */
+	for (link = &g->links[g->link_start[sw]];
+	     link < &g->links[g->link_start[sw + 1]]; link++) {
+		connect_switches(p_lash, sw, link->sw, link->port);
+		OSM_LOG(p_log, OSM_LOG_VERBOSE,
+			"LASH SUCCESS connected G 0x%016" PRIx64
+			" , lash_id(%u), P(%u) " " to G 0x%016"
+			PRIx64 " , lash_id(%u) , P(%u)\n",
+			cl_ntoh64(osm_physp_get_port_guid
+				  (osm_node_get_physp_ptr(g->sw[sw]->p_node,
+							  link->port))),
+			sw, link->port,
+			cl_ntoh64(osm_physp_get_port_guid
+				  (osm_node_get_physp_ptr(g->sw[link->sw]->p_node,
+							  link->rem_port))),
+			link->sw, link->rem_port);
 	}
 
 	OSM_LOG_EXIT(p_log);
@@ -1132,13 +1121,13 @@ static void lash_cleanup(lash_t * p_lash)
 
 static int discover_network_properties(lash_t * p_lash)
 {
-	int i, id = 0;
-	uint8_t vl_min;
-	osm_subn_t *p_subn = &p_lash->p_osm->subn;
-	osm_switch_t *p_next_sw, *p_sw;
+	unsigned i, id;
+	uint8_t vl_min, port_vl_min;
+	osm_graph_t *g = &p_lash->p_osm->sm.ucast_mgr.graph;
+	osm_switch_t *p_sw;
 	osm_log_t *p_log = &p_lash->p_osm->log;
 
-	p_lash->num_switches = cl_qmap_count(&p_subn->sw_guid_tbl);
+	p_lash->num_switches = g->num_sw;
 
 	p_lash->switches = calloc(p_lash->num_switches, sizeof(switch_t *));
 	if (!p_lash->switches)
@@ -1146,36 +1135,30 @@ static int discover_network_properties(lash_t * p_lash)
 
 	vl_min = 5;		/* set to a high value */
 
-	p_next_sw = (osm_switch_t *) cl_qmap_head(&p_subn->sw_guid_tbl);
-	while (p_next_sw != (osm_switch_t *) cl_qmap_end(&p_subn->sw_guid_tbl)) {
-		uint16_t port_count;
-		p_sw = p_next_sw;
-		p_next_sw = (osm_switch_t *) cl_qmap_next(&p_sw->map_item);
+	for (id = 0; id < g->num_sw; id++) {
+		p_sw = g->sw[id];
 
 		p_lash->switches[id] = switch_create(p_lash, id, p_sw);
 		if (!p_lash->switches[id])
 			return -1;
-		id++;
-
-		port_count = osm_node_get_num_physp(p_sw->p_node);
-
-		/* Note, ignoring port 0. management port */
-		for (i = 1; i < port_count; i++) {
-			osm_physp_t *p_current_physp =
-			    osm_node_get_physp_ptr(p_sw->p_node, i);
-
-			if (p_current_physp
-			    && p_current_physp->p_remote_physp) {
 
-				ib_port_info_t *p_port_info =
-				    &p_current_physp->port_info;
-				uint8_t port_vl_min =
-				    ib_port_info_get_op_vls(p_port_info);
-				if (port_vl_min && port_vl_min < vl_min)
-					vl_min = port_vl_min;
-			}
-		}		/* for */
-	}			/* while */
+		/* Note, the graph ignores port 0. management port */
+		for (i = g->link_start[id]; i < g->link_start[id + 1]; i++) {
+			port_vl_min = ib_port_info_get_op_vls(
+			    &osm_node_get_physp_ptr(p_sw->p_node,
+						    g->links[i].port)->port_info);
+			if (port_vl_min && port_vl_min < vl_min)
+				vl_min = port_vl_min;
+		}
+		for (i = g->endport_start[id]; i < g->endport_start[id + 1];
+		     i++) {
+			port_vl_min = ib_port_info_get_op_vls(
+			    &osm_node_get_physp_ptr(p_sw->p_node,
+						    g->endports[i].port)->port_info);
+			if (port_vl_min && port_vl_min < vl_min)
+				vl_min = port_vl_min;
+		}
+	}
 
 	vl_min = 1 << (vl_min - 1);
 	if (vl_min > 15)
@@ -1199,18 +1182,12 @@ static int discover_network_properties(lash_t * p_lash)
 
 static void process_switches(lash_t * p_lash)
 {
-	osm_switch_t *p_sw, *p_next_sw;
-	osm_subn_t *p_subn = &p_lash->p_osm->subn;
+	unsigned sw;
 
 	/* Go through each switch and process it. i.e build the connection
 	   structure required by LASH */
-	p_next_sw = (osm_switch_t *) cl_qmap_head(&p_subn->sw_guid_tbl);
-	while (p_next_sw != (osm_switch_t *) cl_qmap_end(&p_subn->sw_guid_tbl)) {
-		p_sw = p_next_sw;
-		p_next_sw = (osm_switch_t *) cl_qmap_next(&p_sw->map_item);
-
-		osm_lash_process_switch(p_lash, p_sw);
-	}
+	for (sw = 0; sw < (unsigned)p_lash->num_switches; sw++)
+		osm_lash_process_switch(p_lash, sw);
 }
 
 static int lash_process(void *context)
@@ -1323,6 +1300,7 @@ int osm_ucast_lash_setup(struct osm_routing_engine *r, osm_opensm_t *p_osm)
 		return -1;
 
 	r->context = p_lash;
+	r->flags = OSM_ROUTING_ENGINE_PATH_SL_MT_SAFE;
 	r->ucast_build_fwd_tables = lash_process;
 	r->path_sl = get_lash_sl;
 	r->destroy = lash_delete;
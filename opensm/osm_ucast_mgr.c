@@ -47,6 +47,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
 #include <iba/ib_types.h>
 #include <complib/cl_qmap.h>
 #include <complib/cl_debug.h>
@@ -65,6 +68,7 @@
 void osm_ucast_mgr_construct(IN osm_ucast_mgr_t * p_mgr)
 {
 	memset(p_mgr, 0, sizeof(*p_mgr));
+	osm_graph_construct(&p_mgr->graph);
 }
 
 void osm_ucast_mgr_destroy(IN osm_ucast_mgr_t * p_mgr)
@@ -76,6 +80,8 @@ void osm_ucast_mgr_destroy(IN osm_ucast_mgr_t * p_mgr)
 	if (p_mgr->cache_valid)
 		osm_ucast_cache_invalidate(p_mgr);
 
+	osm_graph_destroy(&p_mgr->graph);
+
 	OSM_LOG_EXIT(p_mgr->p_log);
 }
 
@@ -133,8 +139,8 @@ static void ucast_mgr_process_neighbor(IN osm_ucast_mgr_t * p_mgr,
 				       IN uint8_t port_num,
 				       IN uint8_t remote_port_num)
 {
-	osm_switch_t *p_sw;
-	cl_map_item_t *item;
+	osm_graph_t *g = &p_mgr->graph;
+	uint32_t i;
 	uint16_t lid_ho;
 	uint16_t hops;
 	osm_physp_t *p;
@@ -150,11 +156,8 @@ static void ucast_mgr_process_neighbor(IN osm_ucast_mgr_t * p_mgr,
 
 	p = osm_node_get_physp_ptr(p_this_sw->p_node, port_num);
 
-	for (item = cl_qmap_head(&p_mgr->p_subn->sw_guid_tbl);
-	     item != cl_qmap_end(&p_mgr->p_subn->sw_guid_tbl);
-	     item = cl_qmap_next(item)) {
-		p_sw = (osm_switch_t *) item;
-		lid_ho = cl_ntoh16(osm_node_get_base_lid(p_sw->p_node, 0));
+	for (i = 0; i < g->num_sw; i++) {
+		lid_ho = g->lid[i];
 		hops = osm_switch_get_least_hops(p_remote_sw, lid_ho);
 		if (hops == OSM_NO_PATH)
 			continue;
@@ -394,51 +397,29 @@ static void ucast_mgr_process_tbl(IN cl_map_item_t * p_map_item,
 	OSM_LOG_EXIT(p_mgr->p_log);
 }
 
-static void ucast_mgr_process_neighbors(IN cl_map_item_t * p_map_item,
-					IN void *context)
+static void ucast_mgr_process_neighbors(IN osm_ucast_mgr_t * p_mgr,
+					IN uint32_t sw)
 {
-	osm_switch_t * p_sw = (osm_switch_t *) p_map_item;
-	osm_ucast_mgr_t * p_mgr = context;
-	osm_node_t *p_node;
-	osm_node_t *p_remote_node;
-	uint32_t port_num;
-	uint8_t remote_port_num;
-	uint32_t num_ports;
-	osm_physp_t *p_physp;
+	osm_graph_t *g = &p_mgr->graph;
+	osm_switch_t *p_sw = g->sw[sw];
+	osm_graph_link_t *link;
 
 	OSM_LOG_ENTER(p_mgr->p_log);
 
-	p_node = p_sw->p_node;
-
-	CL_ASSERT(p_node);
-	CL_ASSERT(osm_node_get_type(p_node) == IB_NODE_TYPE_SWITCH);
-
 	OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
 		"Processing switch with GUID 0x%" PRIx64 "\n",
-		cl_ntoh64(osm_node_get_node_guid(p_node)));
-
-	num_ports = osm_node_get_num_physp(p_node);
+		cl_ntoh64(osm_node_get_node_guid(p_sw->p_node)));
 
-	/*
-	   Start with port 1 to skip the switch's management port.
-	 */
-	for (port_num = 1; port_num < num_ports; port_num++) {
-		p_remote_node = osm_node_get_remote_node(p_node,
-							 (uint8_t) port_num,
-							 &remote_port_num);
-		if (p_remote_node && p_remote_node->sw
-		    && (p_remote_node != p_node)) {
-			/* make sure the link is healthy. If it is not - don't
-			   propagate through it. */
-			p_physp = osm_node_get_physp_ptr(p_node, port_num);
-			if (!p_physp || !osm_link_is_healthy(p_physp))
-				continue;
+	/* the graph links already skip the switch's management port */
+	for (link = &g->links[g->link_start[sw]];
+	     link < &g->links[g->link_start[sw + 1]]; link++) {
+		/* make sure the link is healthy. If it is not - don't
+		   propagate through it. */
+		if (link->sw == sw || !link->healthy)
+			continue;
 
-			ucast_mgr_process_neighbor(p_mgr, p_sw,
-						   p_remote_node->sw,
-						   (uint8_t) port_num,
-						   remote_port_num);
-		}
+		ucast_mgr_process_neighbor(p_mgr, p_sw, g->sw[link->sw],
+					   link->port, link->rem_port);
 	}
 
 	OSM_LOG_EXIT(p_mgr->p_log);
@@ -595,7 +576,7 @@ static int set_search_ordering_ports(void *ctx, uint64_t guid, char *p)
 
 int osm_ucast_mgr_build_lid_matrices(IN osm_ucast_mgr_t * p_mgr)
 {
-	uint32_t i;
+	uint32_t i, sw;
 	uint32_t iteration_max;
 	cl_qmap_t *p_sw_guid_tbl;
 
@@ -664,8 +645,8 @@ int osm_ucast_mgr_build_lid_matrices(IN osm_ucast_mgr_t * p_mgr)
 		for (i = 0; (i < iteration_max) && p_mgr->some_hop_count_set;
 		     i++) {
 			p_mgr->some_hop_count_set = FALSE;
-			cl_qmap_apply_func(p_sw_guid_tbl,
-					   ucast_mgr_process_neighbors, p_mgr);
+			for (sw = 0; sw < p_mgr->graph.num_sw; sw++)
+				ucast_mgr_process_neighbors(p_mgr, sw);
 		}
 		OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
 			"Min-hop propagated in %d steps\n", i);
@@ -971,6 +952,73 @@ static void ucast_mgr_set_fwd_top(IN cl_map_item_t * p_map_item,
 	OSM_LOG_EXIT(p_mgr->p_log);
 }
 
+/**********************************************************************
+ LFT snapshot file layout (all fields in network byte order):
+   header: magic, version, subnet prefix, port guid of the writing SM,
+	   write sequence number and time, number of switch records
+   per switch: node guid, LFT size, LinearFDBTop, followed by LFT size
+	   bytes of LFT
+ **********************************************************************/
+#define OSM_LFT_SNAPSHOT_MAGIC		0x4f534d4c	/* "OSML" */
+#define OSM_LFT_SNAPSHOT_VERSION	2
+
+typedef struct lft_snapshot_hdr {
+	uint32_t magic;
+	uint32_t version;
+	ib_net64_t subnet_prefix;
+	ib_net64_t sm_port_guid;
+	uint64_t time;
+	uint32_t seq;
+	uint32_t num_switches;
+} lft_snapshot_hdr_t;
+
+typedef struct lft_snapshot_sw {
+	ib_net64_t node_guid;
+	uint16_t lft_size;
+	ib_net16_t lin_top;
+	uint16_t reserved[2];
+} lft_snapshot_sw_t;
+
+/**********************************************************************
+ The switches LFTs are about to change, so the snapshot (if any) no
+ longer describes them. Remove it before sending the first block, so
+ a standby taking over in the middle will not trust it.
+ **********************************************************************/
+static void lft_snapshot_invalidate(IN osm_ucast_mgr_t * p_mgr)
+{
+	const char *file_name = p_mgr->p_subn->opt.lft_snapshot_file;
+
+	if (!file_name || p_mgr->lft_snapshot_stale)
+		return;
+
+	p_mgr->lft_snapshot_stale = TRUE;
+	p_mgr->lft_snapshot_written = FALSE;
+	if (unlink(file_name) && errno != ENOENT)
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A11: "
+			"Cannot remove LFT snapshot file '%s': %s\n",
+			file_name, strerror(errno));
+}
+
+void osm_ucast_mgr_lft_snapshot_drop(IN osm_ucast_mgr_t * p_mgr)
+{
+	const char *file_name = p_mgr->p_subn->opt.lft_snapshot_file;
+
+	p_mgr->lft_snapshot_master = 0;
+	if (!file_name || !p_mgr->lft_snapshot_written)
+		return;
+
+	p_mgr->lft_snapshot_written = FALSE;
+	p_mgr->lft_snapshot_stale = FALSE;
+	if (unlink(file_name) && errno != ENOENT)
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A11: "
+			"Cannot remove LFT snapshot file '%s': %s\n",
+			file_name, strerror(errno));
+	else
+		OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+			"Removed LFT snapshot file '%s' on leaving "
+			"MASTER state\n", file_name);
+}
+
 static int set_lft_block(IN osm_switch_t *p_sw, IN osm_ucast_mgr_t *p_mgr,
 			 IN uint16_t block_id_ho)
 {
@@ -979,18 +1027,6 @@ static int set_lft_block(IN osm_switch_t *p_sw, IN osm_ucast_mgr_t *p_mgr,
 	osm_physp_t *p_physp;
 	ib_api_status_t status;
 
-	/*
-	   Send linear forwarding table blocks to the switch
-	   as long as the switch indicates it has blocks needing
-	   configuration.
-	 */
-	if (!p_sw->new_lft) {
-		/* any routing should provide the new_lft */
-		CL_ASSERT(p_mgr->p_subn->opt.use_ucast_cache &&
-			  p_mgr->cache_valid && !p_sw->need_update);
-		return -1;
-	}
-
 	p_physp = osm_node_get_physp_ptr(p_sw->p_node, 0);
 	if (!p_physp)
 		return -1;
@@ -1000,11 +1036,7 @@ static int set_lft_block(IN osm_switch_t *p_sw, IN osm_ucast_mgr_t *p_mgr,
 	context.lft_context.node_guid = osm_node_get_node_guid(p_sw->p_node);
 	context.lft_context.set_method = TRUE;
 
-	if (!p_sw->need_update && !p_mgr->p_subn->need_update &&
-	    !memcmp(p_sw->new_lft + block_id_ho * IB_SMP_DATA_SIZE,
-		    p_sw->lft + block_id_ho * IB_SMP_DATA_SIZE,
-		    IB_SMP_DATA_SIZE))
-		return 0;
+	lft_snapshot_invalidate(p_mgr);
 
 	/*
 	 * Zero the stored LFT block, so in case the MAD will end up
@@ -1034,17 +1066,103 @@ static int set_lft_block(IN osm_switch_t *p_sw, IN osm_ucast_mgr_t *p_mgr,
 	return 0;
 }
 
+/**********************************************************************
+ Lists the LFT blocks (below max_block) to send to the switch: all of
+ them when it needs a full update, otherwise the ones whose new
+ contents differ from what the switch holds.
+ **********************************************************************/
+static unsigned lft_dirty_blocks(IN osm_switch_t * p_sw,
+				 IN osm_ucast_mgr_t * p_mgr,
+				 IN unsigned max_block, OUT uint16_t * blocks)
+{
+	unsigned i;
+
+	if (!p_sw->new_lft) {
+		/* any routing should provide the new_lft */
+		CL_ASSERT(p_mgr->p_subn->opt.use_ucast_cache &&
+			  p_mgr->cache_valid && !p_sw->need_update);
+		return 0;
+	}
+
+	if (max_block > p_sw->lft_size / IB_SMP_DATA_SIZE)
+		max_block = p_sw->lft_size / IB_SMP_DATA_SIZE;
+
+	if (!p_sw->need_update &&
+	    (!p_mgr->p_subn->need_update || p_sw->lft_preloaded))
+		return osm_lft_diff_blocks(p_sw->new_lft, p_sw->lft,
+					   max_block, blocks);
+
+	for (i = 0; i < max_block; i++)
+		blocks[i] = i;
+	return max_block;
+}
+
+typedef struct lft_dirty {
+	osm_switch_t *p_sw;
+	uint16_t *blocks;
+	unsigned count;
+	unsigned next;
+} lft_dirty_t;
+
 static void ucast_mgr_pipeline_fwd_tbl(osm_ucast_mgr_t * p_mgr)
 {
 	cl_qmap_t *tbl;
 	cl_map_item_t *item;
-	unsigned i, max_block = p_mgr->max_lid / IB_SMP_DATA_SIZE + 1;
+	unsigned i, j, num_sw, max_block = p_mgr->max_lid / IB_SMP_DATA_SIZE + 1;
+	uint16_t stack_blocks[IB_LID_UCAST_END_HO / IB_SMP_DATA_SIZE + 1];
+	uint16_t *blocks;
+	lft_dirty_t *dirty;
 
 	tbl = &p_mgr->p_subn->sw_guid_tbl;
-	for (i = 0; i < max_block; i++)
+	num_sw = cl_qmap_count(tbl);
+
+	/*
+	 * Find the blocks to send to each switch first, so that the
+	 * striping below only walks the blocks which changed.
+	 */
+	dirty = malloc(num_sw * sizeof(*dirty));
+	blocks = malloc(num_sw * max_block * sizeof(*blocks));
+	if (!dirty || !blocks) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A18: "
+			"No memory to stripe LFT blocks, "
+			"sending them switch by switch\n");
+		if (max_block > sizeof(stack_blocks) / sizeof(stack_blocks[0]))
+			max_block = sizeof(stack_blocks) / sizeof(stack_blocks[0]);
 		for (item = cl_qmap_head(tbl); item != cl_qmap_end(tbl);
-		     item = cl_qmap_next(item))
-			set_lft_block((osm_switch_t *)item, p_mgr, i);
+		     item = cl_qmap_next(item)) {
+			j = lft_dirty_blocks((osm_switch_t *) item, p_mgr,
+					     max_block, stack_blocks);
+			for (i = 0; i < j; i++)
+				set_lft_block((osm_switch_t *) item, p_mgr,
+					      stack_blocks[i]);
+		}
+		goto Exit;
+	}
+
+	for (item = cl_qmap_head(tbl), j = 0; item != cl_qmap_end(tbl);
+	     item = cl_qmap_next(item), j++) {
+		dirty[j].p_sw = (osm_switch_t *) item;
+		dirty[j].blocks = blocks + j * max_block;
+		dirty[j].count = lft_dirty_blocks(dirty[j].p_sw, p_mgr,
+						  max_block, dirty[j].blocks);
+		dirty[j].next = 0;
+	}
+
+	for (i = 0; i < max_block; i++)
+		for (j = 0; j < num_sw; j++)
+			if (dirty[j].next < dirty[j].count &&
+			    dirty[j].blocks[dirty[j].next] == i) {
+				set_lft_block(dirty[j].p_sw, p_mgr, i);
+				dirty[j].next++;
+			}
+
+Exit:
+	free(blocks);
+	free(dirty);
+
+	for (item = cl_qmap_head(tbl); item != cl_qmap_end(tbl);
+	     item = cl_qmap_next(item))
+		((osm_switch_t *)item)->lft_preloaded = FALSE;
 }
 
 void osm_ucast_mgr_set_fwd_tables(osm_ucast_mgr_t * p_mgr)
@@ -1057,6 +1175,204 @@ void osm_ucast_mgr_set_fwd_tables(osm_ucast_mgr_t * p_mgr)
 	ucast_mgr_pipeline_fwd_tbl(p_mgr);
 }
 
+/**********************************************************************
+ Restore the LFTs programmed by the previous master, so only the
+ blocks which differ from them are sent. The file is only trusted when
+ written by the master this SM was polling as a standby until it
+ stopped answering: that master removes it before changing any LFT
+ block and when leaving MASTER state. Switches which were reset
+ (need_update) or whose LinearFDBTop differs from the one recorded
+ are skipped and get fully reprogrammed.
+ **********************************************************************/
+static void lft_snapshot_load(IN osm_ucast_mgr_t * p_mgr)
+{
+	const char *file_name = p_mgr->p_subn->opt.lft_snapshot_file;
+	ib_net64_t master_guid = p_mgr->lft_snapshot_master;
+	lft_snapshot_hdr_t hdr;
+	lft_snapshot_sw_t rec;
+	osm_switch_t *p_sw;
+	uint32_t i, num_switches;
+	unsigned loaded = 0, mismatched = 0;
+	uint16_t lft_size, copy_size;
+	FILE *file;
+
+	/* a snapshot is trusted for one takeover only */
+	p_mgr->lft_snapshot_master = 0;
+
+	if (!file_name)
+		return;
+
+	if (!master_guid) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+			"Not taking over from a failed master. "
+			"Skip LFT snapshot restore\n");
+		return;
+	}
+
+	file = fopen(file_name, "rb");
+	if (!file) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+			"Cannot open LFT snapshot file '%s': %s. "
+			"Skip restore\n", file_name, strerror(errno));
+		return;
+	}
+
+	if (fread(&hdr, sizeof(hdr), 1, file) != 1 ||
+	    cl_ntoh32(hdr.magic) != OSM_LFT_SNAPSHOT_MAGIC ||
+	    cl_ntoh32(hdr.version) != OSM_LFT_SNAPSHOT_VERSION ||
+	    hdr.subnet_prefix != p_mgr->p_subn->opt.subnet_prefix) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A12: "
+			"LFT snapshot file '%s' is invalid or belongs to "
+			"another subnet. Skip restore\n", file_name);
+		goto Exit;
+	}
+
+	if (hdr.sm_port_guid != master_guid) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A19: "
+			"LFT snapshot file '%s' was written by SM 0x%016"
+			PRIx64 ", not by the last master 0x%016" PRIx64
+			". Skip restore\n", file_name,
+			cl_ntoh64(hdr.sm_port_guid), cl_ntoh64(master_guid));
+		goto Exit;
+	}
+
+	num_switches = cl_ntoh32(hdr.num_switches);
+	for (i = 0; i < num_switches; i++) {
+		if (fread(&rec, sizeof(rec), 1, file) != 1)
+			break;
+		lft_size = cl_ntoh16(rec.lft_size);
+		p_sw = osm_get_switch_by_guid(p_mgr->p_subn, rec.node_guid);
+		if (p_sw && rec.lin_top != p_sw->switch_info.lin_top)
+			mismatched++;
+		if (!p_sw || p_sw->need_update || !p_sw->lft ||
+		    rec.lin_top != p_sw->switch_info.lin_top) {
+			if (fseek(file, lft_size, SEEK_CUR))
+				break;
+			continue;
+		}
+
+		copy_size = lft_size < p_sw->lft_size ?
+			    lft_size : p_sw->lft_size;
+		if (fread(p_sw->lft, 1, copy_size, file) != copy_size ||
+		    fseek(file, lft_size - copy_size, SEEK_CUR)) {
+			memset(p_sw->lft, OSM_NO_PATH, p_sw->lft_size);
+			break;
+		}
+		p_sw->lft_preloaded = TRUE;
+		loaded++;
+	}
+
+	if (i < num_switches)
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A13: "
+			"LFT snapshot file '%s' is truncated\n", file_name);
+
+	if (mismatched)
+		OSM_LOG(p_mgr->p_log, OSM_LOG_INFO,
+			"LinearFDBTop of %u switches differs from LFT "
+			"snapshot file '%s'\n", mismatched, file_name);
+
+	OSM_LOG(p_mgr->p_log, OSM_LOG_INFO,
+		"Restored LFTs of %u switches from '%s' "
+		"(written by SM 0x%016" PRIx64 ", sequence %u)\n", loaded,
+		file_name, cl_ntoh64(hdr.sm_port_guid), cl_ntoh32(hdr.seq));
+Exit:
+	fclose(file);
+}
+
+int osm_ucast_mgr_lft_snapshot_dump(IN osm_ucast_mgr_t * p_mgr)
+{
+	const char *file_name = p_mgr->p_subn->opt.lft_snapshot_file;
+	cl_qmap_t *p_sw_tbl = &p_mgr->p_subn->sw_guid_tbl;
+	lft_snapshot_hdr_t hdr;
+	lft_snapshot_sw_t rec;
+	cl_map_item_t *item;
+	osm_switch_t *p_sw;
+	char *tmp_name;
+	FILE *file;
+	int ret = -1;
+
+	if (!file_name || !p_mgr->lft_snapshot_stale)
+		return 0;
+
+	tmp_name = malloc(strlen(file_name) + 5);
+	if (!tmp_name) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A14: "
+			"Cannot allocate memory for LFT snapshot file name\n");
+		return -1;
+	}
+	sprintf(tmp_name, "%s.tmp", file_name);
+
+	file = fopen(tmp_name, "wb");
+	if (!file) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A15: "
+			"Cannot open file '%s' for writing: %s\n",
+			tmp_name, strerror(errno));
+		goto Exit;
+	}
+
+	CL_PLOCK_ACQUIRE(p_mgr->p_lock);
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = cl_hton32(OSM_LFT_SNAPSHOT_MAGIC);
+	hdr.version = cl_hton32(OSM_LFT_SNAPSHOT_VERSION);
+	hdr.subnet_prefix = p_mgr->p_subn->opt.subnet_prefix;
+	hdr.sm_port_guid = p_mgr->p_subn->sm_port_guid;
+	hdr.time = cl_hton64((uint64_t) time(NULL));
+	hdr.seq = cl_hton32(p_mgr->lft_snapshot_seq + 1);
+	for (item = cl_qmap_head(p_sw_tbl); item != cl_qmap_end(p_sw_tbl);
+	     item = cl_qmap_next(item))
+		if (((osm_switch_t *) item)->lft)
+			hdr.num_switches++;
+	hdr.num_switches = cl_hton32(hdr.num_switches);
+	fwrite(&hdr, sizeof(hdr), 1, file);
+
+	memset(&rec, 0, sizeof(rec));
+	for (item = cl_qmap_head(p_sw_tbl); item != cl_qmap_end(p_sw_tbl);
+	     item = cl_qmap_next(item)) {
+		p_sw = (osm_switch_t *) item;
+		if (!p_sw->lft)
+			continue;
+		rec.node_guid = osm_node_get_node_guid(p_sw->p_node);
+		rec.lft_size = cl_hton16(p_sw->lft_size);
+		rec.lin_top = p_sw->switch_info.lin_top;
+		fwrite(&rec, sizeof(rec), 1, file);
+		fwrite(p_sw->lft, 1, p_sw->lft_size, file);
+	}
+
+	CL_PLOCK_RELEASE(p_mgr->p_lock);
+
+	if (fflush(file) ||
+	    (p_mgr->p_subn->opt.fsync_high_avail_files &&
+	     fsync(fileno(file))) || ferror(file)) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A16: "
+			"Failed to write LFT snapshot file '%s': %s\n",
+			tmp_name, strerror(errno));
+		fclose(file);
+		unlink(tmp_name);
+		goto Exit;
+	}
+	fclose(file);
+
+	if (rename(tmp_name, file_name)) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A17: "
+			"Failed to rename '%s' to '%s': %s\n",
+			tmp_name, file_name, strerror(errno));
+		unlink(tmp_name);
+		goto Exit;
+	}
+
+	p_mgr->lft_snapshot_stale = FALSE;
+	p_mgr->lft_snapshot_written = TRUE;
+	p_mgr->lft_snapshot_seq++;
+	OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+		"LFT snapshot %u written to '%s'\n", p_mgr->lft_snapshot_seq,
+		file_name);
+	ret = 0;
+Exit:
+	free(tmp_name);
+	return ret;
+}
+
 static int ucast_mgr_route(struct osm_routing_engine *r, osm_opensm_t * osm)
 {
 	int ret;
@@ -1114,18 +1430,30 @@ int osm_ucast_mgr_process(IN osm_ucast_mgr_t * p_mgr)
 	   If there are no switches in the subnet, we are done.
 	 */
 	if (cl_qmap_count(p_sw_guid_tbl) == 0 ||
-	    ucast_mgr_setup_all_switches(p_mgr->p_subn) < 0)
+	    ucast_mgr_setup_all_switches(p_mgr->p_subn) < 0 ||
+	    osm_graph_build(&p_mgr->graph, p_mgr->p_subn) < 0)
 		goto Exit;
 
+	if (p_mgr->p_subn->coming_out_of_standby)
+		lft_snapshot_load(p_mgr);
+
 	failed = -1;
 	p_osm->routing_engine_used = NULL;
 	while (p_routing_eng) {
 		failed = ucast_mgr_route(p_routing_eng, p_osm);
-		if (!failed)
+		if (!failed ||
+		    osm_routing_exec_cancelled(&p_osm->routing_exec))
 			break;
 		p_routing_eng = p_routing_eng->next;
 	}
 
+	if (failed && osm_routing_exec_cancelled(&p_osm->routing_exec)) {
+		/* the tables may be half built, route again next sweep */
+		OSM_LOG(p_mgr->p_log, OSM_LOG_INFO, "Routing cancelled\n");
+		p_mgr->p_subn->force_heavy_sweep = TRUE;
+		goto Exit;
+	}
+
 	if (!p_osm->routing_engine_used &&
 	    p_osm->no_fallback_routing_engine != TRUE) {
 		/* If configured routing algorithm failed, use default MinHop */
@@ -61,6 +61,7 @@
 #include <string.h>
 #include <search.h>
 #include <complib/cl_heap.h>
+#include <complib/cl_work_pool.h>
 #include <opensm/osm_file_ids.h>
 #define FILE_ID OSM_FILE_UCAST_NUE_C
 #include <opensm/osm_ucast_mgr.h>
@@ -145,6 +146,8 @@ typedef struct network_node {
 	uint8_t num_adj_terminals_in_convex_hull;	/*!< Helper for betw. */
 	/* additionally needed for cCDG escape path assignment */
 	boolean_t has_adj_destinations;	/*!< Add reverse path to escape path. */
+	/* additionally needed for routing virtual layers on copies */
+	uint32_t *num_paths;	/*!< Paths per port (only in layer copies). */
 } network_node_t;
 
 /*! \struct network
@@ -173,6 +176,7 @@ typedef struct ccdg_edge {
 	/* color coding to easily identify if cycle search is needed */
 	color_t *color;			/*!< Pointer to current coloring. */
 	boolean_t wet_paint;		/*!< TRUE if color changed recently. */
+	uint32_t color_gen;		/*!< Coloring the color belongs to. */
 } ccdg_edge_t;
 
 /*! \struct ccdg_node
@@ -190,9 +194,11 @@ typedef struct ccdg_node {
 	/* color coding to easily identify if cycle search is needed */
 	color_t *color;		/*!< Pointer to current coloring. */
 	boolean_t wet_paint;	/*!< TRUE if color changed in this iteration. */
+	uint32_t color_gen;	/*!< Coloring the color belongs to. */
 	/* for cycle search in cdg */
 	uint8_t status;		/*!< Helper for iterative cycle search. */
 	uint8_t next_edge_idx;	/*!< Save next edge to check after using pre. */
+	uint32_t search_gen;	/*!< Last cycle search which finished this. */
 	struct ccdg_node *pre;	/*!< Track traversal in cycle search in cCDG. */
 } ccdg_node_t;
 
@@ -202,8 +208,14 @@ typedef struct ccdg_node {
 typedef struct ccdg {
 	uint32_t num_nodes;	/*!< NUmber of nodes in the complete CDG. */
 	ccdg_node_t *nodes;	/*!< Array storing nodes of the complete CDG. */
+	uint32_t num_edges;	/*!< Number of edges in the complete CDG. */
+	ccdg_edge_t *edges;	/*!< Edges of all nodes, grouped by node. */
 	uint32_t num_colors;	/*!< Size of the color array. */
 	color_t *color_array;	/*!< Distinguish disjoint acyclic sub-CDGs. */
+	uint32_t color_gen;	/*!< Current coloring, older colors are UNUSED. */
+	uint32_t search_gen;	/*!< Identifies the current cycle search. */
+	uint32_t num_wet_edges;	/*!< Number of edges in the wet edge list. */
+	ccdg_edge_t **wet_edges;	/*!< Edges painted in this routing step. */
 	cl_heap_t heap;		/*!< Heap object for faster Dijkstra's algo. */
 } ccdg_t;
 
@@ -222,6 +234,7 @@ typedef struct nue_context {
 	/* external parts */
 	osm_routing_engine_type_t routing_type;	/*!< Name of routing engine. */
 	osm_ucast_mgr_t *mgr;	/*!< Pointer to osm management object. */
+	osm_routing_exec_t *exec;	/*!< Worker threads and cancellation. */
 	/* internal parts */
 	network_t network;	/*!< Network object storing fabric copy. */
 	ccdg_t ccdg;		/*!< Complete CDG object for the fabric. */
@@ -232,6 +245,26 @@ typedef struct nue_context {
 	uint8_t *dlid_to_vl_mapping;	/*!< Store VLs to serve path_sl requ. */
 } nue_context_t;
 
+/*! \struct nue_layer
+ *  \brief Private copy of network and cCDG to route one virtual layer.
+ */
+typedef struct nue_layer {
+	network_t network;	/*!< Network copy with own link weights. */
+	ccdg_t ccdg;		/*!< Complete CDG copy for this layer. */
+} nue_layer_t;
+
+/*! \struct nue_layers
+ *  \brief Shared state of the virtual layers routed on copies.
+ */
+typedef struct nue_layers {
+	nue_context_t *nue_ctx;	/*!< Nue context the layers belong to. */
+	boolean_t include_switches;	/*!< Switches are traffic sinks. */
+	nue_layer_t *copies;	/*!< One copy per worker thread. */
+	uint64_t *weight_incr;	/*!< Summed weight increase of each link. */
+	cl_spinlock_t lock;	/*!< Guards weight_incr, port profiles, err. */
+	int err;		/*!< Result of the routing of all layers. */
+} nue_layers_t;
+
 #if defined (ENABLE_METIS_FOR_NUE)
 /*! \struct metis_context
  *  \brief Complete information about fabric graph to perform partitioning.
@@ -250,7 +283,7 @@ typedef struct metis_context {
 
 /*************** predefine all internal functions *********************
  **********************************************************************/
-/*! \fn add_ccdg_edge_betw_nodes_to_colored_subccdg(const ccdg_t *,
+/*! \fn add_ccdg_edge_betw_nodes_to_colored_subccdg(ccdg_t *,
  *                                                  const ccdg_node_t *,
  *                                                  const ccdg_node_t *,
  *                                                  ccdg_edge_t *)
@@ -266,12 +299,12 @@ typedef struct metis_context {
  *  \return NONE
  */
 static inline void
-add_ccdg_edge_betw_nodes_to_colored_subccdg(const ccdg_t *,
+add_ccdg_edge_betw_nodes_to_colored_subccdg(ccdg_t *,
 					    const ccdg_node_t *,
 					    const ccdg_node_t *,
 					    ccdg_edge_t *);
 
-/*! \fn add_ccdg_node_to_colored_subccdg(const ccdg_t *,
+/*! \fn add_ccdg_node_to_colored_subccdg(ccdg_t *,
  *                                       const ccdg_node_t *,
  *                                       ccdg_node_t *)
  *  \brief This fn colors ccdg_node2 in the same color as ccdg_node1 by changing
@@ -284,7 +317,7 @@ add_ccdg_edge_betw_nodes_to_colored_subccdg(const ccdg_t *,
  *  \return NONE
  */
 static inline void
-add_ccdg_node_to_colored_subccdg(const ccdg_t *,
+add_ccdg_node_to_colored_subccdg(ccdg_t *,
 				 const ccdg_node_t *,
 				 ccdg_node_t *);
 
@@ -304,7 +337,7 @@ add_link_to_stack_of_used_links(network_node_t *,
 /*! \fn attempt_local_backtracking(const osm_ucast_mgr_t *,
  *                                 const network_t *,
  *                                 const network_node_t *,
- *                                 const ccdg_t *,
+ *                                 ccdg_t *,
  *                                 const int32_t)
  *  \brief Check alternative paths within a small radius to find and use valid
  *         channel dependencies which won't close a cycle in the cCDG.
@@ -326,13 +359,13 @@ static ccdg_node_t *
 attempt_local_backtracking(const osm_ucast_mgr_t *,
 			   const network_t *,
 			   const network_node_t *,
-			   const ccdg_t *,
+			   ccdg_t *,
 			   const int32_t);
 
 /*! \fn attempt_shortcut_discovery(const osm_ucast_mgr_t *,
  *                                 const network_t *,
  *                                 const network_node_t *,
- *                                 const ccdg_t *,
+ *                                 ccdg_t *,
  *                                 const ccdg_node_t *,
  *                                 const int32_t color)
  *  \brief Check for alternative paths or shortcuts through the cCDG (w.r.t
@@ -355,7 +388,7 @@ static boolean_t
 attempt_shortcut_discovery(const osm_ucast_mgr_t *,
 			   const network_t *,
 			   const network_node_t *,
-			   const ccdg_t *,
+			   ccdg_t *,
 			   const ccdg_node_t *,
 			   const int32_t color);
 
@@ -453,6 +486,36 @@ change_fake_ccdg_node_color(const ccdg_t *,
 			    ccdg_node_t *,
 			    const int32_t);
 
+/*! \fn clone_network_and_ccdg(const osm_ucast_mgr_t *,
+ *                             const network_t *,
+ *                             const ccdg_t *,
+ *                             network_t *,
+ *                             ccdg_t *)
+ *  \brief Deep copy of the network and the complete CDG, so that a virtual
+ *         layer can be routed independently of the other layers.
+ *
+ *  Function description: The copy shares nothing with the original besides
+ *  the OpenSM switch objects. All pointers between network nodes, links and
+ *  cCDG vertices are redirected into the copy, the colors are left unset for
+ *  init_ccdg_colors, and each network node gets a num_paths array to count
+ *  the routes thru its ports instead of updating the port profiles of the
+ *  shared switches.
+ *
+ *  \param[in]     mgr         The management object of OpenSM.
+ *  \param[in]     in_network  Nue's network object storing the subnet.
+ *  \param[in]     in_ccdg     Nue's internal object storing the complete CDG.
+ *  \param[in,out] out_network A constructed network object for the copy.
+ *  \param[in,out] out_ccdg    A constructed cCDG object for the copy.
+ *  \return Integer 0 if the copy was created sucessfully, or any integer
+ *          unequal to 0 otherwise.
+ */
+static int
+clone_network_and_ccdg(const osm_ucast_mgr_t *,
+		       const network_t *,
+		       const ccdg_t *,
+		       network_t *,
+		       ccdg_t *);
+
 /*! \fn compare_backtracking_candidates_by_distance(const void *,
  *                                                  const void *)
  *  \brief Comparator for backtracking candidates of cCDG vertices w.r.t their
@@ -528,15 +591,6 @@ compare_two_channel_id(const void *,
 static inline void
 construct_ccdg(ccdg_t *);
 
-/*! \fn construct_ccdg_edge(ccdg_edge_t *)
- *  \brief Set all ccdg_edge_t struct parameters to 0.
- *
- *  \param[in,out] edge An edge of the complete channel dependency graph.
- *  \return NONE
- */
-static inline void
-construct_ccdg_edge(ccdg_edge_t *);
-
 /*! \fn construct_ccdg_node(ccdg_node_t *)
  *  \brief Set all ccdg_node_t struct parameters to 0.
  *
@@ -748,7 +802,7 @@ dry_ccdg_node_color(ccdg_node_t *);
 /*! \fn fix_ccdg_colors(const osm_ucast_mgr_t *,
  *                      const network_t *,
  *                      const network_node_t *,
- *                      const ccdg_t *,
+ *                      ccdg_t *,
  *                      const ccdg_node_t *)
  *  \brief Change the status of all colors of cCDG vertices and edges, which are
  *         actually used after the routing step, from temporarily to permanent.
@@ -764,31 +818,11 @@ static void
 fix_ccdg_colors(const osm_ucast_mgr_t *,
 		const network_t *,
 		const network_node_t *,
-		const ccdg_t *,
+		ccdg_t *,
 		const ccdg_node_t *);
 
-/*! \fn fix_ccdg_edge_color(ccdg_edge_t *)
- *  \brief Overwrite the (tmp) color pointer of the cCDG edge with the real
- *         color after merging individually colored cCDG subgraphs.
- *
- *  \param[in,out] ccdg_edge An edge of the cCDG.
- *  \return NONE
- */
-static inline void
-fix_ccdg_edge_color(ccdg_edge_t *);
-
-/*! \fn fix_ccdg_node_color(ccdg_node_t *)
- *  \brief Overwrite the (tmp) color pointer of the cCDG vertex with the real
- *         color after merging individually colored cCDG subgraphs.
- *
- *  \param[in,out] ccdg_node A vertex of the cCDG.
- *  \return NONE
- */
-static inline void
-fix_ccdg_node_color(ccdg_node_t *);
-
 /*! \fn found_path_between_ccdg_nodes_in_subgraph(const osm_ucast_mgr_t *,
- *                                                const ccdg_t *,
+ *                                                ccdg_t *,
  *                                                ccdg_node_t *,
  *                                                const ccdg_node_t *,
  *                                                const int32_t)
@@ -804,7 +838,7 @@ fix_ccdg_node_color(ccdg_node_t *);
  */
 static boolean_t
 found_path_between_ccdg_nodes_in_subgraph(const osm_ucast_mgr_t *,
-					  const ccdg_t *,
+					  ccdg_t *,
 					  ccdg_node_t *,
 					  const ccdg_node_t *,
 					  const int32_t);
@@ -984,6 +1018,17 @@ static inline network_node_t *
 get_network_node_by_lid(const network_t *,
 			const ib_net16_t);
 
+/*! \fn get_real_color(color_t *)
+ *  \brief Follows the merges of colored cCDG subgraphs to the color which
+ *         currently represents the merged subgraph, and shortens the chain of
+ *         merges on the way.
+ *
+ *  \param[in,out] color A color of the cCDG.
+ *  \return The real color after all merges.
+ */
+static inline color_t *
+get_real_color(color_t *);
+
 /*! \fn get_switch_lid(const osm_ucast_mgr_t *,
  *                     const ib_net16_t)
  *  \brief The fn returns the input LID, assuming it belongs to a subnet switch,
@@ -997,15 +1042,15 @@ static inline ib_net16_t
 get_switch_lid(const osm_ucast_mgr_t *,
 	       const ib_net16_t);
 
-/*! \fn init_ccdg_colors(const ccdg_t *)
- *  \brief Iterates over all cCDG vertices and edges to set the color ID/Ptr
- *         into the UNUSED state.
+/*! \fn init_ccdg_colors(ccdg_t *)
+ *  \brief Starts a new coloring of the cCDG, which puts all cCDG vertices and
+ *         edges into the UNUSED state without touching them.
  *
- *  \param[in] ccdg Nue's internal object storing the complete CDG.
+ *  \param[in,out] ccdg Nue's internal object storing the complete CDG.
  *  \return NONE
  */
 static void
-init_ccdg_colors(const ccdg_t *);
+init_ccdg_colors(ccdg_t *);
 
 /*! \fn init_ccdg_edge(ccdg_edge_t *,
  *                     const channel_t)
@@ -1020,19 +1065,7 @@ static inline void
 init_ccdg_edge(ccdg_edge_t *,
 	       const channel_t);
 
-/*! \fn init_ccdg_edge_color(const ccdg_t *,
- *                           ccdg_edge_t *)
- *  \brief Initialize a cCDG edge to set the color ID/Ptr into the UNUSED state.
- *
- *  \param[in]     ccdg      Nue's internal object storing the complete CDG.
- *  \param[in,out] ccdg_edge An edge of the complete CDG.
- *  \return NONE
- */
-static inline void
-init_ccdg_edge_color(const ccdg_t *,
-		     ccdg_edge_t *);
-
-/*! \fn init_ccdg_escape_path_edge_color_betw_nodes(const ccdg_t *,
+/*! \fn init_ccdg_escape_path_edge_color_betw_nodes(ccdg_t *,
  *                                                  const ccdg_node_t *,
  *                                                  const ccdg_node_t *)
  *  \brief Initialize a cCDG edge to set the color ID/Ptr into the
@@ -1044,7 +1077,7 @@ init_ccdg_edge_color(const ccdg_t *,
  *  \return NONE
  */
 static inline void
-init_ccdg_escape_path_edge_color_betw_nodes(const ccdg_t *,
+init_ccdg_escape_path_edge_color_betw_nodes(ccdg_t *,
 					    const ccdg_node_t *,
 					    const ccdg_node_t *);
 
@@ -1084,19 +1117,6 @@ init_ccdg_node(ccdg_node_t *,
 	       ccdg_edge_t *,
 	       network_link_t *);
 
-/*! \fn init_ccdg_node_color(const ccdg_t *,
- *                           ccdg_node_t *)
- *  \brief Initialize a cCDG vertex to set the color ID/Ptr into the UNUSED
- *         state.
- *
- *  \param[in]     ccdg      Nue's internal object storing the complete CDG.
- *  \param[in,out] ccdg_node A complete CDG vertex.
- *  \return NONE
- */
-static inline void
-init_ccdg_node_color(const ccdg_t *,
-		     ccdg_node_t *);
-
 /*! \fn init_linear_forwarding_tables(const osm_ucast_mgr_t *,
  *                                    const network_t *)
  *  \brief Initialize the new_lft array of a given network node (and corresp.
@@ -1190,9 +1210,50 @@ init_network_node(network_node_t *,
 		  network_link_t *,
 		  osm_switch_t *);
 
+/*! \fn is_ccdg_edge_color_wet(const ccdg_t *,
+ *                             const ccdg_edge_t *)
+ *  \brief Check if a cCDG edge was painted in the current routing step, i.e.,
+ *         since the last call of fix_ccdg_colors.
+ *
+ *  \param[in] ccdg      Nue's internal object storing the complete CDG.
+ *  \param[in] ccdg_edge An edge of the complete CDG.
+ *  \return TRUE if the color of the edge is wet, or FALSE otherwise.
+ */
+static inline boolean_t
+is_ccdg_edge_color_wet(const ccdg_t *,
+		       const ccdg_edge_t *);
+
+/*! \fn is_ccdg_edge_colored(const ccdg_t *,
+ *                           const ccdg_edge_t *)
+ *  \brief Check if the color pointer of a cCDG edge belongs to the current
+ *         coloring of the cCDG, since otherwise the edge is UNUSED.
+ *
+ *  \param[in] ccdg      Nue's internal object storing the complete CDG.
+ *  \param[in] ccdg_edge An edge of the complete CDG.
+ *  \return TRUE if the edge was colored in the current coloring, or FALSE
+ *          otherwise.
+ */
+static inline boolean_t
+is_ccdg_edge_colored(const ccdg_t *,
+		     const ccdg_edge_t *);
+
+/*! \fn is_ccdg_node_colored(const ccdg_t *,
+ *                           const ccdg_node_t *)
+ *  \brief Check if the color pointer of a cCDG vertex belongs to the current
+ *         coloring of the cCDG, since otherwise the vertex is UNUSED.
+ *
+ *  \param[in] ccdg      Nue's internal object storing the complete CDG.
+ *  \param[in] ccdg_node A vertex of the complete CDG.
+ *  \return TRUE if the vertex was colored in the current coloring, or FALSE
+ *          otherwise.
+ */
+static inline boolean_t
+is_ccdg_node_colored(const ccdg_t *,
+		     const ccdg_node_t *);
+
 /*! \fn mark_escape_paths(const osm_ucast_mgr_t *,
  *                        network_t *,
- *                        const ccdg_t *,
+ *                        ccdg_t *,
  *                        ib_net16_t *,
  *                        const uint16_t,
  *                        const boolean_t)
@@ -1220,7 +1281,7 @@ init_network_node(network_node_t *,
 static int
 mark_escape_paths(const osm_ucast_mgr_t *,
 		  network_t *,
-		  const ccdg_t *,
+		  ccdg_t *,
 		  ib_net16_t *,
 		  const uint16_t,
 		  const boolean_t);
@@ -1238,7 +1299,7 @@ static inline void
 mcast_cleanup(const network_t *,
 	      cl_qlist_t *);
 
-/*! \fn merge_two_colored_subccdg_by_nodes(const ccdg_t *,
+/*! \fn merge_two_colored_subccdg_by_nodes(ccdg_t *,
  *                                         const ccdg_node_t *,
  *                                         ccdg_node_t *)
  *  \brief Merges two uniquely colored, disjoint, acyclic subgraphs of the cCDG
@@ -1250,10 +1311,36 @@ mcast_cleanup(const network_t *,
  *  \return NONE
  */
 static inline void
-merge_two_colored_subccdg_by_nodes(const ccdg_t *,
+merge_two_colored_subccdg_by_nodes(ccdg_t *,
 				   const ccdg_node_t *,
 				   ccdg_node_t *);
 
+/*! \fn merge_virtual_layer(const osm_ucast_mgr_t *,
+ *                          const network_t *,
+ *                          const nue_layer_t *,
+ *                          uint64_t *)
+ *  \brief Adds the link weight increase and path counts of a virtual layer
+ *         routed on a copy to the summed increases and to OpenSM's port
+ *         profiles.
+ *
+ *  Function description: All layers start from the link weights of the
+ *  network, which stays unchanged until all layers are routed, and the sum of
+ *  the increases does not depend on the order in which layers are merged, so
+ *  the result is independent of the thread schedule.
+ *
+ *  \param[in]     mgr         The management object of OpenSM.
+ *  \param[in]     network     Nue's network object storing the subnet.
+ *  \param[in]     layer       Copy of the network with a routed layer.
+ *  \param[in,out] weight_incr Summed weight increase of each link, in the
+ *                             order of the nodes and their links.
+ *  \return NONE
+ */
+static void
+merge_virtual_layer(const osm_ucast_mgr_t *,
+		    const network_t *,
+		    const nue_layer_t *,
+		    uint64_t *);
+
 /*! \fn nue_create_context(const osm_opensm_t *,
  *                         const osm_routing_engine_type_t)
  *  \brief This fn allocats the context for Nue routing and assigns some initial
@@ -1532,7 +1619,7 @@ reset_ccdg_color_array(const osm_ucast_mgr_t *,
 		       const uint8_t,
 		       const uint8_t);
 
-/*! \fn reset_ccdg_edge_color_betw_nodes(const ccdg_t *,
+/*! \fn reset_ccdg_edge_color_betw_nodes(ccdg_t *,
  *                                       const ccdg_node_t *,
  *                                       const ccdg_node_t *,
  *                                       ccdg_edge_t *)
@@ -1548,12 +1635,12 @@ reset_ccdg_color_array(const osm_ucast_mgr_t *,
  *  \return NONE
  */
 static inline void
-reset_ccdg_edge_color_betw_nodes(const ccdg_t *,
+reset_ccdg_edge_color_betw_nodes(ccdg_t *,
 				 const ccdg_node_t *,
 				 const ccdg_node_t *,
 				 ccdg_edge_t *);
 
-/*! \fn reset_ccdg_edge_color(const ccdg_t *,
+/*! \fn reset_ccdg_edge_color(ccdg_t *,
  *                            ccdg_edge_t *)
  *  \brief This fn changes the color pointer of a given cCDG edge into the
  *         UNUSED state and sets its wet_paint flag to FALSE.
@@ -1563,7 +1650,7 @@ reset_ccdg_edge_color_betw_nodes(const ccdg_t *,
  *  \return NONE
  */
 static inline void
-reset_ccdg_edge_color(const ccdg_t *,
+reset_ccdg_edge_color(ccdg_t *,
 		      ccdg_edge_t *);
 
 /*! \fn reset_ccdg_node_color(const ccdg_t *,
@@ -1644,7 +1731,92 @@ route_via_modified_dijkstra_on_ccdg(const osm_ucast_mgr_t *,
 				    const int32_t,
 				    boolean_t *);
 
-/*! \fn set_ccdg_edge_into_blocked_state(const ccdg_t *,
+/*! \fn route_virtual_layer(nue_context_t *,
+ *                          network_t *,
+ *                          ccdg_t *,
+ *                          const uint8_t,
+ *                          const boolean_t)
+ *  \brief Calculates the deadlock-free routes towards all destinations of a
+ *         single virtual layer and stores them in the ucast forwarding tables.
+ *
+ *  \param[in,out] nue_ctx          Pointer to the nue context object.
+ *  \param[in,out] network          Network object used for this layer.
+ *  \param[in,out] ccdg             Complete CDG object used for this layer.
+ *  \param[in]     vl               The virtual layer to route.
+ *  \param[in]     include_switches If TRUE, switches are traffic sinks, too.
+ *  \return Integer 0 if the routing of the layer was sucessful, or any integer
+ *          unequal to 0 otherwise.
+ */
+static int
+route_virtual_layer(nue_context_t *,
+		    network_t *,
+		    ccdg_t *,
+		    const uint8_t,
+		    const boolean_t);
+
+/*! \fn route_virtual_layer_range(void *,
+ *                                size_t,
+ *                                size_t,
+ *                                unsigned)
+ *  \brief Work item for OpenSM's routing worker threads, which copies the
+ *         network and the cCDG for each virtual layer in the range, routes
+ *         the layer on the copy, merges it and frees the copy again.
+ *
+ *  \param[in,out] context Pointer to the nue_layers_t object.
+ *  \param[in]     begin   First virtual layer to route.
+ *  \param[in]     end     Virtual layer after the last one to route.
+ *  \param[in]     worker  Index of the worker thread owning the copy used.
+ *  \return NONE
+ */
+static void
+route_virtual_layer_range(void *,
+			  size_t,
+			  size_t,
+			  unsigned);
+
+/*! \fn route_virtual_layers_on_copies(nue_context_t *,
+ *                                     const boolean_t)
+ *  \brief Routes all virtual layers on private copies of the network and the
+ *         cCDG, concurrently if OpenSM runs routing threads, and merges the
+ *         results afterwards.
+ *
+ *  Function description: Routing in different virtual layers only interacts
+ *  thru the link weights. Every layer starts from the current link weights of
+ *  the network and the weight increases are summed by merge_virtual_layer and
+ *  applied once all layers are routed, so the result does not depend on the
+ *  number of routing threads. Each worker thread holds at most one copy at a
+ *  time.
+ *
+ *  \param[in,out] nue_ctx          Pointer to the nue context object.
+ *  \param[in]     include_switches If TRUE, switches are traffic sinks, too.
+ *  \return Integer 0 if the routing of all layers was sucessful, or any
+ *          integer unequal to 0 otherwise.
+ */
+static int
+route_virtual_layers_on_copies(nue_context_t *,
+			       const boolean_t);
+
+/*! \fn set_ccdg_edge_color(ccdg_t *,
+ *                          ccdg_edge_t *,
+ *                          color_t *,
+ *                          const boolean_t)
+ *  \brief Paint a cCDG edge in the current coloring of the cCDG. Wet edges are
+ *         recorded in the wet_edges list of the cCDG, so that fix_ccdg_colors
+ *         does not need to search the whole cCDG for them.
+ *
+ *  \param[in,out] ccdg      Nue's internal object storing the complete CDG.
+ *  \param[in,out] ccdg_edge An edge of the complete CDG.
+ *  \param[in]     color     The new color of the edge.
+ *  \param[in]     wet_paint TRUE if the color is only temporarily.
+ *  \return NONE
+ */
+static inline void
+set_ccdg_edge_color(ccdg_t *,
+		    ccdg_edge_t *,
+		    color_t *,
+		    const boolean_t);
+
+/*! \fn set_ccdg_edge_into_blocked_state(ccdg_t *,
  *                                       ccdg_edge_t *)
  *  \brief Change a cCDG edge to set the color ID/Ptr into the BLOCKED state,
  *         and hence prevent any further use since it would close a cycle.
@@ -1654,9 +1826,27 @@ route_via_modified_dijkstra_on_ccdg(const osm_ucast_mgr_t *,
  *  \return NONE
  */
 static inline void
-set_ccdg_edge_into_blocked_state(const ccdg_t *,
+set_ccdg_edge_into_blocked_state(ccdg_t *,
 				 ccdg_edge_t *);
 
+/*! \fn set_ccdg_node_color(const ccdg_t *,
+ *                          ccdg_node_t *,
+ *                          color_t *,
+ *                          const boolean_t)
+ *  \brief Paint a cCDG vertex in the current coloring of the cCDG.
+ *
+ *  \param[in]     ccdg      Nue's internal object storing the complete CDG.
+ *  \param[in,out] ccdg_node A vertex of the complete CDG.
+ *  \param[in]     color     The new color of the vertex.
+ *  \param[in]     wet_paint TRUE if the color is only temporarily.
+ *  \return NONE
+ */
+static inline void
+set_ccdg_node_color(const ccdg_t *,
+		    ccdg_node_t *,
+		    color_t *,
+		    const boolean_t);
+
 /*! \fn sort_backtracking_candidates_by_distance(backtracking_candidate_t *,
  *                                               const size_t)
  *  \brief Qsort the backtracking candidates by the distances determined during
@@ -1832,7 +2022,7 @@ use_escape_paths_to_solve_impass(const osm_ucast_mgr_t *,
 				 const ib_net16_t);
 
 /*! \fn using_edge_induces_cycle_in_ccdg(const osm_ucast_mgr_t *,
- *                                       const ccdg_t *,
+ *                                       ccdg_t *,
  *                                       const ccdg_node_t *,
  *                                       ccdg_edge_t *,
  *                                       const int32_t)
@@ -1853,7 +2043,7 @@ use_escape_paths_to_solve_impass(const osm_ucast_mgr_t *,
  */
 static boolean_t
 using_edge_induces_cycle_in_ccdg(const osm_ucast_mgr_t *,
-				 const ccdg_t *,
+				 ccdg_t *,
 				 const ccdg_node_t *,
 				 ccdg_edge_t *,
 				 const int32_t);
@@ -2029,6 +2219,10 @@ static inline void destroy_network_node(network_node_t * node)
 		free(node->Ps);
 		node->Ps = NULL;
 	}
+	if (node->num_paths) {
+		free(node->num_paths);
+		node->num_paths = NULL;
+	}
 }
 
 static inline void construct_network(network_t * network)
@@ -2057,12 +2251,6 @@ static inline void destroy_network(network_t * network)
 		cl_heap_destroy(&(network->heap));
 }
 
-static inline void construct_ccdg_edge(ccdg_edge_t * edge)
-{
-	CL_ASSERT(edge);
-	memset(edge, 0, sizeof(ccdg_edge_t));
-}
-
 static inline void init_ccdg_edge(ccdg_edge_t * edge, const channel_t to_cid)
 {
 	CL_ASSERT(edge);
@@ -2086,8 +2274,10 @@ static inline void init_ccdg_node(ccdg_node_t * node,
 	node->num_edges = num_edges;
 	node->edges = edges;
 	node->corresponding_netw_link = corresponding_netw_link;
+	node->color_gen = 0;
 	node->status = WHITE;
 	node->next_edge_idx = 0;
+	node->search_gen = 0;
 	node->pre = NULL;
 }
 
@@ -2114,14 +2304,27 @@ static inline void destroy_ccdg(ccdg_t * ccdg)
 
 	CL_ASSERT(ccdg);
 
-	if (ccdg->nodes) {
+	/* only the verification copy of the debug mode has separately
+	   allocated edge arrays for each node
+	 */
+	if (ccdg->nodes && !ccdg->edges) {
 		for (i = 0, ccdg_node_iter = ccdg->nodes; i < ccdg->num_nodes;
 		     i++, ccdg_node_iter++) {
 			destroy_ccdg_node(ccdg_node_iter);
 		}
+	}
+	if (ccdg->nodes) {
 		free(ccdg->nodes);
 		ccdg->nodes = NULL;
 	}
+	if (ccdg->edges) {
+		free(ccdg->edges);
+		ccdg->edges = NULL;
+	}
+	if (ccdg->wet_edges) {
+		free(ccdg->wet_edges);
+		ccdg->wet_edges = NULL;
+	}
 	if (ccdg->color_array) {
 		free(ccdg->color_array);
 		ccdg->color_array = NULL;
@@ -2398,38 +2601,31 @@ sort_backtracking_candidates_by_distance(backtracking_candidate_t *
 
 /****** helper functions to manage disjoint subgraphs of the ccdg *****
  ******* init colors, set/get routines, merge of subgraphs, etc. ******/
-static inline void init_ccdg_node_color(const ccdg_t * ccdg,
-					ccdg_node_t * ccdg_node)
-{
-	CL_ASSERT(ccdg && ccdg->color_array && ccdg_node);
-	ccdg_node->color = &(ccdg->color_array[UNUSED]);
-	ccdg_node->wet_paint = FALSE;
-}
-
-static inline void init_ccdg_edge_color(const ccdg_t * ccdg,
-					ccdg_edge_t * ccdg_edge)
-{
-	CL_ASSERT(ccdg && ccdg->color_array && ccdg_edge);
-	ccdg_edge->color = &(ccdg->color_array[UNUSED]);
-	ccdg_edge->wet_paint = FALSE;
-}
-
-static void init_ccdg_colors(const ccdg_t * ccdg)
+static void init_ccdg_colors(ccdg_t * ccdg)
 {
 	ccdg_node_t *ccdg_node_iter = NULL;
 	ccdg_edge_t *ccdg_edge_iter = NULL;
-	uint32_t i = 0, j = 0;
+	uint32_t i = 0;
 
 	CL_ASSERT(ccdg);
 
+	/* colors of vertices and edges are only valid for the coloring they
+	   were assigned in, so starting a new coloring sets all of them into
+	   the UNUSED state at once
+	 */
+	ccdg->color_gen++;
+	ccdg->num_wet_edges = 0;
+	if (ccdg->color_gen)
+		return;
+
+	/* the counter wrapped around, so forget all old colorings */
 	for (i = 0, ccdg_node_iter = ccdg->nodes; i < ccdg->num_nodes;
-	     i++, ccdg_node_iter++) {
-		init_ccdg_node_color(ccdg, ccdg_node_iter);
-		for (j = 0, ccdg_edge_iter = ccdg_node_iter->edges;
-		     j < ccdg_node_iter->num_edges; j++, ccdg_edge_iter++) {
-			init_ccdg_edge_color(ccdg, ccdg_edge_iter);
-		}
-	}
+	     i++, ccdg_node_iter++)
+		ccdg_node_iter->color_gen = 0;
+	for (i = 0, ccdg_edge_iter = ccdg->edges; i < ccdg->num_edges;
+	     i++, ccdg_edge_iter++)
+		ccdg_edge_iter->color_gen = 0;
+	ccdg->color_gen = 1;
 }
 
 static int reset_ccdg_color_array(const osm_ucast_mgr_t * mgr, ccdg_t * ccdg,
@@ -2473,15 +2669,76 @@ static int reset_ccdg_color_array(const osm_ucast_mgr_t * mgr, ccdg_t * ccdg,
 	return 0;
 }
 
+static inline boolean_t is_ccdg_node_colored(const ccdg_t * ccdg,
+					     const ccdg_node_t * ccdg_node)
+{
+	CL_ASSERT(ccdg && ccdg_node);
+	return (ccdg_node->color_gen == ccdg->color_gen) ? TRUE : FALSE;
+}
+
+static inline boolean_t is_ccdg_edge_colored(const ccdg_t * ccdg,
+					     const ccdg_edge_t * ccdg_edge)
+{
+	CL_ASSERT(ccdg && ccdg_edge);
+	return (ccdg_edge->color_gen == ccdg->color_gen) ? TRUE : FALSE;
+}
+
+static inline boolean_t is_ccdg_edge_color_wet(const ccdg_t * ccdg,
+					       const ccdg_edge_t * ccdg_edge)
+{
+	return is_ccdg_edge_colored(ccdg, ccdg_edge) && ccdg_edge->wet_paint;
+}
+
+static inline void set_ccdg_node_color(const ccdg_t * ccdg,
+				       ccdg_node_t * ccdg_node,
+				       color_t * color,
+				       const boolean_t wet_paint)
+{
+	CL_ASSERT(ccdg && ccdg_node && color);
+	ccdg_node->color = color;
+	ccdg_node->wet_paint = wet_paint;
+	ccdg_node->color_gen = ccdg->color_gen;
+}
+
+static inline void set_ccdg_edge_color(ccdg_t * ccdg,
+				       ccdg_edge_t * ccdg_edge,
+				       color_t * color,
+				       const boolean_t wet_paint)
+{
+	CL_ASSERT(ccdg && ccdg_edge && color);
+	/* remember freshly painted edges, so that fix_ccdg_colors only has
+	   to look at these edges (and their tail vertices) after the step
+	 */
+	if (wet_paint && !is_ccdg_edge_color_wet(ccdg, ccdg_edge)
+	    && ccdg->num_wet_edges < ccdg->num_edges)
+		ccdg->wet_edges[ccdg->num_wet_edges++] = ccdg_edge;
+	ccdg_edge->color = color;
+	ccdg_edge->wet_paint = wet_paint;
+	ccdg_edge->color_gen = ccdg->color_gen;
+}
+
+/* follow the merges of colored subgraphs to the real color, and shorten
+   the chain on the way for the next lookup
+ */
+static inline color_t *get_real_color(color_t * color)
+{
+	CL_ASSERT(color);
+	while (color->real_col != color) {
+		color->real_col = color->real_col->real_col;
+		color = color->real_col;
+	}
+	return color;
+}
+
 static inline void init_ccdg_escape_path_node_color(const ccdg_t * ccdg,
 						    ccdg_node_t * ccdg_node)
 {
 	CL_ASSERT(ccdg && ccdg->color_array && ccdg_node);
-	ccdg_node->color = &(ccdg->color_array[ESCAPEPATHCOLOR]);
+	set_ccdg_node_color(ccdg, ccdg_node,
+			    &(ccdg->color_array[ESCAPEPATHCOLOR]), FALSE);
 }
 
-static inline void init_ccdg_escape_path_edge_color_betw_nodes(const ccdg_t *
-							       ccdg,
+static inline void init_ccdg_escape_path_edge_color_betw_nodes(ccdg_t * ccdg,
 							       const ccdg_node_t
 							       * ccdg_node1,
 							       const ccdg_node_t
@@ -2492,28 +2749,34 @@ static inline void init_ccdg_escape_path_edge_color_betw_nodes(const ccdg_t *
 	CL_ASSERT(ccdg && ccdg->color_array && ccdg_node1 && ccdg_node2);
 	ccdg_edge = get_ccdg_edge_betw_nodes(ccdg_node1, ccdg_node2);
 	CL_ASSERT(ccdg_edge);
-	ccdg_edge->color = &(ccdg->color_array[ESCAPEPATHCOLOR]);
+	set_ccdg_edge_color(ccdg, ccdg_edge,
+			    &(ccdg->color_array[ESCAPEPATHCOLOR]), FALSE);
 }
 
-static inline void set_ccdg_edge_into_blocked_state(const ccdg_t * ccdg,
+static inline void set_ccdg_edge_into_blocked_state(ccdg_t * ccdg,
 						    ccdg_edge_t * ccdg_edge)
 {
 	CL_ASSERT(ccdg && ccdg_edge);
-	ccdg_edge->color = &(ccdg->color_array[BLOCKED]);
+	set_ccdg_edge_color(ccdg, ccdg_edge, &(ccdg->color_array[BLOCKED]),
+			    FALSE);
 }
 
 static inline uint16_t get_ccdg_node_color(const ccdg_t * ccdg,
 					   const ccdg_node_t * ccdg_node)
 {
-	CL_ASSERT(ccdg && ccdg_node && ccdg_node->color);
-	return ccdg_node->color->real_col->color_id;
+	CL_ASSERT(ccdg && ccdg_node);
+	if (!is_ccdg_node_colored(ccdg, ccdg_node))
+		return UNUSED;
+	return get_real_color(ccdg_node->color)->color_id;
 }
 
 static inline uint16_t get_ccdg_edge_color(const ccdg_t * ccdg,
 					   const ccdg_edge_t * ccdg_edge)
 {
-	CL_ASSERT(ccdg_edge && ccdg_edge->color);
-	return ccdg_edge->color->real_col->color_id;
+	CL_ASSERT(ccdg && ccdg_edge);
+	if (!is_ccdg_edge_colored(ccdg, ccdg_edge))
+		return UNUSED;
+	return get_real_color(ccdg_edge->color)->color_id;
 }
 
 static inline uint16_t get_ccdg_edge_color_betw_nodes(const ccdg_t * ccdg,
@@ -2545,35 +2808,36 @@ static inline void change_fake_ccdg_node_color(const ccdg_t * ccdg,
 		       remote_port)));
 
 	if (get_ccdg_node_color(ccdg, ccdg_node) > UNUSED) {
-		ccdg_node->color->real_col = &(ccdg->color_array[color]);
+		get_real_color(ccdg_node->color)->real_col =
+		    get_real_color(&(ccdg->color_array[color]));
 	} else {
-		ccdg_node->color = &(ccdg->color_array[color]);
+		set_ccdg_node_color(ccdg, ccdg_node,
+				    &(ccdg->color_array[color]), FALSE);
 	}
 }
 
 static inline void reset_ccdg_node_color(const ccdg_t * ccdg,
 					 ccdg_node_t * ccdg_node)
 {
-	CL_ASSERT(ccdg && ccdg_node && ccdg_node->color);
+	CL_ASSERT(ccdg && ccdg_node);
 
-	if (ccdg_node->wet_paint) {
-		ccdg_node->color = &(ccdg->color_array[UNUSED]);
-		ccdg_node->wet_paint = FALSE;
-	}
+	if (is_ccdg_node_colored(ccdg, ccdg_node) && ccdg_node->wet_paint)
+		set_ccdg_node_color(ccdg, ccdg_node,
+				    &(ccdg->color_array[UNUSED]), FALSE);
 }
 
-static inline void reset_ccdg_edge_color(const ccdg_t * ccdg,
+static inline void reset_ccdg_edge_color(ccdg_t * ccdg,
 					 ccdg_edge_t * ccdg_edge)
 {
-	CL_ASSERT(ccdg && ccdg_edge && ccdg_edge->color);
-	if (ccdg_edge->wet_paint) {
+	CL_ASSERT(ccdg && ccdg_edge);
+	if (is_ccdg_edge_color_wet(ccdg, ccdg_edge)) {
 		CL_ASSERT(BLOCKED != get_ccdg_edge_color(ccdg, ccdg_edge));
-		ccdg_edge->color = &(ccdg->color_array[UNUSED]);
-		ccdg_edge->wet_paint = FALSE;
+		set_ccdg_edge_color(ccdg, ccdg_edge,
+				    &(ccdg->color_array[UNUSED]), FALSE);
 	}
 }
 
-static inline void reset_ccdg_edge_color_betw_nodes(const ccdg_t * ccdg,
+static inline void reset_ccdg_edge_color_betw_nodes(ccdg_t * ccdg,
 						    const ccdg_node_t *
 						    ccdg_node1,
 						    const ccdg_node_t *
@@ -2589,8 +2853,7 @@ static inline void reset_ccdg_edge_color_betw_nodes(const ccdg_t * ccdg,
 	reset_ccdg_edge_color(ccdg, ccdg_edge);
 }
 
-static inline void add_ccdg_edge_betw_nodes_to_colored_subccdg(const ccdg_t *
-							       ccdg,
+static inline void add_ccdg_edge_betw_nodes_to_colored_subccdg(ccdg_t * ccdg,
 							       const ccdg_node_t
 							       * ccdg_node1,
 							       const ccdg_node_t
@@ -2607,11 +2870,10 @@ static inline void add_ccdg_edge_betw_nodes_to_colored_subccdg(const ccdg_t *
 	}
 	CL_ASSERT(ccdg_edge && ccdg_edge->to_ccdg_node == ccdg_node2
 		  && UNUSED == get_ccdg_edge_color(ccdg, ccdg_edge));
-	ccdg_edge->color = ccdg_node1->color;
-	ccdg_edge->wet_paint = TRUE;
+	set_ccdg_edge_color(ccdg, ccdg_edge, ccdg_node1->color, TRUE);
 }
 
-static inline void add_ccdg_node_to_colored_subccdg(const ccdg_t * ccdg,
+static inline void add_ccdg_node_to_colored_subccdg(ccdg_t * ccdg,
 						    const ccdg_node_t *
 						    ccdg_node1,
 						    ccdg_node_t * ccdg_node2)
@@ -2621,13 +2883,12 @@ static inline void add_ccdg_node_to_colored_subccdg(const ccdg_t * ccdg,
 	CL_ASSERT(get_ccdg_node_color(ccdg, ccdg_node1) > UNUSED
 		  && get_ccdg_node_color(ccdg, ccdg_node2) == UNUSED);
 
-	ccdg_node2->color = ccdg_node1->color;
-	ccdg_node2->wet_paint = TRUE;
+	set_ccdg_node_color(ccdg, ccdg_node2, ccdg_node1->color, TRUE);
 	add_ccdg_edge_betw_nodes_to_colored_subccdg(ccdg, ccdg_node1,
 						    ccdg_node2, NULL);
 }
 
-static inline void merge_two_colored_subccdg_by_nodes(const ccdg_t * ccdg,
+static inline void merge_two_colored_subccdg_by_nodes(ccdg_t * ccdg,
 						      const ccdg_node_t *
 						      ccdg_node1,
 						      ccdg_node_t * ccdg_node2)
@@ -2639,7 +2900,8 @@ static inline void merge_two_colored_subccdg_by_nodes(const ccdg_t * ccdg,
 					 ccdg_node1) > get_ccdg_node_color(ccdg,
 									   ccdg_node2));
 
-	ccdg_node2->color->real_col = ccdg_node1->color;
+	get_real_color(ccdg_node2->color)->real_col =
+	    get_real_color(ccdg_node1->color);
 	add_ccdg_edge_betw_nodes_to_colored_subccdg(ccdg, ccdg_node1,
 						    ccdg_node2, NULL);
 }
@@ -2677,30 +2939,16 @@ static inline void dry_ccdg_edge_color_betw_nodes(const ccdg_t * ccdg,
 		ccdg_edge->wet_paint = FALSE;
 }
 
-static inline void fix_ccdg_node_color(ccdg_node_t * ccdg_node)
-{
-	CL_ASSERT(ccdg_node && ccdg_node->color);
-	if (ccdg_node->color->real_col != ccdg_node->color)
-		ccdg_node->color = ccdg_node->color->real_col;
-}
-
-static inline void fix_ccdg_edge_color(ccdg_edge_t * ccdg_edge)
-{
-	CL_ASSERT(ccdg_edge && ccdg_edge->color);
-	if (ccdg_edge->color->real_col != ccdg_edge->color)
-		ccdg_edge->color = ccdg_edge->color->real_col;
-}
-
 static void fix_ccdg_colors(const osm_ucast_mgr_t * mgr,
 			    const network_t * network,
 			    const network_node_t * source_netw_node,
-			    const ccdg_t * ccdg,
+			    ccdg_t * ccdg,
 			    const ccdg_node_t * source_ccdg_node)
 {
 	network_node_t *network_node = NULL, *netw_node_iter = NULL;
 	ccdg_node_t *ccdg_node = NULL, *pre_ccdg_node = NULL;
 	ccdg_node_t *ccdg_node_iter = NULL;
-	ccdg_edge_t *ccdg_edge_iter = NULL;
+	ccdg_edge_t *ccdg_edge_iter = NULL, **wet_edge_iter = NULL;
 	uint16_t i = 0;
 	uint32_t j = 0;
 	uint8_t k = 0;
@@ -2736,22 +2984,31 @@ static void fix_ccdg_colors(const osm_ucast_mgr_t * mgr,
 		}
 	}
 
-	/* everything else which is still wet now can be reset and afterwards
-	   we simply fix the colors, meaning subgraph merges are made official
+	/* everything else which is still wet now can be reset; subgraph
+	   merges are already official thru the real_col chain of the colors
 	 */
-	for (j = 0, ccdg_node_iter = ccdg->nodes; j < ccdg->num_nodes;
-	     j++, ccdg_node_iter++) {
-		reset_ccdg_node_color(ccdg, ccdg_node_iter);
-		for (k = 0, ccdg_edge_iter = ccdg_node_iter->edges;
-		     k < ccdg_node_iter->num_edges; k++, ccdg_edge_iter++) {
-			reset_ccdg_edge_color_betw_nodes(ccdg, ccdg_node_iter,
-							 ccdg_edge_iter->
-							 to_ccdg_node,
-							 ccdg_edge_iter);
-			fix_ccdg_edge_color(ccdg_edge_iter);
+	if (ccdg->num_wet_edges < ccdg->num_edges) {
+		/* vertices are only painted together with an edge towards
+		   them, so the wet edge list covers all wet vertices, too
+		 */
+		for (j = 0, wet_edge_iter = ccdg->wet_edges;
+		     j < ccdg->num_wet_edges; j++, wet_edge_iter++) {
+			reset_ccdg_edge_color(ccdg, *wet_edge_iter);
+			reset_ccdg_node_color(ccdg,
+					      (*wet_edge_iter)->to_ccdg_node);
+		}
+	} else {
+		/* the list overflowed, so we have to check the whole cCDG */
+		for (j = 0, ccdg_node_iter = ccdg->nodes; j < ccdg->num_nodes;
+		     j++, ccdg_node_iter++) {
+			reset_ccdg_node_color(ccdg, ccdg_node_iter);
+			for (k = 0, ccdg_edge_iter = ccdg_node_iter->edges;
+			     k < ccdg_node_iter->num_edges;
+			     k++, ccdg_edge_iter++)
+				reset_ccdg_edge_color(ccdg, ccdg_edge_iter);
 		}
-		fix_ccdg_node_color(ccdg_node_iter);
 	}
+	ccdg->num_wet_edges = 0;
 }
 
 /**********************************************************************
@@ -3161,6 +3418,7 @@ static nue_context_t *nue_create_context(const osm_opensm_t * osm,
 		/* set initial values with stuff provided by caller */
 		nue_ctx->routing_type = routing_type;
 		nue_ctx->mgr = (osm_ucast_mgr_t *) & (osm->sm.ucast_mgr);
+		nue_ctx->exec = (osm_routing_exec_t *) & (osm->routing_exec);
 		err = create_context(nue_ctx);
 		if (err) {
 			free(nue_ctx);
@@ -3244,6 +3502,7 @@ static int build_complete_cdg(const osm_ucast_mgr_t * mgr,
 	ccdg_edge_t *ccdg_edge_iter = NULL;
 	ib_net16_t l_lid = 0, r_lid = 0;
 	uint8_t l_port = 0, r_port = 0, num_edges = 0;
+	uint32_t total_num_edges = 0;
 
 	CL_ASSERT(mgr && network && ccdg);
 	OSM_LOG_ENTER(mgr->p_log);
@@ -3266,6 +3525,31 @@ static int build_complete_cdg(const osm_ucast_mgr_t * mgr,
 	     i++, ccdg_node_iter++)
 		construct_ccdg_node(ccdg_node_iter);
 
+	/* the edges of all ccdg nodes are stored in one array, so we count
+	   them first: a fake channel connects to all links of its switch,
+	   and a real channel to all links of the adjacent switch except the
+	   reverse path
+	 */
+	for (i = 0, netw_node_iter = network->nodes; i < network->num_nodes;
+	     i++, netw_node_iter++) {
+		total_num_edges += netw_node_iter->num_links;
+		for (j = 0, netw_link_iter = netw_node_iter->links;
+		     j < netw_node_iter->num_links; j++, netw_link_iter++)
+			total_num_edges +=
+			    netw_link_iter->to_network_node->num_links - 1;
+	}
+	ccdg->num_edges = total_num_edges;
+	ccdg->edges =
+	    (ccdg_edge_t *) calloc(total_num_edges, sizeof(ccdg_edge_t));
+	ccdg->wet_edges =
+	    (ccdg_edge_t **) malloc(total_num_edges * sizeof(ccdg_edge_t *));
+	if (total_num_edges && (!ccdg->edges || !ccdg->wet_edges)) {
+		OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
+			"ERR NUE08: can't allocate memory for ccdg edges\n");
+		return -1;
+	}
+	ccdg_edges = ccdg->edges;
+
 	ccdg_node_iter = (ccdg_node_t *) ccdg->nodes;
 	for (i = 0, netw_node_iter = network->nodes; i < network->num_nodes;
 	     i++, netw_node_iter++) {
@@ -3279,17 +3563,6 @@ static int build_complete_cdg(const osm_ucast_mgr_t * mgr,
 		   this node
 		 */
 		num_edges = netw_node_iter->num_links;
-		ccdg_edges =
-		    (ccdg_edge_t *) malloc(num_edges * sizeof(ccdg_edge_t));
-		if (num_edges && !ccdg_edges) {
-			OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
-				"ERR NUE35: cannot allocate memory for"
-				" ccdg edges of fake channel\n");
-			return -1;
-		}
-		for (k = 0, ccdg_edge_iter = ccdg_edges; k < num_edges;
-		     k++, ccdg_edge_iter++)
-			construct_ccdg_edge(ccdg_edge_iter);
 
 		/* init ccdg edges for this fake ccdg node */
 		for (k = 0, ccdg_edge_iter = ccdg_edges; k < num_edges;
@@ -3300,6 +3573,7 @@ static int build_complete_cdg(const osm_ucast_mgr_t * mgr,
 
 		init_ccdg_node(ccdg_node_iter++, channel_id, num_edges,
 			       ccdg_edges, NULL);
+		ccdg_edges += num_edges;
 
 		/* and afterwards the real channels */
 		for (j = 0, netw_link_iter = netw_node_iter->links;
@@ -3313,18 +3587,6 @@ static int build_complete_cdg(const osm_ucast_mgr_t * mgr,
 
 			/* we can ignore reverse path, so it is #links - 1 */
 			num_edges = adj_netw_node->num_links - 1;
-			ccdg_edges =
-			    (ccdg_edge_t *) malloc(num_edges *
-						   sizeof(ccdg_edge_t));
-			if (!ccdg_edges) {
-				OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
-					"ERR NUE08: can't allocate memory for"
-					" ccdg edges\n");
-				return -1;
-			}
-			for (k = 0, ccdg_edge_iter = ccdg_edges; k < num_edges;
-			     k++, ccdg_edge_iter++)
-				construct_ccdg_edge(ccdg_edge_iter);
 
 			/* init ccdg edges for this ccdg node */
 			for (k = 0, ccdg_edge_iter = ccdg_edges;
@@ -3348,6 +3610,7 @@ static int build_complete_cdg(const osm_ucast_mgr_t * mgr,
 
 			init_ccdg_node(ccdg_node_iter, channel_id, num_edges,
 				       ccdg_edges, netw_link_iter);
+			ccdg_edges += num_edges;
 		}
 	}
 
@@ -4370,7 +4633,7 @@ static int calculate_spanning_tree_in_network(const osm_ucast_mgr_t * mgr,
    node w.r.t. the destination nodes in the current virtual layer
  */
 static int mark_escape_paths(const osm_ucast_mgr_t * mgr, network_t * network,
-			     const ccdg_t * ccdg, ib_net16_t * destinations,
+			     ccdg_t * ccdg, ib_net16_t * destinations,
 			     const uint16_t num_destinations,
 			     const boolean_t verify_network_integrity)
 {
@@ -5000,7 +5263,7 @@ static void use_escape_paths_to_solve_impass(const osm_ucast_mgr_t * mgr,
 // check if we find a way from the source to the target -> yes: cycle
 static boolean_t found_path_between_ccdg_nodes_in_subgraph(const osm_ucast_mgr_t
 							   * mgr,
-							   const ccdg_t * ccdg,
+							   ccdg_t * ccdg,
 							   ccdg_node_t * source,
 							   const ccdg_node_t *
 							   target,
@@ -5009,13 +5272,24 @@ static boolean_t found_path_between_ccdg_nodes_in_subgraph(const osm_ucast_mgr_t
 	ccdg_node_t *curr_ccdg_node = NULL, *next_ccdg_node = NULL;
 	ccdg_node_t *ccdg_node_iter = NULL;
 	ccdg_edge_t *ccdg_edge_iter = NULL;
-	uint32_t i = 0;
+	uint32_t i = 0, search_gen = 0;
 	uint8_t j = 0;
 	boolean_t found_path = FALSE;
 
 	CL_ASSERT(mgr && ccdg && source && target && source != target);
 	OSM_LOG_ENTER(mgr->p_log);
 
+	/* vertices finished by this search carry its search_gen, so there is
+	   no need to reset their state afterwards
+	 */
+	search_gen = ++ccdg->search_gen;
+	if (!search_gen) {
+		for (i = 0, ccdg_node_iter = ccdg->nodes; i < ccdg->num_nodes;
+		     i++, ccdg_node_iter++)
+			ccdg_node_iter->search_gen = 0;
+		search_gen = ccdg->search_gen = 1;
+	}
+
 	curr_ccdg_node = source;
 	curr_ccdg_node->next_edge_idx = 0;
 	curr_ccdg_node->pre = NULL;
@@ -5026,7 +5300,8 @@ static boolean_t found_path_between_ccdg_nodes_in_subgraph(const osm_ucast_mgr_t
 		     curr_ccdg_node->edges + curr_ccdg_node->next_edge_idx;
 		     j < curr_ccdg_node->num_edges; j++, ccdg_edge_iter++) {
 			CL_ASSERT(ccdg_edge_iter->to_ccdg_node);
-			if (BLACK == ccdg_edge_iter->to_ccdg_node->status
+			if (search_gen ==
+			    ccdg_edge_iter->to_ccdg_node->search_gen
 			    || get_ccdg_edge_color(ccdg,
 						   ccdg_edge_iter) <= UNUSED)
 				continue;
@@ -5046,24 +5321,18 @@ static boolean_t found_path_between_ccdg_nodes_in_subgraph(const osm_ucast_mgr_t
 			next_ccdg_node->next_edge_idx = 0;
 			next_ccdg_node->pre = curr_ccdg_node;
 		} else {
-			curr_ccdg_node->status = BLACK;
+			curr_ccdg_node->search_gen = search_gen;
 			next_ccdg_node = curr_ccdg_node->pre;
 		}
 		curr_ccdg_node = next_ccdg_node;
 	} while (!found_path && curr_ccdg_node);
 
-	/* reset changed status fields */
-	for (i = 0, ccdg_node_iter = ccdg->nodes; i < ccdg->num_nodes;
-	     i++, ccdg_node_iter++)
-		if (ccdg_node_iter->status == BLACK)
-			ccdg_node_iter->status = WHITE;
-
 	OSM_LOG_EXIT(mgr->p_log);
 	return found_path;
 }
 
 static boolean_t using_edge_induces_cycle_in_ccdg(const osm_ucast_mgr_t * mgr,
-						  const ccdg_t * ccdg,
+						  ccdg_t * ccdg,
 						  const ccdg_node_t * head,
 						  ccdg_edge_t * ccdg_edge,
 						  const int32_t color)
@@ -5139,7 +5408,7 @@ static ccdg_node_t *attempt_local_backtracking(const osm_ucast_mgr_t * mgr,
 					       const network_t * network,
 					       const network_node_t *
 					       source_netw_node,
-					       const ccdg_t * ccdg,
+					       ccdg_t * ccdg,
 					       const int32_t color)
 {
 	network_node_t *unreachable_netw_node = NULL, *network_node = NULL;
@@ -5350,7 +5619,7 @@ static ccdg_node_t *attempt_local_backtracking(const osm_ucast_mgr_t * mgr,
 			pre_ccdg_edge =
 			    get_ccdg_edge_betw_nodes(pre_pre_ccdg_node,
 						     pre_ccdg_node);
-			CL_ASSERT(pre_ccdg_edge && pre_ccdg_edge->color);
+			CL_ASSERT(pre_ccdg_edge);
 
 			/* filter BLOCKED dependencies */
 			if (BLOCKED ==
@@ -5363,7 +5632,8 @@ static ccdg_node_t *attempt_local_backtracking(const osm_ucast_mgr_t * mgr,
 			/* check if we can use this pre_ccdg_edge, or start
 			   over but leave the color as is
 			 */
-			was_wet_before = pre_ccdg_edge->wet_paint;
+			was_wet_before =
+			    is_ccdg_edge_color_wet(ccdg, pre_ccdg_edge);
 			if (using_edge_induces_cycle_in_ccdg
 			    (mgr, ccdg, pre_pre_ccdg_node, pre_ccdg_edge,
 			     color)) {
@@ -5448,7 +5718,7 @@ static boolean_t attempt_shortcut_discovery(const osm_ucast_mgr_t * mgr,
 					    const network_t * network,
 					    const network_node_t *
 					    potential_shortcut_netw_node,
-					    const ccdg_t * ccdg,
+					    ccdg_t * ccdg,
 					    const ccdg_node_t *
 					    potential_shortcut_ccdg_node,
 					    const int32_t color)
@@ -5504,7 +5774,8 @@ static boolean_t attempt_shortcut_discovery(const osm_ucast_mgr_t * mgr,
 
 	/* save the colors for later, in case we have to reset them */
 	for (i = 0; i < num_dependent_edges; i++) {
-		was_wet_before[i] = dependent_edges[i]->wet_paint;
+		was_wet_before[i] =
+		    is_ccdg_edge_color_wet(ccdg, dependent_edges[i]);
 	}
 
 	/* verify that using potential_shortcut_ccdg_node doesn't induce
@@ -6002,9 +6273,16 @@ static void update_linear_forwarding_tables(const osm_ucast_mgr_t * mgr,
 		/* set port in LFT, but switches use host byte order */
 		sw->new_lft[cl_ntoh16(dlid)] = exit_port;
 
-		/* update the number of path routing thru this port */
-		if (!is_ignored_by_port_prof)
-			osm_switch_count_path(sw, exit_port);
+		/* update the number of path routing thru this port; copies
+		   of the network used by the virtual layers count them
+		   privately until merge_virtual_layer adds them up
+		 */
+		if (!is_ignored_by_port_prof) {
+			if (netw_node_iter->num_paths)
+				netw_node_iter->num_paths[exit_port]++;
+			else
+				osm_switch_count_path(sw, exit_port);
+		}
 
 		/* set the hop count from this switch to the dlid */
 		ret = osm_switch_set_hops(sw, cl_ntoh16(dlid), exit_port, hops);
@@ -6028,26 +6306,457 @@ static inline void update_dlid_to_vl_mapping(uint8_t * dlid_to_vl_mapping,
 	dlid_to_vl_mapping[cl_ntoh16(dlid)] = virtual_layer;
 }
 
-static int nue_do_ucast_routing(void *context)
+static int clone_network_and_ccdg(const osm_ucast_mgr_t * mgr,
+				  const network_t * in_network,
+				  const ccdg_t * in_ccdg,
+				  network_t * out_network, ccdg_t * out_ccdg)
 {
-	nue_context_t *nue_ctx = (nue_context_t *) context;
-	osm_ucast_mgr_t *mgr = NULL;
+	network_node_t *in_netw_node = NULL, *out_netw_node = NULL;
+	network_link_t *in_link = NULL, *out_link = NULL;
+	ccdg_node_t *in_ccdg_node = NULL, *out_ccdg_node = NULL;
+	ccdg_edge_t *out_ccdg_edge = NULL;
+	uint32_t i = 0, j = 0;
+
+	CL_ASSERT(mgr && in_network && in_ccdg && out_network && out_ccdg);
+	OSM_LOG_ENTER(mgr->p_log);
+
+	out_network->nodes =
+	    (network_node_t *) calloc(in_network->num_nodes,
+				      sizeof(network_node_t));
+	out_ccdg->nodes =
+	    (ccdg_node_t *) calloc(in_ccdg->num_nodes, sizeof(ccdg_node_t));
+	if (!out_network->nodes || !out_ccdg->nodes) {
+		OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
+			"ERR NUE49: cannot allocate memory for the copy of"
+			" network and ccdg of a virtual layer\n");
+		destroy_network(out_network);
+		destroy_ccdg(out_ccdg);
+		return -1;
+	}
+	out_network->num_nodes = in_network->num_nodes;
+	out_ccdg->num_nodes = in_ccdg->num_nodes;
+
+	out_ccdg->edges =
+	    (ccdg_edge_t *) malloc(in_ccdg->num_edges * sizeof(ccdg_edge_t));
+	out_ccdg->wet_edges =
+	    (ccdg_edge_t **) malloc(in_ccdg->num_edges *
+				    sizeof(ccdg_edge_t *));
+	if (in_ccdg->num_edges && (!out_ccdg->edges || !out_ccdg->wet_edges)) {
+		OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
+			"ERR NUE50: cannot allocate memory for ccdg edges"
+			" of a virtual layer\n");
+		destroy_network(out_network);
+		destroy_ccdg(out_ccdg);
+		return -1;
+	}
+	out_ccdg->num_edges = in_ccdg->num_edges;
+	out_ccdg->color_gen = in_ccdg->color_gen;
+	out_ccdg->search_gen = in_ccdg->search_gen;
+
+	/* copy the cCDG vertices and edges and redirect the edges into the
+	   copy; the colors are assigned later by init_ccdg_colors for each
+	   layer
+	 */
+	for (i = 0, in_ccdg_node = in_ccdg->nodes, out_ccdg_node =
+	     out_ccdg->nodes; i < in_ccdg->num_nodes;
+	     i++, in_ccdg_node++, out_ccdg_node++) {
+		*out_ccdg_node = *in_ccdg_node;
+		out_ccdg_node->edges =
+		    out_ccdg->edges + (in_ccdg_node->edges - in_ccdg->edges);
+		out_ccdg_node->corresponding_netw_link = NULL;
+		out_ccdg_node->color = NULL;
+		out_ccdg_node->pre = NULL;
+	}
+	for (i = 0, out_ccdg_edge = out_ccdg->edges; i < in_ccdg->num_edges;
+	     i++, out_ccdg_edge++) {
+		*out_ccdg_edge = in_ccdg->edges[i];
+		out_ccdg_edge->to_ccdg_node = out_ccdg->nodes +
+		    (in_ccdg->edges[i].to_ccdg_node - in_ccdg->nodes);
+		out_ccdg_edge->color = NULL;
+	}
+
+	/* copy the network nodes with their links, and connect the links
+	   with the corresponding vertices of the copied cCDG
+	 */
+	for (i = 0, in_netw_node = in_network->nodes, out_netw_node =
+	     out_network->nodes; i < in_network->num_nodes;
+	     i++, in_netw_node++, out_netw_node++) {
+		*out_netw_node = *in_netw_node;
+		out_netw_node->links = NULL;
+		out_netw_node->used_link = NULL;
+		out_netw_node->escape_path = NULL;
+		out_netw_node->stack_used_links = NULL;
+		out_netw_node->num_elem_in_Ps = 0;
+		out_netw_node->Ps = NULL;
+
+		out_netw_node->num_paths =
+		    (uint32_t *) calloc(in_netw_node->sw->num_ports,
+					sizeof(uint32_t));
+		if (!out_netw_node->num_paths)
+			break;
+		if (!in_netw_node->num_links)
+			continue;
+
+		out_netw_node->links =
+		    (network_link_t *) malloc(in_netw_node->num_links *
+					      sizeof(network_link_t));
+		out_netw_node->stack_used_links =
+		    (network_link_t **) malloc(in_netw_node->num_links *
+					       sizeof(network_link_t *));
+		if (!out_netw_node->links || !out_netw_node->stack_used_links)
+			break;
+
+		for (j = 0, in_link = in_netw_node->links, out_link =
+		     out_netw_node->links; j < in_netw_node->num_links;
+		     j++, in_link++, out_link++) {
+			*out_link = *in_link;
+			out_link->to_network_node = out_network->nodes +
+			    (in_link->to_network_node - in_network->nodes);
+			out_ccdg_node = out_ccdg->nodes +
+			    (in_link->corresponding_ccdg_node - in_ccdg->nodes);
+			out_link->corresponding_ccdg_node = out_ccdg_node;
+			out_ccdg_node->corresponding_netw_link = out_link;
+		}
+	}
+	if (i < in_network->num_nodes) {
+		OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
+			"ERR NUE51: cannot allocate memory for network links"
+			" of a virtual layer\n");
+		destroy_network(out_network);
+		destroy_ccdg(out_ccdg);
+		return -1;
+	}
+
+	OSM_LOG_EXIT(mgr->p_log);
+	return 0;
+}
+
+static void merge_virtual_layer(const osm_ucast_mgr_t * mgr,
+				const network_t * network,
+				const nue_layer_t * layer,
+				uint64_t * weight_incr)
+{
+	network_node_t *netw_node_iter = NULL, *layer_netw_node = NULL;
+	osm_switch_t *sw = NULL;
+	uint32_t k = 0;
+	uint16_t i = 0, j = 0;
+	uint8_t port = 0;
+
+	CL_ASSERT(mgr && network && layer && weight_incr);
+	OSM_LOG_ENTER(mgr->p_log);
+
+	for (i = 0, netw_node_iter = network->nodes,
+	     layer_netw_node = layer->network.nodes; i < network->num_nodes;
+	     i++, netw_node_iter++, layer_netw_node++) {
+		/* the layer started from the weights of the network */
+		for (j = 0; j < netw_node_iter->num_links; j++, k++)
+			weight_incr[k] += layer_netw_node->links[j].weight -
+			    netw_node_iter->links[j].weight;
+
+		/* and the paths thru each port are counted in the switch's
+		   port profile like update_linear_forwarding_tables does
+		 */
+		sw = netw_node_iter->sw;
+		for (port = 0; port < sw->num_ports; port++)
+			sw->p_prof[port].num_paths +=
+			    layer_netw_node->num_paths[port];
+	}
+
+	OSM_LOG_EXIT(mgr->p_log);
+}
+
+static int route_virtual_layer(nue_context_t * nue_ctx, network_t * network,
+			       ccdg_t * ccdg, const uint8_t vl,
+			       const boolean_t include_switches)
+{
+	osm_ucast_mgr_t *mgr = nue_ctx->mgr;
 	osm_port_t *dest_port = NULL;
-	boolean_t include_switches = FALSE;
 	ib_net16_t *dlid_iter = NULL;
 	uint16_t lid = 0, min_lid_ho = 0, max_lid_ho = 0;
 	uint16_t i = 0;
-	uint8_t vl = 0;
 	uint8_t ntype = 0;
 	int err = 0;
 	int32_t color = 0;
 	boolean_t process_sw = FALSE, fallback_to_escape_paths = FALSE;
-	network_node_t *netw_node_iter = NULL;
 #if defined (_DEBUG_)
 	ccdg_t verify_ccdg = {.num_nodes = 0, .nodes = NULL, .num_colors = 0,
 			      .color_array = NULL};
 #endif
 
+	OSM_LOG(mgr->p_log, OSM_LOG_DEBUG,
+		"Processing virtual layer %" PRIu8 "\n", vl);
+
+	if (!nue_ctx->num_destinations[vl]) {
+		OSM_LOG(mgr->p_log, OSM_LOG_INFO,
+			"WRN NUE43: no desti in this VL; skipping\n");
+		return 0;
+	}
+
+	color = ESCAPEPATHCOLOR + 1;
+	err =
+	    reset_ccdg_color_array(mgr, ccdg, nue_ctx->num_destinations,
+				   nue_ctx->max_vl, nue_ctx->max_lmc);
+	if (err)
+		return -1;
+	init_ccdg_colors(ccdg);
+
+	err =
+	    mark_escape_paths(mgr, network, ccdg, nue_ctx->destinations[vl],
+			      nue_ctx->num_destinations[vl],
+			      (0 == vl) ? TRUE : FALSE);
+	if (err)
+		return -1;
+	if (OSM_LOG_IS_ACTIVE_V2(mgr->p_log, OSM_LOG_DEBUG)) {
+		OSM_LOG(mgr->p_log, OSM_LOG_DEBUG,
+			"Complete CDG including escape paths for"
+			" virtual layer %" PRIu8 "\n", vl);
+		print_ccdg(mgr, ccdg, TRUE);
+	}
+
+	/* in the debug mode we monitor the correctness more closely */
+	CL_ASSERT(deep_cpy_ccdg(mgr, ccdg, &verify_ccdg));
+
+	process_sw = FALSE;
+	do {
+		dlid_iter = (ib_net16_t *) nue_ctx->destinations[vl];
+		for (i = 0; i < nue_ctx->num_destinations[vl];
+		     i++, dlid_iter++) {
+			if (osm_routing_exec_cancelled(nue_ctx->exec)) {
+				OSM_LOG(mgr->p_log, OSM_LOG_VERBOSE,
+					"Routing of virtual layer %" PRIu8
+					" cancelled\n", vl);
+				return -1;
+			}
+			dest_port =
+			    osm_get_port_by_lid(mgr->p_subn,
+						*dlid_iter);
+			ntype = osm_node_get_type(dest_port->p_node);
+			if (ntype == IB_NODE_TYPE_CA) {
+				if (process_sw)
+					continue;
+				OSM_LOG(mgr->p_log, OSM_LOG_DEBUG,
+					"Processing Hca with GUID"
+					" 0x%016" PRIx64 "\n",
+					cl_ntoh64(osm_node_get_node_guid
+						  (dest_port->p_node)));
+			} else if (ntype == IB_NODE_TYPE_SWITCH) {
+				if (!process_sw)
+					continue;
+				OSM_LOG(mgr->p_log, OSM_LOG_DEBUG,
+					"Processing switch with GUID"
+					" 0x%016" PRIx64 "\n",
+					cl_ntoh64(osm_node_get_node_guid
+						  (dest_port->p_node)));
+			}
+
+			/* distribute the LID range across the ports
+			   that can reach those LIDs to have disjoint
+			   paths for one destination port with lmc>0;
+			   for switches with bsp0: min=max; with esp0:
+			   max>min if lmc>0
+			 */
+			osm_port_get_lid_range_ho(dest_port,
+						  &min_lid_ho,
+						  &max_lid_ho);
+			for (lid = min_lid_ho; lid <= max_lid_ho; lid++) {
+				/* search a path from all nodes to dlid
+				   without closing a cycle in the ccdg
+				 */
+				err =
+				    route_via_modified_dijkstra_on_ccdg
+				    (mgr, network, ccdg, dest_port,
+				     cl_hton16(lid), color++,
+				     &fallback_to_escape_paths);
+				if (err)
+					return -1;
+				/* check intermediate steps for cycles
+				   in the complete cdg
+				 */
+				CL_ASSERT(add_paths_to_verify_ccdg
+					  (mgr, network,
+					   get_switch_lid(mgr,
+							  cl_hton16(lid)),
+					   ccdg, &verify_ccdg,
+					   fallback_to_escape_paths));
+				CL_ASSERT(is_ccdg_cycle_free
+					  (mgr, &verify_ccdg));
+				/* print the updated complete cdg after
+				   the routing for this desti is done
+				 */
+				if (OSM_LOG_IS_ACTIVE_V2
+				    (mgr->p_log, OSM_LOG_DEBUG)) {
+					OSM_LOG(mgr->p_log,
+						OSM_LOG_DEBUG,
+						"Complete CDG after routing destination LID %"
+						PRIu16
+						" for virtual layer %"
+						PRIu8 "\n", lid, vl);
+					print_ccdg(mgr, ccdg, TRUE);
+				}
+
+				/* and print the calculated routes */
+				if (OSM_LOG_IS_ACTIVE_V2
+				    (mgr->p_log, OSM_LOG_DEBUG)) {
+					OSM_LOG(mgr->p_log,
+						OSM_LOG_DEBUG,
+						"Calculated paths towards destination LID %"
+						PRIu16 "\n", lid);
+					print_routes(mgr, network, dest_port,
+						     cl_hton16(lid));
+				}
+
+				/* update linear forwarding tables of
+				   all switches towards this desti
+				 */
+				update_linear_forwarding_tables(mgr, network,
+								dest_port,
+								cl_hton16
+								(lid));
+
+				/* traverse the calculated paths and
+				   update link weights for the next
+				   step to increase the path balancing
+				 */
+				update_network_link_weights(mgr, network,
+							    get_switch_lid
+							    (mgr,
+							     cl_hton16
+							     (lid)));
+
+				/* and finally update the mapping of
+				   'destination to virtual layer'
+				 */
+				update_dlid_to_vl_mapping(nue_ctx->
+							  dlid_to_vl_mapping,
+							  cl_hton16
+							  (lid), vl);
+			}
+		}
+		if (!process_sw && include_switches)
+			process_sw = TRUE;
+		else
+			break;
+	} while (TRUE);
+
+	/* do a final check if ccdg is acyclic after processing all */
+	CL_ASSERT(is_ccdg_cycle_free(mgr, &verify_ccdg));
+
+#if defined (_DEBUG_)
+	destroy_ccdg(&verify_ccdg);
+#endif
+	return 0;
+}
+
+static void route_virtual_layer_range(void *context, size_t begin,
+				      size_t end, unsigned worker)
+{
+	nue_layers_t *layers = (nue_layers_t *) context;
+	nue_context_t *nue_ctx = layers->nue_ctx;
+	nue_layer_t *copy = &(layers->copies[worker]);
+	size_t vl = 0;
+	int err = 0;
+
+	for (vl = begin; vl < end; vl++) {
+		if (!nue_ctx->num_destinations[vl])
+			continue;
+
+		construct_network(&(copy->network));
+		construct_ccdg(&(copy->ccdg));
+		err = clone_network_and_ccdg(nue_ctx->mgr, &(nue_ctx->network),
+					     &(nue_ctx->ccdg), &(copy->network),
+					     &(copy->ccdg));
+		if (!err)
+			err = route_virtual_layer(nue_ctx, &(copy->network),
+						  &(copy->ccdg), (uint8_t) vl,
+						  layers->include_switches);
+
+		cl_spinlock_acquire(&(layers->lock));
+		if (err)
+			layers->err = err;
+		else
+			merge_virtual_layer(nue_ctx->mgr, &(nue_ctx->network),
+					    copy, layers->weight_incr);
+		cl_spinlock_release(&(layers->lock));
+
+		/* at most one copy per worker exists at any time */
+		destroy_network(&(copy->network));
+		destroy_ccdg(&(copy->ccdg));
+	}
+}
+
+static int route_virtual_layers_on_copies(nue_context_t * nue_ctx,
+					  const boolean_t include_switches)
+{
+	osm_ucast_mgr_t *mgr = nue_ctx->mgr;
+	network_node_t *netw_node_iter = NULL;
+	nue_layers_t layers;
+	uint32_t num_links = 0, k = 0;
+	uint16_t i = 0, j = 0;
+	int err = 0;
+
+	OSM_LOG_ENTER(mgr->p_log);
+
+	for (i = 0, netw_node_iter = nue_ctx->network.nodes;
+	     i < nue_ctx->network.num_nodes; i++, netw_node_iter++)
+		num_links += netw_node_iter->num_links;
+
+	memset(&layers, 0, sizeof(layers));
+	layers.nue_ctx = nue_ctx;
+	layers.include_switches = include_switches;
+	layers.copies = (nue_layer_t *) calloc(nue_ctx->exec->num_workers,
+					       sizeof(nue_layer_t));
+	layers.weight_incr = (uint64_t *) calloc(num_links ? num_links : 1,
+						 sizeof(uint64_t));
+	cl_spinlock_construct(&(layers.lock));
+	if (!layers.copies || !layers.weight_incr ||
+	    cl_spinlock_init(&(layers.lock)) != CL_SUCCESS) {
+		OSM_LOG(mgr->p_log, OSM_LOG_ERROR,
+			"ERR NUE52: cannot allocate memory for virtual layers\n");
+		err = -1;
+		goto Exit;
+	}
+
+	OSM_LOG(mgr->p_log, OSM_LOG_INFO,
+		"Routing %" PRIu8 " virtual layers on %u threads\n",
+		nue_ctx->max_vl, nue_ctx->exec->num_workers);
+	if (cl_work_pool_parallel_for(nue_ctx->exec->pool, 0,
+				      nue_ctx->max_vl, 1,
+				      route_virtual_layer_range,
+				      &layers) != CL_SUCCESS)
+		cl_work_pool_parallel_for(NULL, 0, nue_ctx->max_vl, 1,
+					  route_virtual_layer_range, &layers);
+
+	/* the copies were made from the original weights, so the increases
+	   are only applied to the network once all layers are routed
+	 */
+	err = layers.err;
+	if (!err)
+		for (i = 0, netw_node_iter = nue_ctx->network.nodes;
+		     i < nue_ctx->network.num_nodes; i++, netw_node_iter++)
+			for (j = 0; j < netw_node_iter->num_links; j++, k++)
+				netw_node_iter->links[j].weight +=
+				    layers.weight_incr[k];
+
+Exit:
+	cl_spinlock_destroy(&(layers.lock));
+	free(layers.weight_incr);
+	free(layers.copies);
+
+	OSM_LOG_EXIT(mgr->p_log);
+	return err;
+}
+
+static int nue_do_ucast_routing(void *context)
+{
+	nue_context_t *nue_ctx = (nue_context_t *) context;
+	osm_ucast_mgr_t *mgr = NULL;
+	osm_port_t *dest_port = NULL;
+	boolean_t include_switches = FALSE;
+	uint16_t lid = 0, min_lid_ho = 0, max_lid_ho = 0;
+	uint16_t i = 0;
+	int err = 0;
+	network_node_t *netw_node_iter = NULL;
+
 	if (nue_ctx)
 		mgr = (osm_ucast_mgr_t *) nue_ctx->mgr;
 	else
@@ -6074,180 +6783,21 @@ static int nue_do_ucast_routing(void *context)
 		print_destination_distribution(mgr, nue_ctx->destinations,
 					       nue_ctx->num_destinations);
 
-	for (vl = 0; vl < nue_ctx->max_vl; vl++) {
-		OSM_LOG(mgr->p_log, OSM_LOG_DEBUG,
-			"Processing virtual layer %" PRIu8 "\n", vl);
-
-		if (!nue_ctx->num_destinations[vl]) {
-			OSM_LOG(mgr->p_log, OSM_LOG_INFO,
-				"WRN NUE43: no desti in this VL; skipping\n");
-			continue;
-		}
-
-		color = ESCAPEPATHCOLOR + 1;
-		err =
-		    reset_ccdg_color_array(mgr, &(nue_ctx->ccdg),
-					   nue_ctx->num_destinations,
-					   nue_ctx->max_vl, nue_ctx->max_lmc);
-		if (err) {
-			destroy_context(nue_ctx);
-			return -1;
-		}
-		init_ccdg_colors(&(nue_ctx->ccdg));
-
-		err =
-		    mark_escape_paths(mgr, &(nue_ctx->network),
-				      &(nue_ctx->ccdg),
-				      nue_ctx->destinations[vl],
-				      nue_ctx->num_destinations[vl],
-				      (0 == vl) ? TRUE : FALSE);
-		if (err) {
-			destroy_context(nue_ctx);
-			return -1;
-		}
-		if (OSM_LOG_IS_ACTIVE_V2(mgr->p_log, OSM_LOG_DEBUG)) {
-			OSM_LOG(mgr->p_log, OSM_LOG_DEBUG,
-				"Complete CDG including escape paths for"
-				" virtual layer %" PRIu8 "\n", vl);
-			print_ccdg(mgr, &(nue_ctx->ccdg), TRUE);
-		}
-
-		/* in the debug mode we monitor the correctness more closely */
-		CL_ASSERT(deep_cpy_ccdg(mgr, &(nue_ctx->ccdg), &verify_ccdg));
-
-		process_sw = FALSE;
-		do {
-			dlid_iter = (ib_net16_t *) nue_ctx->destinations[vl];
-			for (i = 0; i < nue_ctx->num_destinations[vl];
-			     i++, dlid_iter++) {
-				dest_port =
-				    osm_get_port_by_lid(mgr->p_subn,
-							*dlid_iter);
-				ntype = osm_node_get_type(dest_port->p_node);
-				if (ntype == IB_NODE_TYPE_CA) {
-					if (process_sw)
-						continue;
-					OSM_LOG(mgr->p_log, OSM_LOG_DEBUG,
-						"Processing Hca with GUID"
-						" 0x%016" PRIx64 "\n",
-						cl_ntoh64(osm_node_get_node_guid
-							  (dest_port->p_node)));
-				} else if (ntype == IB_NODE_TYPE_SWITCH) {
-					if (!process_sw)
-						continue;
-					OSM_LOG(mgr->p_log, OSM_LOG_DEBUG,
-						"Processing switch with GUID"
-						" 0x%016" PRIx64 "\n",
-						cl_ntoh64(osm_node_get_node_guid
-							  (dest_port->p_node)));
-				}
-
-				/* distribute the LID range across the ports
-				   that can reach those LIDs to have disjoint
-				   paths for one destination port with lmc>0;
-				   for switches with bsp0: min=max; with esp0:
-				   max>min if lmc>0
-				 */
-				osm_port_get_lid_range_ho(dest_port,
-							  &min_lid_ho,
-							  &max_lid_ho);
-				for (lid = min_lid_ho; lid <= max_lid_ho; lid++) {
-					/* search a path from all nodes to dlid
-					   without closing a cycle in the ccdg
-					 */
-					err =
-					    route_via_modified_dijkstra_on_ccdg
-					    (mgr, &(nue_ctx->network),
-					     &(nue_ctx->ccdg), dest_port,
-					     cl_hton16(lid), color++,
-					     &fallback_to_escape_paths);
-					if (err) {
-						destroy_context(nue_ctx);
-						return -1;
-					}
-					/* check intermediate steps for cycles
-					   in the complete cdg
-					 */
-					CL_ASSERT(add_paths_to_verify_ccdg
-						  (mgr, &(nue_ctx->network),
-						   get_switch_lid(mgr,
-								  cl_hton16
-								  (lid)),
-						   &(nue_ctx->ccdg),
-						   &verify_ccdg,
-						   fallback_to_escape_paths));
-					CL_ASSERT(is_ccdg_cycle_free
-						  (mgr, &verify_ccdg));
-					/* print the updated complete cdg after
-					   the routing for this desti is done
-					 */
-					if (OSM_LOG_IS_ACTIVE_V2
-					    (mgr->p_log, OSM_LOG_DEBUG)) {
-						OSM_LOG(mgr->p_log,
-							OSM_LOG_DEBUG,
-							"Complete CDG after routing destination LID %"
-							PRIu16
-							" for virtual layer %"
-							PRIu8 "\n", lid, vl);
-						print_ccdg(mgr,
-							   &(nue_ctx->ccdg),
-							   TRUE);
-					}
-
-					/* and print the calculated routes */
-					if (OSM_LOG_IS_ACTIVE_V2
-					    (mgr->p_log, OSM_LOG_DEBUG)) {
-						OSM_LOG(mgr->p_log,
-							OSM_LOG_DEBUG,
-							"Calculated paths towards destination LID %"
-							PRIu16 "\n", lid);
-						print_routes(mgr,
-							     &(nue_ctx->
-							       network),
-							     dest_port,
-							     cl_hton16(lid));
-					}
-
-					/* update linear forwarding tables of
-					   all switches towards this desti
-					 */
-					update_linear_forwarding_tables(mgr,
-									&
-									(nue_ctx->
-									 network),
-									dest_port,
-									cl_hton16
-									(lid));
-
-					/* traverse the calculated paths and
-					   update link weights for the next
-					   step to increase the path balancing
-					 */
-					update_network_link_weights(mgr,
-								    &(nue_ctx->
-								      network),
-								    get_switch_lid
-								    (mgr,
-								     cl_hton16
-								     (lid)));
-
-					/* and finally update the mapping of
-					   'destination to virtual layer'
-					 */
-					update_dlid_to_vl_mapping(nue_ctx->
-								  dlid_to_vl_mapping,
-								  cl_hton16
-								  (lid), vl);
-				}
-			}
-			if (!process_sw && include_switches)
-				process_sw = TRUE;
-			else
-				break;
-		} while (TRUE);
-
-		/* do a final check if ccdg is acyclic after processing all */
-		CL_ASSERT(is_ccdg_cycle_free(mgr, &verify_ccdg));
+	/* virtual layers only interact thru the link weights, so they are
+	   routed on copies starting from the same weights (concurrently if
+	   the subnet manager runs routing threads) to get the same result
+	   for any number of threads; a single layer is routed in place
+	 */
+	if (nue_ctx->max_vl > 1)
+		err = route_virtual_layers_on_copies(nue_ctx,
+						     include_switches);
+	else
+		err = route_virtual_layer(nue_ctx, &(nue_ctx->network),
+					  &(nue_ctx->ccdg), 0,
+					  include_switches);
+	if (err) {
+		destroy_context(nue_ctx);
+		return -1;
 	}
 
 	/* if switches haven't been included in the original destinations set
@@ -6722,6 +7272,7 @@ int osm_ucast_nue_setup(struct osm_routing_engine *r, osm_opensm_t * osm)
 
 	/* reset function pointers to nue routines */
 	r->context = (void *)nue_context;
+	r->flags = OSM_ROUTING_ENGINE_PATH_SL_MT_SAFE;
 	r->build_lid_matrices = nue_discover_network;
 	r->ucast_build_fwd_tables = nue_do_ucast_routing;
 	r->ucast_dump_tables = NULL;
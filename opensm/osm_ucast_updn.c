@@ -68,15 +68,21 @@ typedef enum updn_switch_dir {
 typedef struct updn {
 	unsigned num_roots;
 	osm_opensm_t *p_osm;
+	osm_graph_t *graph;
+	unsigned *rank;		/* indexed by graph switch number */
+	uint64_t *id;
 } updn_t;
 
-struct updn_node {
-	cl_list_item_t list;
-	osm_switch_t *sw;
-	uint64_t id;
-	updn_switch_dir_t dir;
-	unsigned rank;
-	unsigned visited;
+/* per worker BFS state, the queue is a ring of graph->num_sw entries */
+struct updn_bfs_scratch {
+	uint32_t *queue;
+	uint8_t *dir;
+	uint8_t *visited;
+};
+
+struct updn_bfs_work {
+	updn_t *p_updn;
+	struct updn_bfs_scratch *scratch;
 };
 
 /* This function returns direction based on rank and guid info of current &
@@ -108,58 +114,48 @@ static updn_switch_dir_t updn_get_dir(unsigned cur_rank, unsigned rem_rank,
  * This function does the bfs of min hop table calculation by guid index
  * as a starting point.
  **********************************************************************/
-static int updn_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
-			    IN osm_switch_t * p_sw)
+static int updn_bfs_by_node(IN osm_log_t * p_log, IN updn_t * p_updn,
+			    IN uint32_t root, IN struct updn_bfs_scratch *s)
 {
-	uint8_t pn, pn_rem;
-	cl_qlist_t list;
+	osm_graph_t *g = p_updn->graph;
+	osm_graph_link_t *link;
+	uint32_t u, rem_u, head = 0, count = 0;
 	uint16_t lid;
-	struct updn_node *u;
 	updn_switch_dir_t next_dir, current_dir;
 
 	OSM_LOG_ENTER(p_log);
 
-	lid = osm_node_get_base_lid(p_sw->p_node, 0);
-	lid = cl_ntoh16(lid);
-	osm_switch_set_hops(p_sw, lid, 0, 0);
+	lid = g->lid[root];
+	osm_switch_set_hops(g->sw[root], lid, 0, 0);
 
 	OSM_LOG(p_log, OSM_LOG_DEBUG,
 		"Starting from switch - port GUID 0x%" PRIx64 " lid %u\n",
-		cl_ntoh64(p_sw->p_node->node_info.port_guid), lid);
+		cl_ntoh64(g->sw[root]->p_node->node_info.port_guid), lid);
 
-	u = p_sw->priv;
-	u->dir = UP;
+	s->dir[root] = UP;
 
 	/* Update list with the new element */
-	cl_qlist_init(&list);
-	cl_qlist_insert_tail(&list, &u->list);
+	s->queue[count++] = root;
 
 	/* BFS the list till no next element */
-	while (!cl_is_qlist_empty(&list)) {
-		u = (struct updn_node *)cl_qlist_remove_head(&list);
-		u->visited = 0;	/* cleanup */
-		current_dir = u->dir;
-		/* Go over all ports of the switch and find unvisited remote nodes */
-		for (pn = 1; pn < u->sw->num_ports; pn++) {
-			osm_node_t *p_remote_node;
-			struct updn_node *rem_u;
+	while (count) {
+		u = s->queue[head];
+		head = head + 1 < g->num_sw ? head + 1 : 0;
+		count--;
+		s->visited[u] = 0;	/* cleanup */
+		current_dir = s->dir[u];
+		/* Go over all links of the switch and find unvisited remote nodes */
+		for (link = &g->links[g->link_start[u]];
+		     link < &g->links[g->link_start[u + 1]]; link++) {
 			uint8_t current_min_hop, remote_min_hop,
 			    set_hop_return_value;
 			osm_switch_t *p_remote_sw;
 
-			p_remote_node =
-			    osm_node_get_remote_node(u->sw->p_node, pn,
-						     &pn_rem);
-			/* If no remote node OR remote node is not a SWITCH
-			   continue to next pn */
-			if (!p_remote_node || !p_remote_node->sw)
-				continue;
-			/* Fetch remote guid only after validation of remote node */
-			p_remote_sw = p_remote_node->sw;
-			rem_u = p_remote_sw->priv;
+			rem_u = link->sw;
+			p_remote_sw = g->sw[rem_u];
 			/* Decide which direction to mark it (UP/DOWN) */
-			next_dir = updn_get_dir(u->rank, rem_u->rank,
-						u->id, rem_u->id);
+			next_dir = updn_get_dir(p_updn->rank[u], p_updn->rank[rem_u],
+						p_updn->id[u], p_updn->id[rem_u]);
 
 			/* Check if this is a legal step : the only illegal step is going
 			   from DOWN to UP */
@@ -167,21 +163,22 @@ static int updn_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
 				OSM_LOG(p_log, OSM_LOG_DEBUG,
 					"Avoiding move from 0x%016" PRIx64
 					" to 0x%016" PRIx64 "\n",
-					cl_ntoh64(osm_node_get_node_guid(u->sw->p_node)),
-					cl_ntoh64(osm_node_get_node_guid(p_remote_node)));
+					cl_ntoh64(osm_node_get_node_guid(g->sw[u]->p_node)),
+					cl_ntoh64(osm_node_get_node_guid(p_remote_sw->p_node)));
 				/* Illegal step */
 				continue;
 			}
 			/* Set MinHop value for the current lid */
-			current_min_hop = osm_switch_get_least_hops(u->sw, lid);
+			current_min_hop = osm_switch_get_least_hops(g->sw[u], lid);
 			/* Check hop count if better insert into list && update
 			   the remote node Min Hop Table */
 			remote_min_hop =
-			    osm_switch_get_hop_count(p_remote_sw, lid, pn_rem);
+			    osm_switch_get_hop_count(p_remote_sw, lid,
+						     link->rem_port);
 			if (current_min_hop + 1 < remote_min_hop) {
 				set_hop_return_value =
 				    osm_switch_set_hops(p_remote_sw, lid,
-							pn_rem,
+							link->rem_port,
 							current_min_hop + 1);
 				if (set_hop_return_value) {
 					OSM_LOG(p_log, OSM_LOG_ERROR, "ERR AA01: "
@@ -189,12 +186,13 @@ static int updn_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
 						set_hop_return_value);
 				}
 				/* Check if remote port has already been visited */
-				if (!rem_u->visited) {
+				if (!s->visited[rem_u]) {
 					/* Insert updn_switch item into the list */
-					rem_u->dir = next_dir;
-					rem_u->visited = 1;
-					cl_qlist_insert_tail(&list,
-							     &rem_u->list);
+					s->dir[rem_u] = next_dir;
+					s->visited[rem_u] = 1;
+					s->queue[(head + count) % g->num_sw] =
+					    rem_u;
+					count++;
 				}
 			}
 		}
@@ -204,76 +202,73 @@ static int updn_bfs_by_node(IN osm_log_t * p_log, IN osm_subn_t * p_subn,
 	return 0;
 }
 
+static void updn_bfs_range(void *context, size_t begin, size_t end,
+			   unsigned worker)
+{
+	struct updn_bfs_work *w = context;
+	size_t i;
+
+	for (i = begin; i < end; i++) {
+		if (osm_routing_exec_cancelled(&w->p_updn->p_osm->
+					       routing_exec))
+			break;
+		updn_bfs_by_node(&w->p_updn->p_osm->log, w->p_updn, i,
+				 &w->scratch[worker]);
+	}
+}
+
 /* NOTE : PLS check if we need to decide that the first */
 /*        rank is a SWITCH for BFS purpose */
 static int updn_subn_rank(IN updn_t * p_updn)
 {
-	osm_switch_t *p_sw;
-	osm_physp_t *p_physp, *p_remote_physp;
-	cl_qlist_t list;
-	cl_map_item_t *item;
-	struct updn_node *u, *remote_u;
-	uint8_t num_ports, port_num;
+	osm_graph_t *g = p_updn->graph;
+	osm_graph_link_t *link;
+	uint32_t *queue;
+	uint32_t u, rem_u, head = 0, tail = 0;
 	osm_log_t *p_log = &p_updn->p_osm->log;
 	unsigned max_rank = 0;
 
 	OSM_LOG_ENTER(p_log);
-	cl_qlist_init(&list);
 
-	/* add all roots to the list */
-	for (item = cl_qmap_head(&p_updn->p_osm->subn.sw_guid_tbl);
-	     item != cl_qmap_end(&p_updn->p_osm->subn.sw_guid_tbl);
-	     item = cl_qmap_next(item)) {
-		p_sw = (osm_switch_t *)item;
-		u = p_sw->priv;
-		if (!u->rank)
-			cl_qlist_insert_tail(&list, &u->list);
+	/* a switch is queued once, when it is ranked */
+	queue = malloc(g->num_sw * sizeof(*queue));
+	if (!queue) {
+		OSM_LOG_EXIT(p_log);
+		return -1;
 	}
 
+	/* add all roots to the list */
+	for (u = 0; u < g->num_sw; u++)
+		if (!p_updn->rank[u])
+			queue[tail++] = u;
+
 	/* BFS the list till it's empty */
-	while (!cl_is_qlist_empty(&list)) {
-		u = (struct updn_node *)cl_qlist_remove_head(&list);
+	while (head < tail) {
+		u = queue[head++];
 		/* Go over all remote nodes and rank them (if not already visited) */
-		p_sw = u->sw;
-		num_ports = p_sw->num_ports;
 		OSM_LOG(p_log, OSM_LOG_DEBUG,
 			"Handling switch GUID 0x%" PRIx64 "\n",
-			cl_ntoh64(osm_node_get_node_guid(p_sw->p_node)));
-		for (port_num = 1; port_num < num_ports; port_num++) {
-			ib_net64_t port_guid;
-
-			/* Current port fetched in order to get remote side */
-			p_physp =
-			    osm_node_get_physp_ptr(p_sw->p_node, port_num);
-
-			if (!p_physp)
-				continue;
-
-			p_remote_physp = p_physp->p_remote_physp;
-
-			/*
-			   make sure that all the following occur on p_remote_physp:
-			   1. The port isn't NULL
-			   2. It is a switch
-			 */
-			if (p_remote_physp && p_remote_physp->p_node->sw) {
-				remote_u = p_remote_physp->p_node->sw->priv;
-				port_guid = p_remote_physp->port_guid;
-
-				if (remote_u->rank > u->rank + 1) {
-					remote_u->rank = u->rank + 1;
-					max_rank = remote_u->rank;
-					cl_qlist_insert_tail(&list,
-							     &remote_u->list);
-					OSM_LOG(p_log, OSM_LOG_DEBUG,
-						"Rank of port GUID 0x%" PRIx64
-						" = %u\n", cl_ntoh64(port_guid),
-						remote_u->rank);
-				}
+			cl_ntoh64(osm_node_get_node_guid(g->sw[u]->p_node)));
+		for (link = &g->links[g->link_start[u]];
+		     link < &g->links[g->link_start[u + 1]]; link++) {
+			rem_u = link->sw;
+			if (p_updn->rank[rem_u] > p_updn->rank[u] + 1) {
+				p_updn->rank[rem_u] = p_updn->rank[u] + 1;
+				max_rank = p_updn->rank[rem_u];
+				queue[tail++] = rem_u;
+				OSM_LOG(p_log, OSM_LOG_DEBUG,
+					"Rank of port GUID 0x%" PRIx64
+					" = %u\n",
+					cl_ntoh64(osm_node_get_physp_ptr
+						  (g->sw[rem_u]->p_node,
+						   link->rem_port)->port_guid),
+					p_updn->rank[rem_u]);
 			}
 		}
 	}
 
+	free(queue);
+
 	/* Print Summary of ranking */
 	OSM_LOG(p_log, OSM_LOG_VERBOSE,
 		"Subnet ranking completed. Max Node Rank = %d\n", max_rank);
@@ -284,15 +279,17 @@ static int updn_subn_rank(IN updn_t * p_updn)
 /* hack: preserve min hops entries to any other root switches */
 static void updn_clear_non_root_hops(updn_t * updn, osm_switch_t * sw)
 {
-	osm_port_t *port;
+	osm_graph_t *g = updn->graph;
+	uint32_t lid_sw;
 	unsigned i;
 
 	for (i = 0; i < sw->num_hops; i++)
 		if (sw->hops[i]) {
-			port = osm_get_port_by_lid_ho(&updn->p_osm->subn, i);
-			if (!port || !port->p_node->sw
-			    || ((struct updn_node *)port->p_node->sw->priv)->
-			    rank != 0)
+			/* keep the entry only for the own LIDs of root switches */
+			lid_sw = osm_graph_lid_to_sw(g, i);
+			if (lid_sw == OSM_GRAPH_NO_SW || i < g->lid[lid_sw]
+			    || i >= g->lid[lid_sw] + (1U << g->lmc[lid_sw])
+			    || updn->rank[lid_sw] != 0)
 				memset(sw->hops[i], 0xff, sw->num_ports);
 		}
 }
@@ -301,8 +298,15 @@ static int updn_set_min_hop_table(IN updn_t * p_updn)
 {
 	osm_subn_t *p_subn = &p_updn->p_osm->subn;
 	osm_log_t *p_log = &p_updn->p_osm->log;
+	osm_routing_exec_t *exec = &p_updn->p_osm->routing_exec;
+	unsigned workers = exec->num_workers;
+	uint32_t num_sw = p_updn->graph->num_sw;
+	struct updn_bfs_work w;
 	osm_switch_t *p_sw;
 	cl_map_item_t *item;
+	uint32_t *buf;
+	unsigned i;
+	int status = 0;
 
 	OSM_LOG_ENTER(p_log);
 
@@ -329,18 +333,45 @@ static int updn_set_min_hop_table(IN updn_t * p_updn)
 	OSM_LOG(p_log, OSM_LOG_VERBOSE,
 		"BFS through all port guids in the subnet [\n");
 
-	for (item = cl_qmap_head(&p_updn->p_osm->subn.sw_guid_tbl);
-	     item != cl_qmap_end(&p_updn->p_osm->subn.sw_guid_tbl);
-	     item = cl_qmap_next(item)) {
-		p_sw = (osm_switch_t *)item;
-		updn_bfs_by_node(p_log, p_subn, p_sw);
+	/*
+	   Each BFS only sets the hops to the LID of its own root, so the
+	   roots are spread over the routing workers.
+	 */
+	w.p_updn = p_updn;
+	w.scratch = calloc(workers, sizeof(*w.scratch));
+	if (!w.scratch) {
+		status = -1;
+		goto Exit;
+	}
+	for (i = 0; i < workers; i++) {
+		buf = osm_routing_exec_scratch(exec, i, num_sw *
+					       (sizeof(uint32_t) + 2));
+		if (!buf) {
+			status = -1;
+			goto Exit;
+		}
+		w.scratch[i].queue = buf;
+		w.scratch[i].dir = (uint8_t *) (buf + num_sw);
+		w.scratch[i].visited = w.scratch[i].dir + num_sw;
+		memset(w.scratch[i].visited, 0, num_sw);
 	}
 
+	if (cl_work_pool_parallel_for(exec->pool, 0, num_sw, 1,
+				      updn_bfs_range, &w) != CL_SUCCESS)
+		cl_work_pool_parallel_for(NULL, 0, num_sw, 1, updn_bfs_range,
+					  &w);
+
 	OSM_LOG(p_log, OSM_LOG_VERBOSE,
 		"BFS through all port guids in the subnet ]\n");
-	/* Cleanup */
+Exit:
+	if (status)
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR AA15: "
+			"cannot allocate BFS state for %u workers\n", workers);
+	else if (osm_routing_exec_cancelled(exec))
+		status = -1;
+	free(w.scratch);
 	OSM_LOG_EXIT(p_log);
-	return 0;
+	return status;
 }
 
 static int updn_build_lid_matrices(IN updn_t * p_updn)
@@ -384,31 +415,13 @@ _exit:
 	return status;
 }
 
-static struct updn_node *create_updn_node(osm_switch_t * sw)
-{
-	struct updn_node *u;
-
-	u = malloc(sizeof(*u));
-	if (!u)
-		return NULL;
-	memset(u, 0, sizeof(*u));
-	u->sw = sw;
-	u->id = cl_ntoh64(osm_node_get_node_guid(sw->p_node));
-	u->rank = 0xffffffff;
-	return u;
-}
-
-static void delete_updn_node(struct updn_node *u)
-{
-	u->sw->priv = NULL;
-	free(u);
-}
-
 /* Find Root nodes automatically by Min Hop Table info */
 static void updn_find_root_nodes_by_min_hop(OUT updn_t * p_updn)
 {
 	osm_opensm_t *p_osm = p_updn->p_osm;
+	osm_graph_t *g = p_updn->graph;
 	osm_switch_t *p_sw;
+	uint32_t sw;
 	osm_port_t *p_port;
 	osm_physp_t *p_physp;
 	cl_map_item_t *item;
@@ -459,16 +472,14 @@ static void updn_find_root_nodes_by_min_hop(OUT updn_t * p_updn)
 
 	OSM_LOG(&p_osm->log, OSM_LOG_VERBOSE,
 		"Passing through all switches to collect Min Hop info\n");
-	for (item = cl_qmap_head(&p_updn->p_osm->subn.sw_guid_tbl);
-	     item != cl_qmap_end(&p_updn->p_osm->subn.sw_guid_tbl);
-	     item = cl_qmap_next(item)) {
+	for (sw = 0; sw < g->num_sw; sw++) {
 		unsigned hop_hist[IB_SUBNET_PATH_HOPS_MAX];
 		uint16_t max_lid_ho;
 		uint8_t hop_val;
 		uint16_t numHopBarsOverThd1 = 0;
 		uint16_t numHopBarsOverThd2 = 0;
 
-		p_sw = (osm_switch_t *) item;
+		p_sw = g->sw[sw];
 
 		memset(hop_hist, 0, sizeof(hop_hist));
 
@@ -497,7 +508,7 @@ static void updn_find_root_nodes_by_min_hop(OUT updn_t * p_updn)
 			OSM_LOG(&p_osm->log, OSM_LOG_DEBUG,
 				"Ranking GUID 0x%" PRIx64 " as root node\n",
 				cl_ntoh64(osm_node_get_node_guid(p_sw->p_node)));
-			((struct updn_node *)p_sw->priv)->rank = 0;
+			p_updn->rank[sw] = 0;
 			p_updn->num_roots++;
 		}
 	}
@@ -510,21 +521,24 @@ _exit:
 
 static void dump_roots(cl_map_item_t *item, FILE *file, void *cxt)
 {
+	updn_t *updn = cxt;
 	osm_switch_t *sw = (osm_switch_t *)item;
-	if (!((struct updn_node *)sw->priv)->rank)
+	if (!updn->rank[osm_graph_find_sw(updn->graph,
+					  osm_node_get_node_guid(sw->p_node))])
 		fprintf(file, "0x%" PRIx64 "\n",
 			cl_ntoh64(osm_node_get_node_guid(sw->p_node)));
 }
 
 static int update_id(void *cxt, uint64_t guid, char *p)
 {
-	osm_opensm_t *osm = cxt;
-	osm_switch_t *sw;
+	updn_t *updn = cxt;
+	osm_opensm_t *osm = updn->p_osm;
+	uint32_t sw;
 	uint64_t id;
 	char *e;
 
-	sw = osm_get_switch_by_guid(&osm->subn, cl_hton64(guid));
-	if (!sw) {
+	sw = osm_graph_find_sw(updn->graph, cl_hton64(guid));
+	if (sw == OSM_GRAPH_NO_SW) {
 		OSM_LOG(&osm->log, OSM_LOG_VERBOSE,
 			"switch with guid 0x%" PRIx64 " is not found\n", guid);
 		return 0;
@@ -540,7 +554,7 @@ static int update_id(void *cxt, uint64_t guid, char *p)
 	OSM_LOG(&osm->log, OSM_LOG_DEBUG,
 		"update node 0x%" PRIx64 " id to 0x%" PRIx64 "\n", guid, id);
 
-	((struct updn_node *)sw->priv)->id = id;
+	updn->id[sw] = id;
 
 	return 0;
 }
@@ -548,10 +562,10 @@ static int update_id(void *cxt, uint64_t guid, char *p)
 static int rank_root_node(void *cxt, uint64_t guid, char *p)
 {
 	updn_t *updn = cxt;
-	osm_switch_t *sw;
+	uint32_t sw;
 
-	sw = osm_get_switch_by_guid(&updn->p_osm->subn, cl_hton64(guid));
-	if (!sw) {
+	sw = osm_graph_find_sw(updn->graph, cl_hton64(guid));
+	if (sw == OSM_GRAPH_NO_SW) {
 		OSM_LOG(&updn->p_osm->log, OSM_LOG_VERBOSE,
 			"switch with guid 0x%" PRIx64 " is not found\n", guid);
 		return 0;
@@ -560,7 +574,7 @@ static int rank_root_node(void *cxt, uint64_t guid, char *p)
 	OSM_LOG(&updn->p_osm->log, OSM_LOG_DEBUG,
 		"Ranking root port GUID 0x%" PRIx64 "\n", guid);
 
-	((struct updn_node *)sw->priv)->rank = 0;
+	updn->rank[sw] = 0;
 	updn->num_roots++;
 
 	return 0;
@@ -570,23 +584,25 @@ static int rank_root_node(void *cxt, uint64_t guid, char *p)
 static int updn_lid_matrices(void *ctx)
 {
 	updn_t *p_updn = ctx;
-	cl_map_item_t *item;
-	osm_switch_t *p_sw;
+	osm_graph_t *g = &p_updn->p_osm->sm.ucast_mgr.graph;
+	uint32_t sw;
 	int ret = 0;
 
 	OSM_LOG_ENTER(&p_updn->p_osm->log);
 
-	for (item = cl_qmap_head(&p_updn->p_osm->subn.sw_guid_tbl);
-	     item != cl_qmap_end(&p_updn->p_osm->subn.sw_guid_tbl);
-	     item = cl_qmap_next(item)) {
-		p_sw = (osm_switch_t *)item;
-		p_sw->priv = create_updn_node(p_sw);
-		if (!p_sw->priv) {
-			OSM_LOG(&(p_updn->p_osm->log), OSM_LOG_ERROR, "ERR AA0C: "
-				"cannot create updn node\n");
-			OSM_LOG_EXIT(&p_updn->p_osm->log);
-			return -1;
-		}
+	p_updn->graph = g;
+	p_updn->rank = malloc(g->num_sw * sizeof(*p_updn->rank));
+	p_updn->id = malloc(g->num_sw * sizeof(*p_updn->id));
+	if (!p_updn->rank || !p_updn->id) {
+		OSM_LOG(&(p_updn->p_osm->log), OSM_LOG_ERROR, "ERR AA0C: "
+			"cannot create updn nodes\n");
+		ret = -1;
+		goto Exit;
+	}
+	for (sw = 0; sw < g->num_sw; sw++) {
+		p_updn->rank[sw] = 0xffffffff;
+		p_updn->id[sw] =
+		    cl_ntoh64(osm_node_get_node_guid(g->sw[sw]->p_node));
 	}
 
 	/* First setup root nodes */
@@ -619,7 +635,7 @@ static int updn_lid_matrices(void *ctx)
 			p_updn->p_osm->subn.opt.ids_guid_file);
 
 		ret = parse_node_map(p_updn->p_osm->subn.opt.ids_guid_file,
-				     update_id, p_updn->p_osm);
+				     update_id, p_updn);
 		if (ret)
 			OSM_LOG(&p_updn->p_osm->log, OSM_LOG_ERROR, "ERR AA03: "
 				"cannot parse node ids file \'%s\'\n",
@@ -640,14 +656,13 @@ static int updn_lid_matrices(void *ctx)
 	if (OSM_LOG_IS_ACTIVE_V2(&p_updn->p_osm->log, OSM_LOG_ROUTING))
 		osm_dump_qmap_to_file(p_updn->p_osm, "opensm-updn-roots.dump",
 				      &p_updn->p_osm->subn.sw_guid_tbl,
-				      dump_roots, NULL);
+				      dump_roots, p_updn);
 
-	for (item = cl_qmap_head(&p_updn->p_osm->subn.sw_guid_tbl);
-	     item != cl_qmap_end(&p_updn->p_osm->subn.sw_guid_tbl);
-	     item = cl_qmap_next(item)) {
-		p_sw = (osm_switch_t *) item;
-		delete_updn_node(p_sw->priv);
-	}
+Exit:
+	free(p_updn->rank);
+	free(p_updn->id);
+	p_updn->rank = NULL;
+	p_updn->id = NULL;
 
 	OSM_LOG_EXIT(&p_updn->p_osm->log);
 	return ret;
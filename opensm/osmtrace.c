@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2026 The OpenSM contributors. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *    Offline decoder of the binary MAD trace written by OpenSM when
+ *    the mad_trace_file option is set.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+#include <getopt.h>
+#include <opensm/osm_log.h>
+#include <opensm/osm_helper.h>
+
+static const char *event_str[] = {
+	"???", "SEND", "RECV", "TIMEOUT", "SEND_ERR", "CANCEL"
+};
+
+static int rec_cmp(const void *a, const void *b)
+{
+	const osm_mad_trace_rec_t *r1 = a, *r2 = b;
+
+	/* sequence numbers may wrap, compare by distance */
+	return (int32_t) (r1->seq - r2->seq);
+}
+
+static const char *attr_str(const osm_mad_trace_rec_t * rec)
+{
+	switch (rec->mgmt_class) {
+	case IB_MCLASS_SUBN_LID:
+	case IB_MCLASS_SUBN_DIR:
+		return ib_get_sm_attr_str(rec->attr_id);
+	case IB_MCLASS_SUBN_ADM:
+		return ib_get_sa_attr_str(rec->attr_id);
+	default:
+		return "";
+	}
+}
+
+static void print_rec(FILE * out, const osm_mad_trace_rec_t * rec)
+{
+	time_t tim = rec->time_usecs / 1000000;
+	struct tm result;
+	char date[32];
+
+	localtime_r(&tim, &result);
+	strftime(date, sizeof(date), "%b %d %H:%M:%S", &result);
+
+	fprintf(out, "%s %06u %-8s class 0x%02x method 0x%02x "
+		"attr 0x%04x %-20s mod 0x%08x lid %u tid 0x%016" PRIx64
+		" status 0x%04x",
+		date, (unsigned)(rec->time_usecs % 1000000),
+		rec->event < sizeof(event_str) / sizeof(event_str[0]) ?
+		event_str[rec->event] : event_str[0],
+		rec->mgmt_class, rec->method, cl_ntoh16(rec->attr_id),
+		attr_str(rec), cl_ntoh32(rec->attr_mod), rec->lid,
+		cl_ntoh64(rec->trans_id), cl_ntoh16(rec->status));
+	if (rec->latency_usecs)
+		fprintf(out, " latency %u usec", rec->latency_usecs);
+	fprintf(out, "\n");
+}
+
+static void show_usage(void)
+{
+	printf("Usage: osmtrace [-l] <mad_trace_file>\n"
+	       "Decodes the binary MAD trace written by OpenSM\n"
+	       "  -l  only print sends which got no response "
+	       "(timeouts, cancels and send errors)\n");
+}
+
+int main(int argc, char *argv[])
+{
+	osm_mad_trace_hdr_t hdr;
+	osm_mad_trace_rec_t *recs;
+	unsigned i, n = 0;
+	int lost_only = 0, c;
+	FILE *f;
+
+	while ((c = getopt(argc, argv, "lh")) != -1)
+		switch (c) {
+		case 'l':
+			lost_only = 1;
+			break;
+		default:
+			show_usage();
+			return c == 'h' ? 0 : 1;
+		}
+
+	if (optind != argc - 1) {
+		show_usage();
+		return 1;
+	}
+
+	f = fopen(argv[optind], "rb");
+	if (!f) {
+		fprintf(stderr, "cannot open \'%s\': %s\n", argv[optind],
+			strerror(errno));
+		return 1;
+	}
+
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    hdr.magic != OSM_MAD_TRACE_MAGIC) {
+		fprintf(stderr, "\'%s\' is not a MAD trace file\n",
+			argv[optind]);
+		fclose(f);
+		return 1;
+	}
+	if (hdr.version != OSM_MAD_TRACE_VERSION ||
+	    hdr.rec_size != sizeof(*recs)) {
+		fprintf(stderr, "unsupported MAD trace version %u "
+			"(record size %u)\n", hdr.version, hdr.rec_size);
+		fclose(f);
+		return 1;
+	}
+
+	recs = malloc(hdr.num_recs * sizeof(*recs));
+	if (!recs) {
+		fprintf(stderr, "cannot allocate %u records\n", hdr.num_recs);
+		fclose(f);
+		return 1;
+	}
+
+	for (i = 0; i < hdr.num_recs; i++) {
+		if (fread(&recs[n], sizeof(*recs), 1, f) != 1)
+			break;
+		/* unused or partially written records have seq 0 */
+		if (recs[n].seq)
+			n++;
+	}
+	fclose(f);
+
+	qsort(recs, n, sizeof(*recs), rec_cmp);
+
+	for (i = 0; i < n; i++)
+		if (!lost_only || (recs[i].event != OSM_MAD_TRACE_SEND &&
+				   recs[i].event != OSM_MAD_TRACE_RECV))
+			print_rec(stdout, &recs[i]);
+
+	if ((uint32_t) hdr.next_seq > hdr.num_recs)
+		fprintf(stderr, "%u older records were overwritten\n",
+			(uint32_t) hdr.next_seq - hdr.num_recs);
+
+	free(recs);
+	return 0;
+}
@@ -59,6 +59,7 @@
 
 struct  plugin_t {
 	osm_opensm_t *osm;
+	osm_routing_exec_t *exec;
 };
 
 /*
@@ -167,6 +168,11 @@ int routing_engine_setup(
 	OSM_LOG(&plugin->osm->log, OSM_LOG_INFO,
 		"Setting up the plugin as a new routing engine...\n");
 
+	/* plugin_path_sl only reads the context and logs, so SA threads
+	   may call it concurrently */
+	engine->flags = OSM_ROUTING_ENGINE_PATH_SL_MT_SAFE;
+	plugin->exec = engine->exec;
+
 	engine->build_lid_matrices = plugin_build_lid_matrices;
 	engine->ucast_build_fwd_tables = plugin_ucast_build_fwd_tables;
 	engine->ucast_dump_tables = plugin_ucast_dump_tables;
@@ -195,8 +201,15 @@ static int plugin_ucast_build_fwd_tables(
 {
 	struct plugin_t *plugin = (struct plugin_t *) context;
 
+	if (osm_routing_exec_cancelled(plugin->exec))
+		return -1;
+
+	/* routes may be computed with cl_work_pool_parallel_for on
+	   plugin->exec->pool, using osm_routing_exec_scratch for per
+	   worker memory */
 	OSM_LOG(&plugin->osm->log, OSM_LOG_INFO,
-		"Building Forwarding tables...\n");
+		"Building Forwarding tables with %u routing threads...\n",
+		plugin->exec->num_workers);
 	return 0;
 }
 